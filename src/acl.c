@@ -0,0 +1,655 @@
+//
+// access control lists
+//
+// the acl file has one rule per line, the first matched rule in file order wins:
+//
+//     # action  [src <prefix>] [dst <prefix>] [qtype <type>] [qname <suffix>]
+//     allow     src 10.0.0.0/8
+//     drop      src 192.0.2.0/24 dst 198.51.100.53/32
+//     refuse    qtype ANY
+//     drop      qname attack.example.com.
+//
+// action is one of allow, drop(no response) and refuse(REFUSED response).
+// the rules only having src and dst are packet rules, they are compiled into rte_acl
+// contexts(one for ipv4, one for ipv6) on every numa node, the lcores classify a whole
+// RX burst in one rte_acl_classify call. the rules having qtype or qname are query rules,
+// they are checked after the question is decoded, dst can't be used in query rules.
+// the packet rules before the first query rule are decided in RX burst(the denied packets
+// are dropped before they are parsed), a packet rule after a query rule is only remembered
+// in RX burst and decided with the query rules, so the query rules before it still win.
+// the hit counters belong to lcores, so they are updated without atomic operations,
+// they are reset when the file is reloaded(admin `acl reload`), the new tables are
+// published by rcu_assign_pointer.
+//
+
+#include <ctype.h>
+#include <rte_acl.h>
+
+#include "shuke.h"
+#include "utils.h"
+
+DEF_LOG_MODULE(RTE_LOGTYPE_USER1, "ACL");
+
+typedef struct {
+    aclAction action;
+    bool has_src;
+    bool has_dst;
+    addrPrefix src;
+    addrPrefix dst;
+    // 0 matches all types
+    uint16_t qtype;
+    // the length of qname suffix(len label, including the terminating zero), 0 matches all names.
+    uint16_t qname_len;
+    char qname[MAX_DOMAIN_LEN+2];
+} aclRule;
+
+// the first field of rte_acl rules must be one byte long.
+enum {
+    ACL4_PROTO_FIELD, ACL4_SRC_FIELD, ACL4_DST_FIELD, NUM_ACL4_FIELDS
+};
+
+enum {
+    ACL6_PROTO_FIELD,
+    ACL6_SRC0_FIELD, ACL6_SRC1_FIELD, ACL6_SRC2_FIELD, ACL6_SRC3_FIELD,
+    ACL6_DST0_FIELD, ACL6_DST1_FIELD, ACL6_DST2_FIELD, ACL6_DST3_FIELD,
+    NUM_ACL6_FIELDS
+};
+
+RTE_ACL_RULE_DEF(acl4Rule, NUM_ACL4_FIELDS);
+RTE_ACL_RULE_DEF(acl6Rule, NUM_ACL6_FIELDS);
+
+// the offsets are relative to the protocol field of ip header.
+static struct rte_acl_field_def acl4Defs[NUM_ACL4_FIELDS] = {
+    {
+        .type = RTE_ACL_FIELD_TYPE_BITMASK, .size = sizeof(uint8_t),
+        .field_index = ACL4_PROTO_FIELD, .input_index = 0, .offset = 0,
+    },
+    {
+        .type = RTE_ACL_FIELD_TYPE_MASK, .size = sizeof(uint32_t),
+        .field_index = ACL4_SRC_FIELD, .input_index = 1,
+        .offset = offsetof(struct ipv4_hdr, src_addr) - offsetof(struct ipv4_hdr, next_proto_id),
+    },
+    {
+        .type = RTE_ACL_FIELD_TYPE_MASK, .size = sizeof(uint32_t),
+        .field_index = ACL4_DST_FIELD, .input_index = 2,
+        .offset = offsetof(struct ipv4_hdr, dst_addr) - offsetof(struct ipv4_hdr, next_proto_id),
+    },
+};
+
+#define ACL6_ADDR_DEF(idx, member, i) {                                                 \
+        .type = RTE_ACL_FIELD_TYPE_MASK, .size = sizeof(uint32_t),                      \
+        .field_index = (idx), .input_index = (idx),                                     \
+        .offset = offsetof(struct ipv6_hdr, member) - offsetof(struct ipv6_hdr, proto)  \
+                  + (i) * sizeof(uint32_t),                                             \
+    }
+
+static struct rte_acl_field_def acl6Defs[NUM_ACL6_FIELDS] = {
+    {
+        .type = RTE_ACL_FIELD_TYPE_BITMASK, .size = sizeof(uint8_t),
+        .field_index = ACL6_PROTO_FIELD, .input_index = 0, .offset = 0,
+    },
+    ACL6_ADDR_DEF(ACL6_SRC0_FIELD, src_addr, 0),
+    ACL6_ADDR_DEF(ACL6_SRC1_FIELD, src_addr, 1),
+    ACL6_ADDR_DEF(ACL6_SRC2_FIELD, src_addr, 2),
+    ACL6_ADDR_DEF(ACL6_SRC3_FIELD, src_addr, 3),
+    ACL6_ADDR_DEF(ACL6_DST0_FIELD, dst_addr, 0),
+    ACL6_ADDR_DEF(ACL6_DST1_FIELD, dst_addr, 1),
+    ACL6_ADDR_DEF(ACL6_DST2_FIELD, dst_addr, 2),
+    ACL6_ADDR_DEF(ACL6_DST3_FIELD, dst_addr, 3),
+};
+
+/*
+ * rules[1..nr_rules] is a copy of the rules on the numa node, the id of a rule
+ * is the userdata of rte_acl rule. every lcore of the numa node has a row of
+ * hit counters, the row of an lcore is hits[(lcore_id - start_lcore) * stride],
+ * the rows are padded to cache lines.
+ */
+struct aclTable_s {
+    int socket_id;
+    struct rte_acl_ctx *acx4;
+    struct rte_acl_ctx *acx6;
+    int nr_rules;
+    aclRule *rules;
+    int nr_packet_rules;
+    uint32_t *packet_rules;
+    int nr_query_rules;
+    uint32_t *query_rules;
+    // the id of the first query rule(nr_rules+1 if none), the packet rules
+    // before it are decided in RX burst.
+    uint32_t first_query_rule;
+
+    int start_lcore;
+    int nr_rows;
+    size_t stride;
+    uint64_t *hits;
+    struct rcu_head rcu_head;
+};
+
+// only accessed by main thread.
+static struct {
+    unsigned generation;            // makes the names of rte_acl contexts unique
+    long load_ts;
+    int nr_rules;
+    sds *texts;                     // texts[1..nr_rules]
+} acl;
+
+static const char *aclActionToStr(aclAction action) {
+    switch (action) {
+        case ACL_ALLOW:
+            return "allow";
+        case ACL_DROP:
+            return "drop";
+        case ACL_REFUSE:
+            return "refuse";
+        default:
+            return "none";
+    }
+}
+
+static inline bool isPacketRule(aclRule *r) {
+    return r->qtype == 0 && r->qname_len == 0;
+}
+
+static inline uint64_t *aclLcoreHits(aclTable *t, unsigned lcore_id) {
+    int row = (int)lcore_id - t->start_lcore;
+    if (row < 0 || row >= t->nr_rows) return NULL;
+    return t->hits + (size_t)row * t->stride;
+}
+
+static void aclTableDestroy(aclTable *t) {
+    if (t == NULL) return;
+    if (t->acx4) rte_acl_free(t->acx4);
+    if (t->acx6) rte_acl_free(t->acx6);
+    socket_free(t->socket_id, t->rules);
+    socket_free(t->socket_id, t->packet_rules);
+    socket_free(t->socket_id, t->query_rules);
+    socket_free(t->socket_id, t->hits);
+    zfree(t);
+}
+
+static void aclTableFreeCallback(struct rcu_head *head) {
+    aclTable *t = caa_container_of(head, aclTable, rcu_head);
+    aclTableDestroy(t);
+}
+
+static inline void setMaskField(struct rte_acl_field *f, bool has, addrPrefix *p, int i) {
+    int bits;
+
+    if (!has) {
+        f->value.u32 = 0;
+        f->mask_range.u32 = 0;
+        return;
+    }
+    bits = p->prefix - i * 32;
+    bits = bits < 0? 0: (bits > 32? 32: bits);
+    // rte_acl takes the rules in host byte order.
+    f->value.u32 = bits? load32be((char *)p->addr + i * 4): 0;
+    f->mask_range.u32 = (uint32_t)bits;
+}
+
+static struct rte_acl_ctx *aclCtxCreate(char *errstr, int socket_id, bool is_ipv4,
+                                        aclRule *rules, uint32_t *ids, int n)
+{
+    char name[RTE_ACL_NAMESIZE];
+    int nr_fields = is_ipv4? NUM_ACL4_FIELDS: NUM_ACL6_FIELDS;
+    struct rte_acl_param param = {
+        .name = name,
+        .socket_id = socket_id,
+        .rule_size = is_ipv4? RTE_ACL_RULE_SZ(NUM_ACL4_FIELDS): RTE_ACL_RULE_SZ(NUM_ACL6_FIELDS),
+        .max_rule_num = (uint32_t)n,
+    };
+    struct rte_acl_config config;
+    struct rte_acl_ctx *acx;
+    struct acl6Rule r;
+    int ret;
+
+    snprintf(name, sizeof(name), "acl%c_%d_%u", is_ipv4? '4': '6', socket_id, acl.generation);
+    if ((acx = rte_acl_create(&param)) == NULL) {
+        snprintf(errstr, ERR_STR_LEN, "can't create acl context on socket %d: %s", socket_id, rte_strerror(rte_errno));
+        return NULL;
+    }
+    for (int i = 0; i < n; ++i) {
+        aclRule *ar = rules + ids[i];
+        memset(&r, 0, sizeof(r));
+        r.data.userdata = ids[i];
+        r.data.category_mask = 1;
+        // the first rule has the highest priority.
+        r.data.priority = RTE_ACL_MAX_PRIORITY - (int32_t)ids[i];
+        // the protocol field matches all values.
+        r.field[0].value.u8 = 0;
+        r.field[0].mask_range.u8 = 0;
+        if (is_ipv4) {
+            setMaskField(&r.field[ACL4_SRC_FIELD], ar->has_src, &ar->src, 0);
+            setMaskField(&r.field[ACL4_DST_FIELD], ar->has_dst, &ar->dst, 0);
+        } else {
+            for (int j = 0; j < 4; ++j) {
+                setMaskField(&r.field[ACL6_SRC0_FIELD+j], ar->has_src, &ar->src, j);
+                setMaskField(&r.field[ACL6_DST0_FIELD+j], ar->has_dst, &ar->dst, j);
+            }
+        }
+        // acl4Rule is the prefix of acl6Rule.
+        if ((ret = rte_acl_add_rules(acx, (struct rte_acl_rule *)&r, 1)) != 0) {
+            snprintf(errstr, ERR_STR_LEN, "can't add rule %u to acl context: %s", ids[i], strerror(-ret));
+            goto error;
+        }
+    }
+    memset(&config, 0, sizeof(config));
+    config.num_categories = 1;
+    config.num_fields = (uint32_t)nr_fields;
+    memcpy(config.defs, is_ipv4? acl4Defs: acl6Defs, nr_fields * sizeof(struct rte_acl_field_def));
+    if ((ret = rte_acl_build(acx, &config)) != 0) {
+        snprintf(errstr, ERR_STR_LEN, "can't build acl context on socket %d: %s", socket_id, strerror(-ret));
+        goto error;
+    }
+    return acx;
+
+error:
+    rte_acl_free(acx);
+    return NULL;
+}
+
+/*
+ * build the table of a numa node, the packet rules without address apply
+ * to both families.
+ */
+static aclTable *aclTableCreate(char *errstr, int socket_id, aclRule *rules, int n) {
+    numaNode_t *node = sk.nodes[socket_id];
+    aclTable *t = zcalloc(sizeof(*t));
+    uint32_t *ids4 = zmalloc((n + 1) * sizeof(uint32_t));
+    uint32_t *ids6 = zmalloc((n + 1) * sizeof(uint32_t));
+    int n4 = 0, n6 = 0;
+
+    t->socket_id = socket_id;
+    t->nr_rules = n;
+    t->rules = socket_memdup(socket_id, rules, (n + 1) * sizeof(aclRule));
+    t->packet_rules = socket_calloc(socket_id, (size_t)n + 1, sizeof(uint32_t));
+    t->query_rules = socket_calloc(socket_id, (size_t)n + 1, sizeof(uint32_t));
+    t->first_query_rule = (uint32_t)n + 1;
+    for (uint32_t id = 1; id <= (uint32_t)n; ++id) {
+        aclRule *r = rules + id;
+        if (!isPacketRule(r)) {
+            if (t->nr_query_rules == 0) t->first_query_rule = id;
+            t->query_rules[t->nr_query_rules++] = id;
+            continue;
+        }
+        t->packet_rules[t->nr_packet_rules++] = id;
+        int af = r->has_src? r->src.af: (r->has_dst? r->dst.af: AF_UNSPEC);
+        if (af != AF_INET6) ids4[n4++] = id;
+        if (af != AF_INET) ids6[n6++] = id;
+    }
+    acl.generation++;
+    if (n4 > 0 && (t->acx4 = aclCtxCreate(errstr, socket_id, true, rules, ids4, n4)) == NULL) goto error;
+    if (n6 > 0 && (t->acx6 = aclCtxCreate(errstr, socket_id, false, rules, ids6, n6)) == NULL) goto error;
+
+    // 8 counters per cache line.
+    t->stride = (size_t)(n + 1 + 7) & ~(size_t)7;
+    t->start_lcore = node->min_lcore_id;
+    t->nr_rows = node->max_lcore_id - node->min_lcore_id + 1;
+    t->hits = socket_calloc(socket_id, t->stride * t->nr_rows, sizeof(uint64_t));
+    zfree(ids4);
+    zfree(ids6);
+    return t;
+
+error:
+    zfree(ids4);
+    zfree(ids6);
+    aclTableDestroy(t);
+    return NULL;
+}
+
+static int parseQname(const char *ss, aclRule *r) {
+    char buf[MAX_DOMAIN_LEN+2];
+    size_t len = strlen(ss);
+
+    if (len == 0 || len > MAX_DOMAIN_LEN || strstr(ss, "..") != NULL) return ERR_CODE;
+    if (strcmp(ss, ".") == 0) {
+        // the root matches all names.
+        r->qname_len = 0;
+        return OK_CODE;
+    }
+    if (ss[0] == '.') return ERR_CODE;
+    memcpy(buf, ss, len + 1);
+    if (buf[len-1] != '.') {
+        if (len == MAX_DOMAIN_LEN) return ERR_CODE;
+        buf[len++] = '.';
+        buf[len] = 0;
+    }
+    for (char *p = buf, *dot; *p; p = dot + 1) {
+        dot = strchr(p, '.');
+        if (dot - p > 63) return ERR_CODE;
+    }
+    dot2lenlabel(buf, r->qname);
+    r->qname_len = (uint16_t)(len + 1);
+    return OK_CODE;
+}
+
+static int parseAclRule(char *errstr, sds *argv, int argc, aclRule *r) {
+    int ty;
+
+    memset(r, 0, sizeof(*r));
+    if (strcasecmp(argv[0], "allow") == 0) r->action = ACL_ALLOW;
+    else if (strcasecmp(argv[0], "drop") == 0) r->action = ACL_DROP;
+    else if (strcasecmp(argv[0], "refuse") == 0) r->action = ACL_REFUSE;
+    else {
+        snprintf(errstr, ERR_STR_LEN, "unknown action %s.", argv[0]);
+        return ERR_CODE;
+    }
+    if (argc % 2 == 0) {
+        snprintf(errstr, ERR_STR_LEN, "%s needs a value.", argv[argc-1]);
+        return ERR_CODE;
+    }
+    for (int i = 1; i < argc; i += 2) {
+        if (strcasecmp(argv[i], "src") == 0) {
+            if (parseAddrPrefix(argv[i+1], &r->src) == ERR_CODE) goto invalid;
+            r->has_src = true;
+        } else if (strcasecmp(argv[i], "dst") == 0) {
+            if (parseAddrPrefix(argv[i+1], &r->dst) == ERR_CODE) goto invalid;
+            r->has_dst = true;
+        } else if (strcasecmp(argv[i], "qtype") == 0) {
+            if ((ty = strToQtype(argv[i+1])) == ERR_CODE) goto invalid;
+            r->qtype = (uint16_t)ty;
+        } else if (strcasecmp(argv[i], "qname") == 0) {
+            if (parseQname(argv[i+1], r) == ERR_CODE) goto invalid;
+        } else {
+            snprintf(errstr, ERR_STR_LEN, "unknown field %s.", argv[i]);
+            return ERR_CODE;
+        }
+        continue;
+invalid:
+        snprintf(errstr, ERR_STR_LEN, "invalid %s %s.", argv[i], argv[i+1]);
+        return ERR_CODE;
+    }
+    if (r->has_src && r->has_dst && r->src.af != r->dst.af) {
+        snprintf(errstr, ERR_STR_LEN, "src and dst are not in the same address family.");
+        return ERR_CODE;
+    }
+    // the destination address is not kept after the packet is classified.
+    if (r->has_dst && !isPacketRule(r)) {
+        snprintf(errstr, ERR_STR_LEN, "dst can't be used with qtype or qname.");
+        return ERR_CODE;
+    }
+    return OK_CODE;
+}
+
+/*
+ * rules[0] is unused, so the index of a rule is its id.
+ */
+static int parseAclFile(char *errstr, const char *fname, aclRule **rulesp, sds **textsp, int *np) {
+    FILE *fp;
+    char *line = NULL;
+    size_t cap = 0;
+    int lineno = 0, n = 0, max = 0, argc;
+    sds *argv = NULL;
+    aclRule *rules = NULL;
+    sds *texts = NULL;
+    char err[ERR_STR_LEN];
+
+    if ((fp = fopen(fname, "r")) == NULL) {
+        snprintf(errstr, ERR_STR_LEN, "can't open acl file %s: %s", fname, strerror(errno));
+        return ERR_CODE;
+    }
+    while (getline(&line, &cap, fp) != -1) {
+        lineno++;
+        char *comment = strchr(line, '#');
+        if (comment) *comment = 0;
+        argv = sdssplitargs(line, &argc);
+        if (argv == NULL) {
+            snprintf(errstr, ERR_STR_LEN, "line %d of %s: unbalanced quotes.", lineno, fname);
+            goto error;
+        }
+        if (argc == 0) {
+            sdsfreesplitres(argv, argc);
+            continue;
+        }
+        if (n == ACL_MAX_RULES) {
+            snprintf(errstr, ERR_STR_LEN, "line %d of %s: too many rules(max %d).", lineno, fname, ACL_MAX_RULES);
+            goto error;
+        }
+        if (n + 1 >= max) {
+            max = max? max * 2: 64;
+            rules = zrealloc(rules, max * sizeof(*rules));
+            texts = zrealloc(texts, max * sizeof(*texts));
+        }
+        n++;
+        texts[n] = NULL;
+        if (parseAclRule(err, argv, argc, rules + n) == ERR_CODE) {
+            snprintf(errstr, ERR_STR_LEN, "line %d of %s: %s", lineno, fname, err);
+            goto error;
+        }
+        texts[n] = sdsjoin(argv, argc, (char *)" ");
+        sdsfreesplitres(argv, argc);
+    }
+    argv = NULL;
+    if (n == 0) {
+        rules = zrealloc(rules, sizeof(*rules));
+        texts = zrealloc(texts, sizeof(*texts));
+    }
+    memset(rules, 0, sizeof(*rules));
+    texts[0] = NULL;
+    *rulesp = rules;
+    *textsp = texts;
+    *np = n;
+    free(line);
+    fclose(fp);
+    return OK_CODE;
+
+error:
+    if (argv) sdsfreesplitres(argv, argc);
+    free(line);
+    fclose(fp);
+    for (int i = 1; i <= n; ++i) sdsfree(texts[i]);
+    zfree(texts);
+    zfree(rules);
+    return ERR_CODE;
+}
+
+/*!
+ * (re)load the acl file, the tables of all numa nodes are replaced only if
+ * all of them are built successfully, otherwise the old tables are kept.
+ * must be called in main thread.
+ */
+int loadAcl(char *errstr) {
+    aclRule *rules = NULL;
+    sds *texts = NULL;
+    aclTable *tables[MAX_NUMA_NODES] = {NULL};
+    int n = 0, i, numa_id, nr_query = 0;
+
+    if (sk.acl_file == NULL) return OK_CODE;
+    if (parseAclFile(errstr, sk.acl_file, &rules, &texts, &n) == ERR_CODE) return ERR_CODE;
+
+    for (i = 0; i < sk.nr_numa_id; ++i) {
+        numa_id = sk.numa_ids[i];
+        if ((tables[numa_id] = aclTableCreate(errstr, numa_id, rules, n)) == NULL) goto error;
+    }
+    for (i = 0; i < sk.nr_numa_id; ++i) {
+        numa_id = sk.numa_ids[i];
+        aclTable *old = sk.nodes[numa_id]->acl;
+        rcu_assign_pointer(sk.nodes[numa_id]->acl, tables[numa_id]);
+        if (old) call_rcu(&old->rcu_head, aclTableFreeCallback);
+    }
+
+    for (i = 1; i <= acl.nr_rules; ++i) sdsfree(acl.texts[i]);
+    zfree(acl.texts);
+    acl.texts = texts;
+    acl.nr_rules = n;
+    acl.load_ts = sk.unixtime;
+    for (i = 1; i <= n; ++i) {
+        if (!isPacketRule(rules + i)) nr_query++;
+    }
+    LOG_INFO("load %d rules(packet: %d, query: %d) from acl file %s.", n, n - nr_query, nr_query, sk.acl_file);
+    zfree(rules);
+    return OK_CODE;
+
+error:
+    for (i = 0; i < sk.nr_numa_id; ++i) aclTableDestroy(tables[sk.numa_ids[i]]);
+    for (i = 1; i <= n; ++i) sdsfree(texts[i]);
+    zfree(texts);
+    zfree(rules);
+    return ERR_CODE;
+}
+
+/*!
+ * classify the ipv4 and ipv6 packets of an RX burst against the packet rules,
+ * one rte_acl_classify call per address family. the packets dropped by the rules
+ * before the first query rule are freed and removed from pkts, the id of matched
+ * rule(0 if none) of the remaining packets is stored in matched.
+ *
+ * @return the number of remaining packets.
+ */
+int aclFilterBurst(aclTable *t, unsigned lcore_id, struct rte_mbuf **pkts, int n, uint32_t *matched) {
+    const uint8_t *data4[MAX_PKT_BURST], *data6[MAX_PKT_BURST];
+    uint32_t res4[MAX_PKT_BURST], res6[MAX_PKT_BURST];
+    uint8_t idx4[MAX_PKT_BURST], idx6[MAX_PKT_BURST];
+    uint32_t n4 = 0, n6 = 0, i;
+    uint64_t *hits = aclLcoreHits(t, lcore_id);
+    int j = 0;
+
+    for (i = 0; i < (uint32_t)n; ++i) {
+        struct ether_hdr *eth_h = rte_pktmbuf_mtod(pkts[i], struct ether_hdr *);
+        matched[i] = 0;
+        if (eth_h->ether_type == rte_cpu_to_be_16(ETHER_TYPE_IPv4)) {
+            struct ipv4_hdr *ipv4_h = (struct ipv4_hdr *)(eth_h + 1);
+            data4[n4] = &ipv4_h->next_proto_id;
+            idx4[n4++] = (uint8_t)i;
+        } else if (eth_h->ether_type == rte_cpu_to_be_16(ETHER_TYPE_IPv6)) {
+            struct ipv6_hdr *ipv6_h = (struct ipv6_hdr *)(eth_h + 1);
+            data6[n6] = &ipv6_h->proto;
+            idx6[n6++] = (uint8_t)i;
+        }
+    }
+    if (n4 > 0 && t->acx4 != NULL) {
+        rte_acl_classify(t->acx4, data4, res4, n4, 1);
+        for (i = 0; i < n4; ++i) matched[idx4[i]] = res4[i];
+    }
+    if (n6 > 0 && t->acx6 != NULL) {
+        rte_acl_classify(t->acx6, data6, res6, n6, 1);
+        for (i = 0; i < n6; ++i) matched[idx6[i]] = res6[i];
+    }
+    for (i = 0; i < (uint32_t)n; ++i) {
+        uint32_t id = matched[i];
+        // the rules after a query rule are counted and enforced by aclCheckQuery.
+        if (id != 0 && id < t->first_query_rule) {
+            if (hits) hits[id]++;
+            if (t->rules[id].action == ACL_DROP) {
+                rte_pktmbuf_free(pkts[i]);
+                continue;
+            }
+        }
+        pkts[j] = pkts[i];
+        matched[j++] = id;
+    }
+    return j;
+}
+
+static inline bool qnameHasSuffix(struct context *ctx, aclRule *r) {
+    size_t name_len = ctx->nameLen + 1;
+    size_t off = 0;
+
+    // the suffix must start at a label boundary.
+    while (name_len - off > r->qname_len) off += (uint8_t)ctx->name[off] + 1;
+    if (name_len - off != r->qname_len) return false;
+    for (size_t i = 0; i < r->qname_len; ++i) {
+        if (tolower((unsigned char)ctx->name[off+i]) != tolower((unsigned char)r->qname[i])) return false;
+    }
+    return true;
+}
+
+static inline bool aclRuleMatchSrc(aclRule *r, struct context *ctx) {
+    return !r->has_src || addrPrefixMatch(&r->src, ctx->src_addr, ctx->src_ipv4);
+}
+
+/*!
+ * check the decoded query, the rules are evaluated in file order. the packet
+ * rule matched in RX burst(ctx->acl_rule) is already decided if it precedes all
+ * query rules, otherwise the query rules before it are checked first. the packets
+ * not classified in RX burst(tcp) are checked against the packet rules by source
+ * address here.
+ */
+aclAction aclCheckQuery(aclTable *t, struct context *ctx) {
+    uint64_t *hits = aclLcoreHits(t, (unsigned)ctx->lcore_id);
+    uint32_t id = ctx->acl_rule;
+    aclRule *r;
+    int i;
+
+    if (unlikely(id == ACL_RULE_UNKNOWN)) {
+        id = 0;
+        for (i = 0; i < t->nr_packet_rules; ++i) {
+            r = t->rules + t->packet_rules[i];
+            if (!r->has_dst && aclRuleMatchSrc(r, ctx)) {
+                id = t->packet_rules[i];
+                break;
+            }
+        }
+    } else if (id != 0 && id < t->first_query_rule) {
+        // counted in RX burst.
+        return t->rules[id].action;
+    }
+
+    for (i = 0; i < t->nr_query_rules; ++i) {
+        uint32_t qid = t->query_rules[i];
+        if (id != 0 && qid > id) break;
+        r = t->rules + qid;
+        if (r->qtype != 0 && r->qtype != ctx->qType) continue;
+        if (r->qname_len != 0 && !qnameHasSuffix(ctx, r)) continue;
+        if (!aclRuleMatchSrc(r, ctx)) continue;
+        if (hits) hits[qid]++;
+        return r->action;
+    }
+    if (id != 0) {
+        if (hits) hits[id]++;
+        return t->rules[id].action;
+    }
+    return ACL_NONE;
+}
+
+/*
+ * sum the hit counters of all lcores, the counters are read without locks,
+ * the values may be a little stale. must be called in main thread.
+ */
+static void aclGetHits(uint64_t *hits) {
+    memset(hits, 0, (acl.nr_rules + 1) * sizeof(uint64_t));
+    rcu_read_lock();
+    for (int i = 0; i < sk.nr_numa_id; ++i) {
+        aclTable *t = rcu_dereference(sk.nodes[sk.numa_ids[i]]->acl);
+        if (t == NULL || t->nr_rules != acl.nr_rules) continue;
+        for (int row = 0; row < t->nr_rows; ++row) {
+            uint64_t *h = t->hits + (size_t)row * t->stride;
+            for (int id = 1; id <= t->nr_rules; ++id) hits[id] += h[id];
+        }
+    }
+    rcu_read_unlock();
+}
+
+sds aclToStr(void) {
+    sds s = sdsempty();
+    uint64_t *hits;
+
+    if (sk.acl_file == NULL) return sdscat(s, "acl file is not configured.\n");
+    hits = zmalloc((acl.nr_rules + 1) * sizeof(uint64_t));
+    aclGetHits(hits);
+    s = sdscatprintf(s, "file: %s\nload_time: %ld\nrules: %d\n", sk.acl_file, acl.load_ts, acl.nr_rules);
+    for (int id = 1; id <= acl.nr_rules; ++id) {
+        s = sdscatprintf(s, "%d: %s (hits: %llu)\n", id, acl.texts[id], (unsigned long long)hits[id]);
+    }
+    zfree(hits);
+    return s;
+}
+
+sds aclGenMetrics(sds s) {
+    uint64_t *hits;
+
+    if (sk.acl_file == NULL) return s;
+    hits = zmalloc((acl.nr_rules + 1) * sizeof(uint64_t));
+    aclGetHits(hits);
+    s = sdscatprintf(s, "# HELP shuke_acl_hits_total %s\n# TYPE shuke_acl_hits_total counter\n",
+                     "Packets(packet rules) or queries(query rules) matched by the acl rule, reset by reload.");
+    rcu_read_lock();
+    aclTable *t = rcu_dereference(sk.nodes[sk.master_numa_id]->acl);
+    for (int id = 1; t != NULL && id <= acl.nr_rules && id <= t->nr_rules; ++id) {
+        s = sdscatprintf(s, "shuke_acl_hits_total{rule=\"%d\",action=\"%s\"} %llu\n",
+                         id, aclActionToStr(t->rules[id].action), (unsigned long long)hits[id]);
+    }
+    rcu_read_unlock();
+    zfree(hits);
+    return s;
+}
@@ -0,0 +1,33 @@
+//
+// access control of queries, the rules are classified per RX burst.
+//
+
+#ifndef SHUKE_ACL_H
+#define SHUKE_ACL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sds.h"
+
+#define ACL_MAX_RULES       (4096)
+// the packet is not classified in RX burst(tcp queries, or no table when the burst is received).
+#define ACL_RULE_UNKNOWN    (0xffffffffU)
+
+typedef enum {
+    ACL_NONE = 0,       // no rule matches
+    ACL_ALLOW,
+    ACL_DROP,
+    ACL_REFUSE,
+} aclAction;
+
+struct rte_mbuf;
+struct context;
+typedef struct aclTable_s aclTable;
+
+int loadAcl(char *errstr);
+int aclFilterBurst(aclTable *t, unsigned lcore_id, struct rte_mbuf **pkts, int n, uint32_t *matched);
+aclAction aclCheckQuery(aclTable *t, struct context *ctx);
+sds aclToStr(void);
+sds aclGenMetrics(sds s);
+
+#endif //SHUKE_ACL_H
@@ -49,6 +49,9 @@ static void infoCommand(int argc, char *argv[], adminConn *c);
 static void debugCommand(int argc, char *argv[], adminConn *c);
 static void zoneCommand(int argc, char *argv[], adminConn *c);
 static void configCommand(int argc, char *argv[], adminConn *c);
+static void topCommand(int argc, char *argv[], adminConn *c);
+static void viewCommand(int argc, char *argv[], adminConn *c);
+static void aclCommand(int argc, char *argv[], adminConn *c);
 
 typedef void adminCommandProc(int argc, char *argv[], adminConn *c);
 typedef struct {
@@ -61,7 +64,10 @@ static adminCommand adminCommandTable[] = {
     {(char *)"debug", debugCommand},
     {(char *)"info", infoCommand},
     {(char *)"zone", zoneCommand},
-    {(char *)"config", configCommand}
+    {(char *)"config", configCommand},
+    {(char *)"top", topCommand},
+    {(char *)"view", viewCommand},
+    {(char *)"acl", aclCommand}
 };
 
 static inline void adminConnMoveTail(adminConn *c) {
@@ -471,20 +477,44 @@ static sds genInfoString(char *section) {
                              stat.free_count,
                              stat.alloc_count);
         }
+
+        ltreeReclaimStats rstat;
+        char pending_hmem[64];
+        ltreeGetReclaimStats(&rstat);
+        bytesToHuman(pending_hmem, rstat.pending_bytes);
+        s = sdscatprintf(s,
+                         "#RCU Reclamation\r\n"
+                         "rcu_pending_nodes:%lu\r\n"
+                         "rcu_pending_bytes:%lu\r\n"
+                         "rcu_pending_bytes_human:%s\r\n"
+                         "rcu_reclaimed_nodes:%lu\r\n"
+                         "rcu_reclaimed_bytes:%llu\r\n"
+                         "rcu_gp_latency_avg_us:%llu\r\n"
+                         "rcu_gp_latency_max_us:%llu\r\n"
+                         "rcu_gp_latency_last_us:%llu\r\n",
+                         rstat.pending_nodes,
+                         rstat.pending_bytes,
+                         pending_hmem,
+                         rstat.reclaimed_nodes,
+                         rstat.reclaimed_bytes,
+                         rstat.reclaimed_nodes? rstat.gp_latency_us_total/rstat.reclaimed_nodes: 0,
+                         rstat.gp_latency_us_max,
+                         rstat.gp_latency_us_last);
+
+        s = sdscat(s, "#RRSet Pool\r\n");
+        for (int i = 0; i < sk.nr_numa_id; ++i) {
+            int numa_id = sk.numa_ids[i];
+            size_t nr_rrsets, nr_refs, pool_bytes;
+            RRSetPoolGetStats(numa_id, &nr_rrsets, &nr_refs, &pool_bytes);
+            s = sdscatprintf(s, "rrset_pool_%d:rrsets=%lu,refs=%lu,bytes=%lu\r\n",
+                             numa_id, nr_rrsets, nr_refs, pool_bytes);
+        }
     }
 
     // statistics
     if (allsections || defsections || (strcasecmp(section, "stats") == 0)) {
         if (sections++) s = sdscat(s, "\r\n");
-        static int64_t prev_nr_req = 0;
-        static int64_t prev_nr_dropped = 0;
-        long long prev_ms = sk.last_collect_ms;
-
-        collectStats();
-
-        int64_t interval = (int64_t)(sk.last_collect_ms - prev_ms);
-        if (unlikely(interval == 0)) interval = 1;
-
+        // collected by main thread cron, reading them doesn't change the rates.
         int64_t nr_req = sk.nr_req;
         int64_t nr_dropped = sk.nr_dropped;
          s = sdscatprintf(s,
@@ -498,11 +528,23 @@ static sds genInfoString(char *section) {
                           (long long)nr_req,
                           (long long)nr_dropped,
                           (long long unsigned)(nr_req/uptime),
-                          (long long unsigned)((nr_req - prev_nr_req)/(interval/1000.0)),
-                          (long long unsigned)((nr_dropped - prev_nr_dropped)/(interval/1000.0)),
+                          (long long unsigned)sk.qps,
+                          (long long unsigned)sk.dropped_qps,
                           ltreeGetNumZones(sk.lt));
-        prev_nr_req = nr_req;
-        prev_nr_dropped = nr_dropped;
+
+        // only the qtypes and rcodes ever seen
+        char name[32];
+        s = sdscat(s, "\r\n# Query stats\r\n");
+        for (int i = 0; i < NR_QTYPES; ++i) {
+            if (sk.nr_qtype[i] == 0) continue;
+            s = sdscatprintf(s, "qtype_%s:%lld\r\n", qtypeToStr(i, name, sizeof(name)),
+                             (long long)sk.nr_qtype[i]);
+        }
+        for (int i = 0; i < NR_RCODES; ++i) {
+            if (sk.nr_rcode[i] == 0) continue;
+            s = sdscatprintf(s, "rcode_%s:%lld\r\n", rcodeToStr(i, name, sizeof(name)),
+                             (long long)sk.nr_rcode[i]);
+        }
 
         if (!sk.only_udp) {
             s = sdscat(s, "\r\n");
@@ -515,6 +557,35 @@ static sds genInfoString(char *section) {
                              (long long unsigned)sk.total_tcp_conn,
                              (long long unsigned)sk.rejected_tcp_conn);
         }
+        if (!sk.only_udp && sk.nr_xfr_out_allow > 0) {
+            xfrOutStats xstat;
+            xfrOutGetStats(&xstat);
+            s = sdscat(s, "\r\n");
+            s = sdscatprintf(s,
+                             "# Zone transfer stats\r\n"
+                             "xfrout_active:%lu\r\n"
+                             "xfrout_axfr:%lu\r\n"
+                             "xfrout_ixfr:%lu\r\n"
+                             "xfrout_ixfr_fallback:%lu\r\n"
+                             "xfrout_up_to_date:%lu\r\n"
+                             "xfrout_refused:%lu\r\n"
+                             "xfrout_busy:%lu\r\n"
+                             "xfrout_failed:%lu\r\n"
+                             "xfrout_bytes:%lu\r\n"
+                             "xfrout_journal_entries:%lu\r\n"
+                             "xfrout_journal_bytes:%lu\r\n",
+                             xstat.nr_active,
+                             xstat.nr_axfr,
+                             xstat.nr_ixfr,
+                             xstat.nr_ixfr_fallback,
+                             xstat.nr_up_to_date,
+                             xstat.nr_refused,
+                             xstat.nr_busy,
+                             xstat.nr_failed,
+                             xstat.nr_bytes,
+                             xstat.journal_entries,
+                             xstat.journal_bytes);
+        }
 
         struct rte_eth_stats eth_stats;
         for (int i = 0; i < sk.nr_ports; i++) {
@@ -573,6 +644,152 @@ static sds genInfoString(char *section) {
         s = sdscat(s, "\r\n");
     }
 
+    // reload worker
+    if (allsections || defsections || (strcasecmp(section, "reload") == 0)) {
+        if (sections++) s = sdscat(s, "\r\n");
+        reloaderStats rstat;
+        reloaderGetStats(&rstat);
+        s = sdscatprintf(s,
+                         "# Reload\r\n"
+                         "reload_queue_depth:%lu\r\n"
+                         "reload_running:%lu\r\n"
+                         "reload_done:%lu\r\n"
+                         "reload_failed:%lu\r\n"
+                         "reload_unchanged:%lu\r\n"
+                         "reload_build_avg_us:%lld\r\n"
+                         "reload_build_max_us:%lld\r\n"
+                         "reload_build_max_zone:%s\r\n"
+                         "reload_build_last_us:%lld\r\n"
+                         "reload_latency_avg_us:%lld\r\n"
+                         "reload_latency_max_us:%lld\r\n",
+                         rstat.nr_pending,
+                         rstat.nr_running,
+                         rstat.nr_done,
+                         rstat.nr_failed,
+                         rstat.nr_unchanged,
+                         rstat.nr_done? rstat.build_us_total/(long long)rstat.nr_done: 0,
+                         rstat.build_us_max,
+                         rstat.max_zone,
+                         rstat.build_us_last,
+                         rstat.nr_done? rstat.latency_us_total/(long long)rstat.nr_done: 0,
+                         rstat.latency_us_max);
+
+        reloadSchedStats *st = &sk.sched_stats;
+        s = sdscatprintf(s,
+                         "sched_backlog:%d\r\n"
+                         "sched_inflight:%d\r\n"
+                         "sched_max_inflight:%d\r\n"
+                         "sched_dispatched:%lu\r\n"
+                         "sched_finished:%lu\r\n"
+                         "sched_urgent:%lu\r\n"
+                         "sched_unchanged:%lu\r\n"
+                         "sched_wait_avg_us:%lld\r\n"
+                         "sched_wait_max_us:%lld\r\n"
+                         "sched_latency_avg_us:%lld\r\n"
+                         "sched_latency_max_us:%lld\r\n",
+                         sk.nr_pending_tasks,
+                         sk.nr_inflight_tasks,
+                         sk.max_inflight_reloads,
+                         st->nr_dispatched,
+                         st->nr_finished,
+                         st->nr_urgent,
+                         st->nr_unchanged,
+                         st->nr_dispatched? st->wait_us_total/(long long)st->nr_dispatched: 0,
+                         st->wait_us_max,
+                         st->nr_finished? st->latency_us_total/(long long)st->nr_finished: 0,
+                         st->latency_us_max);
+        if (strcasecmp(sk.data_store, "mongo") == 0) {
+            s = sdscatprintf(s, "mongo_conns:%d\r\nmongo_connected:%d\r\nmongo_conn_load:",
+                             sk.mongo_conns, mongoConnectedCount());
+            for (int i = 0; i < sk.mongo_conns; ++i) {
+                s = sdscatprintf(s, "%s%d", i? ",": "", sk.mongo_conn_load[i]);
+            }
+            s = sdscat(s, "\r\n");
+            if (sk.mongo_catalog) {
+                mongoCatalogStats cstat;
+                mongoGetCatalogStats(&cstat);
+                s = sdscatprintf(s,
+                                 "catalog_polls:%lu\r\n"
+                                 "catalog_failed:%lu\r\n"
+                                 "catalog_last_poll_ts:%ld\r\n"
+                                 "catalog_last_poll_us:%lld\r\n"
+                                 "catalog_zones:%lu\r\n"
+                                 "catalog_changed:%lu\r\n"
+                                 "catalog_new:%lu\r\n"
+                                 "catalog_removed:%lu\r\n",
+                                 cstat.nr_polls,
+                                 cstat.nr_failed,
+                                 cstat.last_poll_ts,
+                                 cstat.poll_us,
+                                 cstat.nr_zones,
+                                 cstat.nr_changed,
+                                 cstat.nr_new,
+                                 cstat.nr_removed);
+            }
+        }
+        if (strcasecmp(sk.data_store, "file") == 0 && sk.zone_files_watch) {
+            zoneWatcherStats wstat;
+            zoneWatcherGetStats(&wstat);
+            s = sdscatprintf(s,
+                             "watch_dirs:%d\r\n"
+                             "watch_files:%lu\r\n"
+                             "watch_pending:%lu\r\n"
+                             "watch_events:%lu\r\n"
+                             "watch_reloads:%lu\r\n"
+                             "watch_new_files:%lu\r\n"
+                             "watch_overflows:%lu\r\n",
+                             wstat.nr_dirs,
+                             wstat.nr_files,
+                             wstat.nr_pending,
+                             wstat.nr_events,
+                             wstat.nr_reloads,
+                             wstat.nr_new_files,
+                             wstat.nr_overflows);
+        }
+        if (strcasecmp(sk.data_store, "xfr") == 0) {
+            xfrinStats xstat;
+            xfrinGetStats(&xstat);
+            s = sdscatprintf(s,
+                             "xfrin_soa_queries:%lu\r\n"
+                             "xfrin_axfr:%lu\r\n"
+                             "xfrin_ixfr:%lu\r\n"
+                             "xfrin_ixfr_fallback:%lu\r\n"
+                             "xfrin_up_to_date:%lu\r\n"
+                             "xfrin_failed:%lu\r\n"
+                             "xfrin_changes:%lu\r\n"
+                             "xfrin_bytes:%lu\r\n",
+                             xstat.nr_soa_queries,
+                             xstat.nr_axfr,
+                             xstat.nr_ixfr,
+                             xstat.nr_ixfr_fallback,
+                             xstat.nr_up_to_date,
+                             xstat.nr_failed,
+                             xstat.nr_changes,
+                             xstat.nr_bytes);
+        }
+        if (sk.nr_notify_sources > 0) {
+            notifyStats nstat;
+            notifyGetStats(&nstat);
+            s = sdscatprintf(s,
+                             "notify_received:%lu\r\n"
+                             "notify_coalesced:%lu\r\n"
+                             "notify_refused:%lu\r\n"
+                             "notify_dropped:%lu\r\n"
+                             "notify_pending:%lu\r\n",
+                             nstat.nr_received,
+                             nstat.nr_coalesced,
+                             nstat.nr_refused,
+                             nstat.nr_dropped,
+                             nstat.nr_pending);
+        }
+    }
+
+    // random subdomain guard
+    if ((allsections || defsections || (strcasecmp(section, "nxguard") == 0)) && sk.nxguard_threshold > 0) {
+        if (sections++) s = sdscat(s, "\r\n");
+        s = nxguardToStr(s);
+    }
+
     // cpu usage
     if (allsections || defsections || (strcasecmp(section, "cpu") == 0)) {
         if (sections++) s = sdscat(s, "\r\n");
@@ -676,6 +893,12 @@ static void debugCommand(int argc, char *argv[], adminConn *c) {
         s = sdsnew("OK");
     } else if (strcasecmp(argv[1], "info") == 0) {
         s = genDebugInfo();
+    } else if (strcasecmp(argv[1], "ltree") == 0) {
+        s = sdsempty();
+        for (int i = 0; i < sk.nr_numa_id; ++i) {
+            if (i) s = sdscat(s, "\r\n");
+            s = ltreeStatsToStr(sk.nodes[sk.numa_ids[i]]->lt, s);
+        }
     } else {
         s = sdsnewprintf("unknown debug subcommand %s.", argv[1]);
     }
@@ -686,6 +909,106 @@ end:
     return;
 }
 
+/*
+ * top [names|clients|zones] [N]
+ */
+static void topCommand(int argc, char *argv[], adminConn *c) {
+    adminReply *rep;
+    sds s = NULL;
+    int kind = TOPK_NAME;
+    long n = 10;
+
+    if (sk.top_window <= 0) {
+        s = sdsnew("heavy hitter tracking is disabled(top_window is 0).");
+        goto end;
+    }
+    if (argc > 3) {
+        s = sdsnewprintf("TOP command needs at most 2 arguments, but got %d", argc-1);
+        goto end;
+    }
+    if (argc > 1) {
+        kind = topkKindFromStr(argv[1]);
+        if (kind < 0) {
+            s = sdsnewprintf("unknown kind(%s) for TOP command, should be names, clients or zones.", argv[1]);
+            goto end;
+        }
+    }
+    if (argc > 2 && (str2long(argv[2], &n) != OK_CODE || n <= 0)) {
+        s = sdsnewprintf("invalid count(%s) for TOP command.", argv[2]);
+        goto end;
+    }
+    s = topkToStr(kind, (int)n);
+end:
+    rep = adminReplyCreate(s);
+    adminConnAppendW(c, rep);
+}
+
+/*
+ * view [list]
+ * view reload
+ * view lookup <ip>
+ */
+static void viewCommand(int argc, char *argv[], adminConn *c) {
+    adminReply *rep;
+    sds s = NULL;
+    addrPrefix p;
+    viewTable *vt;
+    uint32_t hop = 0;
+
+    if (argc == 1 || strcasecmp(argv[1], "LIST") == 0) {
+        s = viewsToStr();
+    } else if (strcasecmp(argv[1], "RELOAD") == 0) {
+        if (sk.views_file == NULL) {
+            s = sdsnew("views file is not configured.");
+        } else if (loadViews(sk.errstr) == ERR_CODE) {
+            s = sdsnewprintf("can't reload views: %s", sk.errstr);
+        } else {
+            s = sdsnew("OK");
+        }
+    } else if (strcasecmp(argv[1], "LOOKUP") == 0) {
+        if (argc != 3 || parseAddrPrefix(argv[2], &p) == ERR_CODE) {
+            s = sdsnew("VIEW LOOKUP needs an ip address.");
+            goto end;
+        }
+        rcu_read_lock();
+        vt = rcu_dereference(sk.nodes[sk.master_numa_id]->vt);
+        if (vt) hop = viewLookup(vt, p.af == AF_INET, p.addr);
+        rcu_read_unlock();
+        if (hop) s = sdsnewprintf("%s/%d", viewIdToName(VIEW_HOP_ID(hop)), VIEW_HOP_DEPTH(hop));
+        else s = sdsnew(VIEW_DEFAULT_NAME);
+    } else {
+        s = sdsnewprintf("unknown subcommand(%s) for VIEW command.", argv[1]);
+    }
+end:
+    rep = adminReplyCreate(s);
+    adminConnAppendW(c, rep);
+}
+
+/*
+ * acl [list]
+ * acl reload
+ */
+static void aclCommand(int argc, char *argv[], adminConn *c) {
+    adminReply *rep;
+    sds s = NULL;
+
+    if (argc == 1 || strcasecmp(argv[1], "LIST") == 0) {
+        s = aclToStr();
+    } else if (strcasecmp(argv[1], "RELOAD") == 0) {
+        if (sk.acl_file == NULL) {
+            s = sdsnew("acl file is not configured.");
+        } else if (loadAcl(sk.errstr) == ERR_CODE) {
+            s = sdsnewprintf("can't reload acl: %s", sk.errstr);
+        } else {
+            s = sdsnew("OK");
+        }
+    } else {
+        s = sdsnewprintf("unknown subcommand(%s) for ACL command.", argv[1]);
+    }
+    rep = adminReplyCreate(s);
+    adminConnAppendW(c, rep);
+}
+
 static int setZoneFileInConf(char *errstr, char *dotOrigin, char *fname) {
     int err = OK_CODE;
     char *k = NULL, *v = NULL;
@@ -833,7 +1156,7 @@ static void zoneCommand(int argc, char *argv[], adminConn *c) {
         for (int i = 2; i < argc; ++i) {
             strncpy(dotOrigin, argv[i], MAX_DOMAIN_LEN);
             if (!isAbsDotDomain(dotOrigin)) strcat(dotOrigin, ".");
-            if (asyncReloadZoneRaw(dotOrigin) != OK_CODE) {
+            if (asyncReloadZoneUrgent(dotOrigin) != OK_CODE) {
                 s = sdsnewprintf("Error: %s", sk.errstr);
             }
         }
@@ -850,6 +1173,79 @@ static void zoneCommand(int argc, char *argv[], adminConn *c) {
     } else if (strcasecmp(argv[1], "GET_NUMZONES") == 0) {
         size_t n = ltreeGetNumZones(sk.lt);
         s = sdsnewprintf("%lu", n);
+    } else if (strcasecmp(argv[1], "MEMUSAGE") == 0) {
+        if (argc != 3) {
+            s = sdsnewprintf("ZONE MEMUSAGE needs 1 argument, but gives %d.", argc-2);
+            goto end;
+        }
+        strncpy(dotOrigin, argv[2], MAX_DOMAIN_LEN);
+        if (isAbsDotDomain(dotOrigin) == false) {
+            strcat(dotOrigin, ".");
+        }
+        dot2lenlabel(dotOrigin, origin);
+        ltreeRLock(sk.lt);
+        z = ltreeGetZoneExactRaw(sk.lt, origin);
+        if (z == NULL) {
+            s = sdsnewprintf("zone %s not found", dotOrigin);
+            ltreeRUnlock(sk.lt);
+            goto end;
+        }
+        size_t nr_records = 0;
+        size_t bytes = zoneMemUsage(z, &nr_records);
+        s = sdsnewprintf("names:%lu\r\nrecords:%zu\r\nbytes:%zu\r\nbytes_per_record:%.2f\r\n",
+                         dictSize(z->d), nr_records, bytes,
+                         nr_records? (double)bytes/nr_records: 0.0);
+        ltreeRUnlock(sk.lt);
+    } else if (strcasecmp(argv[1], "RELOADINFO") == 0) {
+        if (argc != 3) {
+            s = sdsnewprintf("ZONE RELOADINFO needs 1 argument, but gives %d.", argc-2);
+            goto end;
+        }
+        strncpy(dotOrigin, argv[2], MAX_DOMAIN_LEN);
+        if (isAbsDotDomain(dotOrigin) == false) {
+            strcat(dotOrigin, ".");
+        }
+        dot2lenlabel(dotOrigin, origin);
+        ltreeRLock(sk.lt);
+        z = ltreeGetZoneExactRaw(sk.lt, origin);
+        if (z == NULL) {
+            s = sdsnewprintf("zone %s not found", dotOrigin);
+            ltreeRUnlock(sk.lt);
+            goto end;
+        }
+        s = sdsnewprintf("serial:%u\r\nreload_ts:%ld\r\nreload_us:%lld\r\nrefresh_ts:%ld\r\n",
+                         z->sn, z->reload_ts, z->reload_us, z->refresh_ts);
+        ltreeRUnlock(sk.lt);
+    } else if (strcasecmp(argv[1], "STATS") == 0) {
+        if (argc != 3) {
+            s = sdsnewprintf("ZONE STATS needs 1 argument, but gives %d.", argc-2);
+            goto end;
+        }
+        strncpy(dotOrigin, argv[2], MAX_DOMAIN_LEN);
+        if (isAbsDotDomain(dotOrigin) == false) {
+            strcat(dotOrigin, ".");
+        }
+        dot2lenlabel(dotOrigin, origin);
+        // every numa node has a copy of the zone, each counts the queries of its lcores.
+        uint64_t nr_queries = 0, nr_nxdomain = 0, q, nx;
+        bool found = false;
+        for (int i = 0; i < sk.nr_numa_id; ++i) {
+            numaNode_t *node = sk.nodes[sk.numa_ids[i]];
+            ltreeRLock(node->lt);
+            z = ltreeGetZoneExactRaw(node->lt, origin);
+            if (z != NULL) {
+                zoneGetQueryStats(z, &q, &nx);
+                nr_queries += q;
+                nr_nxdomain += nx;
+                found = true;
+            }
+            ltreeRUnlock(node->lt);
+        }
+        if (!found) {
+            s = sdsnewprintf("zone %s not found", dotOrigin);
+            goto end;
+        }
+        s = sdsnewprintf("queries:%lu\r\nnxdomain:%lu\r\n", nr_queries, nr_nxdomain);
     } else {
         s = sdsnewprintf("unknown subcommand %s for ZONE.", argv[1]);
     }
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <arpa/inet.h>
 #include "defines.h"
 #include "shuke.h"
 #include "utils.h"
@@ -57,6 +58,19 @@
         }                                                           \
     } while(0)
 
+#define GET_DOUBLE_CONFIG(name, v, t)                               \
+    do{                                                             \
+        const char *raw;                                            \
+        double tmp;                                                 \
+        if ((raw = toml_raw_in(t, name))) {                         \
+            if (toml_rtod(raw, &tmp) < 0) {                         \
+                fprintf(stderr, "ERROR: bad value in %s\n", name);  \
+                exit(EXIT_FAILURE);                                 \
+            }                                                       \
+            (v) = tmp;                                              \
+        }                                                           \
+    } while(0)
+
 static int addZoneFileToConf(char *k, char *v) {
     dict *d = sk.zone_files_dict;
     if (isAbsDotDomain(k) == false) {
@@ -77,9 +91,47 @@ static int addZoneFileToConf(char *k, char *v) {
     return 0;
 }
 
+/*
+ * parse an array of address prefixes, like ["10.0.0.1", "192.168.0.0/24"].
+ */
+static void parseAddrPrefixArray(toml_array_t *arr, const char *name, addrPrefix **prefixes, int *n) {
+    int nr = 0;
+    char *ss;
+
+    if (arr == NULL) return;
+    if (toml_array_kind(arr) != 'v') {
+        fprintf(stderr, "the value of %s should be an array of string.\n", name);
+        exit(EXIT_FAILURE);
+    }
+    while (toml_raw_at(arr, nr) != NULL) nr++;
+    *prefixes = zcalloc(sizeof(addrPrefix) * (nr > 0? nr: 1));
+    *n = 0;
+    for (int i = 0; i < nr; ++i) {
+        if (toml_rtos(toml_raw_at(arr, i), &ss) < 0) {
+            fprintf(stderr, "the value of %s should be an array of string.\n", name);
+            exit(EXIT_FAILURE);
+        }
+        if (parseAddrPrefix(ss, &(*prefixes)[(*n)++]) == ERR_CODE) {
+            fprintf(stderr, "Config Error: invalid address prefix %s in %s.\n", ss, name);
+            exit(EXIT_FAILURE);
+        }
+        free(ss);
+    }
+}
+
+static sds addrPrefixArrayToStr(sds s, const char *name, addrPrefix *prefixes, int n) {
+    s = sdscatfmt(s, "%s: \n", name);
+    for (int i = 0; i < n; ++i) {
+        char addr[INET6_ADDRSTRLEN];
+        inet_ntop(prefixes[i].af, prefixes[i].addr, addr, sizeof(addr));
+        s = sdscatfmt(s, "  - %s/%i\n", addr, prefixes[i].prefix);
+    }
+    return s;
+}
+
 static int _parse_toml_config(FILE *fp) {
     toml_table_t *conf;
-    toml_table_t *dpdk, *core, *zone_source, *lua;
+    toml_table_t *dpdk, *core, *zone_source, *lua, *xfr_out, *nxguard, *cookie;
     char errbuf[200];
     conf = toml_parse_file(fp, errbuf, sizeof(errbuf));
     if (conf == NULL) {
@@ -112,6 +164,25 @@ static int _parse_toml_config(FILE *fp) {
     GET_BOOL_CONFIG("jumbo_on", sk.jumbo_on, dpdk);
     GET_INT_CONFIG("max_pkt_len", sk.max_pkt_len, dpdk);
     GET_STR_CONFIG("queue_config", sk.queue_config, dpdk);
+    GET_BOOL_CONFIG("no_pci", sk.no_pci, dpdk);
+    toml_array_t *vdevs;
+    if ((vdevs = toml_array_in(dpdk, "vdevs")) != NULL) {
+        const char *raw;
+        if (toml_array_kind(vdevs) != 'v') {
+            fprintf(stderr, "the value of vdevs should be an array of string.\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; (raw = toml_raw_at(vdevs, i)) != NULL; ++i) {
+            if (sk.nr_vdevs >= CONFIG_VDEV_MAX) {
+                fprintf(stderr, "too many vdevs, at most %d.\n", CONFIG_VDEV_MAX);
+                exit(EXIT_FAILURE);
+            }
+            if (toml_rtos(raw, &sk.vdevs[sk.nr_vdevs++]) < 0) {
+                fprintf(stderr, "the value of vdevs should be an array of string.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
 
     // core config
     toml_array_t *bind;
@@ -151,12 +222,21 @@ static int _parse_toml_config(FILE *fp) {
     GET_STR_CONFIG("loglevel", sk.logLevelStr, core);
     GET_STR_CONFIG("admin_host", sk.admin_host, core);
     GET_INT_CONFIG("admin_port", sk.admin_port, core);
+    GET_INT_CONFIG("metrics_port", sk.metrics_port, core);
+    GET_INT_CONFIG("top_window", sk.top_window, core);
+    GET_STR_CONFIG("views_file", sk.views_file, core);
+    GET_STR_CONFIG("acl_file", sk.acl_file, core);
     GET_INT_CONFIG("max_resp_size", sk.max_resp_size, core);
     GET_BOOL_CONFIG("minimize_resp", sk.minimize_resp, core);
+    GET_INT_CONFIG("idle_backoff_us", sk.idle_backoff_us, core);
 
     // zone_source related config
     GET_INT_CONFIG("retry_interval", sk.retry_interval, zone_source);
     GET_INT_CONFIG("all_reload_interval", sk.all_reload_interval, zone_source);
+    GET_INT_CONFIG("max_inflight_reloads", sk.max_inflight_reloads, zone_source);
+    GET_INT_CONFIG("refresh_jitter", sk.refresh_jitter, zone_source);
+    parseAddrPrefixArray(toml_array_in(zone_source, "notify_sources"), "notify_sources",
+                         &sk.notify_sources, &sk.nr_notify_sources);
     GET_STR_CONFIG("type", sk.data_store, zone_source);
     if (strcasecmp(sk.data_store, "file") == 0) {
         toml_table_t *file;
@@ -168,12 +248,17 @@ static int _parse_toml_config(FILE *fp) {
             toml_free(conf);
             exit(EXIT_FAILURE);
         }
-        if ((file_list= toml_array_in(file, "files")) == NULL) {
+        GET_STR_CONFIG("zone_files_root", sk.zone_files_root, file);
+        GET_BOOL_CONFIG("watch", sk.zone_files_watch, file);
+        GET_INT_CONFIG("watch_debounce", sk.zone_files_debounce, file);
+        GET_BOOL_CONFIG("scan", sk.zone_files_scan, file);
+        GET_STR_CONFIG("suffix", sk.zone_files_suffix, file);
+        // the files list is optional in scan mode.
+        if ((file_list= toml_array_in(file, "files")) == NULL && !sk.zone_files_scan) {
             fprintf(stderr, "ERROR: missing [zone_source.file.files]\n");
             toml_free(conf);
             exit(EXIT_FAILURE);
         }
-        GET_STR_CONFIG("zone_files_root", sk.zone_files_root, file);
 
         if (sk.zone_files_root == NULL) {
             char cwd[MAXLINE];
@@ -187,8 +272,11 @@ static int _parse_toml_config(FILE *fp) {
             fprintf(stderr, "Config Error: zone_files_root must be an absolute path.\n");
             exit(1);
         }
+        for (size_t n = strlen(sk.zone_files_root); n > 1 && sk.zone_files_root[n-1] == '/'; --n) {
+            sk.zone_files_root[n-1] = 0;
+        }
         sk.zone_files_dict = dictCreate(&dictTypeCaseStringCopyKeyVal, NULL, SOCKET_ID_HEAP);
-        for (int i = 0; ; i++) {
+        for (int i = 0; file_list; i++) {
             if ((entry = toml_table_at(file_list, i)) == NULL) break;
             char *k=NULL, *v=NULL;
             GET_STR_CONFIG("name", k, entry);
@@ -201,6 +289,10 @@ static int _parse_toml_config(FILE *fp) {
             free(k);
             free(v);
         }
+        if (sk.zone_files_scan && scanZoneFilesRoot(false) == ERR_CODE) {
+            fprintf(stderr, "Config Error: %s.\n", sk.errstr);
+            exit(EXIT_FAILURE);
+        }
     } else if (strcasecmp(sk.data_store, "mongo") == 0) {
         toml_table_t *mongo;
 
@@ -212,14 +304,81 @@ static int _parse_toml_config(FILE *fp) {
         GET_STR_CONFIG("host", sk.mongo_host, mongo);
         GET_INT_CONFIG("port", sk.mongo_port, mongo);
         GET_STR_CONFIG("dbname", sk.mongo_dbname, mongo);
+        GET_INT_CONFIG("conns", sk.mongo_conns, mongo);
+        GET_STR_CONFIG("catalog", sk.mongo_catalog, mongo);
+        GET_INT_CONFIG("catalog_interval", sk.catalog_interval, mongo);
+        if (sk.mongo_catalog && *sk.mongo_catalog == '\0') {
+            free(sk.mongo_catalog);
+            sk.mongo_catalog = NULL;
+        }
 
         CHECK_CONFIG("mongo_host", sk.mongo_host != NULL, NULL);
         CHECK_CONFIG("mongo_dbname", sk.mongo_dbname != NULL, NULL);
+        CHECK_CONFIG("catalog_interval", sk.catalog_interval > 0, NULL);
+        CHECK_CONFIG("mongo_conns", sk.mongo_conns > 0 && sk.mongo_conns <= MONGO_MAX_CONNS,
+                     "Config Error: conns of [zone_source.mongo] should in 1-16");
+    } else if (strcasecmp(sk.data_store, "xfr") == 0) {
+        toml_table_t *xfr;
+        toml_array_t *zones;
+
+        if ((xfr = toml_table_in(zone_source, "xfr")) == NULL) {
+            fprintf(stderr, "ERROR: missing [zone_source.xfr]\n");
+            toml_free(conf);
+            exit(EXIT_FAILURE);
+        }
+        GET_STR_CONFIG("primary", sk.xfr_primary, xfr);
+        GET_INT_CONFIG("port", sk.xfr_port, xfr);
+        GET_BOOL_CONFIG("ixfr", sk.xfr_ixfr, xfr);
+        GET_INT_CONFIG("timeout", sk.xfr_timeout, xfr);
+        if ((zones = toml_array_in(xfr, "zones")) == NULL || toml_array_kind(zones) != 'v') {
+            fprintf(stderr, "ERROR: zones of [zone_source.xfr] should be an array of string.\n");
+            toml_free(conf);
+            exit(EXIT_FAILURE);
+        }
+        sk.xfr_zones = dictCreate(&dictTypeCaseStringCopyKey, NULL, SOCKET_ID_HEAP);
+        for (int i = 0; toml_raw_at(zones, i) != NULL; i++) {
+            char *name, dotOrigin[MAX_DOMAIN_LEN+2];
+            if (toml_rtos(toml_raw_at(zones, i), &name) < 0) {
+                fprintf(stderr, "ERROR: zones of [zone_source.xfr] should be an array of string.\n");
+                exit(EXIT_FAILURE);
+            }
+            snprintf(dotOrigin, MAX_DOMAIN_LEN, "%s", name);
+            if (!isAbsDotDomain(dotOrigin)) strcat(dotOrigin, ".");
+            dictReplace(sk.xfr_zones, dotOrigin, NULL);
+            free(name);
+        }
+
+        CHECK_CONFIG("xfr_primary", sk.xfr_primary != NULL, NULL);
+        CHECK_CONFIG("xfr_timeout", sk.xfr_timeout > 0,
+                     "Config Error: timeout of [zone_source.xfr] should be positive");
     } else {
         fprintf(stderr, "Unknown zone source type\n");
         exit(EXIT_FAILURE);
     }
 
+    if ((xfr_out = toml_table_in(conf, "xfr_out")) != NULL) {
+        parseAddrPrefixArray(toml_array_in(xfr_out, "allow"), "allow of [xfr_out]",
+                             &sk.xfr_out_allow, &sk.nr_xfr_out_allow);
+        GET_INT_CONFIG("max_transfers", sk.xfr_out_max_transfers, xfr_out);
+        GET_INT_CONFIG("rate_limit", sk.xfr_out_rate_limit, xfr_out);
+        GET_INT_CONFIG("timeout", sk.xfr_out_timeout, xfr_out);
+        GET_INT_CONFIG("journal_size", sk.xfr_out_journal_size, xfr_out);
+    }
+
+    if ((cookie = toml_table_in(conf, "cookie")) != NULL) {
+        GET_BOOL_CONFIG("enabled", sk.cookie_enabled, cookie);
+        GET_STR_CONFIG("secret", sk.cookie_secret, cookie);
+        GET_INT_CONFIG("rotate", sk.cookie_rotate, cookie);
+    }
+
+    if ((nxguard = toml_table_in(conf, "nxguard")) != NULL) {
+        GET_INT_CONFIG("threshold", sk.nxguard_threshold, nxguard);
+        GET_STR_CONFIG("mode", sk.nxguard_mode_str, nxguard);
+        GET_DOUBLE_CONFIG("min_entropy", sk.nxguard_min_entropy, nxguard);
+        GET_INT_CONFIG("budget", sk.nxguard_budget, nxguard);
+        GET_INT_CONFIG("hold", sk.nxguard_hold, nxguard);
+    }
+
     if ((lua = toml_table_in(conf, "lua")) != NULL) {
         GET_STR_CONFIG("package_path", sk.lconf.package_path, lua);
         GET_STR_CONFIG("package_cpath", sk.lconf.package_cpath, lua);
@@ -253,11 +412,35 @@ void initConfigFromTomlFile(char *conffile) {
 
     sk.retry_interval = 120;
     sk.mongo_port = 27017;
+    sk.mongo_conns = 4;
+    sk.catalog_interval = 10;
+    sk.max_inflight_reloads = 32;
+    sk.refresh_jitter = 10;
+    sk.zone_files_watch = true;
+    sk.zone_files_debounce = 500;
+    sk.zone_files_scan = false;
+    sk.zone_files_suffix = strdup(".z");
+    sk.xfr_port = 53;
+    sk.xfr_ixfr = true;
+    sk.xfr_timeout = 10;
+    sk.xfr_out_max_transfers = 8;
+    sk.xfr_out_rate_limit = 0;
+    sk.xfr_out_timeout = 30;
+    sk.xfr_out_journal_size = 1024 * 1024;
 
     sk.admin_port = 14141;
+    sk.top_window = 10;
+    sk.cookie_enabled = false;
+    sk.cookie_rotate = 3600;
+    sk.nxguard_threshold = 0;
+    sk.nxguard_mode_str = strdup("slip");
+    sk.nxguard_min_entropy = 3.0;
+    sk.nxguard_budget = 100;
+    sk.nxguard_hold = 60;
     sk.all_reload_interval = 36000;
     sk.max_resp_size = 16384;
     sk.minimize_resp = true;
+    sk.idle_backoff_us = 0;
     sk.pidfile = strdup("/var/run/shuke.pid");
     sk.logLevelStr = strdup("info");
 
@@ -267,6 +450,39 @@ void initConfigFromTomlFile(char *conffile) {
                  "Config Error: master_lcore_id must set correctly");
     CHECK_CONFIG("mem_channels", sk.mem_channels > 0,
                  "Config Error: mem_channels can't be empty");
+    CHECK_CONFIG("max_inflight_reloads", sk.max_inflight_reloads > 0,
+                 "Config Error: max_inflight_reloads should be positive");
+    CHECK_CONFIG("watch_debounce", sk.zone_files_debounce > 0,
+                 "Config Error: watch_debounce should be positive");
+    CHECK_CONFIG("refresh_jitter", sk.refresh_jitter >= 0 && sk.refresh_jitter <= 100,
+                 "Config Error: refresh_jitter should in 0-100");
+    CHECK_CONFIG("metrics_port", sk.metrics_port >= 0 && sk.metrics_port <= 65535,
+                 "Config Error: metrics_port should in 0-65535");
+    CHECK_CONFIG("top_window", sk.top_window >= 0,
+                 "Config Error: top_window should not be negative");
+    CHECK_CONFIG("cookie_rotate", sk.cookie_rotate >= 0,
+                 "Config Error: rotate of [cookie] should not be negative");
+    CHECK_CONFIG("nxguard_threshold", sk.nxguard_threshold >= 0,
+                 "Config Error: threshold of [nxguard] should not be negative");
+    sk.nxguard_mode = nxguardModeFromStr(sk.nxguard_mode_str);
+    CHECK_CONFIG("nxguard_mode", sk.nxguard_mode > 0,
+                 "Config Error: mode of [nxguard] should be slip, drop or budget");
+    CHECK_CONFIG("nxguard_min_entropy", sk.nxguard_min_entropy > 0 && sk.nxguard_min_entropy <= 6,
+                 "Config Error: min_entropy of [nxguard] should in (0, 6]");
+    CHECK_CONFIG("nxguard_budget", sk.nxguard_budget >= 0,
+                 "Config Error: budget of [nxguard] should not be negative");
+    CHECK_CONFIG("nxguard_hold", sk.nxguard_hold >= 0,
+                 "Config Error: hold of [nxguard] should not be negative");
+    CHECK_CONFIG("xfr_out_max_transfers", sk.xfr_out_max_transfers > 0,
+                 "Config Error: max_transfers of [xfr_out] should be positive");
+    CHECK_CONFIG("xfr_out_rate_limit", sk.xfr_out_rate_limit >= 0,
+                 "Config Error: rate_limit of [xfr_out] can't be negative");
+    CHECK_CONFIG("xfr_out_timeout", sk.xfr_out_timeout > 0,
+                 "Config Error: timeout of [xfr_out] should be positive");
+    CHECK_CONFIG("xfr_out_journal_size", sk.xfr_out_journal_size >= 0,
+                 "Config Error: journal_size of [xfr_out] can't be negative");
+    CHECK_CONFIG("idle_backoff_us", sk.idle_backoff_us >= 0 && sk.idle_backoff_us <= 1000000,
+                 "Config Error: idle_backoff_us should in 0-1000000");
     CHECK_CONFIG("max_resp_size", sk.max_resp_size >= 4096 || sk.max_resp_size <= 64000,
                  "Config Error: max_resp_size should in 4096-64000");
     fclose(fp);
@@ -282,6 +498,7 @@ sds configToStr() {
             "jumbo_on: %d\n"
             "max_pkt_len: %d\n"
             "queue_config: %s\n"
+            "no_pci: %d\n"
             "port: %d\n"
             "only_udp: %d\n"
             "pidfile: %s\n"
@@ -296,14 +513,43 @@ sds configToStr() {
             "max_tcp_connections: %d\n"
             "data_store: %s\n"
             "zone_files_root: %s\n"
+            "zone_files_watch: %d\n"
+            "zone_files_debounce: %d\n"
+            "zone_files_scan: %d\n"
+            "zone_files_suffix: %s\n"
+            "xfr_primary: %s\n"
+            "xfr_port: %d\n"
+            "xfr_ixfr: %d\n"
+            "xfr_timeout: %d\n"
+            "xfr_out_max_transfers: %d\n"
+            "xfr_out_rate_limit: %d\n"
+            "xfr_out_timeout: %d\n"
+            "xfr_out_journal_size: %ld\n"
             "mongo_host: %s\n"
             "mongo_port: %d\n"
             "mongo_dbname: %s\n"
+            "mongo_conns: %d\n"
+            "mongo_catalog: %s\n"
+            "catalog_interval: %d\n"
             "retry_interval: %ld\n"
+            "max_inflight_reloads: %d\n"
+            "refresh_jitter: %d\n"
             "admin_host: %s\n"
             "admin_port: %d\n"
+            "metrics_port: %d\n"
+            "top_window: %d\n"
+            "views_file: %s\n"
+            "acl_file: %s\n"
+            "cookie_enabled: %d\n"
+            "cookie_rotate: %d\n"
+            "nxguard_threshold: %d\n"
+            "nxguard_mode: %s\n"
+            "nxguard_min_entropy: %.2f\n"
+            "nxguard_budget: %d\n"
+            "nxguard_hold: %d\n"
             "all_reload_interval: %d\n"
-            "minimize_resp: %d\n",
+            "minimize_resp: %d\n"
+            "idle_backoff_us: %d\n",
             sk.configfile,
             sk.master_lcore_id,
             sk.mem_channels,
@@ -312,6 +558,7 @@ sds configToStr() {
             sk.jumbo_on,
             sk.max_pkt_len,
             sk.queue_config,
+            sk.no_pci,
             sk.port,
             sk.only_udp,
             sk.pidfile,
@@ -326,19 +573,54 @@ sds configToStr() {
             sk.max_tcp_connections,
             sk.data_store,
             sk.zone_files_root,
+            sk.zone_files_watch,
+            sk.zone_files_debounce,
+            sk.zone_files_scan,
+            sk.zone_files_suffix,
+            sk.xfr_primary,
+            sk.xfr_port,
+            sk.xfr_ixfr,
+            sk.xfr_timeout,
+            sk.xfr_out_max_transfers,
+            sk.xfr_out_rate_limit,
+            sk.xfr_out_timeout,
+            sk.xfr_out_journal_size,
             sk.mongo_host,
             sk.mongo_port,
             sk.mongo_dbname,
+            sk.mongo_conns,
+            sk.mongo_catalog ? sk.mongo_catalog : "",
+            sk.catalog_interval,
             sk.retry_interval,
+            sk.max_inflight_reloads,
+            sk.refresh_jitter,
             sk.admin_host,
             sk.admin_port,
+            sk.metrics_port,
+            sk.top_window,
+            sk.views_file,
+            sk.acl_file,
+            sk.cookie_enabled,
+            sk.cookie_rotate,
+            sk.nxguard_threshold,
+            sk.nxguard_mode_str,
+            sk.nxguard_min_entropy,
+            sk.nxguard_budget,
+            sk.nxguard_hold,
             sk.all_reload_interval,
-            sk.minimize_resp
+            sk.minimize_resp,
+            sk.idle_backoff_us
     );
+    s = sdscat(s, "vdevs: \n");
+    for (int i = 0; i < sk.nr_vdevs; ++i) {
+        s = sdscatfmt(s, "  - %s\n", sk.vdevs[i]);
+    }
     s = sdscat(s, "bind: \n");
     for (int i = 0; i < sk.bindaddr_count; ++i) {
         s = sdscatfmt(s, "  - %s\n", sk.bindaddr[i]);
     }
+    s = addrPrefixArrayToStr(s, "notify_sources", sk.notify_sources, sk.nr_notify_sources);
+    s = addrPrefixArrayToStr(s, "xfr_out_allow", sk.xfr_out_allow, sk.nr_xfr_out_allow);
     return s;
 }
 
@@ -0,0 +1,292 @@
+//
+// DNS cookies
+//
+// the server cookie is the interoperable format of RFC 9018:
+//
+//     version(1) | reserved(3) | timestamp(4) | hash(8)
+//     hash = SipHash-2-4(client cookie | version | reserved | timestamp | client ip, secret)
+//
+// so nothing is stored per client, a server cookie is valid if the hash matches
+// with the current or the previous secret and the timestamp is at most one hour
+// old(5 minutes in the future are allowed). the secret is random and rotated every
+// `rotate` seconds by main thread, or set by `secret` to share it with the other
+// servers of an anycast group(then it is never rotated). every numa node has a
+// copy of the secrets, the new copies are published by rcu_assign_pointer.
+//
+// a query with a valid server cookie comes from a client that has seen our response,
+// so its source address isn't spoofed, nxguard never drops or slips it. the queries
+// with bad server cookies are answered normally with a new cookie(no BADCOOKIE).
+//
+
+#include <fcntl.h>
+
+#include "shuke.h"
+#include "utils.h"
+
+DEF_LOG_MODULE(RTE_LOGTYPE_USER1, "COOKIE");
+
+#define COOKIE_VERSION      1
+#define COOKIE_MAX_AGE      3600
+#define COOKIE_MAX_SKEW     300
+// a valid server cookie older than it is replaced by a new one.
+#define COOKIE_REFRESH_AGE  1800
+
+struct cookieSecret_s {
+    uint64_t keys[2][2];        // the current and the previous secret
+    bool has_prev;
+    int socket_id;
+    struct rcu_head rcu_head;
+};
+
+// the secrets of main thread.
+static struct {
+    uint8_t cur[16];
+    uint8_t prev[16];
+    bool has_prev;
+    bool fixed;             // set by config, never rotated
+    long rotate_ts;
+} secrets;
+
+static const char *resultNames[NR_COOKIE_RESULTS] = {"none", "new", "valid", "invalid"};
+
+#define ROTL64(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND                                                \
+    do {                                                        \
+        v0 += v1; v1 = ROTL64(v1, 13); v1 ^= v0; v0 = ROTL64(v0, 32); \
+        v2 += v3; v3 = ROTL64(v3, 16); v3 ^= v2;                \
+        v0 += v3; v3 = ROTL64(v3, 21); v3 ^= v0;                \
+        v2 += v1; v1 = ROTL64(v1, 17); v1 ^= v2; v2 = ROTL64(v2, 32); \
+    } while (0)
+
+static inline uint64_t load64le(const uint8_t *p) {
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+           ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+static inline void dump64le(uint64_t v, uint8_t *p) {
+    for (int i = 0; i < 8; ++i) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+/*
+ * SipHash-2-4, the key is two little endian 64 bits words.
+ */
+static uint64_t siphash24(const uint8_t *in, size_t len, const uint64_t k[2]) {
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k[0];
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k[1];
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k[0];
+    uint64_t v3 = 0x7465646279746573ULL ^ k[1];
+    uint64_t b = (uint64_t)len << 56;
+    uint64_t m;
+    const uint8_t *end = in + len - (len % 8);
+
+    for (; in != end; in += 8) {
+        m = load64le(in);
+        v3 ^= m;
+        SIPROUND;
+        SIPROUND;
+        v0 ^= m;
+    }
+    for (int i = (int)(len % 8) - 1; i >= 0; --i) b |= (uint64_t)in[i] << (8 * i);
+    v3 ^= b;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= b;
+    v2 ^= 0xff;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+/*
+ * the hash of the server cookie, `cookie` is the client cookie followed by
+ * version, reserved and timestamp of the server cookie.
+ */
+static inline uint64_t cookieHash(const uint64_t key[2], const char *cookie, struct context *ctx) {
+    uint8_t buf[COOKIE_CLIENT_LEN + 8 + 16];
+    size_t addrlen = ctx->src_ipv4? 4: 16;
+
+    memcpy(buf, cookie, COOKIE_CLIENT_LEN + 8);
+    memcpy(buf + COOKIE_CLIENT_LEN + 8, ctx->src_addr, addrlen);
+    return siphash24(buf, COOKIE_CLIENT_LEN + 8 + addrlen, key);
+}
+
+/*!
+ * handle the COOKIE option of query, the COOKIE option of response is appended
+ * to ctx->opt_rr and ctx->cookie is set, called by parseEdnsOptions.
+ *
+ * @return ERR_CODE if the option is malformed(FORMERR)
+ */
+int cookieProcess(struct context *ctx, const char *opt, uint16_t opt_len) {
+    cookieSecret *cs;
+    uint8_t *out;
+    uint32_t now = (uint32_t)sk.unixtime;
+    bool reuse = false;
+
+    if (opt_len < COOKIE_CLIENT_LEN || (opt_len > COOKIE_CLIENT_LEN && opt_len < 16) || opt_len > 40) {
+        return ERR_CODE;
+    }
+    cs = rcu_dereference(ctx->node->cookie);
+    // the option is ignored if cookies are disabled.
+    if (cs == NULL || ctx->cookie != COOKIE_NONE) return OK_CODE;
+    if (unlikely(sizeof(ctx->opt_rr) < (size_t)(ctx->opt_rr_len + COOKIE_OPT_LEN))) return OK_CODE;
+
+    ctx->cookie = COOKIE_NEW;
+    if (opt_len > COOKIE_CLIENT_LEN) {
+        ctx->cookie = COOKIE_INVALID;
+        if (opt_len == COOKIE_CLIENT_LEN + COOKIE_SERVER_LEN && opt[COOKIE_CLIENT_LEN] == COOKIE_VERSION) {
+            uint32_t ts = load32be((char *)opt + COOKIE_CLIENT_LEN + 4);
+            int32_t age = (int32_t)(now - ts);
+            if (age <= COOKIE_MAX_AGE && age >= -COOKIE_MAX_SKEW) {
+                uint64_t hash = load64le((const uint8_t *)opt + COOKIE_CLIENT_LEN + 8);
+                if (cookieHash(cs->keys[0], opt, ctx) == hash) {
+                    ctx->cookie = COOKIE_VALID;
+                    reuse = age < COOKIE_REFRESH_AGE;
+                } else if (cs->has_prev && cookieHash(cs->keys[1], opt, ctx) == hash) {
+                    ctx->cookie = COOKIE_VALID;
+                }
+            }
+        }
+    }
+
+    out = ctx->opt_rr + ctx->opt_rr_len;
+    dump16be(OPT_COOKIE_CODE, (char *)out);
+    dump16be(COOKIE_CLIENT_LEN + COOKIE_SERVER_LEN, (char *)out + 2);
+    if (reuse) {
+        memcpy(out + 4, opt, COOKIE_CLIENT_LEN + COOKIE_SERVER_LEN);
+    } else {
+        memcpy(out + 4, opt, COOKIE_CLIENT_LEN);
+        out[4 + COOKIE_CLIENT_LEN] = COOKIE_VERSION;
+        memset(out + 4 + COOKIE_CLIENT_LEN + 1, 0, 3);
+        dump32be(now, (char *)out + 4 + COOKIE_CLIENT_LEN + 4);
+        dump64le(cookieHash(cs->keys[0], (char *)out + 4, ctx), out + 4 + COOKIE_CLIENT_LEN + 8);
+    }
+    ctx->opt_rr_len += COOKIE_OPT_LEN;
+    return OK_CODE;
+}
+
+static void cookieSecretFreeCallback(struct rcu_head *head) {
+    cookieSecret *cs = caa_container_of(head, cookieSecret, rcu_head);
+    socket_free(cs->socket_id, cs);
+}
+
+static int randomSecret(uint8_t *buf, size_t len) {
+    int fd = open("/dev/urandom", O_RDONLY);
+    ssize_t n;
+
+    if (fd < 0) return ERR_CODE;
+    n = read(fd, buf, len);
+    close(fd);
+    return n == (ssize_t)len? OK_CODE: ERR_CODE;
+}
+
+// copy the secrets to all numa nodes.
+static void publishSecrets(void) {
+    for (int i = 0; i < sk.nr_numa_id; ++i) {
+        int numa_id = sk.numa_ids[i];
+        cookieSecret *cs = socket_calloc(numa_id, 1, sizeof(*cs));
+        cookieSecret *old = sk.nodes[numa_id]->cookie;
+
+        cs->socket_id = numa_id;
+        cs->keys[0][0] = load64le(secrets.cur);
+        cs->keys[0][1] = load64le(secrets.cur + 8);
+        cs->keys[1][0] = load64le(secrets.prev);
+        cs->keys[1][1] = load64le(secrets.prev + 8);
+        cs->has_prev = secrets.has_prev;
+        rcu_assign_pointer(sk.nodes[numa_id]->cookie, cs);
+        if (old) call_rcu(&old->rcu_head, cookieSecretFreeCallback);
+    }
+}
+
+int initCookie(char *errstr) {
+    if (!sk.cookie_enabled) return OK_CODE;
+
+    if (sk.cookie_secret != NULL && *sk.cookie_secret != '\0') {
+        if (strlen(sk.cookie_secret) != 32) goto bad_secret;
+        for (int i = 0; i < 16; ++i) {
+            unsigned v;
+            if (sscanf(sk.cookie_secret + 2 * i, "%2x", &v) != 1) goto bad_secret;
+            secrets.cur[i] = (uint8_t)v;
+        }
+        secrets.fixed = true;
+    } else if (randomSecret(secrets.cur, sizeof(secrets.cur)) == ERR_CODE) {
+        snprintf(errstr, ERR_STR_LEN, "can't read /dev/urandom: %s", strerror(errno));
+        return ERR_CODE;
+    }
+    secrets.rotate_ts = sk.unixtime;
+    publishSecrets();
+    return OK_CODE;
+
+bad_secret:
+    snprintf(errstr, ERR_STR_LEN, "secret of [cookie] should be 32 hex digits.");
+    return ERR_CODE;
+}
+
+/*!
+ * rotate the random secret every `rotate` seconds, the previous secret is still
+ * accepted until the next rotation. called by main thread cron.
+ */
+void cookieCron(void) {
+    uint8_t key[16];
+
+    if (!sk.cookie_enabled || secrets.fixed || sk.cookie_rotate <= 0) return;
+    if (sk.unixtime - secrets.rotate_ts < sk.cookie_rotate) return;
+    secrets.rotate_ts = sk.unixtime;
+    if (randomSecret(key, sizeof(key)) == ERR_CODE) {
+        LOG_WARN("can't read /dev/urandom(%s), the cookie secret isn't rotated.", strerror(errno));
+        return;
+    }
+    memcpy(secrets.prev, secrets.cur, sizeof(secrets.cur));
+    memcpy(secrets.cur, key, sizeof(key));
+    secrets.has_prev = true;
+    publishSecrets();
+    LOG_INFO("cookie secret is rotated.");
+}
+
+sds cookieGenMetrics(sds s) {
+    if (!sk.cookie_enabled) return s;
+    s = sdscatprintf(s, "# HELP shuke_cookies_total %s\n# TYPE shuke_cookies_total counter\n",
+                     "Queries having COOKIE option by lcore and the result of server cookie check.");
+    for (int i = 0; i < sk.nr_lcore_ids; ++i) {
+        unsigned lcore_id = (unsigned)sk.lcore_ids[i];
+        lcoreQueryStats *qs = &sk.lcore_conf[lcore_id].qstats;
+        for (int r = COOKIE_NEW; r < NR_COOKIE_RESULTS; ++r) {
+            s = sdscatprintf(s, "shuke_cookies_total{lcore=\"%u\",result=\"%s\"} %lld\n",
+                             lcore_id, resultNames[r], (long long)qs->nr_cookie[r]);
+        }
+    }
+    return s;
+}
+
+#if defined(SK_TEST)
+#include "testhelp.h"
+
+/*
+ * usage: shuke-server test cookie
+ * the test vectors of RFC 9018 appendix A.
+ */
+int cookieTest(int argc, char *argv[]) {
+    UNUSED2(argc, argv);
+    struct context ctx;
+    uint64_t key[2];
+    uint8_t secret[16] = {0xe5, 0xe9, 0x73, 0xe5, 0xa6, 0xb2, 0xa4, 0x3f,
+                          0x48, 0xe7, 0xdc, 0x84, 0x9e, 0x37, 0xbf, 0xcf};
+    uint8_t cookie[16] = {0x24, 0x64, 0xc4, 0xab, 0xcf, 0x10, 0xc9, 0x57,
+                          0x01, 0x00, 0x00, 0x00, 0x5c, 0xf7, 0x9f, 0x11};
+    uint8_t hash[8];
+    uint8_t expected[8] = {0x1f, 0x81, 0x30, 0xc3, 0xee, 0xe2, 0x94, 0x80};
+    char addr[4] = {(char)198, 51, 100, 100};
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.src_addr = addr;
+    ctx.src_ipv4 = true;
+    key[0] = load64le(secret);
+    key[1] = load64le(secret + 8);
+    dump64le(cookieHash(key, (char *)cookie, &ctx), hash);
+    test_cond("RFC 9018 A.1 server cookie", memcmp(hash, expected, 8) == 0);
+    test_report();
+    return 0;
+}
+#endif
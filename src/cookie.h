@@ -0,0 +1,38 @@
+//
+// DNS cookies(RFC 7873), the server cookies are generated and verified statelessly.
+//
+
+#ifndef SHUKE_COOKIE_H
+#define SHUKE_COOKIE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sds.h"
+
+#define COOKIE_CLIENT_LEN   8
+// the interoperable server cookie(RFC 9018): version, reserved, timestamp and hash.
+#define COOKIE_SERVER_LEN   16
+// the COOKIE option in responses, option code and length included.
+#define COOKIE_OPT_LEN      (4 + COOKIE_CLIENT_LEN + COOKIE_SERVER_LEN)
+
+typedef enum {
+    COOKIE_NONE = 0,    // no COOKIE option, or cookies are disabled
+    COOKIE_NEW,         // only the client cookie
+    COOKIE_VALID,
+    COOKIE_INVALID,     // bad or expired server cookie
+    NR_COOKIE_RESULTS,
+} cookieResult;
+
+struct context;
+typedef struct cookieSecret_s cookieSecret;
+
+int initCookie(char *errstr);
+void cookieCron(void);
+int cookieProcess(struct context *ctx, const char *opt, uint16_t opt_len);
+sds cookieGenMetrics(sds s);
+
+#if defined(SK_TEST)
+int cookieTest(int argc, char *argv[]);
+#endif
+
+#endif //SHUKE_COOKIE_H
@@ -62,13 +62,13 @@ int checkLenLabel(char *name, size_t max) {
     return (int)(name-start);
 }
 
-//we do not support type DS, KEY etc.
+// the DNSSEC types are served from pre-signed zones, we do not support type KEY, NAPTR etc.
 bool isSupportDnsType(uint16_t type) {
     static const unsigned char supportTypeTable[256] = {
             0, DNS_TYPE_A, DNS_TYPE_NS, 0, 0, DNS_TYPE_CNAME, DNS_TYPE_SOA, 0, 0, 0, 0, 0, DNS_TYPE_PTR, 0, 0, DNS_TYPE_MX,
             DNS_TYPE_TXT, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, DNS_TYPE_AAAA, 0, 0, 0,
-            0, DNS_TYPE_SRV, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, DNS_TYPE_SRV, 0, 0, 0, 0, 0, 0, 0, 0, 0, DNS_TYPE_DS, 0, 0, DNS_TYPE_RRSIG, DNS_TYPE_NSEC,
+            DNS_TYPE_DNSKEY, 0, DNS_TYPE_NSEC3, DNS_TYPE_NSEC3PARAM, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
             0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
             0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
             0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
@@ -82,7 +82,7 @@ bool isSupportDnsType(uint16_t type) {
             0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
             0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
     };
-    if (type > 0xFF) return false;
+    if (type > 0xFF) return type == DNS_TYPE_CAA;
     return supportTypeTable[type] != 0;
 }
 
@@ -96,6 +96,13 @@ int strToDNSType(const char *ss) {
     else if (strcasecmp(ss, "TXT") == 0) return DNS_TYPE_TXT;
     else if (strcasecmp(ss, "SRV") == 0) return DNS_TYPE_SRV;
     else if (strcasecmp(ss, "PTR") == 0) return DNS_TYPE_PTR;
+    else if (strcasecmp(ss, "CAA") == 0) return DNS_TYPE_CAA;
+    else if (strcasecmp(ss, "DS") == 0) return DNS_TYPE_DS;
+    else if (strcasecmp(ss, "DNSKEY") == 0) return DNS_TYPE_DNSKEY;
+    else if (strcasecmp(ss, "RRSIG") == 0) return DNS_TYPE_RRSIG;
+    else if (strcasecmp(ss, "NSEC") == 0) return DNS_TYPE_NSEC;
+    else if (strcasecmp(ss, "NSEC3") == 0) return DNS_TYPE_NSEC3;
+    else if (strcasecmp(ss, "NSEC3PARAM") == 0) return DNS_TYPE_NSEC3PARAM;
     return ERR_CODE;
 }
 
@@ -119,11 +126,72 @@ char *DNSTypeToStr(int ty) {
             return "SRV";
         case DNS_TYPE_PTR:
             return "PTR";
+        case DNS_TYPE_CAA:
+            return "CAA";
+        case DNS_TYPE_DS:
+            return "DS";
+        case DNS_TYPE_DNSKEY:
+            return "DNSKEY";
+        case DNS_TYPE_RRSIG:
+            return "RRSIG";
+        case DNS_TYPE_NSEC:
+            return "NSEC";
+        case DNS_TYPE_NSEC3:
+            return "NSEC3";
+        case DNS_TYPE_NSEC3PARAM:
+            return "NSEC3PARAM";
         default:
             return "unsupported";
     }
 }
 
+/*!
+ * name of qtype used by statistics, the types not supported are in RFC 3597 format(TYPE<n>).
+ */
+char *qtypeToStr(int ty, char *buf, size_t size) {
+    switch (ty) {
+        case DNS_TYPE_ANY:
+            return "ANY";
+        case DNS_TYPE_AXFR:
+            return "AXFR";
+        case DNS_TYPE_IXFR:
+            return "IXFR";
+        default:
+            if (isSupportDnsType((uint16_t)ty)) return DNSTypeToStr(ty);
+            snprintf(buf, size, "TYPE%d", ty);
+            return buf;
+    }
+}
+
+/*!
+ * the reverse of qtypeToStr, the types not supported in zones(ANY, AXFR, IXFR
+ * and TYPE<n>) are accepted too.
+ */
+int strToQtype(const char *ss) {
+    char *end;
+    long ty;
+
+    if (strcasecmp(ss, "ANY") == 0) return DNS_TYPE_ANY;
+    else if (strcasecmp(ss, "AXFR") == 0) return DNS_TYPE_AXFR;
+    else if (strcasecmp(ss, "IXFR") == 0) return DNS_TYPE_IXFR;
+    else if (strncasecmp(ss, "TYPE", 4) == 0) {
+        ty = strtol(ss+4, &end, 10);
+        if (end == ss+4 || *end != 0 || ty <= 0 || ty > 65535) return ERR_CODE;
+        return (int)ty;
+    }
+    return strToDNSType(ss);
+}
+
+char *rcodeToStr(int rcode, char *buf, size_t size) {
+    static char *names[] = {
+        "NOERROR", "FORMERR", "SERVFAIL", "NXDOMAIN", "NOTIMP", "REFUSED",
+        "YXDOMAIN", "YXRRSET", "NXRRSET", "NOTAUTH", "NOTZONE",
+    };
+    if (rcode >= 0 && rcode < (int)(sizeof(names)/sizeof(names[0]))) return names[rcode];
+    snprintf(buf, size, "RCODE%d", rcode);
+    return buf;
+}
+
 char *abs2relative(char *name, char *origin) {
     size_t remain = strlen(name) - strlen(origin);
     if (remain == 0) {
@@ -325,10 +393,12 @@ static inline int dumpCompressedRRHeader(char *buf, int offset, size_t size, uin
  *
  * @param ctx:  context object, used to store the dumped bytes
  * @param rs:  the RRSet object needs to be dumped
+ * @param sig:  the RRSIG RRSet covering rs(resolved by zoneCompact), it is appended
+ *              only if the query has DO bit. NULL if rs is not signed.
  * @param nameOffset: the offset of the name in sds, used to compress the name
- * @return OK_CODE if everything is OK, otherwise return ERR_CODE.
+ * @return the number of RRs dumped, ERR_CODE if the buffer can't be expanded.
  */
-int RRSetCompressPack(struct context *ctx, RRSet *rs, size_t nameOffset)
+int RRSetCompressPack(struct context *ctx, RRSet *rs, RRSet *sig, size_t nameOffset)
 {
     char *name;
     char *rdata;
@@ -338,17 +408,15 @@ int RRSetCompressPack(struct context *ctx, RRSet *rs, size_t nameOffset)
 
     // support round robin
     if (rs->num > 1) {
-        //TODO better way to support round rabin
-        zone *z = ctx->z;
-        int idx = ctx->lcore_id - z->start_core_idx;
-        uint8_t *arr = (uint8_t *)(z->rr_offset_array) + z->rr_offset_array[idx];
-        start_idx = (++ arr[rs->z_rr_idx]) % rs->num;
-        LOG_DEBUG("core: %d, rr idx: %d", ctx->lcore_id, arr[rs->z_rr_idx]);
+        // RRSets may be shared by many zones, so the counter is per lcore and indexed by RRSet hash.
+        uint8_t *cnt = &ctx->rr_idx[rs->hash & (RR_IDX_TABLE_SIZE - 1)];
+        start_idx = (++(*cnt)) % rs->num;
+        LOG_DEBUG("core: %d, rr idx: %d", ctx->lcore_id, *cnt);
     }
 
     for (int i = 0; i < rs->num; ++i) {
         int idx = (i + start_idx) % rs->num;
-        rdata = rs->data + (rs->offsets[idx]);
+        rdata = rs->data + RRSetGetOffset(rs, idx);
 
         uint16_t rdlength = load16be(rdata);
 
@@ -378,6 +446,14 @@ int RRSetCompressPack(struct context *ctx, RRSet *rs, size_t nameOffset)
                     ctx->ari[ctx->ari_sz++] = ai_temp;
                 }
                 break;
+            case DNS_TYPE_PTR:
+                name = rdata + 2;
+                len_offset = ctx->cur;
+                ctx->cur = snpack(ctx->chunk, ctx->cur, ctx->chunk_len, "m", rdata, 2);
+                dumpCompressedName(ctx, name);
+
+                dump16be((uint16_t)(ctx->cur-len_offset-2), ctx->chunk+len_offset);
+                break;
             case DNS_TYPE_MX:
                 name = rdata + 4;
                 len_offset = ctx->cur;
@@ -414,11 +490,15 @@ int RRSetCompressPack(struct context *ctx, RRSet *rs, size_t nameOffset)
                 ctx->cur += (rdlength+2);
         }
     }
-    return OK_CODE;
+    if (sig == NULL || !ctx->dnssec_ok) return rs->num;
+    // the signer's name in RRSIG is never compressed, so the RRs are copied as is.
+    if (RRSetCompressPack(ctx, sig, NULL, nameOffset) == ERR_CODE) return ERR_CODE;
+    return rs->num + sig->num;
 }
 
 int parseClientSubnet(char *buf, int size, struct clientInfo *cinfo) {
     char *p = buf;
+    if (size < 4) return ERR_CODE;
     uint16_t family = load16be(p);
     p += 2;
     uint8_t source_prefix_len = (uint8_t)(*p++);
@@ -429,6 +509,8 @@ int parseClientSubnet(char *buf, int size, struct clientInfo *cinfo) {
     unsigned addrlen = (source_prefix_len+7U)/8U;
     if (size < (int)(addrlen+4)) return ERR_CODE;
 
+    // the address is looked up in views, so the bytes beyond the prefix must be zero.
+    memset(cinfo->client_ip, 0, sizeof(cinfo->client_ip));
     switch (family) {
         case 1:
             if (source_prefix_len > 32) {
@@ -443,10 +525,10 @@ int parseClientSubnet(char *buf, int size, struct clientInfo *cinfo) {
             if (source_prefix_len > 128) {
                 LOG_DEBUG("edns_client_subnet: invalid src_mask of %u for IPv6",
                           source_prefix_len);
-                cinfo->client_family = AF_INET6;
-                memcpy(&cinfo->client_ip, p, addrlen);
                 return ERR_CODE;
             }
+            cinfo->client_family = AF_INET6;
+            memcpy(&cinfo->client_ip, p, addrlen);
             break;
         default:
             //FIXME: just skip seems a good choice.
@@ -471,15 +553,21 @@ parseEdnsOptions(char *rdata, unsigned rdlength, struct context *ctx) {
         rdlength -= 4;
         if (opt_len > rdlength) return ERR_CODE;
         if (opt_code == OPT_CLIENT_SUBNET_CODE) {
-            if (parseClientSubnet(rdata, rdlength, &ctx->cinfo) != OK_CODE) {
+            if (parseClientSubnet(rdata, opt_len, &ctx->cinfo) != OK_CODE) {
                 return ERR_CODE;
             }
             if (likely(sizeof(ctx->opt_rr) >= (size_t)(ctx->opt_rr_len+opt_len+4))) {
                 ctx->hasClientSubnetOpt = true;
+                // option code(2), option length(2), family(2) and source prefix-length(1)
+                ctx->ecs_scope_off = (uint16_t)(ctx->opt_rr_len + 7);
                 // copy ecs in query buffer to response buffer
                 rte_memcpy(ctx->opt_rr+ctx->opt_rr_len, rdata-4, opt_len+4);
                 ctx->opt_rr_len += (opt_len+4);
             }
+        } else if (opt_code == OPT_COOKIE_CODE) {
+            if (cookieProcess(ctx, rdata, opt_len) != OK_CODE) {
+                return ERR_CODE;
+            }
         }
         rdata += opt_len;
         rdlength -= opt_len;
@@ -505,21 +593,22 @@ decodeRcode decodeOptRR(char *buf, size_t sz, optRR_t *opt_rr, struct context *c
         return DECODE_BADVERS;
     }
     ctx->hasEdns = true;
+    ctx->dnssec_ok = (ntohs(opt_rr->flags) & DNSSEC_OK_MASK) != 0;
 
     rte_memcpy(ctx->opt_rr, buf-1, 11);
     ctx->opt_rr_len = 11U;
+    // the DO bit is copied to response(RFC 3225), the other flags are cleared.
+    dump16be(ctx->dnssec_ok? DNSSEC_OK_MASK: 0, (char *)ctx->opt_rr+7);
+    // the options of response(ECS and COOKIE) differ from the query.
+    dump16be(0, (char *)ctx->opt_rr+9);
 
     if (rdlength) {
         if (parseEdnsOptions(opt_rr->rdata, rdlength, ctx) == ERR_CODE) {
+            ctx->opt_rr_len = 11U;
+            ctx->hasClientSubnetOpt = false;
             return DECODE_FORMERR;
         }
-        if (ctx->hasClientSubnetOpt) {
-            uint16_t ecs_opt_len = ctx->opt_rr_len - (uint16_t )11U;
-            dump16be(ecs_opt_len, buf+8);
-        } else {
-            // set rdlength to 0
-            dump16be(0, buf+8);
-        }
+        dump16be((uint16_t)(ctx->opt_rr_len - 11U), (char *)ctx->opt_rr+9);
     }
     return DECODE_OK;
 }
@@ -545,12 +634,6 @@ decodeRcode decodeQuery(char *buf, size_t sz, struct context *ctx) {
 
     LOG_DEBUG("receive dns query message(xid: %d, qd: %d, an: %d, ns: %d, ar:%d)",
               ctx->hdr.xid, ctx->hdr.nQd, ctx->hdr.nAnRR, ctx->hdr.nNsRR, ctx->hdr.nArRR);
-    // in order to support EDNS, nArRR can bigger than 0
-    if (ctx->hdr.nQd != 1 || ctx->hdr.nAnRR > 0 || ctx->hdr.nNsRR > 0) {
-        LOG_DEBUG("receive bad dns query message(xid: %d, qd: %d, an: %d, ns: %d, ar: %d), drop it",
-                  ctx->hdr.xid, ctx->hdr.nQd, ctx->hdr.nAnRR, ctx->hdr.nNsRR, ctx->hdr.nArRR);
-        return DECODE_IGNORE;
-    }
     if (unlikely(GET_QR(ctx->hdr.flag))) {
         LOG_DEBUG("receive bad dns query packet(QR is set), drop it");
         return DECODE_IGNORE;
@@ -559,9 +642,37 @@ decodeRcode decodeQuery(char *buf, size_t sz, struct context *ctx) {
         LOG_DEBUG("receive bad dns query packet(TC is set), drop it");
         return DECODE_IGNORE;
     }
+    // the error responses check these fields, so reset them before any return.
+    ctx->hasEdns = false;
+    ctx->hasClientSubnetOpt = false;
+    ctx->dnssec_ok = false;
+    ctx->opt_rr_len = 0;
+    ctx->cookie = COOKIE_NONE;
+
+    // NOTIFY may carry the new SOA record in answer section(RFC 1996), it is ignored.
+    if (unlikely(GET_OPCODE(ctx->hdr.flag) == DNS_OPCODE_NOTIFY) && ctx->hdr.nQd == 1) {
+        ctx->nameLen = lenlabellen(ctx->name);
+        return DECODE_NOTIFY;
+    }
+    // IXFR carries the SOA of client in authority section(RFC 1995).
+    if (unlikely(ctx->qType == DNS_TYPE_AXFR || ctx->qType == DNS_TYPE_IXFR) &&
+        GET_OPCODE(ctx->hdr.flag) == DNS_OPCODE_QUERY && ctx->hdr.nQd == 1) {
+        ctx->nameLen = lenlabellen(ctx->name);
+        return DECODE_XFR;
+    }
+    // in order to support EDNS, nArRR can bigger than 0
+    if (ctx->hdr.nQd != 1 || ctx->hdr.nAnRR > 0 || ctx->hdr.nNsRR > 0) {
+        LOG_DEBUG("receive bad dns query message(xid: %d, qd: %d, an: %d, ns: %d, ar: %d), drop it",
+                  ctx->hdr.xid, ctx->hdr.nQd, ctx->hdr.nAnRR, ctx->hdr.nNsRR, ctx->hdr.nArRR);
+        return DECODE_IGNORE;
+    }
 
     ctx->nameLen = lenlabellen(ctx->name);
 
+    if (unlikely(GET_OPCODE(ctx->hdr.flag) != DNS_OPCODE_QUERY)) {
+        return DECODE_NOTIMP;
+    }
+
     if (isSupportDnsType(ctx->qType) == false) {
         return DECODE_NOTIMP;
     }
@@ -570,9 +681,6 @@ decodeRcode decodeQuery(char *buf, size_t sz, struct context *ctx) {
      * we assume the first rr in additional section is OPT RR,
      * TODO search the additional section to get OPT RR
      */
-    ctx->hasEdns = false;
-    ctx->hasClientSubnetOpt = false;
-    ctx->opt_rr_len = 0;
     optRR_t *opt_rr = (optRR_t*)(buf+ctx->cur+1);
     if (ctx->hdr.nArRR > 0
         && likely(sz-ctx->cur >= 11)
@@ -598,7 +706,7 @@ encodeOptRR(struct context *ctx) {
 
 int dumpDnsResp(struct context *ctx, dnsDictValue *dv, zone *z) {
     if (dv == NULL) return ERR_CODE;
-    int errcode;
+    int n;
     numaNode_t *node = ctx->node;
 
     compressInfo temp = {ctx->name, DNS_HDR_SIZE, ctx->nameLen+1};
@@ -615,11 +723,11 @@ int dumpDnsResp(struct context *ctx, dnsDictValue *dv, zone *z) {
 
     cname = dnsDictValueGet(dv, DNS_TYPE_CNAME);
     if (cname) {
-        hdr.nAnRR = 1;
-        errcode = RRSetCompressPack(ctx, cname, DNS_HDR_SIZE);
-        if (errcode == ERR_CODE) {
+        n = RRSetCompressPack(ctx, cname, dnsDictValueGetSig(dv, DNS_TYPE_CNAME), DNS_HDR_SIZE);
+        if (n == ERR_CODE) {
             return ERR_CODE;
         }
+        hdr.nAnRR = (uint16_t)n;
         // dump NS records of the zone this CNAME record's value belongs to to authority section
         if (!sk.minimize_resp) {
             char *name = ctx->ari[0].name;
@@ -628,34 +736,34 @@ int dumpDnsResp(struct context *ctx, dnsDictValue *dv, zone *z) {
             zone *ns_z = ltreeGetZoneRaw(node->lt, name);
             if (ns_z) {
                 if (ns_z->ns) {
-                    hdr.nNsRR += ns_z->ns->num;
                     size_t nameOffset = offset + strlen(name) - strlen(ns_z->origin);
-                    errcode = RRSetCompressPack(ctx, ns_z->ns, nameOffset);
-                    if (errcode == ERR_CODE) {
+                    n = RRSetCompressPack(ctx, ns_z->ns, ns_z->ns_sig, nameOffset);
+                    if (n == ERR_CODE) {
                         return ERR_CODE;
                     }
+                    hdr.nNsRR += n;
                 }
             }
         }
     } else {
         // dump answer section.
         RRSet *rs = dnsDictValueGet(dv, ctx->qType);
-        if (rs) {
-            hdr.nAnRR = rs->num;
-            errcode = RRSetCompressPack(ctx, rs, DNS_HDR_SIZE);
-            if (errcode == ERR_CODE) {
-                return ERR_CODE;
-            }
+        // NODATA, the SOA is in authority section instead of NS.
+        if (rs == NULL) return dumpDnsNegResp(ctx, z, dv, DNS_RCODE_OK);
+        n = RRSetCompressPack(ctx, rs, dnsDictValueGetSig(dv, ctx->qType), DNS_HDR_SIZE);
+        if (n == ERR_CODE) {
+            return ERR_CODE;
         }
+        hdr.nAnRR = (uint16_t)n;
         if (!sk.minimize_resp) {
             // dump NS section
             if (z->ns && (ctx->qType != DNS_TYPE_NS || strcasecmp(z->origin, ctx->name) != 0)) {
-                hdr.nNsRR += z->ns->num;
                 size_t nameOffset = DNS_HDR_SIZE + ctx->nameLen - strlen(z->origin);
-                errcode = RRSetCompressPack(ctx, z->ns, nameOffset);
-                if (errcode == ERR_CODE) {
+                n = RRSetCompressPack(ctx, z->ns, z->ns_sig, nameOffset);
+                if (n == ERR_CODE) {
                     return ERR_CODE;
                 }
+                hdr.nNsRR += n;
             }
         }
     }
@@ -663,27 +771,30 @@ int dumpDnsResp(struct context *ctx, dnsDictValue *dv, zone *z) {
     //TODO avoid duplication
     for (size_t i = 0; i < ctx->ari_sz; i++) {
         zone *ar_z;
+        dnsDictValue *ar_dv;
         char *name = ctx->ari[i].name;
         size_t offset = ctx->ari[i].offset;
 
         // TODO avoid fetch when the name belongs to z
         ar_z = ltreeGetZoneRaw(node->lt, name);
         if (ar_z == NULL) continue;
-        RRSet *ar_a = zoneFetchTypeVal(ar_z, name, DNS_TYPE_A);
+        ar_dv = zoneFetchValue(ar_z, name);
+        if (ar_dv == NULL) continue;
+        RRSet *ar_a = dnsDictValueGet(ar_dv, DNS_TYPE_A);
         if (ar_a) {
-            hdr.nArRR += ar_a->num;
-            errcode = RRSetCompressPack(ctx, ar_a, offset);
-            if (errcode == ERR_CODE) {
+            n = RRSetCompressPack(ctx, ar_a, dnsDictValueGetSig(ar_dv, DNS_TYPE_A), offset);
+            if (n == ERR_CODE) {
                 return ERR_CODE;
             }
+            hdr.nArRR += n;
         }
-        RRSet *ar_aaaa = zoneFetchTypeVal(ar_z, name, DNS_TYPE_AAAA);
+        RRSet *ar_aaaa = dnsDictValueGet(ar_dv, DNS_TYPE_AAAA);
         if (ar_aaaa) {
-            hdr.nArRR += ar_aaaa->num;
-            errcode = RRSetCompressPack(ctx, ar_aaaa, offset);
-            if (errcode == ERR_CODE) {
+            n = RRSetCompressPack(ctx, ar_aaaa, dnsDictValueGetSig(ar_dv, DNS_TYPE_AAAA), offset);
+            if (n == ERR_CODE) {
                 return ERR_CODE;
             }
+            hdr.nArRR += n;
         }
     }
     // dump edns
@@ -696,6 +807,186 @@ int dumpDnsResp(struct context *ctx, dnsDictValue *dv, zone *z) {
     return OK_CODE;
 }
 
+/*
+ * dump the NSEC or NSEC3 RRSet(and its signatures) of a name in the chain, the owner
+ * name is written once(relative labels and a pointer to origin in question).
+ */
+static int dumpNsecEntry(struct context *ctx, zone *z, nsecEntry *e, uint16_t type) {
+    RRSet *nsec = dnsDictValueGet(e->dv, type);
+    RRSet *sig = dnsDictValueGetSig(e->dv, type);
+    uint16_t originOffset = (uint16_t)(0xC000 | (DNS_HDR_SIZE + ctx->nameLen - z->originLen));
+    uint16_t nameOffset = 0;
+
+    if (e->len == 0) return RRSetCompressPack(ctx, nsec, sig, originOffset & 0x3FFF);
+    for (int i = 0; i < nsec->num; ++i) {
+        char *rdata = nsec->data + RRSetGetOffset(nsec, i);
+        uint16_t rdlength = load16be(rdata);
+
+        if (contextMakeRoomForResp(ctx, (int)(e->len + rdlength + 12)) == ERR_CODE) return ERR_CODE;
+        if (i == 0) {
+            nameOffset = (uint16_t)(0xC000 | ctx->cur);
+            rte_memcpy(ctx->chunk+ctx->cur, e->name, e->len);
+            ctx->cur += (int)e->len;
+        }
+        ctx->cur = dumpCompressedRRHeader(ctx->chunk, ctx->cur, ctx->chunk_len, i == 0? originOffset: nameOffset,
+                                          type, DNS_CLASS_IN, nsec->ttl);
+        rte_memcpy(ctx->chunk+ctx->cur, rdata, rdlength+2);
+        ctx->cur += (rdlength+2);
+    }
+    if (sig == NULL) return nsec->num;
+    if (RRSetCompressPack(ctx, sig, NULL, nameOffset & 0x3FFF) == ERR_CODE) return ERR_CODE;
+    return nsec->num + sig->num;
+}
+
+/*
+ * the authenticated denial of existence(RFC 4035 3.1.3) of NSEC signed zones, the chain
+ * is sorted by zoneCompact, so only a binary search is done per query.
+ *
+ * @param dv: the RRSets of the name, NULL if the name doesn't exist or is an empty non-terminal.
+ * @return the number of RRs dumped, ERR_CODE if the buffer can't be expanded.
+ */
+static int dumpNsecProof(struct context *ctx, zone *z, dnsDictValue *dv, int rcode) {
+    char *key = ctx->name;
+    size_t keyLen = ctx->nameLen - z->originLen;
+    nsecEntry *cover, *wildcard;
+    RRSet *nsec;
+    int n, m;
+
+    // NODATA, the type bitmap of the name proves the type doesn't exist.
+    if (dv != NULL) {
+        if ((nsec = dnsDictValueGet(dv, DNS_TYPE_NSEC)) == NULL) return 0;
+        return RRSetCompressPack(ctx, nsec, dnsDictValueGetSig(dv, DNS_TYPE_NSEC), DNS_HDR_SIZE);
+    }
+    // NXDOMAIN or the empty non-terminal, the NSEC RR covers the name.
+    cover = zoneFindNsecCover(z, key, keyLen);
+    if ((n = dumpNsecEntry(ctx, z, cover, DNS_TYPE_NSEC)) == ERR_CODE) return ERR_CODE;
+    if (rcode != DNS_RCODE_NXDOMAIN) return n;
+    // no wildcard could match the name.
+    wildcard = zoneFindWildcardNsecCover(z, key, keyLen);
+    if (wildcard == cover) return n;
+    if ((m = dumpNsecEntry(ctx, z, wildcard, DNS_TYPE_NSEC)) == ERR_CODE) return ERR_CODE;
+    return n + m;
+}
+
+/*
+ * the authenticated denial of existence(RFC 5155 7.2) of NSEC3 signed zones. NODATA gets
+ * the NSEC3 matching the name, NXDOMAIN gets the closest encloser proof(the NSEC3 matching
+ * the closest encloser and the one covering the next closer name) and the NSEC3 covering
+ * the wildcard of the closest encloser. the proof of apex is found by zoneCompact, so
+ * only the next closer name is hashed if the closest encloser is the apex.
+ *
+ * @return the number of RRs dumped, ERR_CODE if the buffer can't be expanded.
+ */
+static int dumpNsec3Proof(struct context *ctx, zone *z, int rcode) {
+    nsec3Chain *c = z->nsec3;
+    char *key = ctx->name;
+    char *end = key + (ctx->nameLen - z->originLen);
+    char *ce, *nc = key;
+    char buf[MAX_DOMAIN_LEN+4] = "\001*";
+    uint8_t hash[NSEC3_HASH_LEN];
+    nsec3Entry *proof[3], *e;
+    int nr_proof = 0, total = 0, n;
+    bool match;
+
+    // NODATA(or the empty non-terminal).
+    if (rcode != DNS_RCODE_NXDOMAIN) {
+        zoneNsec3Hash(z, key, (size_t)(end - key), hash);
+        e = zoneFindNsec3(z, hash, &match);
+        return match? dumpNsecEntry(ctx, z, &e->e, DNS_TYPE_NSEC3): 0;
+    }
+    // the closest encloser is the longest existing ancestor, the next closer name is
+    // one label longer.
+    for (ce = key + (uint8_t)*key + 1; ce < end; nc = ce, ce += (uint8_t)*ce + 1) {
+        memcpy(buf+2, ce, (size_t)(end - ce));
+        buf[2 + (end - ce)] = 0;
+        if (dictFind(z->d, buf+2) != NULL || (z->ents && dictFind(z->ents, buf+2) != NULL)) break;
+    }
+    if (ce == end) {
+        if (c->apex < 0) return 0;
+        proof[nr_proof++] = &c->entries[c->apex];
+        e = &c->entries[c->apex_wildcard];
+    } else {
+        zoneNsec3Hash(z, buf+2, (size_t)(end - ce), hash);
+        proof[nr_proof] = zoneFindNsec3(z, hash, &match);
+        if (!match) return 0;
+        nr_proof++;
+        zoneNsec3Hash(z, buf, 2 + (size_t)(end - ce), hash);
+        e = zoneFindNsec3(z, hash, &match);
+    }
+    zoneNsec3Hash(z, nc, (size_t)(end - nc), hash);
+    proof[nr_proof] = zoneFindNsec3(z, hash, &match);
+    if (proof[nr_proof] != proof[0]) nr_proof++;
+    if (e != proof[0] && e != proof[nr_proof-1]) proof[nr_proof++] = e;
+
+    for (int i = 0; i < nr_proof; ++i) {
+        if ((n = dumpNsecEntry(ctx, z, &proof[i]->e, DNS_TYPE_NSEC3)) == ERR_CODE) return ERR_CODE;
+        total += n;
+    }
+    return total;
+}
+
+/*!
+ * dump the negative response(NXDOMAIN or NODATA) of the zone, the authority section is
+ * the SOA RR prebuilt by zoneCompact, only the owner pointer is patched.
+ * if the zone is signed and the query has DO bit, the prebuilt signatures of SOA
+ * and the NSEC(or NSEC3) RRs proving the denial follow the SOA RR.
+ *
+ * @param dv: the RRSets of the name(NODATA), NULL if the name doesn't have RRSet.
+ * @param rcode: DNS_RCODE_NXDOMAIN or DNS_RCODE_OK(NODATA)
+ */
+int dumpDnsNegResp(struct context *ctx, zone *z, dnsDictValue *dv, int rcode) {
+    dnsHeader_t hdr = {ctx->hdr.xid, 0, 1, 0, 0, 0};
+    int n;
+
+    SET_QR_R(hdr.flag);
+    SET_AA(hdr.flag);
+    if (GET_RD(ctx->hdr.flag)) SET_RD(hdr.flag);
+    SET_ERROR(hdr.flag, rcode);
+
+    if (likely(z->neg_soa != NULL)) {
+        uint16_t owner = (uint16_t)(0xC000 | (DNS_HDR_SIZE + ctx->nameLen - z->originLen));
+        int len = z->neg_soa_len + (ctx->dnssec_ok? z->neg_sig_len: 0);
+        char *p, *end;
+
+        if (unlikely(contextMakeRoomForResp(ctx, len) == ERR_CODE)) return ERR_CODE;
+        rte_memcpy(ctx->chunk+ctx->cur, z->neg_soa, len);
+        for (p = ctx->chunk+ctx->cur, end = p + len; p < end; p += 12 + load16be(p+10)) {
+            dump16be(owner, p);
+            hdr.nNsRR++;
+        }
+        ctx->cur += len;
+    }
+    if (unlikely(ctx->dnssec_ok) && z->nr_nsec > 0) {
+        if ((n = dumpNsecProof(ctx, z, dv, rcode)) == ERR_CODE) return ERR_CODE;
+        hdr.nNsRR += n;
+    } else if (unlikely(ctx->dnssec_ok) && z->nsec3 != NULL) {
+        if ((n = dumpNsec3Proof(ctx, z, rcode)) == ERR_CODE) return ERR_CODE;
+        hdr.nNsRR += n;
+    }
+    if (ctx->hasEdns) {
+        if (unlikely(encodeOptRR(ctx) == ERR_CODE)) return ERR_CODE;
+        hdr.nArRR = 1;
+    }
+    // don't update `cur` in ctx
+    dnsHeader_dump(&hdr, ctx->chunk, DNS_HDR_SIZE);
+    return OK_CODE;
+}
+
+/*!
+ * dump the response of NOTIFY, only the header and question section are included.
+ */
+int dumpDnsNotifyResp(struct context *ctx, int rcode) {
+    dnsHeader_t hdr = {ctx->hdr.xid, 0, 1, 0, 0, 0};
+
+    SET_QR_R(hdr.flag);
+    hdr.flag |= (uint16_t)(DNS_OPCODE_NOTIFY << 11);
+    if (rcode == DNS_RCODE_OK) SET_AA(hdr.flag);
+    SET_ERROR(hdr.flag, rcode);
+
+    dnsHeader_dump(&hdr, ctx->chunk, DNS_HDR_SIZE);
+    return OK_CODE;
+}
+
 int dumpDnsError(struct context *ctx, int err) {
     dnsHeader_t hdr = {ctx->hdr.xid, 0, 1, 0, 0, ctx->hdr.nArRR};
 
@@ -7,7 +7,7 @@
 #include <stdint.h>
 #include <netinet/in.h>
 
-#include <urcu.h>		/* RCU flavor */
+#include <urcu-qsbr.h>	/* RCU flavor */
 #include <urcu/rculfhash.h>	/* RCU Lock-free hash table */
 #include <urcu/compiler.h>	/* For CAA_ARRAY_SIZE */
 
@@ -21,13 +21,17 @@
 #include "str.h"
 #include "protocol.h"
 #include "edns.h"
+#include "cookie.h"
 #include "zone.h"
+#include "acl.h"
 
 #define IP_STR_LEN  INET6_ADDRSTRLEN
 
 
 #define AR_INFO_SIZE   64
 #define CPS_INFO_SIZE  64
+// must be power of 2
+#define RR_IDX_TABLE_SIZE  1024
 
 struct numaNode_s;
 
@@ -79,6 +83,8 @@ struct context {
     struct  numaNode_s *node;
     int lcore_id;
     struct _zone *z;
+    // the length of z's origin, the origin is the suffix of name.
+    size_t originLen;
     // information parsed from dns query packet.
     dnsHeader_t hdr;
     // information of question.
@@ -95,23 +101,44 @@ struct context {
     uint16_t max_resp_size;
 
     struct clientInfo cinfo;
-
-    // the OPT RR for response
-    uint8_t opt_rr[11+24];
+    // source address of the query(network byte order), 4 bytes if src_ipv4 is true, otherwise 16 bytes.
+    char *src_addr;
+    bool src_ipv4;
+    // the view hop of source address looked up in RX burst, VIEW_HOP_UNKNOWN if not looked up.
+    uint32_t src_view;
+    // the acl rule matched in RX burst(0 if none), ACL_RULE_UNKNOWN if the packet isn't classified.
+    uint32_t acl_rule;
+    // the table classifying the RX burst, acl_rule is an index of its rules.
+    aclTable *acl;
+
+    // the result of COOKIE option check(cookieResult)
+    uint8_t cookie;
+    // DO bit of OPT RR, the signatures of pre-signed zones are included.
+    bool dnssec_ok;
+
+    // the OPT RR for response(ECS and COOKIE options)
+    uint8_t opt_rr[11+24+COOKIE_OPT_LEN];
     uint16_t opt_rr_len;
+    // the offset of ECS scope prefix-length in opt_rr
+    uint16_t ecs_scope_off;
 
     size_t ari_sz;
     size_t cps_sz;
     arInfo ari[AR_INFO_SIZE];
     compressInfo cps[CPS_INFO_SIZE];
+
+    // round robin counters, indexed by RRSet hash, never reset.
+    uint8_t rr_idx[RR_IDX_TABLE_SIZE];
 };
 
 typedef enum {
     DECODE_IGNORE  = -4, // totally invalid packet (len < header len or unparseable question, and we do not respond)
     DECODE_FORMERR = -3, // slightly better but still invalid input, we return FORMERR
     DECODE_BADVERS = -2, // EDNS version higher than ours (0)
-    DECODE_NOTIMP  = -1, // non-QUERY opcode or [AI]XFER, we return NOTIMP
+    DECODE_NOTIMP  = -1, // non-QUERY opcode, we return NOTIMP
     DECODE_OK      =  0, // normal and valid
+    DECODE_NOTIFY  =  1, // NOTIFY opcode, the zone should be reloaded
+    DECODE_XFR     =  2, // AXFR or IXFR query
 } decodeRcode;
 
 bool isSupportDnsType(uint16_t type);
@@ -120,6 +147,9 @@ char *abs2relative(char *name, char *origin);
 
 int strToDNSType(const char *ss);
 char *DNSTypeToStr(int ty);
+char *qtypeToStr(int ty, char *buf, size_t size);
+int strToQtype(const char *ss);
+char *rcodeToStr(int rcode, char *buf, size_t size);
 
 int parseDNSHeader(char *buf, size_t size, uint16_t *xid, uint16_t *flag,
                    uint16_t *nQd, uint16_t *nAn, uint16_t *nNs, uint16_t *nAr);
@@ -137,11 +167,13 @@ static inline int dnsHeader_dump(dnsHeader_t *hdr, char *buf, size_t size) {
 int parseDnsQuestion(char *buf, size_t size, char **name, uint16_t *qType, uint16_t *qClass);
 decodeRcode decodeQuery(char *buf, size_t sz, struct context *ctx);
 int dumpDnsResp(struct context *ctx, dnsDictValue *dv, zone *z);
+int dumpDnsNegResp(struct context *ctx, zone *z, dnsDictValue *dv, int rcode);
+int dumpDnsNotifyResp(struct context *ctx, int rcode);
 int dumpDnsError(struct context *ctx, int err);
 
 int contextMakeRoomForResp(struct context *ctx, int addlen);
 
-int RRSetCompressPack(struct context *ctx, RRSet *rs, size_t nameOffset);
+int RRSetCompressPack(struct context *ctx, RRSet *rs, RRSet *sig, size_t nameOffset);
 
 sds sdscatpack(sds s, char const *fmt, ...);
 #if defined(SK_TEST)
@@ -260,7 +260,7 @@ kni_process_tx(lcore_conf_t *qconf, uint8_t port_id)
         LOG_DEBUG("port %d got %d packets and send %d packets to kni.", port_id, nb_tx, nb_kni_tx);
     }
     rte_kni_handle_request(kconf->kni);
-    return 0;
+    return nb_tx;
 }
 
 static int
@@ -286,14 +286,30 @@ kni_process_rx(uint8_t port_id, uint16_t queue_id,
 
         kconf->tx_packets += nb_rx;
     }
+    return nb_kni_rx;
+}
+
+int
+kni_get_stats(uint8_t port_id, sk_kni_stats_t *st)
+{
+    sk_kni_conf_t *kconf = kni_conf_list[port_id];
+
+    if (kconf == NULL) return -1;
+    st->rx_packets = kconf->rx_packets;
+    st->rx_dropped = kconf->rx_dropped;
+    st->tx_packets = kconf->tx_packets;
+    st->tx_dropped = kconf->tx_dropped;
     return 0;
 }
 
-void
+/*
+ * return the number of packets moved between the port and kni.
+ */
+unsigned
 sk_kni_process(lcore_conf_t *qconf, uint8_t port_id, uint16_t queue_id, struct rte_mbuf **pkts_burst, unsigned count)
 {
-    kni_process_tx(qconf, port_id);
-    kni_process_rx(port_id, queue_id, pkts_burst, count);
+    unsigned n = (unsigned)kni_process_tx(qconf, port_id);
+    return n + (unsigned)kni_process_rx(port_id, queue_id, pkts_burst, count);
 }
 
 /* Initialize KNI subsystem */
@@ -591,7 +591,7 @@ int sk_handle_arp_request(struct rte_mbuf *m, int portid) {
 
 static inline __attribute__((always_inline)) void
 __handle_packet(struct rte_mbuf *m, uint8_t portid,
-                 lcore_conf_t *qconf)
+                 lcore_conf_t *qconf, uint32_t src_view, aclTable *acl, uint32_t acl_rule)
 {
     port_info_t *pinfo = sk.port_info[portid];
     if (pinfo->hw_features.rx_csum && !verify_cksum(m)) {
@@ -720,7 +720,7 @@ __handle_packet(struct rte_mbuf *m, uint8_t portid,
     rte_pktmbuf_trim(m, (uint16_t)(data_end - udp_data));
 
     res = processUDPDnsQuery(m, udp_data, udp_data_len, src_addr,
-                             udp_h->src_port, is_ipv4, qconf);
+                             udp_h->src_port, is_ipv4, src_view, acl, acl_rule, qconf);
     if(res == ERR_CODE) goto dropped;
 
     // ethernet frame should at least contain 64 bytes(include 4 byte CRC)
@@ -807,11 +807,21 @@ static void handle_packets(int nb_rx, struct rte_mbuf **pkts_burst,
                            uint8_t portid, lcore_conf_t *qconf)
 {
     int32_t j;
+    uint32_t view_hops[MAX_PKT_BURST];
+    uint32_t acl_rules[MAX_PKT_BURST];
+    viewTable *vt = rcu_dereference(qconf->node->vt);
+    aclTable *acl = rcu_dereference(qconf->node->acl);
 
     /* Prefetch first packets */
     for (j = 0; j < PREFETCH_OFFSET && j < nb_rx; j++)
         rte_prefetch0(rte_pktmbuf_mtod(pkts_burst[j], void *));
 
+    // classify the whole burst and drop the denied packets before they are parsed.
+    if (acl != NULL) nb_rx = aclFilterBurst(acl, qconf->lcore_id, pkts_burst, nb_rx, acl_rules);
+
+    // look up the views of all source addresses at once.
+    if (vt != NULL) viewLookupBurst(vt, pkts_burst, nb_rx, view_hops);
+
     /*
      * Prefetch and forward already prefetched
      * packets.
@@ -819,12 +829,14 @@ static void handle_packets(int nb_rx, struct rte_mbuf **pkts_burst,
     for (j = 0; j < (nb_rx - PREFETCH_OFFSET); j++) {
         rte_prefetch0(rte_pktmbuf_mtod(pkts_burst[
                                            j + PREFETCH_OFFSET], void *));
-        __handle_packet(pkts_burst[j], portid, qconf);
+        __handle_packet(pkts_burst[j], portid, qconf, vt? view_hops[j]: VIEW_HOP_UNKNOWN,
+                        acl, acl? acl_rules[j]: ACL_RULE_UNKNOWN);
     }
 
     /* Forward remaining prefetched packets */
     for (; j < nb_rx; j++)
-        __handle_packet(pkts_burst[j], portid, qconf);
+        __handle_packet(pkts_burst[j], portid, qconf, vt? view_hops[j]: VIEW_HOP_UNKNOWN,
+                        acl, acl? acl_rules[j]: ACL_RULE_UNKNOWN);
 }
 
 int
@@ -834,7 +846,8 @@ launch_one_lcore(__attribute__((unused)) void *dummy)
     unsigned lcore_id = rte_lcore_id();
     lcore_conf_t *qconf = &sk.lcore_conf[lcore_id];
     uint64_t prev_tsc, diff_tsc, cur_tsc;
-    int i, nb_rx;
+    int i, nb_rx, nb_total;
+    unsigned idle_polls = 0;
     uint8_t portid, queueid;
     const uint64_t drain_tsc = (rte_get_tsc_hz() + US_PER_S - 1) /
         US_PER_S * BURST_TX_DRAIN_US;
@@ -848,6 +861,8 @@ launch_one_lcore(__attribute__((unused)) void *dummy)
 
     if (qconf->nr_ports == 0) {
         LOG_INFO("lcore %u has nothing to do.", lcore_id);
+        // an online QSBR reader which never reports quiescent state blocks all grace periods.
+        rcu_unregister_thread();
         return 0;
     }
 
@@ -885,23 +900,47 @@ launch_one_lcore(__attribute__((unused)) void *dummy)
         /*
          * Read packet from RX queues
          */
+        nb_total = 0;
         for (i = 0; i < qconf->nr_ports; i++) {
 
             portid = (uint8_t )qconf->port_id_list[i];
             queueid = (uint8_t )qconf->queue_id_list[portid];
 
             if (!sk.only_udp) {
-                sk_kni_process(qconf, portid, queueid, pkts_burst, MAX_PKT_BURST);
+                // the traffic to and from kni(tcp, admin etc.) keeps the lcore busy too.
+                nb_total += sk_kni_process(qconf, portid, queueid, pkts_burst, MAX_PKT_BURST);
             }
 
             nb_rx = rte_eth_rx_burst(portid, queueid, pkts_burst, MAX_PKT_BURST);
             if (nb_rx == 0)
                 continue;
             qconf->received_req += nb_rx;
+            nb_total += nb_rx;
             // LOG_DEBUG("lcore %d recv port %d, queue %d, nb_rx: %d\n", qconf->lcore_id, portid, queueid, nb_rx);
 
             handle_packets(nb_rx, pkts_burst, portid, qconf);
         }
+
+        /*
+         * no ltree node or zone is referenced across loop iterations,
+         * so announce a quiescent state once per iteration.
+         */
+        rcu_quiescent_state();
+
+        /*
+         * optional back-off of an idle lcore(idle_backoff_us), trades the latency of the
+         * first packets of a burst for cpu, lcores busy poll by default.
+         */
+        if (sk.idle_backoff_us > 0) {
+            if (nb_total > 0) {
+                idle_polls = 0;
+            } else if (++idle_polls >= IDLE_BACKOFF_POLLS) {
+                // go offline while sleeping, so the idle lcore won't delay grace periods.
+                rcu_thread_offline();
+                usleep((useconds_t)sk.idle_backoff_us);
+                rcu_thread_online();
+            }
+        }
     }
 
     rcu_unregister_thread();
@@ -922,7 +961,7 @@ init_dpdk_eal() {
     snprintf(log_cmd, 128, "--log-level=%d", log_level);
     snprintf(mem_channel_str, 128, "%d", sk.mem_channels);
     /* initialize the rte env first*/
-    char *argv[] = {
+    char *argv[16 + 2 * CONFIG_VDEV_MAX] = {
             "",
             "-l",
             sk.total_lcore_list,
@@ -931,9 +970,15 @@ init_dpdk_eal() {
             master_lcore_cmd,
             log_cmd,
             "--proc-type=auto",
-            "--"
     };
-    const int argc = 9;
+    int argc = 8;
+    // virtual devices make it possible to run without a NIC(tests and benchmarks).
+    for (int i = 0; i < sk.nr_vdevs; ++i) {
+        argv[argc++] = "--vdev";
+        argv[argc++] = sk.vdevs[i];
+    }
+    if (sk.no_pci) argv[argc++] = "--no-pci";
+    argv[argc++] = "--";
     /*
      * reset optind, because rte_eal_init uses getopt.
      */
@@ -51,6 +51,9 @@
 
 #define MAX_PKT_BURST     32
 #define BURST_TX_DRAIN_US 100 /* TX drain every ~100us */
+#define IDLE_BACKOFF_POLLS 1024 /* consecutive empty polls before backing off(idle_backoff_us) */
+#define NR_RCODES         16  /* the rcode field of dns header has 4 bits */
+#define NR_QTYPES         512 /* larger qtypes are counted in slot 0(reserved type) */
 
 
 struct mbuf_table {
@@ -59,6 +62,19 @@ struct mbuf_table {
 };
 
 struct numaNode_s;
+typedef struct topkLcore_s topkLcore;
+typedef struct nxguardLcore_s nxguardLcore;
+
+/*
+ * query counters of an lcore, written only by the owning lcore without atomic
+ * operations, readers(admin, metrics) load them without locks.
+ */
+typedef struct {
+    int64_t nr_qtype[NR_QTYPES];
+    int64_t nr_rcode[NR_RCODES];
+    // the queries with COOKIE option by cookieResult
+    int64_t nr_cookie[NR_COOKIE_RESULTS];
+} __rte_cache_aligned lcoreQueryStats;
 
 typedef struct lcore_conf {
     lua_State *L;
@@ -92,6 +108,12 @@ typedef struct lcore_conf {
     int64_t nr_dropped;
 
     int64_t received_req;
+    // queries by qtype and responses by rcode
+    lcoreQueryStats qstats;
+    // heavy hitter tables, NULL if disabled
+    topkLcore *topk;
+    // the zones hinted to nxguard, NULL if disabled
+    nxguardLcore *nxguard;
     // context used to decode request and construct response
     struct context ctx;
 } __rte_cache_aligned lcore_conf_t;
@@ -136,7 +158,16 @@ int kni_ifconfig_all();
 bool is_all_veth_up();
 int kni_send_single_packet(lcore_conf_t *qconf, struct rte_mbuf *m, uint8_t port);
 
-void
+typedef struct {
+    uint64_t rx_packets;
+    uint64_t rx_dropped;
+    uint64_t tx_packets;
+    uint64_t tx_dropped;
+} sk_kni_stats_t;
+
+int kni_get_stats(uint8_t port_id, sk_kni_stats_t *st);
+
+unsigned
 sk_kni_process(lcore_conf_t *qconf, uint8_t port_id, uint16_t queue_id, struct rte_mbuf **pkts_burst, unsigned count);
 
 #ifdef SK_TEST
@@ -2,60 +2,197 @@
 // Created by yangyu on 17-11-14.
 //
 #include <string.h>
+#include <assert.h>
 #include "log.h"
 #include "dnspacket.h"
 #include "ltree.h"
 #include "zmalloc.h"
+#include "utils.h"
 
 DEF_LOG_MODULE(RTE_LOGTYPE_USER1, "LTREE");
 
+static ltreeReclaimStats reclaim_stats;
+
 /*----------------------------------------------
  *     label tree definition
  *---------------------------------------------*/
+static void ltreeNodeDeferFree(ltreeNode *lnode);
+
+static inline size_t ltreeNodeSize(ltreeNode *lnode) {
+    return sizeof(*lnode) + (size_t)(*(lnode->label)) + 2;
+}
+
+static inline size_t ltreeChildrenSize(ltreeChildren *kids) {
+    return sizeof(*kids) + kids->nr * sizeof(ltreeChildEntry);
+}
+
 static ltreeNode *ltreeNodeCreate(int socket_id, char *label) {
-    ltreeNode *lnode = socket_calloc(socket_id, 1, sizeof(*lnode));
-    long l_socket_id = (long)socket_id;
-    int max_table_order = (sizeof(long) == 8)? 64 : 32;
-    lnode->children = cds_lfht_new_priv(1, 1, 1UL << (max_table_order - 1),
-                                        CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
-                                        &cds_lfht_mm_socket, NULL, (void*)l_socket_id);
     int label_len = *label;
-    lnode->label = socket_calloc(socket_id, 1, label_len+2);
+    ltreeNode *lnode = socket_calloc(socket_id, 1, sizeof(*lnode) + label_len + 2);
     rte_memcpy(lnode->label, label, label_len+1);
+    lnode->hash = ltreeHash(label, label_len + 1);
     lnode->socket_id = socket_id;
     return lnode;
 }
 
-static void ltreeNodeDestroy(ltreeNode *lnode) {
-    if (lnode->label) {
-        socket_free(lnode->socket_id, lnode->label);
+/*
+ * the copy shares the children with lnode, so lnode should be
+ * marked as shallow before it is freed.
+ */
+static ltreeNode *ltreeNodeDup(ltreeNode *lnode) {
+    size_t sz = ltreeNodeSize(lnode);
+    ltreeNode *new_lnode = socket_malloc(lnode->socket_id, sz);
+    memcpy(new_lnode, lnode, sz);
+    cds_lfht_node_init(&new_lnode->htnode);
+    return new_lnode;
+}
+
+static struct cds_lfht *ltreeHtCreate(int socket_id, unsigned long init_size) {
+    long l_socket_id = (long)socket_id;
+    int max_table_order = (sizeof(long) == 8)? 64 : 32;
+    unsigned long size = 1;
+
+    // init_size must be power of 2
+    while (size < init_size) size <<= 1;
+    return cds_lfht_new_priv(size, 1, 1UL << (max_table_order - 1),
+                             CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
+                             &cds_lfht_mm_socket, NULL, (void*)l_socket_id);
+}
+
+static ltreeChildren *ltreeChildrenCreate(int socket_id, int nr) {
+    ltreeChildren *kids = socket_calloc(socket_id, 1, sizeof(*kids) + nr * sizeof(ltreeChildEntry));
+    kids->socket_id = socket_id;
+    kids->nr = nr;
+    return kids;
+}
+
+/*
+ * move the children in the array of old to a hash table which can hold size_hint children.
+ */
+static ltreeChildren *ltreeChildrenCreateHt(int socket_id, ltreeChildren *old, size_t size_hint) {
+    ltreeChildren *kids = ltreeChildrenCreate(socket_id, 0);
+    if (size_hint < 2 * LTREE_INLINE_MAX) size_hint = 2 * LTREE_INLINE_MAX;
+    kids->ht = ltreeHtCreate(socket_id, size_hint);
+    if (old == NULL) return kids;
+
+    for (int i = 0; i < old->nr; ++i) {
+        ltreeNode *child = old->entries[i].node;
+        cds_lfht_add_unique(kids->ht, child->hash, ltreeHtMatch, child->label, &child->htnode);
     }
+    return kids;
+}
+
+static void ltreeChildrenFreeCallback(struct rcu_head *head) {
+    ltreeChildren *kids = caa_container_of(head, ltreeChildren, rcu_head);
+    socket_free(kids->socket_id, kids);
+}
+
+static void ltreeNodeDestroy(ltreeNode *lnode) {
+    ltreeChildren *kids = lnode->children;
+
     if (lnode->z) {
         zoneDestroy(lnode->z);
     }
-    if (lnode->children) {
-        int ret;
-        struct cds_lfht_iter iter;	/* For iteration on hash table */
-        struct cds_lfht_node *ht_node;
-        struct cds_lfht *ht = lnode->children;
-        ltreeNode *child;
-        cds_lfht_for_each_entry(ht, &iter, child, htnode) {
-            ht_node = cds_lfht_iter_get_node(&iter);
-            ret = cds_lfht_del(ht, ht_node);
-            if (!ret) {
-                call_rcu(&child->rcu_head, ltreeFreeCallback);
+    if (kids && !lnode->shallow) {
+        if (kids->ht) {
+            int ret;
+            struct cds_lfht_iter iter;	/* For iteration on hash table */
+            struct cds_lfht_node *ht_node;
+            struct cds_lfht *ht = kids->ht;
+            ltreeNode *child;
+            cds_lfht_for_each_entry(ht, &iter, child, htnode) {
+                ht_node = cds_lfht_iter_get_node(&iter);
+                ret = cds_lfht_del(ht, ht_node);
+                if (!ret) {
+                    ltreeNodeDeferFree(child);
+                }
+            }
+            int err = cds_lfht_destroy(ht, NULL);
+            if (err) {
+                LOG_ERR("destroy cru hash table failed.");
+            }
+        } else {
+            for (int i = 0; i < kids->nr; ++i) {
+                ltreeNodeDeferFree(kids->entries[i].node);
             }
         }
-        int err = cds_lfht_destroy(lnode->children, NULL);
-        if (err) {
-            LOG_ERR("destroy cru hash table failed.");
-        }
+        socket_free(kids->socket_id, kids);
     }
     socket_free(lnode->socket_id, lnode);
 }
 
-static void ltreeNodeSetParent(ltreeNode *lnode, ltreeNode *parent) {
-    lnode->parent = parent;
+/*
+ * lookup the child whose label is equal to label, the caller must hold the read lock.
+ */
+static ltreeNode *ltreeNodeGetChild(ltreeNode *lnode, char *label) {
+    ltreeChildren *kids = rcu_dereference(lnode->children);
+    if (kids == NULL) return NULL;
+
+    uint8_t label_len = (uint8_t )*label;
+    unsigned int hash = ltreeHash(label, label_len + 1);
+    if (kids->ht) {
+        struct cds_lfht_iter iter;	/* For iteration on hash table */
+        struct cds_lfht_node *ht_node;
+        cds_lfht_lookup(kids->ht, hash, ltreeHtMatch, label, &iter);
+        ht_node = cds_lfht_iter_get_node(&iter);
+        if (!ht_node) return NULL;
+        return caa_container_of(ht_node, ltreeNode, htnode);
+    }
+    for (int i = 0; i < kids->nr; ++i) {
+        if (kids->entries[i].hash != hash) continue;
+        ltreeNode *child = rcu_dereference(kids->entries[i].node);
+        if (strncasecmp(child->label, label, label_len+1) == 0) return child;
+    }
+    return NULL;
+}
+
+/*
+ * add a new child, only called by writer. the child must not exist.
+ */
+static int ltreeNodeAddChild(ltreeNode *lnode, ltreeNode *child) {
+    ltreeChildren *old = lnode->children, *kids;
+    struct cds_lfht_node *ht_node;
+
+    if (old && old->ht) {
+        ht_node = cds_lfht_add_unique(old->ht, child->hash, ltreeHtMatch, child->label, &child->htnode);
+        return ht_node == &child->htnode? DICT_OK: DICT_ERR;
+    }
+
+    int nr = old? old->nr: 0;
+    if (nr < LTREE_INLINE_MAX) {
+        kids = ltreeChildrenCreate(lnode->socket_id, nr+1);
+        if (nr > 0) memcpy(kids->entries, old->entries, nr * sizeof(ltreeChildEntry));
+        kids->entries[nr].hash = child->hash;
+        kids->entries[nr].node = child;
+    } else {
+        kids = ltreeChildrenCreateHt(lnode->socket_id, old, (size_t)nr * 2);
+        cds_lfht_add_unique(kids->ht, child->hash, ltreeHtMatch, child->label, &child->htnode);
+    }
+    rcu_assign_pointer(lnode->children, kids);
+    if (old) call_rcu(&old->rcu_head, ltreeChildrenFreeCallback);
+    return DICT_OK;
+}
+
+/*
+ * replace the child old_child with new_child which has the same label, only called by writer.
+ */
+static void ltreeNodeReplaceChild(ltreeNode *lnode, ltreeNode *old_child, ltreeNode *new_child) {
+    ltreeChildren *kids = lnode->children;
+    struct cds_lfht_node *ht_node;
+
+    if (kids->ht) {
+        ht_node = cds_lfht_add_replace(kids->ht, new_child->hash, ltreeHtMatch,
+                                       new_child->label, &new_child->htnode);
+        assert(caa_container_of(ht_node, ltreeNode, htnode) == old_child);
+        return;
+    }
+    for (int i = 0; i < kids->nr; ++i) {
+        if (kids->entries[i].node == old_child) {
+            rcu_assign_pointer(kids->entries[i].node, new_child);
+            return;
+        }
+    }
+    assert(0);
 }
 
 int ltreeHtMatch(struct cds_lfht_node *ht_node, const void *_key)
@@ -69,22 +206,50 @@ int ltreeHtMatch(struct cds_lfht_node *ht_node, const void *_key)
 void ltreeFreeCallback(struct rcu_head *head)
 {
     ltreeNode *lnode = caa_container_of(head, ltreeNode, rcu_head);
+    unsigned long long latency = (unsigned long long)(ustime() - lnode->defer_us);
+    unsigned long long old_max;
+    size_t bytes = lnode->defer_bytes;
+
     ltreeNodeDestroy(lnode);
+
+    uatomic_sub(&reclaim_stats.pending_nodes, 1);
+    uatomic_sub(&reclaim_stats.pending_bytes, bytes);
+    uatomic_inc(&reclaim_stats.reclaimed_nodes);
+    uatomic_add(&reclaim_stats.reclaimed_bytes, bytes);
+    uatomic_add(&reclaim_stats.gp_latency_us_total, latency);
+    uatomic_set(&reclaim_stats.gp_latency_us_last, latency);
+    do {
+        old_max = uatomic_read(&reclaim_stats.gp_latency_us_max);
+        if (latency <= old_max) break;
+    } while (uatomic_cmpxchg(&reclaim_stats.gp_latency_us_max, old_max, latency) != old_max);
 }
 
-static void *rcu_ht_fetch_value(struct cds_lfht *ht, void *_key) {
-    struct cds_lfht_iter iter;	/* For iteration on hash table */
-    struct cds_lfht_node *ht_node;
-    char *label = _key;
-    uint8_t label_len = (uint8_t )*label;
-    unsigned int hash = ltreeHash(label, label_len + 1);
-    cds_lfht_lookup(ht, hash, ltreeHtMatch, label, &iter);
-    ht_node = cds_lfht_iter_get_node(&iter);
-    if (!ht_node) {
-        return NULL;
-    } else {
-        return caa_container_of(ht_node, ltreeNode, htnode);
-    }
+/*!
+ * hand the node to the call_rcu worker, the node(and its zone) is freed
+ * after all reader threads have passed a quiescent state.
+ * the writer thread uses a dedicated call_rcu worker, so the callbacks queued
+ * in one cron loop are reclaimed in one batch after a single grace period.
+ */
+static void ltreeNodeDeferFree(ltreeNode *lnode) {
+    size_t bytes = ltreeNodeSize(lnode);
+    if (lnode->z) bytes += lnode->z->mem_usage;
+    if (lnode->children && !lnode->shallow) bytes += ltreeChildrenSize(lnode->children);
+
+    lnode->defer_us = ustime();
+    lnode->defer_bytes = bytes;
+    uatomic_inc(&reclaim_stats.pending_nodes);
+    uatomic_add(&reclaim_stats.pending_bytes, bytes);
+    call_rcu(&lnode->rcu_head, ltreeFreeCallback);
+}
+
+void ltreeGetReclaimStats(ltreeReclaimStats *stats) {
+    stats->pending_nodes = uatomic_read(&reclaim_stats.pending_nodes);
+    stats->pending_bytes = uatomic_read(&reclaim_stats.pending_bytes);
+    stats->reclaimed_nodes = uatomic_read(&reclaim_stats.reclaimed_nodes);
+    stats->reclaimed_bytes = uatomic_read(&reclaim_stats.reclaimed_bytes);
+    stats->gp_latency_us_total = uatomic_read(&reclaim_stats.gp_latency_us_total);
+    stats->gp_latency_us_max = uatomic_read(&reclaim_stats.gp_latency_us_max);
+    stats->gp_latency_us_last = uatomic_read(&reclaim_stats.gp_latency_us_last);
 }
 
 /* case insensitive hash function (based on djb hash) */
@@ -99,7 +264,6 @@ unsigned int ltreeHash(char *buf, size_t len) {
 ltree *ltreeCreate(int socket_id) {
     ltree *lt = socket_calloc(socket_id, 1, sizeof(*lt));
     lt->root = ltreeNodeCreate(socket_id, "");
-    ltreeNodeSetParent(lt->root, lt->root);
     lt->socket_id = socket_id;
     return lt;
 }
@@ -132,7 +296,7 @@ zone *ltreeGetZone(ltree *lt, struct dname *dn) {
         char *label = dn->name + dn->label_offset[i];
         LOG_DEBUG("get zone exact: label %s, %d", label, label[0]);
 
-        lnode = rcu_ht_fetch_value(parent_lnode->children, label);
+        lnode = ltreeNodeGetChild(parent_lnode, label);
         if (lnode == NULL) break;
         if (lnode->z != NULL) z = lnode->z;
         parent_lnode = lnode;
@@ -159,7 +323,7 @@ zone *ltreeGetZoneExact(ltree *lt, struct dname *dn) {
         char *label = dn->name + dn->label_offset[i];
 
         LOG_DEBUG("get zone exact: label %s, %d", label, label[0]);
-        lnode = rcu_ht_fetch_value(parent_lnode->children, label);
+        lnode = ltreeNodeGetChild(parent_lnode, label);
         if (lnode == NULL) break;
         parent_lnode = lnode;
         if (i == 0) {
@@ -169,61 +333,61 @@ zone *ltreeGetZoneExact(ltree *lt, struct dname *dn) {
     return z;
 }
 
+/*
+ * fetch the node of dn, the missing nodes in the path are created if create is true.
+ * the parent of the returned node is stored in parentp.
+ */
+static ltreeNode *ltreeGetNode(ltree *lt, struct dname *dn, bool create, ltreeNode **parentp) {
+    ltreeNode *lnode = NULL;
+    ltreeNode *parent_lnode = lt->root;
+
+    for (int i = dn->label_count-1; i >= 0; i--) {
+        char *label = dn->name + dn->label_offset[i];
+        lnode = ltreeNodeGetChild(parent_lnode, label);
+        if (lnode == NULL) {
+            if (!create) return NULL;
+            lnode = ltreeNodeCreate(lt->socket_id, label);
+            if (ltreeNodeAddChild(parent_lnode, lnode) != DICT_OK) {
+                socket_free(lnode->socket_id, lnode);
+                return NULL;
+            }
+        }
+        if (i > 0) parent_lnode = lnode;
+    }
+    if (parentp) *parentp = parent_lnode;
+    return lnode;
+}
+
+/*
+ * replace lnode with a copy whose zone is z, the old node and its zone are freed after a grace period.
+ */
+static void ltreeNodeReplaceZone(ltreeNode *parent_lnode, ltreeNode *lnode, zone *z) {
+    ltreeNode *new_lnode = ltreeNodeDup(lnode);
+    new_lnode->z = z;
+    ltreeNodeReplaceChild(parent_lnode, lnode, new_lnode);
+    lnode->shallow = true;
+    ltreeNodeDeferFree(lnode);
+}
+
 /* Add a zone, discarding the old if the key already exists.
  * Return 1 if the key was added from scratch, 0 if there was already an
  * element with such key and dictReplace() just performed a value update
  * operation. */
 int ltreeReplaceNoLock(ltree *lt, zone *z) {
     struct dname dn;
-    makeDname(z->origin, &dn);
-    int err = 1;
-    int max_count = dn.label_count;
-
+    ltreeNode *lnode, *parent_lnode;
 
-    struct cds_lfht *ht = NULL;
-    ltreeNode *lnode = NULL;
-    ltreeNode *parent_lnode = lt->root;
-    for (int i = max_count-1; i >= 0; i--) {
-        char *label = dn.name + dn.label_offset[i];
-        ht = parent_lnode->children;
-        lnode = rcu_ht_fetch_value(ht, label);
-        if (lnode == NULL) {
-            struct cds_lfht_node *htnode;
-            int label_len = *label;
-            unsigned int hash = ltreeHash(label, label_len + 1);
-            lnode = ltreeNodeCreate(lt->socket_id, label);
-            ltreeNodeSetParent(lnode, parent_lnode);
+    makeDname(z->origin, &dn);
+    lnode = ltreeGetNode(lt, &dn, true, &parent_lnode);
+    if (lnode == NULL) return DICT_ERR;
 
-            htnode = cds_lfht_add_unique(ht, hash, ltreeHtMatch, label, &lnode->htnode);
-            if (htnode != &lnode->htnode) {
-                return DICT_ERR;
-            }
-        }
-        if (i == 0) {
-            if (lnode->z == NULL) {
-                lnode->z = z;
-                lt->nb_zone++;
-            } else {
-                struct cds_lfht_node *ht_node;
-                int label_len = *label;
-                unsigned int hash = ltreeHash(label, label_len + 1);
-                ltreeNode *new_lnode = socket_malloc(lt->socket_id, sizeof(ltreeNode));
-                memcpy(new_lnode, lnode, sizeof(ltreeNode));
-                new_lnode->z = z;
-                cds_lfht_node_init(&new_lnode->htnode);
-
-                ht_node = cds_lfht_add_replace(ht, hash, ltreeHtMatch, label, &new_lnode->htnode);
-                ltreeNode *old_node = caa_container_of(ht_node, ltreeNode, htnode);
-                assert(old_node == lnode);
-                old_node->label = NULL;
-                old_node->children = NULL;
-                call_rcu(&old_node->rcu_head, ltreeFreeCallback);
-                err = 0;
-            }
-        }
-        parent_lnode = lnode;
+    if (lnode->z == NULL) {
+        rcu_assign_pointer(lnode->z, z);
+        lt->nb_zone++;
+        return 1;
     }
-    return err;
+    ltreeNodeReplaceZone(parent_lnode, lnode, z);
+    return 0;
 }
 
 int ltreeReplace(ltree *lt, zone *z) {
@@ -237,37 +401,46 @@ int ltreeAdd(ltree *lt, zone *z) {
     struct dname dn;
     makeDname(z->origin, &dn);
     int err = DICT_OK;
-    ltreeNode *lnode = NULL, *parent_lnode = NULL;
-    struct cds_lfht *ht;
-    int max_count = dn.label_count;
+    ltreeNode *lnode;
 
     ltreeWLock(lt);
+    lnode = ltreeGetNode(lt, &dn, true, NULL);
+    if (lnode == NULL || lnode->z != NULL) {
+        err = DICT_ERR;
+    } else {
+        rcu_assign_pointer(lnode->z, z);
+        lt->nb_zone++;
+    }
+    ltreeWUnlock(lt);
+    return err;
+}
 
-    parent_lnode = lt->root;
-    for (int i = max_count-1; i >= 0; i--) {
-        char *label = dn.name + dn.label_offset[i];
-        ht = parent_lnode->children;
+/*!
+ * presize the children table of origin's node, mainly used before loading lots of zones,
+ * so the hash table doesn't need to be resized again and again.
+ *
+ * @param lt
+ * @param origin: len label format
+ * @param nr_children: the expected number of children
+ * @return DICT_OK or DICT_ERR
+ */
+int ltreeReserve(ltree *lt, char *origin, size_t nr_children) {
+    struct dname dn;
+    ltreeNode *lnode;
+    int err = DICT_OK;
 
-        lnode = rcu_ht_fetch_value(ht, label);
-        if (lnode == NULL) {
-            struct cds_lfht_node *htnode;
-            int label_len = *label;
-            unsigned int hash = ltreeHash(label, label_len + 1);
-            lnode = ltreeNodeCreate(lt->socket_id, label);
-            ltreeNodeSetParent(lnode, parent_lnode);
+    if (nr_children <= LTREE_INLINE_MAX) return DICT_OK;
+    makeDname(origin, &dn);
 
-            htnode = cds_lfht_add_unique(ht, hash, ltreeHtMatch, label, &lnode->htnode);
-            assert(htnode == &lnode->htnode);
-        }
-        parent_lnode = lnode;
-        if (i == 0) {
-            if (lnode->z == NULL) {
-                lnode->z = z;
-                lt->nb_zone++;
-            } else {
-                err = DICT_ERR;
-            }
-        }
+    ltreeWLock(lt);
+    lnode = dn.label_count == 0? lt->root: ltreeGetNode(lt, &dn, true, NULL);
+    if (lnode == NULL) {
+        err = DICT_ERR;
+    } else if (lnode->children == NULL || lnode->children->ht == NULL) {
+        ltreeChildren *old = lnode->children;
+        ltreeChildren *kids = ltreeChildrenCreateHt(lnode->socket_id, old, nr_children);
+        rcu_assign_pointer(lnode->children, kids);
+        if (old) call_rcu(&old->rcu_head, ltreeChildrenFreeCallback);
     }
     ltreeWUnlock(lt);
     return err;
@@ -275,47 +448,15 @@ int ltreeAdd(ltree *lt, zone *z) {
 
 int ltreeDeleteNoLock(ltree *lt, char *origin) {
     struct dname dn;
-    makeDname(origin, &dn);
-    int err = DICT_OK;
-    ltreeNode *lnode = NULL, *parent_lnode=NULL;
-    struct cds_lfht *ht;
-    int max_count = dn.label_count;
+    ltreeNode *lnode, *parent_lnode;
 
-    parent_lnode = lt->root;
-    for (int i = max_count-1; i >= 0; i--) {
-        char *label = dn.name + dn.label_offset[i];
-        ht = parent_lnode->children;
+    makeDname(origin, &dn);
+    lnode = ltreeGetNode(lt, &dn, false, &parent_lnode);
+    if (lnode == NULL || lnode->z == NULL) return DICT_ERR;
 
-        lnode = rcu_ht_fetch_value(ht, label);
-        if (lnode == NULL) {
-            err = DICT_ERR;
-            break;
-        }
-        if (i == 0) {
-            if (lnode->z == NULL) {
-                err = DICT_ERR;
-            } else {
-                struct cds_lfht_node *ht_node;
-                int label_len = *label;
-                unsigned int hash = ltreeHash(label, label_len + 1);
-                ltreeNode *new_lnode = socket_malloc(lt->socket_id, sizeof(ltreeNode));
-                memcpy(new_lnode, lnode, sizeof(ltreeNode));
-                new_lnode->z = NULL;
-                cds_lfht_node_init(&new_lnode->htnode);
-
-                ht_node = cds_lfht_add_replace(ht, hash, ltreeHtMatch, label, &new_lnode->htnode);
-                ltreeNode *old_node = caa_container_of(ht_node, ltreeNode, htnode);
-                assert(old_node == lnode);
-                old_node->label = NULL;
-                old_node->children = NULL;
-                call_rcu(&old_node->rcu_head, ltreeFreeCallback);
-                lt->nb_zone--;
-                err = DICT_OK;
-            }
-        }
-        parent_lnode = lnode;
-    }
-    return err;
+    ltreeNodeReplaceZone(parent_lnode, lnode, NULL);
+    lt->nb_zone--;
+    return DICT_OK;
 }
 
 int ltreeDelete(ltree *lt, char *origin) {
@@ -344,28 +485,126 @@ size_t ltreeGetNumZones(ltree *lt) {
     return (size_t)count;
 }
 
-// may lock the dict long time, mainly for debug.
-static sds ltreeNodeToStr(ltreeNode *lnode, sds s) {
-    struct cds_lfht_iter iter;	/* For iteration on hash table */
-    sds zone_s;
-    struct cds_lfht *ht = lnode->children;
-    cds_lfht_for_each_entry(ht, &iter, lnode, htnode) {
-        if (lnode->z) {
-            zone_s = zoneToStr(lnode->z);
-            s = sdscatsds(s, zone_s);
-            sdsfree(zone_s);
-            LOG_DEBUG("label: %s %d", lnode->label, strlen(lnode->label));
+/*
+ * call fn for every descendant of lnode, the caller must hold the read lock.
+ */
+static void ltreeNodeWalk(ltreeNode *lnode, void (*fn)(ltreeNode *, void *), void *privdata) {
+    ltreeChildren *kids = rcu_dereference(lnode->children);
+    ltreeNode *child;
+
+    if (kids == NULL) return;
+    if (kids->ht) {
+        struct cds_lfht_iter iter;	/* For iteration on hash table */
+        cds_lfht_for_each_entry(kids->ht, &iter, child, htnode) {
+            fn(child, privdata);
+            ltreeNodeWalk(child, fn, privdata);
+        }
+    } else {
+        for (int i = 0; i < kids->nr; ++i) {
+            child = rcu_dereference(kids->entries[i].node);
+            fn(child, privdata);
+            ltreeNodeWalk(child, fn, privdata);
         }
-        s = ltreeNodeToStr(lnode, s);
     }
-    return s;
 }
 
+static void ltreeNodeToStr(ltreeNode *lnode, void *privdata) {
+    sds *sp = privdata;
+    sds zone_s;
+    if (lnode->z) {
+        zone_s = zoneToStr(lnode->z);
+        *sp = sdscatsds(*sp, zone_s);
+        sdsfree(zone_s);
+        LOG_DEBUG("label: %s %d", lnode->label, strlen(lnode->label));
+    }
+}
+
+// may lock the dict long time, mainly for debug.
 sds ltreeToStr(ltree *lt) {
     sds s = sdsempty();
 
     ltreeRLock(lt);
-    s = ltreeNodeToStr(lt->root, s);
+    ltreeNodeWalk(lt->root, ltreeNodeToStr, &s);
+    ltreeRUnlock(lt);
+    return s;
+}
+
+static void ltreeNodeStats(ltreeNode *lnode, void *privdata) {
+    ltreeStats *stats = privdata;
+    ltreeChildren *kids = rcu_dereference(lnode->children);
+    size_t fanout = 0;
+    int bucket;
+
+    stats->nr_nodes++;
+    stats->node_bytes += ltreeNodeSize(lnode);
+    if (lnode->z) stats->nr_zones++;
+
+    if (kids == NULL) {
+        stats->nr_leaf_nodes++;
+    } else if (kids->ht) {
+        long approx_before, approx_after;
+        unsigned long count;
+        cds_lfht_count_nodes(kids->ht, &approx_before, &count, &approx_after);
+        fanout = count;
+        stats->nr_ht_nodes++;
+        stats->inline_bytes += ltreeChildrenSize(kids);
+    } else {
+        fanout = (size_t)kids->nr;
+        stats->nr_inline_nodes++;
+        stats->inline_bytes += ltreeChildrenSize(kids);
+    }
+
+    if (fanout == 0) bucket = 0;
+    else if (fanout == 1) bucket = 1;
+    else if (fanout <= 4) bucket = 2;
+    else if (fanout <= 8) bucket = 3;
+    else if (fanout <= 64) bucket = 4;
+    else if (fanout <= 1024) bucket = 5;
+    else if (fanout <= 65536) bucket = 6;
+    else bucket = 7;
+    stats->fanout[bucket]++;
+    if (fanout > stats->max_fanout) stats->max_fanout = fanout;
+}
+
+void ltreeGetStats(ltree *lt, ltreeStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    ltreeRLock(lt);
+    ltreeNodeStats(lt->root, stats);
+    ltreeNodeWalk(lt->root, ltreeNodeStats, stats);
     ltreeRUnlock(lt);
+}
+
+sds ltreeStatsToStr(ltree *lt, sds s) {
+    static const char *fanout_names[LTREE_FANOUT_BUCKETS] = {
+            "0", "1", "2-4", "5-8", "9-64", "65-1024", "1025-65536", ">65536",
+    };
+    ltreeStats stats;
+
+    ltreeGetStats(lt, &stats);
+    s = sdscatprintf(s,
+                     "socket_id:%d\r\n"
+                     "zones:%lu\r\n"
+                     "nodes:%lu\r\n"
+                     "leaf_nodes:%lu\r\n"
+                     "inline_nodes:%lu\r\n"
+                     "ht_nodes:%lu\r\n"
+                     "max_fanout:%lu\r\n"
+                     "node_bytes:%lu\r\n"
+                     "children_bytes:%lu\r\n"
+                     "ht_bucket_bytes_all:%lu\r\n",
+                     lt->socket_id,
+                     stats.nr_zones,
+                     stats.nr_nodes,
+                     stats.nr_leaf_nodes,
+                     stats.nr_inline_nodes,
+                     stats.nr_ht_nodes,
+                     stats.max_fanout,
+                     stats.node_bytes,
+                     stats.inline_bytes,
+                     uatomic_read(&cds_lfht_mm_socket_bytes));
+    for (int i = 0; i < LTREE_FANOUT_BUCKETS; ++i) {
+        s = sdscatprintf(s, "fanout_%s:%lu\r\n", fanout_names[i], stats.fanout[i]);
+    }
     return s;
 }
@@ -7,7 +7,9 @@
 
 /*
  * label tree implementation
- * every node contains an hash table to track the children.
+ * most nodes have zero or only a few children(e.g. the node of a zone origin),
+ * so the children of a node are stored in a small array and the array is
+ * converted to a hash table when the number of children exceeds LTREE_INLINE_MAX.
  */
 struct dname {
     uint8_t name_size;   // doesn't include last '\0'
@@ -16,15 +18,44 @@ struct dname {
     uint8_t label_offset[64];
 };
 
+#define LTREE_INLINE_MAX     (8)
+
+struct _ltreeNode;
+
+typedef struct _ltreeChildEntry {
+    unsigned int hash;
+    struct _ltreeNode *node;
+} ltreeChildEntry;
+
+/*
+ * the children set is immutable except the node pointers which can be replaced atomically,
+ * writer creates a new set to add a child and the old one is freed after a grace period.
+ * if ht is not NULL, all children are stored in ht and the array is empty.
+ */
+typedef struct _ltreeChildren {
+    struct rcu_head rcu_head;
+    int socket_id;
+    int nr;
+    struct cds_lfht *ht;
+    ltreeChildEntry entries[];
+} ltreeChildren;
+
 typedef struct _ltreeNode {
     int socket_id;
-    char *label;
+    unsigned int hash;
     zone *z;
-    struct cds_lfht *children;
+    ltreeChildren *children;
 
     struct cds_lfht_node htnode;
     struct rcu_head rcu_head;
-    struct _ltreeNode *parent;
+
+    // set when the node is handed to call_rcu, used for reclamation statistics.
+    long long defer_us;
+    size_t defer_bytes;
+    // the children are owned by the node which replaced this one.
+    bool shallow;
+    // len label format
+    char label[];
 } ltreeNode;
 
 typedef struct _ltree {
@@ -34,6 +65,44 @@ typedef struct _ltree {
     ltreeNode *root;
 } ltree;
 
+/*
+ * statistics of the nodes(and zones) waiting for a grace period.
+ * the counters are updated by the writer and the call_rcu worker thread,
+ * so always access them with uatomic_* functions.
+ */
+typedef struct _ltreeReclaimStats {
+    unsigned long pending_nodes;
+    unsigned long pending_bytes;
+    unsigned long reclaimed_nodes;
+    unsigned long long reclaimed_bytes;
+    // latency between call_rcu and the free callback(microseconds)
+    unsigned long long gp_latency_us_total;
+    unsigned long long gp_latency_us_max;
+    unsigned long long gp_latency_us_last;
+} ltreeReclaimStats;
+
+/*
+ * shape of the tree, mainly for debug.
+ */
+#define LTREE_FANOUT_BUCKETS   (8)
+
+typedef struct _ltreeStats {
+    size_t nr_nodes;
+    size_t nr_zones;
+    size_t nr_leaf_nodes;
+    size_t nr_inline_nodes;
+    size_t nr_ht_nodes;
+    size_t max_fanout;
+    // fanout 0, 1, 2-4, 5-8, 9-64, 65-1024, 1025-65536, >65536
+    size_t fanout[LTREE_FANOUT_BUCKETS];
+    size_t node_bytes;
+    size_t inline_bytes;
+} ltreeStats;
+
+/*
+ * QSBR flavor is used, so read lock and unlock are nearly free,
+ * every reader thread must announce quiescent state periodically.
+ */
 #define ltreeRLock(zt) rcu_read_lock()
 #define ltreeRUnlock(zt) rcu_read_unlock()
 #define ltreeWLock(zt) rcu_read_lock()
@@ -83,12 +152,16 @@ int ltreeReplaceNoLock(ltree *lt, zone *z);
 int ltreeReplace(ltree *lt, zone *z);
 
 int ltreeAdd(ltree *lt, zone *z);
+int ltreeReserve(ltree *lt, char *origin, size_t nr_children);
 
 int ltreeDeleteNoLock(ltree *lt, char *origin);
 int ltreeDelete(ltree *lt, char *origin);
 
 size_t ltreeGetNumZones(ltree *lt);
+void ltreeGetReclaimStats(ltreeReclaimStats *stats);
 int ltreeExistZone(ltree *lt, char *origin);
 sds ltreeToStr(ltree *lt);
+void ltreeGetStats(ltree *lt, ltreeStats *stats);
+sds ltreeStatsToStr(ltree *lt, sds s);
 
 #endif //SHUKE_LTREE_H
@@ -0,0 +1,383 @@
+//
+// Prometheus metrics endpoint
+//
+// a minimal http server running in main thread's event loop, `GET /metrics`
+// returns the counters in prometheus text format(version 0.0.4).
+// every metric is a monotonic counter or a gauge read directly from the
+// counters(lcore_conf_t, port, KNI, tcp server, reload worker), nothing is
+// computed per scrape, so any number of scrapers can read them concurrently.
+//
+
+#include "shuke.h"
+#include "utils.h"
+
+DEF_LOG_MODULE(RTE_LOGTYPE_USER1, "METRICS");
+
+#define METRICS_MAX_REQ_SIZE 4096
+#define METRICS_MAX_CONNS 64
+#define METRICS_CONN_EXPIRE 10
+
+typedef struct {
+    int fd;
+    char buf[METRICS_MAX_REQ_SIZE];
+    size_t nread;
+    sds resp;
+    size_t wpos;
+    long lastActiveTs;
+    struct list_head node;
+} metricsConn;
+
+static struct {
+    int fd;
+    int nr_conns;
+    struct list_head conns;
+} metrics = {
+    .fd = -1,
+};
+
+static void metricsReadHandler(aeEventLoop *el, int fd, void *privdata, int mask);
+static void metricsWriteHandler(aeEventLoop *el, int fd, void *privdata, int mask);
+
+static sds metricHeader(sds s, const char *name, const char *type, const char *help) {
+    return sdscatprintf(s, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static sds genLcoreMetrics(sds s) {
+    unsigned lcore_id;
+    lcore_conf_t *qconf;
+    char buf[32];
+
+#define LCORE_COUNTER(name, field, help) do {                                   \
+        s = metricHeader(s, name, "counter", help);                             \
+        for (int i = 0; i < sk.nr_lcore_ids; ++i) {                             \
+            lcore_id = (unsigned)sk.lcore_ids[i];                               \
+            if (lcore_id == rte_get_master_lcore()) continue;                   \
+            qconf = &sk.lcore_conf[lcore_id];                                   \
+            s = sdscatprintf(s, name "{lcore=\"%u\"} %lld\n",                   \
+                             lcore_id, (long long)qconf->field);                \
+        }                                                                       \
+    } while(0)
+
+    LCORE_COUNTER("shuke_lcore_rx_packets_total", received_req,
+                  "Packets received from the ports by the lcore.");
+    LCORE_COUNTER("shuke_lcore_answered_total", nr_req,
+                  "UDP queries answered by the lcore.");
+    LCORE_COUNTER("shuke_lcore_dropped_total", nr_dropped,
+                  "UDP queries dropped by the lcore.");
+#undef LCORE_COUNTER
+
+    // the master lcore counts the responses of tcp server.
+    s = metricHeader(s, "shuke_responses_total", "counter",
+                     "Responses by lcore and rcode, lcore of the tcp server is the master lcore.");
+    for (int i = 0; i < sk.nr_lcore_ids; ++i) {
+        lcore_id = (unsigned)sk.lcore_ids[i];
+        qconf = &sk.lcore_conf[lcore_id];
+        for (int rcode = 0; rcode < NR_RCODES; ++rcode) {
+            int64_t v = qconf->qstats.nr_rcode[rcode];
+            // the common rcodes are always exported, so rate() works from the first response.
+            if (v == 0 && rcode > DNS_RCODE_REFUSED) continue;
+            s = sdscatprintf(s, "shuke_responses_total{lcore=\"%u\",rcode=\"%s\"} %lld\n",
+                             lcore_id, rcodeToStr(rcode, buf, sizeof(buf)), (long long)v);
+        }
+    }
+
+    s = metricHeader(s, "shuke_queries_total", "counter", "Queries by lcore and qtype.");
+    for (int i = 0; i < sk.nr_lcore_ids; ++i) {
+        lcore_id = (unsigned)sk.lcore_ids[i];
+        qconf = &sk.lcore_conf[lcore_id];
+        for (int qtype = 0; qtype < NR_QTYPES; ++qtype) {
+            int64_t v = qconf->qstats.nr_qtype[qtype];
+            if (v == 0) continue;
+            s = sdscatprintf(s, "shuke_queries_total{lcore=\"%u\",qtype=\"%s\"} %lld\n",
+                             lcore_id, qtypeToStr(qtype, buf, sizeof(buf)), (long long)v);
+        }
+    }
+    return s;
+}
+
+static sds genPortMetrics(sds s) {
+    struct rte_eth_stats st[RTE_MAX_ETHPORTS];
+    bool ok[RTE_MAX_ETHPORTS];
+    uint8_t portid;
+
+    for (int i = 0; i < sk.nr_ports; i++) {
+        portid = (uint8_t)sk.port_ids[i];
+        ok[i] = rte_eth_stats_get(portid, &st[i]) == 0;
+        if (!ok[i]) LOG_WARN("can't get stats of port %d.", portid);
+    }
+
+#define PORT_COUNTER(name, field, help) do {                                    \
+        s = metricHeader(s, name, "counter", help);                             \
+        for (int i = 0; i < sk.nr_ports; i++) {                                 \
+            if (!ok[i]) continue;                                               \
+            s = sdscatprintf(s, name "{port=\"%d\"} %llu\n",                    \
+                             sk.port_ids[i], (unsigned long long)st[i].field);  \
+        }                                                                       \
+    } while(0)
+
+    PORT_COUNTER("shuke_port_rx_packets_total", ipackets, "Packets received by the port.");
+    PORT_COUNTER("shuke_port_tx_packets_total", opackets, "Packets sent by the port.");
+    PORT_COUNTER("shuke_port_rx_bytes_total", ibytes, "Bytes received by the port.");
+    PORT_COUNTER("shuke_port_tx_bytes_total", obytes, "Bytes sent by the port.");
+    PORT_COUNTER("shuke_port_rx_missed_total", imissed, "Packets dropped by the port because rx queues are full.");
+    PORT_COUNTER("shuke_port_rx_errors_total", ierrors, "Erroneous packets received by the port.");
+    PORT_COUNTER("shuke_port_tx_errors_total", oerrors, "Packets failed to be sent by the port.");
+    PORT_COUNTER("shuke_port_rx_nombuf_total", rx_nombuf, "Mbuf allocation failures of the port.");
+#undef PORT_COUNTER
+
+    // the extended stats are driver specific, export them with the name as label.
+    s = metricHeader(s, "shuke_port_xstats", "untyped", "Extended statistics of the port driver.");
+    for (int i = 0; i < sk.nr_ports; i++) {
+        portid = (uint8_t)sk.port_ids[i];
+        int n = rte_eth_xstats_get_names(portid, NULL, 0);
+        if (n <= 0) continue;
+
+        struct rte_eth_xstat_name *names = zmalloc(sizeof(*names) * n);
+        struct rte_eth_xstat *xstats = zmalloc(sizeof(*xstats) * n);
+        if (rte_eth_xstats_get_names(portid, names, (unsigned)n) == n &&
+            rte_eth_xstats_get(portid, xstats, (unsigned)n) == n) {
+            for (int j = 0; j < n; ++j) {
+                s = sdscatprintf(s, "shuke_port_xstats{port=\"%d\",name=\"%s\"} %llu\n",
+                                 portid, names[xstats[j].id].name,
+                                 (unsigned long long)xstats[j].value);
+            }
+        } else {
+            LOG_WARN("can't get extended stats of port %d.", portid);
+        }
+        zfree(names);
+        zfree(xstats);
+    }
+
+    sk_kni_stats_t kst[RTE_MAX_ETHPORTS];
+    for (int i = 0; i < sk.nr_ports; i++) {
+        ok[i] = kni_get_stats((uint8_t)sk.port_ids[i], &kst[i]) == 0;
+    }
+#define KNI_COUNTER(name, field, help) do {                                     \
+        s = metricHeader(s, name, "counter", help);                             \
+        for (int i = 0; i < sk.nr_ports; i++) {                                 \
+            if (!ok[i]) continue;                                               \
+            s = sdscatprintf(s, name "{port=\"%d\"} %llu\n",                    \
+                             sk.port_ids[i], (unsigned long long)kst[i].field); \
+        }                                                                       \
+    } while(0)
+
+    KNI_COUNTER("shuke_kni_rx_packets_total", rx_packets, "Packets received from the port and sent to KNI.");
+    KNI_COUNTER("shuke_kni_rx_dropped_total", rx_dropped, "Packets received from the port but failed to be sent to KNI.");
+    KNI_COUNTER("shuke_kni_tx_packets_total", tx_packets, "Packets received from KNI and sent to the port.");
+    KNI_COUNTER("shuke_kni_tx_dropped_total", tx_dropped, "Packets received from KNI but failed to be sent to the port.");
+#undef KNI_COUNTER
+    return s;
+}
+
+static sds genServerMetrics(sds s) {
+    reloaderStats rstat;
+
+    s = metricHeader(s, "shuke_uptime_seconds", "gauge", "Seconds since the server started.");
+    s = sdscatprintf(s, "shuke_uptime_seconds %ld\n", (long)(sk.unixtime - sk.starttime));
+    s = metricHeader(s, "shuke_zones", "gauge", "Zones in memory.");
+    s = sdscatprintf(s, "shuke_zones %lu\n", ltreeGetNumZones(sk.lt));
+
+    if (!sk.only_udp) {
+        s = metricHeader(s, "shuke_tcp_connections", "gauge", "Open dns tcp connections.");
+        s = sdscatprintf(s, "shuke_tcp_connections %llu\n", (unsigned long long)sk.num_tcp_conn);
+        s = metricHeader(s, "shuke_tcp_connections_total", "counter", "Accepted dns tcp connections.");
+        s = sdscatprintf(s, "shuke_tcp_connections_total %llu\n", (unsigned long long)sk.total_tcp_conn);
+        s = metricHeader(s, "shuke_tcp_rejected_connections_total", "counter",
+                         "Dns tcp connections rejected because of max_tcp_connections.");
+        s = sdscatprintf(s, "shuke_tcp_rejected_connections_total %llu\n",
+                         (unsigned long long)sk.rejected_tcp_conn);
+    }
+
+    reloaderGetStats(&rstat);
+    s = metricHeader(s, "shuke_reload_queue_depth", "gauge", "Zones waiting for the reload worker.");
+    s = sdscatprintf(s, "shuke_reload_queue_depth %lu\n", rstat.nr_pending + (size_t)sk.nr_pending_tasks);
+    s = metricHeader(s, "shuke_reloads_total", "counter", "Zone reloads by result.");
+    s = sdscatprintf(s,
+                     "shuke_reloads_total{result=\"done\"} %lu\n"
+                     "shuke_reloads_total{result=\"failed\"} %lu\n"
+                     "shuke_reloads_total{result=\"unchanged\"} %lu\n",
+                     rstat.nr_done, rstat.nr_failed, rstat.nr_unchanged);
+    s = metricHeader(s, "shuke_reload_build_seconds_total", "counter",
+                     "Time spent by the reload worker to build zones.");
+    s = sdscatprintf(s, "shuke_reload_build_seconds_total %.6f\n", rstat.build_us_total / 1e6);
+    s = metricHeader(s, "shuke_reload_latency_seconds_total", "counter",
+                     "Time between submitting and publishing the reloaded zones.");
+    s = sdscatprintf(s, "shuke_reload_latency_seconds_total %.6f\n", rstat.latency_us_total / 1e6);
+    return s;
+}
+
+sds genMetrics(void) {
+    sds s = sdsempty();
+    s = genServerMetrics(s);
+    s = genLcoreMetrics(s);
+    s = genPortMetrics(s);
+    s = aclGenMetrics(s);
+    s = cookieGenMetrics(s);
+    return s;
+}
+
+static void metricsConnDestroy(metricsConn *c) {
+    list_del(&c->node);
+    aeDeleteFileEvent(sk.el, c->fd, AE_READABLE|AE_WRITABLE);
+    close(c->fd);
+    sdsfree(c->resp);
+    zfree(c);
+    metrics.nr_conns--;
+}
+
+static sds httpResponse(int code, const char *reason, const char *ctype, sds body) {
+    sds s = sdscatprintf(sdsempty(),
+                         "HTTP/1.1 %d %s\r\n"
+                         "Content-Type: %s\r\n"
+                         "Content-Length: %zu\r\n"
+                         "Connection: close\r\n"
+                         "\r\n",
+                         code, reason, ctype, sdslen(body));
+    s = sdscatsds(s, body);
+    sdsfree(body);
+    return s;
+}
+
+/*
+ * only the request line is used, the connection is closed after the response.
+ */
+static sds handleRequest(char *req) {
+    char *argv[3];
+    int argc = 3;
+    char *eol = strstr(req, "\r\n");
+
+    *eol = 0;
+    if (tokenize(req, argv, &argc, " ") < 0 || argc != 3) {
+        return httpResponse(400, "Bad Request", "text/plain", sdsnew("bad request\n"));
+    }
+    if (strcmp(argv[0], "GET") != 0) {
+        return httpResponse(405, "Method Not Allowed", "text/plain", sdsnew("method not allowed\n"));
+    }
+    char *q = strchr(argv[1], '?');
+    if (q) *q = 0;
+    if (strcmp(argv[1], "/metrics") != 0) {
+        return httpResponse(404, "Not Found", "text/plain", sdsnew("not found\n"));
+    }
+    return httpResponse(200, "OK", "text/plain; version=0.0.4", genMetrics());
+}
+
+static void metricsReadHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
+    UNUSED2(el, mask);
+    metricsConn *c = privdata;
+    ssize_t n;
+
+    c->lastActiveTs = sk.unixtime;
+    n = read(fd, c->buf + c->nread, sizeof(c->buf) - 1 - c->nread);
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+        LOG_WARN("metrics read: %s", strerror(errno));
+        metricsConnDestroy(c);
+        return;
+    }
+    if (n == 0) {
+        metricsConnDestroy(c);
+        return;
+    }
+    c->nread += n;
+    c->buf[c->nread] = 0;
+    if (strstr(c->buf, "\r\n\r\n") == NULL) {
+        if (c->nread == sizeof(c->buf) - 1) {
+            LOG_WARN("metrics request is too large.");
+            metricsConnDestroy(c);
+        }
+        return;
+    }
+
+    aeDeleteFileEvent(sk.el, fd, AE_READABLE);
+    c->resp = handleRequest(c->buf);
+    if (aeCreateFileEvent(sk.el, fd, AE_WRITABLE, metricsWriteHandler, c) == AE_ERR) {
+        LOG_ERROR("can't create file event for metrics connection.");
+        metricsConnDestroy(c);
+    }
+}
+
+static void metricsWriteHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
+    UNUSED2(el, mask);
+    metricsConn *c = privdata;
+    ssize_t n;
+
+    c->lastActiveTs = sk.unixtime;
+    while (c->wpos < sdslen(c->resp)) {
+        n = write(fd, c->resp + c->wpos, sdslen(c->resp) - c->wpos);
+        if (n <= 0) {
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            LOG_WARN("can't write metrics response: %s", strerror(errno));
+            break;
+        }
+        c->wpos += n;
+    }
+    metricsConnDestroy(c);
+}
+
+static void metricsAcceptHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
+    UNUSED3(el, privdata, mask);
+    char cip[IP_STR_LEN];
+    int cport, cfd;
+
+    while (true) {
+        cfd = anetTcpAccept(sk.errstr, fd, cip, sizeof(cip), &cport);
+        if (cfd == ANET_ERR) {
+            if (errno != EWOULDBLOCK)
+                LOG_WARN("Accepting metrics connection: %s", sk.errstr);
+            return;
+        }
+        if (metrics.nr_conns >= METRICS_MAX_CONNS) {
+            LOG_WARN("too many metrics connections, close %s:%d.", cip, cport);
+            close(cfd);
+            continue;
+        }
+        anetNonBlock(NULL, cfd);
+        metricsConn *c = zcalloc(sizeof(*c));
+        c->fd = cfd;
+        c->lastActiveTs = sk.unixtime;
+        list_add_tail(&c->node, &metrics.conns);
+        metrics.nr_conns++;
+        if (aeCreateFileEvent(sk.el, cfd, AE_READABLE, metricsReadHandler, c) == AE_ERR) {
+            LOG_ERROR("can't create file event for metrics connection.");
+            metricsConnDestroy(c);
+        }
+    }
+}
+
+static int metricsCron(struct aeEventLoop *el, long long id, void *clientData) {
+    UNUSED3(el, id, clientData);
+    struct list_head *pos, *temp;
+
+    list_for_each_safe(pos, temp, &metrics.conns) {
+        metricsConn *c = list_entry(pos, metricsConn, node);
+        if (sk.unixtime - c->lastActiveTs >= METRICS_CONN_EXPIRE) metricsConnDestroy(c);
+    }
+    return TIME_INTERVAL;
+}
+
+int initMetricsServer(void) {
+    char *host = sk.admin_host;
+    int port = sk.metrics_port;
+
+    INIT_LIST_HEAD(&metrics.conns);
+    if (host == NULL) {
+        metrics.fd = anetTcpServer(sk.errstr, port, NULL, sk.tcp_backlog, 0);
+    } else if (strchr(host, ':') == NULL) {
+        metrics.fd = anetTcpServer(sk.errstr, port, host, sk.tcp_backlog, 0);
+    } else {
+        metrics.fd = anetTcp6Server(sk.errstr, port, host, sk.tcp_backlog, 0);
+    }
+    if (metrics.fd == ANET_ERR) {
+        LOG_ERROR("can't listen on metrics port %d: %s", port, sk.errstr);
+        return ERR_CODE;
+    }
+    anetNonBlock(NULL, metrics.fd);
+    if (aeCreateFileEvent(sk.el, metrics.fd, AE_READABLE, metricsAcceptHandler, NULL) == AE_ERR) {
+        LOG_ERROR("can't create file event for metrics listen socket %d", metrics.fd);
+        return ERR_CODE;
+    }
+    if (aeCreateTimeEvent(sk.el, TIME_INTERVAL, metricsCron, NULL, NULL) == AE_ERR) {
+        return ERR_CODE;
+    }
+    return OK_CODE;
+}
@@ -114,12 +114,54 @@ static int prepareColName(char *dotOrigin, char *colName) {
     return MONGO_OK;
 }
 
+static bool isCatalogCol(char *col) {
+    return sk.mongo_catalog != NULL && strcmp(col, sk.mongo_catalog) == 0;
+}
+
+/*
+ * feed a RR document to zone, the document contains the following fields:
+ *     name, ttl, type, rdata: text format, always exist.
+ *     owner, wire: optional, the absolute owner name in len label format and
+ *                  the uncompressed wire rdata, both are binary. if they exist,
+ *                  the text rdata is not parsed.
+ *     view: optional, the GeoDNS view this RR belongs to, the default view if absent.
+ */
+static int feedRRDoc(RRParser *psr, bson_t *b, zone *z) {
+    bson_iter_t iter;
+    bson_subtype_t subtype;
+    const uint8_t *owner = NULL, *wire = NULL;
+    uint32_t ownerLen = 0, wireLen = 0;
+    char *name, *type, *rdata;
+    uint32_t ttl;
+
+    ttl = (uint32_t)bson_extract_int32(b, "ttl");
+    type = bson_extract_string(b, "type");
+
+    if (bson_iter_init_find(&iter, b, "view") && BSON_ITER_HOLDS_UTF8(&iter)) {
+        if (RRParserSetView(psr, (char *)bson_iter_utf8(&iter, NULL)) == ERR_CODE) return ERR_CODE;
+    } else {
+        RRParserSetView(psr, NULL);
+    }
+
+    if (bson_iter_init_find(&iter, b, "owner") && BSON_ITER_HOLDS_BINARY(&iter)) {
+        bson_iter_binary(&iter, &subtype, &ownerLen, &owner);
+    }
+    if (bson_iter_init_find(&iter, b, "wire") && BSON_ITER_HOLDS_BINARY(&iter)) {
+        bson_iter_binary(&iter, &subtype, &wireLen, &wire);
+    }
+    if (owner && wire) {
+        return RRParserFeedWire(psr, (char *)owner, ownerLen, ttl, type, (char *)wire, wireLen, z);
+    }
+    name = bson_extract_string(b, "name");
+    rdata = bson_extract_string(b, "rdata");
+    LOG_DEBUG("RR: %s, %d, %s, %s", name, ttl, type, rdata);
+    return RRParserFeedRdata(psr, rdata, name, ttl, type, z);
+}
+
 static void RRSetGetCallback(mongoAsyncContext *c, void *r, void *privdata) {
     ((void) c);
     mongoReply *reply = r;
     zoneReloadContext *ctx = privdata;
-    char *name, *type, *rdata;
-    uint32_t ttl;
     if (reply == NULL) {
         goto error;
     }
@@ -134,12 +176,7 @@ static void RRSetGetCallback(mongoAsyncContext *c, void *r, void *privdata) {
         if (ctx->psr == NULL) ctx->psr = RRParserCreate("@", 0, ctx->dotOrigin);
 
         for (int i = 0; i < reply->numberReturned; ++i) {
-            bson_t *b = reply->docs[i];
-            name = bson_extract_string(b, "name");
-            ttl = (uint32_t)bson_extract_int32(b, "ttl");
-            type = bson_extract_string(b, "type");
-            rdata = bson_extract_string(b, "rdata");
-            if (RRParserFeedRdata(ctx->psr, rdata, name, ttl, type, ctx->new_zn) == ERR_CODE) {
+            if (feedRRDoc(ctx->psr, reply->docs[i], ctx->new_zn) == ERR_CODE) {
                 LOG_ERR("parse rdata error %d.", ctx->psr->errstr);
                 goto error;
             }
@@ -165,10 +202,8 @@ ok:
                 zoneReloadContextDestroy(ctx);
             }
         } else {
-            LOG_INFO("reload zone %s successfully. ", ctx->dotOrigin);
-            replaceZoneAllNumaNodes(ctx->new_zn);
-            ctx->new_zn = NULL;
-            zoneReloadContextDestroy(ctx);
+            // build numa copies in reload worker, ctx is released after the zone is published.
+            reloaderSubmit(ctx);
         }
     }
     return;
@@ -209,6 +244,7 @@ static void zoneSOAGetCallback(mongoAsyncContext *c, void *r, void *privdata) {
     if (ctx->sn >= sn) {
         // update zone's ts field
         LOG_INFO("reload zone %s successfully(unchanged).", ctx->dotOrigin);
+        sk.sched_stats.nr_unchanged++;
         dot2lenlabel(ctx->dotOrigin, origin);
         masterRefreshZone(origin);
 
@@ -245,6 +281,7 @@ static void reloadAllCallback(mongoAsyncContext *c, void *r, void *privdata) {
     if (reply == NULL) goto error;
     namev = bson_extract_collection_names(reply->docs[0]);
     for (p = namev; *p != NULL; ++p) {
+        if (isCatalogCol(*p)) continue;
         snprintf(dotOrigin, MAX_DOMAIN_LEN, "%s.", *p);
         if (!isAbsDotDomain(dotOrigin)) {
             LOG_WARN("%s is too long, ignore it.", dotOrigin);
@@ -263,61 +300,100 @@ error:
     triggerReloadAllZone();
 }
 
+static int getConnId(const mongoAsyncContext *c) {
+    for (int i = 0; i < sk.mongo_conns; ++i) {
+        if (sk.mongo_ctxs[i] == c) return i;
+    }
+    return -1;
+}
+
+/*
+ * pick the connected context serving least reload tasks,
+ * so a giant zone only blocks the tasks on its own connection.
+ */
+static int pickConnId(void) {
+    int conn_id = -1;
+    for (int i = 0; i < sk.mongo_conns; ++i) {
+        mongoAsyncContext *c = sk.mongo_ctxs[i];
+        if (c == NULL || !mongoAsyncIsConnected(c)) continue;
+        if (conn_id < 0 || sk.mongo_conn_load[i] < sk.mongo_conn_load[conn_id]) conn_id = i;
+    }
+    return conn_id;
+}
+
 static void connectCallback(const mongoAsyncContext *c, int status) {
+    int conn_id = getConnId(c);
+    assert(conn_id >= 0);
     if (status != OK_CODE) {
-        LOG_ERROR("Failed to connect to mongodb: %s", c->errstr);
-        sk.mongo_ctx = NULL;
+        LOG_ERROR("Failed to connect to mongodb(conn %d): %s", conn_id, c->errstr);
+        sk.mongo_ctxs[conn_id] = NULL;
         return;
     }
-    assert(sk.mongo_ctx == c);
-    LOG_INFO("mongodb connected..");
+    LOG_INFO("mongodb connected(conn %d)..", conn_id);
 }
 
 static void disconnectCallback(const mongoAsyncContext *c, int status) {
-    sk.mongo_ctx = NULL;
+    int conn_id = getConnId(c);
+    assert(conn_id >= 0);
+    sk.mongo_ctxs[conn_id] = NULL;
     if (status != MONGO_OK) {
         LOG_ERROR("Error: %s", c->errstr);
     }
-    LOG_WARN("Disconnected...");
+    LOG_WARN("Disconnected(conn %d)...", conn_id);
     // only reconnect in cron callback in main thread
     return;
 }
 
 /*
  * check if mongo async context is connected.
+ * it returns OK_CODE when any connection of the pool is connected.
  */
 int checkMongo() {
-    return (sk.mongo_ctx && mongoAsyncIsConnected(sk.mongo_ctx)) ? OK_CODE: ERR_CODE;
+    return pickConnId() >= 0 ? OK_CODE: ERR_CODE;
+}
+
+int mongoConnectedCount() {
+    int n = 0;
+    for (int i = 0; i < sk.mongo_conns; ++i) {
+        if (sk.mongo_ctxs[i] && mongoAsyncIsConnected(sk.mongo_ctxs[i])) n++;
+    }
+    return n;
 }
 
 /*
- * issue a connection to mongodb
+ * issue connections to mongodb for the empty slots of the pool
  * pls note: async context is connected only after connectCallback is called sunccessfully
  */
 int initMongo() {
-    if (sk.mongo_ctx) return OK_CODE;
+    int nr_empty = 0;
+    for (int i = 0; i < sk.mongo_conns; ++i) {
+        if (sk.mongo_ctxs[i] == NULL) nr_empty++;
+    }
+    if (nr_empty == 0) return OK_CODE;
+
     long now = sk.unixtime;
     if (now - sk.last_retry_ts < sk.retry_interval) return ERR_CODE;
     sk.last_retry_ts = now;
 
-    mongoAsyncContext *ac = mongoAsyncConnect(sk.mongo_host, sk.mongo_port);
-    if (ac->err) {
-        LOG_ERROR("Failed to init mongodb: %s", ac->errstr);
-        sk.mongo_ctx = NULL;
-        return ERR_CODE;
+    for (int i = 0; i < sk.mongo_conns; ++i) {
+        if (sk.mongo_ctxs[i] != NULL) continue;
+
+        mongoAsyncContext *ac = mongoAsyncConnect(sk.mongo_host, sk.mongo_port);
+        if (ac->err) {
+            LOG_ERROR("Failed to init mongodb(conn %d): %s", i, ac->errstr);
+            return ERR_CODE;
+        }
+        mongoAeAttach(sk.el, ac);
+        mongoAsyncSetConnectCallback(ac,connectCallback);
+        mongoAsyncSetDisconnectCallback(ac,disconnectCallback);
+        sk.mongo_ctxs[i] = ac;
     }
-    mongoAeAttach(sk.el, ac);
-    mongoAsyncSetConnectCallback(ac,connectCallback);
-    mongoAsyncSetDisconnectCallback(ac,disconnectCallback);
-    sk.mongo_ctx = ac;
     return OK_CODE;
 }
 
 static zone *_mongoGetZone(mongoContext *c, RRParser *psr, char *db, char *col, char *dotOrigin) {
     mongoReply **replies;
     mongoReply *reply;
-    uint32_t ttl;
-    char *type, *rdata, *name;
 
     zone *z = zoneCreate(dotOrigin, sk.master_numa_id);
 
@@ -326,13 +402,7 @@ static zone *_mongoGetZone(mongoContext *c, RRParser *psr, char *db, char *col,
     for (int i = 0; replies[i] != NULL; ++i) {
         reply = replies[i];
         for (int j = 0; j < reply->numberReturned; ++j) {
-            bson_t *b = reply->docs[j];
-            name = bson_extract_string(b, "name");
-            ttl = (uint32_t)bson_extract_int32(b, "ttl");
-            type = bson_extract_string(b, "type");
-            rdata = bson_extract_string(b, "rdata");
-            LOG_DEBUG("RR%d: %s, %d, %s, %s", j, name, ttl, type, rdata);
-            if (RRParserFeedRdata(psr, rdata, name, ttl, type, z) == ERR_CODE) {
+            if (feedRRDoc(psr, reply->docs[j], z) == ERR_CODE) {
                 goto error;
             }
         }
@@ -367,8 +437,12 @@ static int _mongoGetAllZone(char *host, int port, char *db) {
         }
     }
     namev = mongoGetCollectionNames(c, db);
+    for (p = namev; *p != NULL; ++p);
+    reserveZoneTree(namev, (size_t)(p - namev));
+
     for (p = namev; *p != NULL; ++p) {
         col = *p;
+        if (isCatalogCol(col)) continue;
         snprintf(dotOrigin, MAX_DOMAIN_LEN, "%s.", *p);
         if (!isAbsDotDomain(dotOrigin)) {
             LOG_WARN("%s is too long, ignore it.");
@@ -398,38 +472,212 @@ ok:
     return errcode;
 }
 
+/*----------------------------------------------
+ *     zone catalog
+ *
+ * the catalog collection contains a document for every zone:
+ *     {zone: "example.com", serial: 2017010101, updated_at: ISODate(...)}
+ * shuke fetches the whole catalog with one cursor and only reloads the
+ * zones whose serial is changed, instead of querying the SOA record of
+ * every zone.
+ *---------------------------------------------*/
+static struct {
+    bool running;
+    long last_poll_ts;
+    long long start_us;
+    // dotOrigin of the zones in catalog, only valid when running
+    dict *seen;
+    size_t nr_changed;
+    size_t nr_new;
+
+    mongoCatalogStats stats;
+} catalog;
+
+/*
+ * remove the zones which are not in catalog any more.
+ * the zones in reloading state are not in rbtree, they are checked in next poll.
+ */
+static size_t removeZonesNotInCatalog(void) {
+    struct rb_node *n;
+    char **origins;
+    size_t nr_removed = 0;
+    size_t nr_zones = 0;
+
+    for (n = rb_first(&sk.rbroot); n != NULL; n = rb_next(n)) nr_zones++;
+    if (nr_zones == 0) return 0;
+    origins = zmalloc(nr_zones * sizeof(char *));
+
+    for (n = rb_first(&sk.rbroot); n != NULL; n = rb_next(n)) {
+        zone *z = rb_entry(n, zone, rbnode);
+        if (dictFind(catalog.seen, z->dotOrigin) != NULL) continue;
+        origins[nr_removed++] = zstrdup(z->origin);
+    }
+    for (size_t i = 0; i < nr_removed; ++i) {
+        LOG_INFO("zone %s is not in catalog, remove it.", origins[i]);
+        deleteZoneAllNumaNodes(origins[i]);
+        zfree(origins[i]);
+    }
+    zfree(origins);
+    return nr_removed;
+}
+
+static void catalogFeedDoc(bson_t *b) {
+    char dotOrigin[MAX_DOMAIN_LEN+2];
+    char origin[MAX_DOMAIN_LEN+2];
+    bson_iter_t iter;
+    char *name;
+    int64_t sn = -1;
+    uint32_t old_sn = 0;
+    bool reloading = false;
+    zone *z;
+
+    name = bson_extract_string(b, "zone");
+    if (name == NULL) {
+        LOG_WARN("catalog document doesn't contain zone field, ignore it.");
+        return;
+    }
+    if (bson_iter_init_find(&iter, b, "serial")) sn = bson_iter_as_int64(&iter);
+
+    snprintf(dotOrigin, MAX_DOMAIN_LEN, "%s", name);
+    if (!isAbsDotDomain(dotOrigin)) strcat(dotOrigin, ".");
+    if (!isAbsDotDomain(dotOrigin)) {
+        LOG_WARN("%s is too long, ignore it.", dotOrigin);
+        return;
+    }
+    dictReplace(catalog.seen, dotOrigin, NULL);
+
+    dot2lenlabel(dotOrigin, origin);
+    ltreeRLock(sk.lt);
+    z = ltreeGetZoneExactRaw(sk.lt, origin);
+    if (z) {
+        old_sn = z->sn;
+        reloading = RB_EMPTY_NODE(&z->rbnode);
+    }
+    ltreeRUnlock(sk.lt);
+
+    if (z == NULL) {
+        if (asyncReloadZoneRaw(dotOrigin) == OK_CODE) catalog.nr_new++;
+    } else if (!reloading && sn >= 0 && sn <= UINT32_MAX && serialGt((uint32_t)sn, old_sn)) {
+        // the serial may wrap around(RFC 1982), a document without valid serial never triggers reload.
+        if (asyncReloadChangedZone(dotOrigin) == OK_CODE) catalog.nr_changed++;
+    }
+}
+
+static void catalogGetCallback(mongoAsyncContext *c, void *r, void *privdata) {
+    ((void) c); ((void) privdata);
+    mongoReply *reply = r;
+    mongoCatalogStats *st = &catalog.stats;
+
+    if (reply == NULL) {
+        LOG_ERROR("failed to fetch zone catalog %s.", sk.mongo_catalog);
+        st->nr_failed++;
+        goto end;
+    }
+    for (int i = 0; i < reply->numberReturned; ++i) {
+        catalogFeedDoc(reply->docs[i]);
+    }
+    if (reply->cursorID != 0) return;
+
+    st->nr_polls++;
+    st->nr_zones = dictSize(catalog.seen);
+    st->nr_changed = catalog.nr_changed;
+    st->nr_new = catalog.nr_new;
+    // an empty catalog is more likely a mistake than removing all zones.
+    if (st->nr_zones > 0) {
+        st->nr_removed = removeZonesNotInCatalog();
+    } else {
+        LOG_WARN("zone catalog %s is empty, skip removing zones.", sk.mongo_catalog);
+        st->nr_removed = 0;
+    }
+    st->last_poll_ts = sk.unixtime;
+    st->poll_us = ustime() - catalog.start_us;
+    LOG_INFO("poll zone catalog: %lu zones, %lu changed, %lu new, %lu removed, %lld us.",
+             st->nr_zones, st->nr_changed, st->nr_new, st->nr_removed, st->poll_us);
+end:
+    dictRelease(catalog.seen);
+    catalog.seen = NULL;
+    catalog.running = false;
+}
+
+/*!
+ * fetch the zone catalog and reload the changed zones, called in mainThreadCron.
+ * a new poll is issued only when the reloads triggered by last poll are finished,
+ * so a zone is never queued twice.
+ *
+ * @return OK_CODE if a poll is running.
+ */
+int mongoAsyncPollCatalog() {
+    int errcode;
+    int conn_id;
+    mongoAsyncContext *c;
+
+    if (catalog.running) return OK_CODE;
+    if (sk.unixtime - catalog.last_poll_ts < sk.catalog_interval) return ERR_CODE;
+    if (sk.nr_pending_tasks > 0 || sk.nr_inflight_tasks > 0) return ERR_CODE;
+    if ((conn_id = pickConnId()) < 0) return ERR_CODE;
+    c = sk.mongo_ctxs[conn_id];
+
+    catalog.last_poll_ts = sk.unixtime;
+    catalog.start_us = ustime();
+    catalog.nr_changed = 0;
+    catalog.nr_new = 0;
+    catalog.seen = dictCreate(&dictTypeCaseStringCopyKey, NULL, SOCKET_ID_HEAP);
+
+    errcode = mongoAsyncFindAll(c, catalogGetCallback, NULL, sk.mongo_dbname,
+                                sk.mongo_catalog, NULL, NULL, 0);
+    if (errcode != MONGO_OK) {
+        LOG_ERROR("MONGO ERROR: %s", c->errstr);
+        catalog.stats.nr_failed++;
+        dictRelease(catalog.seen);
+        catalog.seen = NULL;
+        return ERR_CODE;
+    }
+    catalog.running = true;
+    return OK_CODE;
+}
+
+void mongoGetCatalogStats(mongoCatalogStats *stats) {
+    memcpy(stats, &catalog.stats, sizeof(*stats));
+}
+
 int mongoGetAllZone() {
     LOG_INFO("Synchronous get all zones from mongodb.");
     return _mongoGetAllZone(sk.mongo_host, sk.mongo_port, sk.mongo_dbname);
 }
 
 int mongoAsyncReloadZone(zoneReloadContext *t) {
-    if (sk.mongo_ctx == NULL) return ERR_CODE;
     int errcode;
     int retcode = OK_CODE;
     char col_name[MAX_DOMAIN_LEN];
+    int conn_id = pickConnId();
+    mongoAsyncContext *c;
+
+    if (conn_id < 0) goto error;
+    c = sk.mongo_ctxs[conn_id];
+    t->conn_id = conn_id;
+    sk.mongo_conn_load[conn_id]++;
 
     // remove last dot
     prepareColName(t->dotOrigin, col_name);
 
     t->status = TASK_RUNNING;
-    LOG_INFO("asynchronous reload zone %s.", t->dotOrigin);
+    LOG_INFO("asynchronous reload zone %s(conn %d).", t->dotOrigin, conn_id);
 
     LOG_DEBUG("async sn: %d.", t->sn);
-    if (t->zone_exist) {
+    if (t->zone_exist && !t->sn_checked) {
         bson_t *q = BCON_NEW("type", BCON_UTF8("SOA"));
-        errcode = mongoAsyncFindOne(sk.mongo_ctx, zoneSOAGetCallback, t,
+        errcode = mongoAsyncFindOne(c, zoneSOAGetCallback, t,
                                     sk.mongo_dbname, col_name, q, NULL);
     } else {
         /*
          * new zone.
          * skip checking sn.
          */
-        errcode = mongoAsyncFindAll(sk.mongo_ctx, RRSetGetCallback, t, sk.mongo_dbname,
+        errcode = mongoAsyncFindAll(c, RRSetGetCallback, t, sk.mongo_dbname,
                                     col_name, NULL, NULL, 0);
     }
     if (errcode != MONGO_OK) {
-        LOG_ERROR("MONGO ERROR: %s", sk.mongo_ctx->errstr);
+        LOG_ERROR("MONGO ERROR: %s", c->errstr);
         goto error;
     }
     goto ok;
@@ -443,12 +691,20 @@ ok:
 }
 
 int mongoAsyncReloadAllZone() {
-    if (sk.mongo_ctx == NULL) return ERR_CODE;
+    if (sk.mongo_catalog) {
+        // new zones are found by polling catalog.
+        catalog.last_poll_ts = 0;
+        sk.last_all_reload_ts = sk.unixtime;
+        return mongoAsyncPollCatalog();
+    }
+    int conn_id = pickConnId();
+    if (conn_id < 0) return ERR_CODE;
+    mongoAsyncContext *c = sk.mongo_ctxs[conn_id];
     LOG_INFO("Asynchronous get all zones from mongodb");
     int errcode;
-    errcode = mongoAsyncGetCollectionNames(sk.mongo_ctx, reloadAllCallback, NULL, sk.mongo_dbname);
+    errcode = mongoAsyncGetCollectionNames(c, reloadAllCallback, NULL, sk.mongo_dbname);
     if (errcode != MONGO_OK) {
-        LOG_ERROR("Mongo ERROR: %s", sk.mongo_ctx->errstr);
+        LOG_ERROR("Mongo ERROR: %s", c->errstr);
         return ERR_CODE;
     }
     // we need set last_all_reload_ts here, otherwise it will trigger many reloadAll task in cron callback
@@ -0,0 +1,221 @@
+//
+// DNS NOTIFY(RFC 1996)
+//
+// NOTIFY messages are accepted by the lcores(udp) and the tcp server(main thread),
+// the zone names are written to a pipe as fixed size messages, the writes smaller
+// than PIPE_BUF are atomic, so the lcores can write it concurrently.
+// main thread reloads the notified zones before the periodical refreshes,
+// the NOTIFY messages for a zone waiting for reload are coalesced.
+//
+
+#include <arpa/inet.h>
+
+#include "shuke.h"
+#include "utils.h"
+
+DEF_LOG_MODULE(RTE_LOGTYPE_USER1, "NOTIFY");
+
+// retry interval(milliseconds) of the zones in reloading state.
+#define NOTIFY_RETRY_INTERVAL 100
+
+typedef struct {
+    char dotOrigin[MAX_DOMAIN_LEN+2];
+} notifyMsg;
+
+static struct {
+    int fds[2];
+    // the partial message of last read
+    char buf[sizeof(notifyMsg)];
+    size_t nbuf;
+    // the zones in reloading state when NOTIFY is received, they are reloaded again later.
+    dict *pending;
+    long long timer_id;
+
+    notifyStats stats;
+    // updated by lcores
+    rte_atomic64_t nr_refused;
+    rte_atomic64_t nr_dropped;
+} notifier = {
+    .fds = {-1, -1},
+    .timer_id = -1,
+};
+
+/*!
+ * parse address prefix, like 10.0.0.0/8, ::1 or 192.168.1.1(the same as 192.168.1.1/32)
+ *
+ * @return ERR_CODE if ss is not a valid address prefix.
+ */
+int parseAddrPrefix(const char *ss, addrPrefix *p) {
+    char buf[INET6_ADDRSTRLEN+8];
+    char *slash, *end;
+    int max;
+
+    snprintf(buf, sizeof(buf), "%s", ss);
+    if ((slash = strchr(buf, '/')) != NULL) *slash++ = 0;
+
+    memset(p, 0, sizeof(*p));
+    if (inet_pton(AF_INET, buf, p->addr) == 1) {
+        p->af = AF_INET;
+        max = 32;
+    } else if (inet_pton(AF_INET6, buf, p->addr) == 1) {
+        p->af = AF_INET6;
+        max = 128;
+    } else {
+        return ERR_CODE;
+    }
+    p->prefix = max;
+    if (slash != NULL) {
+        long v = strtol(slash, &end, 10);
+        if (*slash == 0 || *end != 0 || v < 0 || v > max) return ERR_CODE;
+        p->prefix = (int)v;
+    }
+    return OK_CODE;
+}
+
+/*!
+ * check if the address is in the prefix.
+ *
+ * @param addr : network byte order, 4 bytes if is_ipv4 is true, otherwise 16 bytes.
+ */
+bool addrPrefixMatch(addrPrefix *p, const void *addr, bool is_ipv4) {
+    const uint8_t *a = addr;
+    int nbytes = p->prefix / 8;
+    int nbits = p->prefix % 8;
+
+    if (p->af != (is_ipv4? AF_INET: AF_INET6)) return false;
+    if (memcmp(a, p->addr, (size_t)nbytes) != 0) return false;
+    if (nbits == 0) return true;
+    uint8_t mask = (uint8_t)(0xff << (8 - nbits));
+    return (a[nbytes] & mask) == (p->addr[nbytes] & mask);
+}
+
+static bool isNotifySource(const void *addr, bool is_ipv4) {
+    for (int i = 0; i < sk.nr_notify_sources; ++i) {
+        if (addrPrefixMatch(&sk.notify_sources[i], addr, is_ipv4)) return true;
+    }
+    return false;
+}
+
+/*!
+ * handle NOTIFY message, it can be called in lcores or main thread.
+ * the zone needn't be in memory, so a NOTIFY can add a new zone.
+ */
+int processNotify(struct context *ctx) {
+    notifyMsg msg;
+    int rcode = DNS_RCODE_OK;
+
+    if (sk.nr_notify_sources == 0) {
+        rcode = DNS_RCODE_NOTIMPL;
+    } else if (!isNotifySource(ctx->src_addr, ctx->src_ipv4)) {
+        rte_atomic64_inc(&notifier.nr_refused);
+        rcode = DNS_RCODE_REFUSED;
+    } else if (ctx->qType != DNS_TYPE_SOA) {
+        rcode = DNS_RCODE_FORMERR;
+    } else {
+        memset(&msg, 0, sizeof(msg));
+        len2dotlabel(ctx->name, msg.dotOrigin);
+        if (write(notifier.fds[1], &msg, sizeof(msg)) != sizeof(msg)) {
+            // the pipe is full, the primary will retry if no response.
+            rte_atomic64_inc(&notifier.nr_dropped);
+            return ERR_CODE;
+        }
+    }
+    return dumpDnsNotifyResp(ctx, rcode);
+}
+
+static int notifyRetryCron(struct aeEventLoop *el, long long id, void *clientData) {
+    UNUSED3(el, id, clientData);
+    dictIterator *it;
+    dictEntry *de;
+
+    it = dictGetIterator(notifier.pending);
+    while ((de = dictNext(it)) != NULL) {
+        if (asyncReloadZoneNotified(dictGetKey(de), NULL) == OK_CODE) {
+            dictDelete(notifier.pending, dictGetKey(de));
+        }
+    }
+    dictReleaseIterator(it);
+
+    if (dictSize(notifier.pending) == 0) {
+        notifier.timer_id = -1;
+        return AE_NOMORE;
+    }
+    return NOTIFY_RETRY_INTERVAL;
+}
+
+static void handleNotifyMsg(notifyMsg *msg) {
+    bool coalesced = false;
+
+    notifier.stats.nr_received++;
+    msg->dotOrigin[sizeof(msg->dotOrigin)-1] = 0;
+    LOG_DEBUG("receive NOTIFY of zone %s.", msg->dotOrigin);
+
+    if (dictFind(notifier.pending, msg->dotOrigin) != NULL) {
+        notifier.stats.nr_coalesced++;
+        return;
+    }
+    if (asyncReloadZoneNotified(msg->dotOrigin, &coalesced) == OK_CODE) {
+        if (coalesced) notifier.stats.nr_coalesced++;
+        return;
+    }
+    // the zone is reloading, the data may be read before the change.
+    dictAdd(notifier.pending, msg->dotOrigin, NULL);
+    if (notifier.timer_id < 0) {
+        notifier.timer_id = aeCreateTimeEvent(sk.el, NOTIFY_RETRY_INTERVAL, notifyRetryCron, NULL, NULL);
+        if (notifier.timer_id == AE_ERR) {
+            LOG_ERROR("can't create time event for NOTIFY.");
+            notifier.timer_id = -1;
+        }
+    }
+}
+
+static void notifyReadHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
+    UNUSED3(el, privdata, mask);
+    notifyMsg msgs[64];
+    char *buf = (char *)msgs;
+    ssize_t n;
+
+    while (true) {
+        // the messages are read as a whole, copy the partial message of last read first.
+        memcpy(buf, notifier.buf, notifier.nbuf);
+        n = read(fd, buf + notifier.nbuf, sizeof(msgs) - notifier.nbuf);
+        if (n <= 0) break;
+
+        size_t total = notifier.nbuf + (size_t)n;
+        size_t nr_msgs = total / sizeof(notifyMsg);
+        for (size_t i = 0; i < nr_msgs; ++i) {
+            handleNotifyMsg(&msgs[i]);
+        }
+        notifier.nbuf = total - nr_msgs * sizeof(notifyMsg);
+        memcpy(notifier.buf, buf + nr_msgs * sizeof(notifyMsg), notifier.nbuf);
+    }
+    if (n < 0 && errno != EAGAIN) {
+        LOG_WARN("can't read NOTIFY messages: %s.", strerror(errno));
+    }
+}
+
+void notifyGetStats(notifyStats *stats) {
+    memcpy(stats, &notifier.stats, sizeof(*stats));
+    stats->nr_refused = (uint64_t)rte_atomic64_read(&notifier.nr_refused);
+    stats->nr_dropped = (uint64_t)rte_atomic64_read(&notifier.nr_dropped);
+    stats->nr_pending = notifier.pending? dictSize(notifier.pending): 0;
+}
+
+int initNotify(void) {
+    rte_atomic64_init(&notifier.nr_refused);
+    rte_atomic64_init(&notifier.nr_dropped);
+
+    if (pipe(notifier.fds) < 0) {
+        LOG_ERROR("can't create pipe: %s.", strerror(errno));
+        return ERR_CODE;
+    }
+    anetNonBlock(NULL, notifier.fds[0]);
+    anetNonBlock(NULL, notifier.fds[1]);
+    notifier.pending = dictCreate(&dictTypeCaseStringCopyKey, NULL, SOCKET_ID_HEAP);
+
+    if (aeCreateFileEvent(sk.el, notifier.fds[0], AE_READABLE, notifyReadHandler, NULL) == AE_ERR) {
+        LOG_ERROR("can't create file event for NOTIFY.");
+        return ERR_CODE;
+    }
+    return OK_CODE;
+}
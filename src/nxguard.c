@@ -0,0 +1,350 @@
+//
+// random subdomain(water torture) guard
+//
+// the lcores count the NXDOMAIN answers of every zone in zoneLcoreStats, a zone
+// answering many of them is hinted to main thread every NXGUARD_HINT_EVERY
+// NXDOMAINs, so main thread only looks at the zones that may be attacked
+// instead of scanning all zones every second. main thread sums the counters
+// of the hinted zones(all lcores of all numa nodes), when the NXDOMAIN rate of
+// a zone crosses `threshold`, the zone is mitigated until the rate stays below
+// half of the threshold for `hold` seconds.
+//
+// the mitigation only applies to the udp queries of names not in the zone, the
+// existing names are always answered:
+//   slip:   answer with an empty truncated response, the resolvers retry over tcp.
+//   drop:   drop the queries whose first label looks random(high entropy).
+//   budget: every lcore answers at most `budget` of them per second, the rest are dropped.
+//
+
+#include "shuke.h"
+#include "utils.h"
+
+DEF_LOG_MODULE(RTE_LOGTYPE_USER1, "NXGUARD");
+
+#define NXGUARD_NR_HINTS        8
+#define NXGUARD_MIN_LABEL_LEN   8
+
+typedef struct {
+    uint32_t version;       // odd while origin is being written
+    char origin[MAX_DOMAIN_LEN+2];
+} nxguardHint;
+
+struct nxguardLcore_s {
+    nxguardHint hints[NXGUARD_NR_HINTS];
+    // the number of hints written, never reset.
+    volatile uint64_t nr_hints;
+};
+
+// the state of a hinted zone, only accessed by main thread.
+typedef struct {
+    char dotOrigin[MAX_DOMAIN_LEN+2];
+    uint64_t last_nxdomain;
+    long long last_ms;
+    uint64_t rate;
+    // the queries slipped or dropped by the current copies of the zone
+    uint64_t nr_guarded;
+    int mode;               // NXGUARD_OFF if not mitigated
+    long since;             // when the mitigation started
+    long calm_ts;           // when the rate dropped below threshold/2, 0 if not
+} nxguardZone;
+
+static const char *modeNames[] = {"off", "slip", "drop", "budget"};
+
+// round(c * log2(c) * 256)
+static const uint32_t nlog2n[64] = {
+    0, 0, 512, 1217, 2048, 2972, 3971, 5031,
+    6144, 7304, 8504, 9742, 11013, 12315, 13646, 15002,
+    16384, 17789, 19215, 20662, 22128, 23613, 25116, 26635,
+    28170, 29721, 31286, 32866, 34459, 36066, 37685, 39317,
+    40960, 42615, 44281, 45958, 47646, 49344, 51052, 52769,
+    54497, 56233, 57978, 59732, 61495, 63266, 65045, 66833,
+    68628, 70431, 72241, 74059, 75884, 77716, 79556, 81402,
+    83254, 85114, 86979, 88851, 90730, 92614, 94505, 96402,
+};
+
+// the last hint of every lcore read by main thread.
+static uint64_t hintsRead[RTE_MAX_LCORE];
+// min_entropy * 256
+static uint32_t minEntropy;
+
+/*!
+ * check if a label looks random, the shannon entropy(bits per char) of the
+ * label is compared with `min_entropy`, the letters are case folded.
+ * the labels shorter than NXGUARD_MIN_LABEL_LEN are never random.
+ */
+static bool isRandomLabel(const char *label, int len) {
+    uint8_t counts[256];
+    uint8_t chars[63];
+    int nr_chars = 0;
+    uint32_t sum = 0;
+
+    if (len < NXGUARD_MIN_LABEL_LEN) return false;
+    memset(counts, 0, sizeof(counts));
+    for (int i = 0; i < len; ++i) {
+        uint8_t c = (uint8_t)label[i];
+        if (c >= 'A' && c <= 'Z') c |= 0x20;
+        if (counts[c]++ == 0) chars[nr_chars++] = c;
+    }
+    for (int i = 0; i < nr_chars; ++i) sum += nlog2n[counts[chars[i]]];
+    // len * H = len * log2(len) - sum(c * log2(c))
+    return nlog2n[len] - sum >= minEntropy * (uint32_t)len;
+}
+
+/*!
+ * hint main thread that the zone answers many NXDOMAINs, called by lcores.
+ */
+void nxguardHintZone(nxguardLcore *gl, zone *z) {
+    uint64_t idx = gl->nr_hints;
+    nxguardHint *h = &gl->hints[idx % NXGUARD_NR_HINTS];
+
+    h->version++;
+    rte_smp_wmb();
+    memcpy(h->origin, z->origin, z->originLen+1);
+    rte_smp_wmb();
+    h->version++;
+    gl->nr_hints = idx + 1;
+}
+
+/*!
+ * decide how to answer a query of a name not in the mitigated zone, called by lcores.
+ *
+ * @param zst: the counters of the zone for current lcore, may be NULL
+ * @return NXGUARD_ANSWER, NXGUARD_SLIP_RESP or NXGUARD_DROP_QUERY
+ */
+int nxguardCheck(zone *z, zoneLcoreStats *zst, struct context *ctx) {
+    int action = NXGUARD_ANSWER;
+
+    // tcp clients can't spoof addresses, and slip sends them to tcp.
+    // a valid server cookie proves the address too.
+    if (ctx->resp_type != RESP_MBUF || ctx->cookie == COOKIE_VALID) return NXGUARD_ANSWER;
+
+    switch (z->guard_mode) {
+        case NXGUARD_SLIP:
+            action = NXGUARD_SLIP_RESP;
+            break;
+        case NXGUARD_DROP:
+            if (isRandomLabel(ctx->name+1, (uint8_t)ctx->name[0])) action = NXGUARD_DROP_QUERY;
+            break;
+        case NXGUARD_BUDGET:
+            if (zst == NULL) break;
+            if (zst->guard_epoch != sk.nxguard_epoch) {
+                zst->guard_epoch = sk.nxguard_epoch;
+                zst->guard_answered = 0;
+            }
+            if (zst->guard_answered >= (uint32_t)sk.nxguard_budget) {
+                action = NXGUARD_DROP_QUERY;
+            } else {
+                zst->guard_answered++;
+            }
+            break;
+        default:
+            break;
+    }
+    if (action != NXGUARD_ANSWER && zst) zst->nr_guarded++;
+    return action;
+}
+
+// set the mode on the copies of the zone of all numa nodes, nr_guarded may be NULL.
+static bool setZoneMode(const char *origin, int mode, uint64_t *nr_nxdomain, uint64_t *nr_guarded) {
+    bool found = false;
+    uint64_t q, nx;
+
+    *nr_nxdomain = 0;
+    if (nr_guarded) *nr_guarded = 0;
+    for (int i = 0; i < sk.nr_numa_id; ++i) {
+        numaNode_t *node = sk.nodes[sk.numa_ids[i]];
+        ltreeRLock(node->lt);
+        zone *z = ltreeGetZoneExactRaw(node->lt, (char *)origin);
+        if (z != NULL) {
+            // the zones are replaced by reloads, set it every time.
+            z->guard_mode = mode;
+            zoneGetQueryStats(z, &q, &nx);
+            *nr_nxdomain += nx;
+            if (nr_guarded) {
+                for (int j = 0; j < z->nr_lcore_stats; ++j) *nr_guarded += z->lcore_stats[j].nr_guarded;
+            }
+            found = true;
+        }
+        ltreeRUnlock(node->lt);
+    }
+    return found;
+}
+
+static void collectHints(void) {
+    char origin[MAX_DOMAIN_LEN+2];
+
+    for (int i = 0; i < sk.nr_lcore_ids; ++i) {
+        unsigned lcore_id = (unsigned)sk.lcore_ids[i];
+        nxguardLcore *gl = sk.lcore_conf[lcore_id].nxguard;
+        if (gl == NULL) continue;
+        uint64_t n = gl->nr_hints;
+        uint64_t start = hintsRead[lcore_id];
+        if (n - start > NXGUARD_NR_HINTS) start = n - NXGUARD_NR_HINTS;
+        for (uint64_t j = start; j < n; ++j) {
+            nxguardHint *h = &gl->hints[j % NXGUARD_NR_HINTS];
+            uint32_t version = h->version;
+            rte_smp_rmb();
+            if (version & 1) continue;
+            snprintf(origin, sizeof(origin), "%s", h->origin);
+            rte_smp_rmb();
+            if (h->version != version) continue;
+            if (dictFind(sk.nxguard_zones, origin) != NULL) continue;
+
+            nxguardZone *gz = zcalloc(sizeof(*gz));
+            len2dotlabel(origin, gz->dotOrigin);
+            // the rate is computed from the next cron.
+            if (!setZoneMode(origin, NXGUARD_OFF, &gz->last_nxdomain, NULL)) {
+                zfree(gz);
+                continue;
+            }
+            gz->last_ms = sk.mstime;
+            dictAdd(sk.nxguard_zones, origin, gz);
+        }
+        hintsRead[lcore_id] = n;
+    }
+}
+
+/*!
+ * update the NXDOMAIN rates of the hinted zones and start or stop the
+ * mitigations, called by main thread cron every second.
+ */
+void nxguardCron(void) {
+    dictIterator *it;
+    dictEntry *de;
+    uint64_t nr_nxdomain;
+
+    if (sk.nxguard_threshold <= 0) return;
+    // a new budget window
+    sk.nxguard_epoch++;
+    collectHints();
+
+    it = dictGetIterator(sk.nxguard_zones);
+    while ((de = dictNext(it)) != NULL) {
+        char *origin = dictGetKey(de);
+        nxguardZone *gz = dictGetVal(de);
+        long long interval = sk.mstime - gz->last_ms;
+
+        if (interval <= 0) continue;
+        if (!setZoneMode(origin, gz->mode, &nr_nxdomain, &gz->nr_guarded)) {
+            // the zone is deleted.
+            if (gz->mode != NXGUARD_OFF) LOG_INFO("zone %s is deleted, stop mitigating.", gz->dotOrigin);
+            zfree(gz);
+            dictDelete(sk.nxguard_zones, origin);
+            continue;
+        }
+        gz->rate = nr_nxdomain > gz->last_nxdomain? (nr_nxdomain - gz->last_nxdomain) * 1000 / interval: 0;
+        gz->last_nxdomain = nr_nxdomain;
+        gz->last_ms = sk.mstime;
+
+        if (gz->mode == NXGUARD_OFF) {
+            if (gz->rate >= (uint64_t)sk.nxguard_threshold) {
+                gz->mode = sk.nxguard_mode;
+                gz->since = sk.unixtime;
+                gz->calm_ts = 0;
+                sk.nxguard_events++;
+                setZoneMode(origin, gz->mode, &nr_nxdomain, NULL);
+                LOG_WARN("zone %s answers %lu NXDOMAIN per second, start mitigating(%s).",
+                         gz->dotOrigin, gz->rate, modeNames[gz->mode]);
+            } else if (gz->rate < (uint64_t)sk.nxguard_threshold / 2) {
+                zfree(gz);
+                dictDelete(sk.nxguard_zones, origin);
+            }
+            continue;
+        }
+        if (gz->rate >= (uint64_t)sk.nxguard_threshold / 2) {
+            gz->calm_ts = 0;
+        } else if (gz->calm_ts == 0) {
+            gz->calm_ts = sk.unixtime;
+        } else if (sk.unixtime - gz->calm_ts >= sk.nxguard_hold) {
+            LOG_INFO("zone %s answers %lu NXDOMAIN per second, stop mitigating after %ld seconds.",
+                     gz->dotOrigin, gz->rate, sk.unixtime - gz->since);
+            setZoneMode(origin, NXGUARD_OFF, &nr_nxdomain, NULL);
+            zfree(gz);
+            dictDelete(sk.nxguard_zones, origin);
+        }
+    }
+    dictReleaseIterator(it);
+}
+
+/*!
+ * get the mode by name(slip, drop or budget), -1 if unknown.
+ */
+int nxguardModeFromStr(const char *ss) {
+    for (int i = NXGUARD_SLIP; i <= NXGUARD_BUDGET; ++i) {
+        if (strcasecmp(ss, modeNames[i]) == 0) return i;
+    }
+    return -1;
+}
+
+/*!
+ * the status of the guard and the hinted zones, used by admin `info nxguard`.
+ */
+sds nxguardToStr(sds s) {
+    dictIterator *it;
+    dictEntry *de;
+    int nr_mitigated = 0, idx = 0;
+
+    if (sk.nxguard_zones) {
+        it = dictGetIterator(sk.nxguard_zones);
+        while ((de = dictNext(it)) != NULL) {
+            if (((nxguardZone *)dictGetVal(de))->mode != NXGUARD_OFF) nr_mitigated++;
+        }
+        dictReleaseIterator(it);
+    }
+    s = sdscatprintf(s,
+                     "# Nxguard\r\n"
+                     "nxguard_threshold:%d\r\n"
+                     "nxguard_mode:%s\r\n"
+                     "nxguard_events:%lu\r\n"
+                     "nxguard_watched_zones:%lu\r\n"
+                     "nxguard_mitigated_zones:%d\r\n",
+                     sk.nxguard_threshold, modeNames[sk.nxguard_mode], sk.nxguard_events,
+                     sk.nxguard_zones? dictSize(sk.nxguard_zones): 0, nr_mitigated);
+    if (sk.nxguard_zones == NULL) return s;
+
+    it = dictGetIterator(sk.nxguard_zones);
+    while ((de = dictNext(it)) != NULL) {
+        nxguardZone *gz = dictGetVal(de);
+        s = sdscatprintf(s, "zone%d:origin=%s,nxdomain_rate=%lu,mode=%s,since=%ld,guarded=%lu\r\n",
+                         idx++, gz->dotOrigin, gz->rate, modeNames[gz->mode],
+                         gz->mode != NXGUARD_OFF? gz->since: 0, gz->nr_guarded);
+    }
+    dictReleaseIterator(it);
+    return s;
+}
+
+int initNxguard(void) {
+    minEntropy = (uint32_t)(sk.nxguard_min_entropy * 256);
+    sk.nxguard_zones = dictCreate(&dictTypeCaseStringCopyKey, NULL, SOCKET_ID_HEAP);
+    for (int i = 0; i < sk.nr_lcore_ids; ++i) {
+        unsigned lcore_id = (unsigned)sk.lcore_ids[i];
+        if (lcore_id == rte_get_master_lcore()) continue;
+        sk.lcore_conf[lcore_id].nxguard = socket_calloc((int)rte_lcore_to_socket_id(lcore_id),
+                                                        1, sizeof(nxguardLcore));
+        if (sk.lcore_conf[lcore_id].nxguard == NULL) {
+            LOG_ERROR("can't allocate nxguard hints for lcore %u.", lcore_id);
+            return ERR_CODE;
+        }
+    }
+    return OK_CODE;
+}
+
+#if defined(SK_TEST)
+#include "testhelp.h"
+
+/*
+ * usage: shuke-server test nxguard
+ */
+int nxguardTest(int argc, char *argv[]) {
+    UNUSED2(argc, argv);
+    minEntropy = (uint32_t)(3.0 * 256);
+
+    test_cond("short labels are not random", !isRandomLabel("x7k2q9", 6));
+    test_cond("repeated chars are not random", !isRandomLabel("aaaaaaaaaaaa", 12));
+    test_cond("words are not random", !isRandomLabel("mailserver", 10));
+    test_cond("random labels", isRandomLabel("q8x3kd9wz7ma", 12));
+    test_cond("random labels(case folded)", isRandomLabel("Q8X3KD9WZ7MA", 12));
+    test_report();
+    return 0;
+}
+#endif
@@ -98,7 +98,12 @@ typedef enum dns_rr_type {
     DNS_TYPE_IPSECKEY= 45,	/**< DNS IPSEC Key.			    */
     DNS_TYPE_RRSIG	= 46,	/**< DNS Resource Record signature.	    */
     DNS_TYPE_NSEC	= 47,	/**< DNS Next Secure Name.		    */
-    DNS_TYPE_DNSKEY	= 48	/**< DNSSEC Key.			    */
+    DNS_TYPE_DNSKEY	= 48,	/**< DNSSEC Key.			    */
+    DNS_TYPE_NSEC3	= 50,	/**< Hashed next secure name.		    */
+    DNS_TYPE_NSEC3PARAM= 51,	/**< NSEC3 parameters.			    */
+    DNS_TYPE_IXFR	= 251,	/**< Incremental zone transfer.		    */
+    DNS_TYPE_AXFR	= 252,	/**< Full zone transfer.		    */
+    DNS_TYPE_CAA	= 257	/**< Certification Authority Authorization. */
 } dns_rr_type;
 
 typedef enum dns_rcode {
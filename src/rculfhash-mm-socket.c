@@ -22,10 +22,13 @@
  */
 
 #include <rculfhash-internal.h>
+#include <urcu/uatomic.h>
 
 #include "zmalloc.h"
 
 const struct cds_lfht_mm_type cds_lfht_mm_socket;
+/* bytes of all bucket tables allocated by this allocator */
+unsigned long cds_lfht_mm_socket_bytes;
 
 static
 void cds_lfht_alloc_bucket_table(struct cds_lfht *ht, unsigned long order)
@@ -35,10 +38,12 @@ void cds_lfht_alloc_bucket_table(struct cds_lfht *ht, unsigned long order)
 		ht->tbl_order[0] = socket_calloc((int)socket_id, ht->min_nr_alloc_buckets,
 			sizeof(struct cds_lfht_node));
 		assert(ht->tbl_order[0]);
+		uatomic_add(&cds_lfht_mm_socket_bytes, ht->min_nr_alloc_buckets * sizeof(struct cds_lfht_node));
 	} else if (order > ht->min_alloc_buckets_order) {
 		ht->tbl_order[order] = socket_calloc((int)socket_id, 1UL << (order -1),
 			sizeof(struct cds_lfht_node));
 		assert(ht->tbl_order[order]);
+		uatomic_add(&cds_lfht_mm_socket_bytes, (1UL << (order -1)) * sizeof(struct cds_lfht_node));
 	}
 	/* Nothing to do for 0 < order && order <= ht->min_alloc_buckets_order */
 }
@@ -52,10 +57,13 @@ static
 void cds_lfht_free_bucket_table(struct cds_lfht *ht, unsigned long order)
 {
     long socket_id = (long)ht->privdata;
-	if (order == 0)
+	if (order == 0) {
 		socket_free((int)socket_id, ht->tbl_order[0]);
-	else if (order > ht->min_alloc_buckets_order)
+		uatomic_sub(&cds_lfht_mm_socket_bytes, ht->min_nr_alloc_buckets * sizeof(struct cds_lfht_node));
+	} else if (order > ht->min_alloc_buckets_order) {
 		socket_free((int)socket_id, ht->tbl_order[order]);
+		uatomic_sub(&cds_lfht_mm_socket_bytes, (1UL << (order -1)) * sizeof(struct cds_lfht_node));
+	}
 	/* Nothing to do for 0 < order && order <= ht->min_alloc_buckets_order */
 }
 
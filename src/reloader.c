@@ -0,0 +1,233 @@
+//
+// reload worker
+//
+// parsing zone file and building the copies for every numa node are slow for
+// big zones, so they are done in a dedicated thread. main thread only needs to
+// publish the finished zones to the label trees.
+//
+
+#include "shuke.h"
+#include "utils.h"
+
+DEF_LOG_MODULE(RTE_LOGTYPE_USER1, "RELOADER");
+
+static struct {
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    // the contexts waiting for worker
+    zoneReloadContextList pending;
+    // the contexts built by worker, waiting for main thread
+    zoneReloadContextList done;
+    // worker writes a byte to notify_fds[1] to wakeup main thread
+    int notify_fds[2];
+
+    // protected by lock
+    reloaderStats stats;
+} reloader;
+
+static void __pushContext(zoneReloadContextList *list, zoneReloadContext *ctx) {
+    ctx->next = NULL;
+    if (list->head == NULL)
+        list->head = ctx;
+    if (list->tail != NULL)
+        list->tail->next = ctx;
+    list->tail = ctx;
+}
+
+static zoneReloadContext *__shiftContext(zoneReloadContextList *list) {
+    zoneReloadContext *ctx = list->head;
+
+    if (ctx != NULL) {
+        list->head = ctx->next;
+        if (ctx == list->tail)
+            list->tail = NULL;
+        ctx->next = NULL;
+    }
+    return ctx;
+}
+
+/*
+ * parse the zone file or call the build function(if needed) and build the copies of all numa nodes.
+ */
+static void buildZone(zoneReloadContext *ctx) {
+    zone *z;
+
+    if (ctx->fname) {
+        // admin reloads always rebuild the zone.
+        if (ctx->zone_exist && !ctx->urgent && !zoneFileChanged(ctx->fname, ctx->sn, &ctx->stamp)) {
+            ctx->unchanged = true;
+            ctx->err = OK_CODE;
+            return;
+        }
+        if (loadZoneFromFile(sk.master_numa_id, ctx->fname, &z) == ERR_CODE) {
+            goto error;
+        }
+        if (strcasecmp(z->dotOrigin, ctx->dotOrigin) != 0) {
+            LOG_ERROR("the origin(%s) of zone in file %s is not %s", z->dotOrigin, ctx->fname, ctx->dotOrigin);
+            zoneDestroy(z);
+            goto error;
+        }
+        ctx->new_zn = z;
+    } else if (ctx->build) {
+        if (ctx->build(ctx) == ERR_CODE) goto error;
+        if (ctx->unchanged) {
+            ctx->err = OK_CODE;
+            return;
+        }
+    }
+    assert(ctx->new_zn != NULL);
+    // the build function may already build the copies.
+    if (ctx->numa_zones[sk.master_numa_id] == NULL) {
+        prepareZoneAllNumaNodes(ctx->new_zn, ctx->numa_zones);
+    }
+    // the changes are served by IXFR.
+    xfrJournalRecord(ctx->new_zn);
+    ctx->err = OK_CODE;
+    return;
+
+error:
+    ctx->err = ERR_CODE;
+}
+
+static void *reloaderThreadMain(void *arg) {
+    UNUSED(arg);
+    zoneReloadContext *ctx;
+
+    // the worker may read the zones in label trees(e.g. applying IXFR),
+    // it stays offline except in the read side critical sections.
+    rcu_register_thread();
+    rcu_thread_offline();
+
+    while (true) {
+        pthread_mutex_lock(&reloader.lock);
+        while ((ctx = __shiftContext(&reloader.pending)) == NULL) {
+            pthread_cond_wait(&reloader.cond, &reloader.lock);
+        }
+        reloader.stats.nr_pending--;
+        reloader.stats.nr_running++;
+        pthread_mutex_unlock(&reloader.lock);
+
+        ctx->start_us = ustime();
+        buildZone(ctx);
+        ctx->end_us = ustime();
+
+        pthread_mutex_lock(&reloader.lock);
+        __pushContext(&reloader.done, ctx);
+        pthread_mutex_unlock(&reloader.lock);
+
+        // the pipe is non-blocking, if it is full, main thread will be woken up anyway.
+        if (write(reloader.notify_fds[1], "x", 1) < 0 && errno != EAGAIN) {
+            LOG_WARN("can't notify main thread: %s.", strerror(errno));
+        }
+    }
+    return NULL;
+}
+
+static void finishReload(zoneReloadContext *ctx) {
+    char origin[MAX_DOMAIN_LEN+2];
+    long long build_us = ctx->end_us - ctx->start_us;
+    long long latency_us = ustime() - ctx->submit_us;
+
+    pthread_mutex_lock(&reloader.lock);
+    reloader.stats.nr_running--;
+    if (ctx->err != OK_CODE) {
+        reloader.stats.nr_failed++;
+    } else if (ctx->unchanged) {
+        reloader.stats.nr_unchanged++;
+    } else {
+        reloader.stats.nr_done++;
+        reloader.stats.build_us_total += build_us;
+        reloader.stats.build_us_last = build_us;
+        reloader.stats.latency_us_total += latency_us;
+        if (latency_us > reloader.stats.latency_us_max) reloader.stats.latency_us_max = latency_us;
+        if (build_us > reloader.stats.build_us_max) {
+            reloader.stats.build_us_max = build_us;
+            snprintf(reloader.stats.max_zone, sizeof(reloader.stats.max_zone), "%s", ctx->dotOrigin);
+        }
+    }
+    pthread_mutex_unlock(&reloader.lock);
+
+    if (ctx->err != OK_CODE) {
+        LOG_ERROR("failed to reload zone %s.", ctx->dotOrigin);
+        // retry when the zone needs refresh next time.
+        if (ctx->zone_exist) {
+            dot2lenlabel(ctx->dotOrigin, origin);
+            masterRefreshZone(origin);
+        }
+    } else if (ctx->unchanged) {
+        finishUnchangedZone(ctx);
+        return;
+    } else {
+        ctx->new_zn->reload_us = build_us;
+        publishZoneAllNumaNodes(ctx->new_zn, ctx->numa_zones);
+        ctx->new_zn = NULL;
+        LOG_INFO("reload zone %s successfully, build: %lld us, latency: %lld us.",
+                 ctx->dotOrigin, build_us, latency_us);
+    }
+    zoneReloadContextDestroy(ctx);
+}
+
+static void reloaderNotifyHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
+    UNUSED3(el, privdata, mask);
+    char buf[256];
+    zoneReloadContext *ctx;
+
+    while (read(fd, buf, sizeof(buf)) > 0);
+
+    while (true) {
+        pthread_mutex_lock(&reloader.lock);
+        ctx = __shiftContext(&reloader.done);
+        pthread_mutex_unlock(&reloader.lock);
+        if (ctx == NULL) break;
+
+        finishReload(ctx);
+    }
+}
+
+/*!
+ * hand a reload context to reload worker, must be called in main thread.
+ * the context is released after the zone is published.
+ *
+ * @param ctx: if ctx->fname is NULL, ctx->new_zn must be a fully loaded zone.
+ * @return OK_CODE
+ */
+int reloaderSubmit(zoneReloadContext *ctx) {
+    ctx->submit_us = ustime();
+
+    pthread_mutex_lock(&reloader.lock);
+    __pushContext(&reloader.pending, ctx);
+    reloader.stats.nr_pending++;
+    pthread_cond_signal(&reloader.cond);
+    pthread_mutex_unlock(&reloader.lock);
+    return OK_CODE;
+}
+
+void reloaderGetStats(reloaderStats *stats) {
+    pthread_mutex_lock(&reloader.lock);
+    memcpy(stats, &reloader.stats, sizeof(*stats));
+    pthread_mutex_unlock(&reloader.lock);
+}
+
+int initReloader(void) {
+    pthread_mutex_init(&reloader.lock, NULL);
+    pthread_cond_init(&reloader.cond, NULL);
+
+    if (pipe(reloader.notify_fds) < 0) {
+        LOG_ERROR("can't create pipe: %s.", strerror(errno));
+        return ERR_CODE;
+    }
+    anetNonBlock(NULL, reloader.notify_fds[0]);
+    anetNonBlock(NULL, reloader.notify_fds[1]);
+
+    if (aeCreateFileEvent(sk.el, reloader.notify_fds[0], AE_READABLE, reloaderNotifyHandler, NULL) == AE_ERR) {
+        LOG_ERROR("can't create file event for reload worker.");
+        return ERR_CODE;
+    }
+    if (pthread_create(&reloader.tid, NULL, reloaderThreadMain, NULL) != 0) {
+        LOG_ERROR("can't create reload worker thread.");
+        return ERR_CODE;
+    }
+    return OK_CODE;
+}
@@ -57,6 +57,19 @@ zone *getOldestZone() {
     return NULL;
 }
 
+/*!
+ * the next time the zone should be refreshed, a random jitter(at most
+ * refresh_jitter percent of refresh) is added, so the zones loaded together
+ * won't be refreshed together.
+ */
+static long zoneNextRefreshTs(zone *z) {
+    long jitter = 0;
+    long max_jitter = (long)z->refresh * sk.refresh_jitter / 100;
+
+    if (max_jitter > 0) jitter = rand() % (max_jitter + 1);
+    return sk.unixtime + z->refresh + jitter;
+}
+
 /*!
  * adjust the position of zone in rbtree
  * @param origin: must be absolute domain name in len label format.
@@ -68,63 +81,77 @@ void masterRefreshZone(char *origin) {
 
     if (z == NULL) return;
     assert(RB_EMPTY_NODE(&z->rbnode));
-    z->refresh_ts = sk.unixtime + z->refresh;
+    z->refresh_ts = zoneNextRefreshTs(z);
     rbtreeInsertZone(z);
 }
 
-void zoneUpdateRoundRabinInfo(zone *z) {
-    int nr_rr_idx = 0;
-    struct numaNode_s *node;
+/*
+ * every lcore of the numa node the zone belongs to gets a slot of query counters.
+ */
+static void zoneInitNodeStats(zone *z) {
+    numaNode_t *node = sk.nodes[z->socket_id];
+    zoneInitStats(z, node->min_lcore_id, node->max_lcore_id - node->min_lcore_id + 1);
+}
 
-    dictIterator *it = dictGetIterator(z->d);
-    dictEntry *de;
-    while((de = dictNext(it)) != NULL) {
-        dnsDictValue *dv = dictGetVal(de);
-        for (int i = 0; i < SUPPORT_TYPE_NUM; ++i) {
-            RRSet *rs = dv->v.rsArr[i];
-            if (rs) {
-                RRSetUpdateOffsets(rs);
-                if (rs->num > 1) {
-                    rs->z_rr_idx = nr_rr_idx++;
-                }
-            }
+/*!
+ * compact z and build its copies for the other numa nodes.
+ * the label trees are not touched, so it is safe to call this function in reload worker.
+ *
+ * @param z: the zone of master numa node
+ * @param numa_zones: indexed by numa id, the slot of master numa node is set to z.
+ */
+void prepareZoneAllNumaNodes(zone *z, zone **numa_zones) {
+    zoneCompact(z);
+
+    for (int i = 0; i < sk.nr_numa_id; ++i) {
+        int numa_id = sk.numa_ids[i];
+        zone *new_z = z;
+        if (numa_id != sk.master_numa_id) {
+            new_z = zoneCopy(z, numa_id);
+            zoneCompact(new_z);
         }
+        zoneInitNodeStats(new_z);
+        numa_zones[numa_id] = new_z;
     }
-    dictReleaseIterator(it);
-
-    assert(z->rr_offset_array == NULL);
-    node = sk.nodes[z->socket_id];
-
-    // to avoid False Share
-    nr_rr_idx = ((nr_rr_idx - 1) / RTE_CACHE_LINE_SIZE + 1) * RTE_CACHE_LINE_SIZE;
-
-    z->start_core_idx = node->min_lcore_id;
-    int arr_len = node->max_lcore_id - node->min_lcore_id + 1;
-    uint32_t arr_size = sizeof(uint32_t)*arr_len;
-    size_t totalsize = arr_size + node->nr_lcore_ids * nr_rr_idx;
-    z->rr_offset_array = socket_calloc(z->socket_id, 1, totalsize);
+}
 
-    for (int i = 0; i < node->nr_lcore_ids; ++i) {
-        int lcore_id = node->lcore_ids[i];
-        int idx = lcore_id - node->min_lcore_id;
-        z->rr_offset_array[idx] = arr_size + i * nr_rr_idx * sizeof(uint8_t);
-    }
+/*
+ * carry the query counters of the replaced zone over to the new zone,
+ * the queries counted by the old zone after this call are lost.
+ */
+static void zoneInheritStats(zone *new_z, zone *old_z) {
+    if (old_z == NULL) return;
+    zoneGetQueryStats(old_z, &new_z->base_queries, &new_z->base_nxdomain);
 }
 
 /*!
- * add or replace a zone to all numa node's zone dict, we need update new zone's offsets and refresh_ts
- * @param z
+ * add or replace the zones built by prepareZoneAllNumaNodes to all numa node's label tree,
+ * must be called in main thread. the label trees own the zones after this call.
+ *
+ * @param z: the zone of master numa node
+ * @param numa_zones
  * @return
  */
-int replaceZoneAllNumaNodes(zone *z) {
+int publishZoneAllNumaNodes(zone *z, zone **numa_zones) {
     int err = 0;
-    z->refresh_ts = sk.unixtime + z->refresh;
-    zoneUpdateRoundRabinInfo(z);
+    z->refresh_ts = zoneNextRefreshTs(z);
+    z->reload_ts = sk.unixtime;
 
-    replaceZoneOtherNuma(z);
+    for (int i = 0; i < sk.nr_numa_id; ++i) {
+        int numa_id = sk.numa_ids[i];
+        numaNode_t *node = sk.nodes[numa_id];
+        if (numa_id == sk.master_numa_id) continue;
+        ltreeRLock(node->lt);
+        zoneInheritStats(numa_zones[numa_id], ltreeGetZoneExactRaw(node->lt, z->origin));
+        ltreeRUnlock(node->lt);
+        ltreeReplace(node->lt, numa_zones[numa_id]);
+        numa_zones[numa_id] = NULL;
+    }
+    numa_zones[sk.master_numa_id] = NULL;
 
     ltreeWLock(sk.lt);
     zone *old_z = ltreeGetZoneExactRaw(sk.lt, z->origin);
+    zoneInheritStats(z, old_z);
     if (old_z != NULL) {
         rbtreeDeleteZone(old_z);
         err = 0;
@@ -136,9 +163,67 @@ int replaceZoneAllNumaNodes(zone *z) {
     return err;
 }
 
+/*!
+ * add or replace a zone to all numa node's zone dict, we need update new zone's offsets and refresh_ts
+ * @param z
+ * @return
+ */
+int replaceZoneAllNumaNodes(zone *z) {
+    zone *numa_zones[MAX_NUMA_NODES] = {NULL};
+
+    prepareZoneAllNumaNodes(z, numa_zones);
+    return publishZoneAllNumaNodes(z, numa_zones);
+}
+
+/*!
+ * presize the label trees of all numa nodes before loading lots of zones,
+ * zones are counted by parent domain, so the children table of a busy parent(e.g. "com.")
+ * is allocated only once instead of being resized again and again.
+ *
+ * @param names: zone names, the trailing dot is optional.
+ * @param n: the number of names
+ */
+void reserveZoneTree(char **names, size_t n) {
+    char dotParent[MAX_DOMAIN_LEN+2];
+    char parent[MAX_DOMAIN_LEN+2];
+    dict *d = dictCreate(&dictTypeCaseStringCopyKey, NULL, SOCKET_ID_HEAP);
+    dictEntry *de;
+
+    for (size_t i = 0; i < n; ++i) {
+        char *p = strchr(names[i], '.');
+        if (p == NULL || *(p+1) == 0) {
+            strcpy(dotParent, ".");
+        } else {
+            snprintf(dotParent, MAX_DOMAIN_LEN, "%s", p+1);
+            if (!isAbsDotDomain(dotParent)) strcat(dotParent, ".");
+        }
+        de = dictFind(d, dotParent);
+        if (de == NULL) {
+            dictAdd(d, dotParent, NULL);
+            de = dictFind(d, dotParent);
+            dictSetUnsignedIntegerVal(de, 0);
+        }
+        dictSetUnsignedIntegerVal(de, dictGetUnsignedIntegerVal(de) + 1);
+    }
+
+    dictIterator *it = dictGetIterator(d);
+    while((de = dictNext(it)) != NULL) {
+        size_t count = (size_t)dictGetUnsignedIntegerVal(de);
+        if (count <= LTREE_INLINE_MAX) continue;
+        dot2lenlabel(dictGetKey(de), parent);
+        for (int i = 0; i < sk.nr_numa_id; ++i) {
+            ltreeReserve(sk.nodes[sk.numa_ids[i]]->lt, parent, count);
+        }
+        LOG_DEBUG("reserve %lu children for %s.", count, (char *)dictGetKey(de));
+    }
+    dictReleaseIterator(it);
+    dictRelease(d);
+}
+
 int addZoneAllNumaNodes(zone *z) {
-    z->refresh_ts = sk.unixtime + z->refresh;
-    zoneUpdateRoundRabinInfo(z);
+    z->refresh_ts = zoneNextRefreshTs(z);
+    zoneCompact(z);
+    zoneInitNodeStats(z);
 
     addZoneOtherNuma(z);
 
@@ -157,6 +242,7 @@ int deleteZoneAllNumaNodes(char *origin) {
 
     // delete the zone on non-master numa node
     deleteZoneOtherNuma(origin);
+    xfrJournalDrop(origin);
 
     ltreeWLock(sk.lt);
     zone *del_z = ltreeGetZoneExactRaw(sk.lt, origin);
@@ -174,14 +260,52 @@ static int __pushZoneReloadContext(zoneReloadContext *ctx) {
     assert(ctx != NULL);
 
     /* Store callback in list */
+    ctx->next = NULL;
     if (list->head == NULL)
         list->head = ctx;
     if (list->tail != NULL)
         list->tail->next = ctx;
     list->tail = ctx;
+    sk.nr_pending_tasks++;
+    return OK_CODE;
+}
+
+/*
+ * put the context to the head of task queue, used by urgent tasks.
+ */
+static int __unshiftZoneReloadContext(zoneReloadContext *ctx) {
+    zoneReloadContextList *list = &sk.tasks;
+    assert(ctx != NULL);
+
+    ctx->next = list->head;
+    list->head = ctx;
+    if (list->tail == NULL)
+        list->tail = ctx;
+    sk.nr_pending_tasks++;
     return OK_CODE;
 }
 
+/*
+ * remove the pending context of dotOrigin from task queue.
+ */
+static zoneReloadContext *__removeZoneReloadContext(char *dotOrigin) {
+    zoneReloadContextList *list = &sk.tasks;
+    zoneReloadContext *prev = NULL;
+    zoneReloadContext *ctx;
+
+    for (ctx = list->head; ctx != NULL; prev = ctx, ctx = ctx->next) {
+        if (strcasecmp(ctx->dotOrigin, dotOrigin) != 0) continue;
+
+        if (prev == NULL) list->head = ctx->next;
+        else prev->next = ctx->next;
+        if (ctx == list->tail) list->tail = prev;
+        ctx->next = NULL;
+        sk.nr_pending_tasks--;
+        break;
+    }
+    return ctx;
+}
+
 static zoneReloadContext* __shiftZoneReloadContext() {
     zoneReloadContextList *list = &sk.tasks;
     zoneReloadContext *ctx = list->head;
@@ -191,6 +315,7 @@ static zoneReloadContext* __shiftZoneReloadContext() {
         if (ctx == list->tail)
             list->tail = NULL;
         ctx->next = NULL;
+        sk.nr_pending_tasks--;
     }
     return ctx;
 }
@@ -209,6 +334,7 @@ zoneReloadContext *zoneReloadContextCreate(char *dotOrigin) {
     int32_t refresh=0, expiry=0;
     long refresh_ts = 0;
     bool zone_exist = false;
+    zoneFileStamp stamp = {0};
 
     char origin[MAX_DOMAIN_LEN+2];
     dot2lenlabel(dotOrigin, origin);
@@ -230,6 +356,7 @@ zoneReloadContext *zoneReloadContextCreate(char *dotOrigin) {
         refresh = old_zn->refresh;
         expiry = old_zn->expiry;
         refresh_ts = old_zn->refresh_ts;
+        stamp = old_zn->stamp;
         zone_exist = true;
         // the zone is reloading should not in rbtree.
         rbtreeDeleteZone(old_zn);
@@ -242,21 +369,76 @@ zoneReloadContext *zoneReloadContextCreate(char *dotOrigin) {
     t->expiry = expiry;
     t->refresh_ts = refresh_ts;
     t->zone_exist = zone_exist;
+    t->stamp = stamp;
     t->status = TASK_PENDING;
+    t->conn_id = -1;
+    t->create_us = ustime();
 invalid:
     ltreeRUnlock(sk.lt);
     return t;
 }
 
-void zoneReloadContextReset(zoneReloadContext *t) {
-    t->status = TASK_PENDING;
+static void zoneReloadContextFreeZones(zoneReloadContext *t) {
+    for (int i = 0; i < MAX_NUMA_NODES; ++i) {
+        if (t->numa_zones[i] && t->numa_zones[i] != t->new_zn) zoneDestroy(t->numa_zones[i]);
+        t->numa_zones[i] = NULL;
+    }
     if (t->new_zn) zoneDestroy(t->new_zn);
     t->new_zn = NULL;
 }
 
+/*
+ * the context leaves the in-flight window, must be called in main thread.
+ */
+static void zoneReloadContextFinish(zoneReloadContext *t) {
+    reloadSchedStats *st = &sk.sched_stats;
+    long long latency_us;
+
+    if (t->conn_id >= 0) {
+        sk.mongo_conn_load[t->conn_id]--;
+        t->conn_id = -1;
+    }
+    if (!t->inflight) return;
+
+    t->inflight = false;
+    sk.nr_inflight_tasks--;
+    latency_us = ustime() - t->create_us;
+    st->nr_finished++;
+    st->latency_us_total += latency_us;
+    if (latency_us > st->latency_us_max) st->latency_us_max = latency_us;
+}
+
+/*
+ * dispatch the context to data store, the context occupies a slot
+ * of the in-flight window until it is finished or requeued.
+ */
+static void zoneReloadContextDispatch(zoneReloadContext *t) {
+    reloadSchedStats *st = &sk.sched_stats;
+    long long wait_us;
+
+    t->inflight = true;
+    t->dispatch_us = ustime();
+    sk.nr_inflight_tasks++;
+    wait_us = t->dispatch_us - t->create_us;
+    st->nr_dispatched++;
+    st->wait_us_total += wait_us;
+    if (wait_us > st->wait_us_max) st->wait_us_max = wait_us;
+
+    sk.asyncReloadZone(t);
+}
+
+void zoneReloadContextReset(zoneReloadContext *t) {
+    zoneReloadContextFinish(t);
+    t->status = TASK_PENDING;
+    t->err = OK_CODE;
+    zoneReloadContextFreeZones(t);
+}
+
 void zoneReloadContextDestroy(zoneReloadContext *t) {
+    zoneReloadContextFinish(t);
     zfree(t->dotOrigin);
-    if (t->new_zn) zoneDestroy(t->new_zn);
+    zfree(t->fname);
+    zoneReloadContextFreeZones(t);
     if (t->psr) RRParserDestroy(t->psr);
     zfree(t);
 }
@@ -292,6 +474,56 @@ int asyncReloadZoneRaw(char *dotOrigin) {
     return OK_CODE;
 }
 
+/*!
+ * reload the zone without checking its serial, used when the caller
+ * already knows the zone is changed.
+ *
+ * @param dotOrigin
+ * @return
+ */
+int asyncReloadChangedZone(char *dotOrigin) {
+    if (sk.checkAsyncContext() != OK_CODE) return ERR_CODE;
+    zoneReloadContext *ctx = zoneReloadContextCreate(dotOrigin);
+    if (ctx == NULL) return ERR_CODE;
+    ctx->sn_checked = true;
+    __pushZoneReloadContext(ctx);
+    return OK_CODE;
+}
+
+/*!
+ * reload the zone before the periodical refreshes, used by admin commands.
+ * if the zone is already in the task queue, just move it to the head.
+ *
+ * @param dotOrigin
+ * @return
+ */
+int asyncReloadZoneUrgent(char *dotOrigin) {
+    if (sk.checkAsyncContext() != OK_CODE) return ERR_CODE;
+    zoneReloadContext *ctx = __removeZoneReloadContext(dotOrigin);
+    if (ctx == NULL) ctx = zoneReloadContextCreate(dotOrigin);
+    if (ctx == NULL) return ERR_CODE;
+    ctx->urgent = true;
+    sk.sched_stats.nr_urgent++;
+    __unshiftZoneReloadContext(ctx);
+    return OK_CODE;
+}
+
+/*!
+ * reload the zone before the periodical refreshes, the serial is still checked.
+ *
+ * @param coalesced : set to true if the zone is already waiting for reload.
+ * @return ERR_CODE if the zone is reloading now.
+ */
+int asyncReloadZoneNotified(char *dotOrigin, bool *coalesced) {
+    if (sk.checkAsyncContext() != OK_CODE) return ERR_CODE;
+    zoneReloadContext *ctx = __removeZoneReloadContext(dotOrigin);
+    if (coalesced) *coalesced = (ctx != NULL);
+    if (ctx == NULL) ctx = zoneReloadContextCreate(dotOrigin);
+    if (ctx == NULL) return ERR_CODE;
+    __unshiftZoneReloadContext(ctx);
+    return OK_CODE;
+}
+
 int triggerReloadAllZone() {
     // just reset last_all_reload_ts, then it will trigger reload all immediately.
     sk.last_all_reload_ts -= sk.all_reload_interval;
@@ -307,18 +539,6 @@ void deleteZoneOtherNuma(char *origin) {
     }
 }
 
-void replaceZoneOtherNuma(zone *z) {
-    for (int i = 0; i < sk.nr_numa_id; ++i) {
-        int numa_id = sk.numa_ids[i];
-        numaNode_t *node = sk.nodes[numa_id];
-        if (numa_id == sk.master_numa_id) continue;
-        zone *new_z = zoneCopy(z, numa_id);
-        zoneUpdateRoundRabinInfo(new_z);
-
-        ltreeReplace(node->lt, new_z);
-    }
-}
-
 void addZoneOtherNuma(zone *z) {
     int err;
     for (int i = 0; i < sk.nr_numa_id; ++i) {
@@ -326,29 +546,44 @@ void addZoneOtherNuma(zone *z) {
         numaNode_t *node = sk.nodes[numa_id];
         if (numa_id == sk.master_numa_id) continue;
         zone *new_z = zoneCopy(z, numa_id);
-        zoneUpdateRoundRabinInfo(new_z);
+        zoneCompact(new_z);
+        zoneInitNodeStats(new_z);
 
         err = ltreeAdd(node->lt, new_z);
         assert(err == DICT_OK);
     }
 }
 
+/*
+ * sum the counters of lcores, it is called by main thread cron, so the rates
+ * are computed over a fixed interval no matter how many clients read them.
+ */
 void collectStats() {
     int64_t nr_req = 0, nr_dropped = 0;
     unsigned lcore_id = 0;
     lcore_conf_t *qconf;
+    long long now = mstime();
+    long long interval = now - sk.last_collect_ms;
 
+    memset(sk.nr_qtype, 0, sizeof(sk.nr_qtype));
+    memset(sk.nr_rcode, 0, sizeof(sk.nr_rcode));
     for (int i = 0; i < sk.nr_lcore_ids; ++i) {
         lcore_id = (unsigned )sk.lcore_ids[i];
+        qconf = &sk.lcore_conf[lcore_id];
+        for (int j = 0; j < NR_QTYPES; ++j) sk.nr_qtype[j] += qconf->qstats.nr_qtype[j];
+        for (int j = 0; j < NR_RCODES; ++j) sk.nr_rcode[j] += qconf->qstats.nr_rcode[j];
         if (lcore_id == rte_get_master_lcore()) continue;
 
-        qconf = &sk.lcore_conf[lcore_id];
         nr_req += qconf->nr_req;
         nr_dropped += qconf->nr_dropped;
     }
+    if (interval > 0) {
+        sk.qps = (uint64_t)((nr_req - sk.nr_req) * 1000 / interval);
+        sk.dropped_qps = (uint64_t)((nr_dropped - sk.nr_dropped) * 1000 / interval);
+    }
     sk.nr_req = nr_req;
     sk.nr_dropped = nr_dropped;
-    sk.last_collect_ms = mstime();
+    sk.last_collect_ms = now;
 }
 
 void config_log() {
@@ -472,12 +707,35 @@ int initFileStore() {
 }
 
 static int _getAllZoneFromFile(bool is_first) {
-    dictIterator *it = dictGetIterator(sk.zone_files_dict);
+    dictIterator *it;
     dictEntry *de;
     zone *z;
+
+    // pick up the zone files added or removed since last scan.
+    if (!is_first && sk.zone_files_scan) {
+        if (scanZoneFilesRoot(true) == ERR_CODE) {
+            LOG_WARN("%s", sk.errstr);
+        }
+    }
+    if (is_first) {
+        size_t n = 0;
+        char **names = zmalloc((dictSize(sk.zone_files_dict) + 1) * sizeof(char *));
+        it = dictGetIterator(sk.zone_files_dict);
+        while((de = dictNext(it)) != NULL) names[n++] = dictGetKey(de);
+        dictReleaseIterator(it);
+        reserveZoneTree(names, n);
+        zfree(names);
+    }
+
+    it = dictGetIterator(sk.zone_files_dict);
     while((de = dictNext(it)) != NULL) {
         char *dotOrigin = dictGetKey(de);
         char *fname = dictGetVal(de);
+        if (!is_first) {
+            // zones are parsed in reload worker, the zone in reloading state is skipped.
+            asyncReloadZoneRaw(dotOrigin);
+            continue;
+        }
         if (loadZoneFromFile(sk.master_numa_id, fname, &z) == ERR_CODE) {
             return ERR_CODE;
         } else {
@@ -486,8 +744,7 @@ static int _getAllZoneFromFile(bool is_first) {
                 zoneDestroy(z);
                 return ERR_CODE;
             }
-            if (is_first) addZoneAllNumaNodes(z);
-            else replaceZoneAllNumaNodes(z);
+            addZoneAllNumaNodes(z);
         }
     }
     dictReleaseIterator(it);
@@ -503,24 +760,41 @@ int initialGetAllZoneFromFile() {
     return _getAllZoneFromFile(true);
 }
 
-int reloadZoneFromFile(zoneReloadContext *t) {
+/*
+ * the zone is unchanged, just update its stamp and refresh time.
+ */
+void finishUnchangedZone(zoneReloadContext *t) {
+    char origin[MAX_DOMAIN_LEN+2];
     zone *z;
+
+    dot2lenlabel(t->dotOrigin, origin);
+    ltreeRLock(sk.lt);
+    z = ltreeGetZoneExactRaw(sk.lt, origin);
+    ltreeRUnlock(sk.lt);
+    if (z != NULL) z->stamp = t->stamp;
+
+    LOG_DEBUG("reload zone %s successfully(unchanged).", t->dotOrigin);
+    sk.sched_stats.nr_unchanged++;
+    masterRefreshZone(origin);
+    zoneReloadContextDestroy(t);
+}
+
+int reloadZoneFromFile(zoneReloadContext *t) {
     char origin[MAX_DOMAIN_LEN+2];
+    zoneFileStamp stamp;
     char *fname = dictFetchValue(sk.zone_files_dict, t->dotOrigin);
     if (fname == NULL) {
         dot2lenlabel(t->dotOrigin, origin);
         deleteZoneAllNumaNodes(origin);
+        zoneReloadContextDestroy(t);
+    } else if (t->zone_exist && !t->urgent && !t->sn_checked &&
+               statZoneFile(fname, &stamp) == OK_CODE && zoneFileStatEqual(&stamp, &t->stamp)) {
+        // the file is not touched since last reload.
+        finishUnchangedZone(t);
     } else {
-        if (loadZoneFromFile(sk.master_numa_id, fname, &z) == ERR_CODE) {
-            return ERR_CODE;
-        } else {
-            if (strcasecmp(z->dotOrigin, t->dotOrigin) != 0) {
-                LOG_ERROR("the origin(%s) of zone in file %s is not %s", z->dotOrigin, fname, t->dotOrigin);
-                zoneDestroy(z);
-                return ERR_CODE;
-            }
-            replaceZoneAllNumaNodes(z);
-        }
+        // parse the file in reload worker.
+        t->fname = zstrdup(fname);
+        return reloaderSubmit(t);
     }
     return OK_CODE;
 }
@@ -552,8 +826,13 @@ void logQuery(struct context *ctx, char *cip, int cport, bool is_tcp) {
     fprintf(sk.query_log_fp, "%s queries: client %s#%d%s: query %s IN %s \n", buf, cip, cport, tcpstr, dotName, ty_str);
 }
 
-static inline int dumpDnsNameErr(struct context *ctx) {
-    return dumpDnsError(ctx, DNS_RCODE_NXDOMAIN);
+/*
+ * an empty response with TC flag, the client should retry over tcp.
+ */
+static inline int dumpDnsTruncated(struct context *ctx) {
+    if (dumpDnsError(ctx, DNS_RCODE_OK) == ERR_CODE) return ERR_CODE;
+    ctx->chunk[2] |= 0x02;
+    return OK_CODE;
 }
 
 static inline int dumpDnsFormatErr(struct context *ctx) {
@@ -568,15 +847,66 @@ static inline int dumpDnsRefusedErr(struct context *ctx) {
     return dumpDnsError(ctx, DNS_RCODE_REFUSED);
 }
 
-static int _getDnsResponse(char *buf, size_t sz, struct context *ctx)
+/*
+ * find the view of the client, the ECS address is preferred to the source address.
+ * return the next hop(view id and prefix length) or 0 if no prefix matches.
+ */
+static inline uint32_t lookupClientView(struct context *ctx, viewTable *vt) {
+    if (ctx->hasClientSubnetOpt && ctx->cinfo.edns_client_mask > 0) {
+        return viewLookup(vt, ctx->cinfo.client_family == AF_INET, ctx->cinfo.client_ip);
+    }
+    if (ctx->src_view != VIEW_HOP_UNKNOWN) return ctx->src_view;
+    return viewLookup(vt, ctx->src_ipv4, ctx->src_addr);
+}
+
+/*
+ * fetch the RRSets of the client's view, NULL if the name doesn't vary with
+ * views or the view of the client has no RRSet of the name.
+ * the ECS scope is only set for the names having views, so the answers of
+ * other names can be cached by resolvers for all clients(scope 0).
+ */
+static dnsDictValue *fetchViewValue(struct context *ctx, zone *z) {
+    dnsViewValue *vv = zoneFetchViewsAbs(z, ctx->name, ctx->nameLen);
+    viewTable *vt = rcu_dereference(ctx->node->vt);
+    uint32_t hop;
+
+    if (vv == NULL) return NULL;
+    hop = vt? lookupClientView(ctx, vt): 0;
+    if (ctx->hasClientSubnetOpt && ctx->cinfo.edns_client_mask > 0) {
+        // the answer is valid for the matched prefix, or the whole source prefix if nothing matches.
+        ctx->opt_rr[ctx->ecs_scope_off] = hop? VIEW_HOP_DEPTH(hop): (uint8_t)ctx->cinfo.edns_client_mask;
+    }
+    return hop? dnsViewValueGet(vv, VIEW_HOP_ID(hop)): NULL;
+}
+
+static int __getDnsResponse(char *buf, size_t sz, struct context *ctx)
 {
     struct dname dn;
+    zoneLcoreStats *zst;
     numaNode_t *node = ctx->node;
+    aclTable *acl;
     zone *z = NULL;
     dnsDictValue *dv = NULL;
     // int64_t now;
     int ret = OK_CODE;
+    ctx->z = NULL;
     decodeRcode res = decodeQuery(buf, sz, ctx);
+
+    // the question is valid unless the packet is malformed.
+    // the table may be replaced after the RX burst, the rule id only makes sense
+    // in the table it was classified against.
+    acl = ctx->acl_rule != ACL_RULE_UNKNOWN? ctx->acl: rcu_dereference(node->acl);
+    if (acl != NULL && res != DECODE_IGNORE && res != DECODE_FORMERR) {
+        switch (aclCheckQuery(acl, ctx)) {
+            case ACL_DROP:
+                return ERR_CODE;
+            case ACL_REFUSE:
+                dumpDnsRefusedErr(ctx);
+                return OK_CODE;
+            default:
+                break;
+        }
+    }
     switch (res) {
         case DECODE_IGNORE:
             return ERR_CODE;
@@ -588,6 +918,10 @@ static int _getDnsResponse(char *buf, size_t sz, struct context *ctx)
             return OK_CODE;
         case DECODE_BADVERS:
             break;
+        case DECODE_NOTIFY:
+            return processNotify(ctx);
+        case DECODE_XFR:
+            return processXfrQuery(ctx);
         default:
             break;
     }
@@ -613,10 +947,29 @@ static int _getDnsResponse(char *buf, size_t sz, struct context *ctx)
         dumpDnsRefusedErr(ctx);
         ret = OK_CODE;
     } else {
-        dv = zoneFetchValueAbs(z, ctx->name, ctx->nameLen);
+        ctx->originLen = z->originLen;
+        zst = zoneGetLcoreStats(z, ctx->lcore_id);
+        if (zst) zst->nr_queries++;
+        if (unlikely(z->vd != NULL)) dv = fetchViewValue(ctx, z);
+        if (dv == NULL) dv = zoneFetchValueAbs(z, ctx->name, ctx->nameLen);
         if (dv == NULL) {
-            dumpDnsNameErr(ctx);
-            ret = OK_CODE;
+            int rcode = DNS_RCODE_OK, action = NXGUARD_ANSWER;
+            // the empty non-terminals exist(RFC 8020), answer NODATA.
+            if (!zoneIsEmptyNonTerminalAbs(z, ctx->name, ctx->nameLen)) {
+                rcode = DNS_RCODE_NXDOMAIN;
+                if (zst && (++zst->nr_nxdomain % NXGUARD_HINT_EVERY) == 0) {
+                    nxguardLcore *gl = sk.lcore_conf[ctx->lcore_id].nxguard;
+                    if (gl) nxguardHintZone(gl, z);
+                }
+                if (unlikely(z->guard_mode != NXGUARD_OFF)) action = nxguardCheck(z, zst, ctx);
+            }
+            if (action == NXGUARD_DROP_QUERY) {
+                ret = ERR_CODE;
+            } else if (action == NXGUARD_SLIP_RESP) {
+                ret = dumpDnsTruncated(ctx);
+            } else if (dumpDnsNegResp(ctx, z, NULL, rcode) == ERR_CODE) {
+                ret = ERR_CODE;
+            }
         } else {
             if (dumpDnsResp(ctx, dv, z) == ERR_CODE) {
                 ret = ERR_CODE;
@@ -627,9 +980,56 @@ static int _getDnsResponse(char *buf, size_t sz, struct context *ctx)
     return ret;
 }
 
+/*
+ * count the queries by qtype and the responses by rcode, the counters belong to
+ * the current lcore, so they are incremented without atomic operations.
+ */
+static int _getDnsResponse(char *buf, size_t sz, struct context *ctx)
+{
+    lcoreQueryStats *qs = &sk.lcore_conf[ctx->lcore_id].qstats;
+    int ret = __getDnsResponse(buf, sz, ctx);
+
+    if (ret == ERR_CODE) return ret;
+    qs->nr_qtype[ctx->qType < NR_QTYPES? ctx->qType: 0]++;
+    // the transfers are answered by zone transfer thread.
+    if (ret != XFR_CODE) qs->nr_rcode[ctx->chunk[3] & 0xf]++;
+    qs->nr_cookie[ctx->cookie]++;
+    return ret;
+}
+
+/*
+ * the response doesn't fit in the payload size of client(mostly DNSSEC signed answers),
+ * only the header, question and OPT RR are kept with TC bit set, so the client retries
+ * over TCP instead of parsing a partial record.
+ */
+static void truncateUDPResp(struct rte_mbuf *m, char *udp_data, struct context *ctx) {
+    int udp_data_offset = (int)(udp_data - rte_pktmbuf_mtod(m, char*));
+    uint16_t len = (uint16_t)(DNS_HDR_SIZE + ctx->nameLen + 1 + 4);
+    uint16_t nr_ar = 0;
+
+    if (m->next != NULL) {
+        rte_pktmbuf_free(m->next);
+        m->next = NULL;
+        m->nb_segs = 1;
+    }
+    if (ctx->hasEdns) {
+        rte_memcpy(udp_data + len, ctx->opt_rr, ctx->opt_rr_len);
+        len += ctx->opt_rr_len;
+        nr_ar = 1;
+    }
+    // set TC flag
+    *((uint8_t*)(udp_data+2)) |= (uint8_t )0x02;
+    dump16be(0, udp_data+6);
+    dump16be(0, udp_data+8);
+    dump16be(nr_ar, udp_data+10);
+    m->data_len = (uint16_t)(udp_data_offset + len);
+    m->pkt_len = m->data_len;
+}
+
 int processUDPDnsQuery(struct rte_mbuf *m, char *udp_data, size_t udp_data_len,
                        char *src_addr, uint16_t src_port,
-                       bool is_ipv4, lcore_conf_t *qconf)
+                       bool is_ipv4, uint32_t src_view, aclTable *acl, uint32_t acl_rule,
+                       lcore_conf_t *qconf)
 {
     int udp_data_offset = (int)(udp_data - rte_pktmbuf_mtod(m, char*));
     struct context *ctx = &qconf->ctx;
@@ -641,8 +1041,14 @@ int processUDPDnsQuery(struct rte_mbuf *m, char *udp_data, size_t udp_data_len,
     ctx->resp_type = RESP_MBUF;
     ctx->m = m;
     ctx->max_resp_size = 512;
+    ctx->src_addr = src_addr;
+    ctx->src_ipv4 = is_ipv4;
+    ctx->src_view = src_view;
+    ctx->acl = acl;
+    ctx->acl_rule = acl_rule;
     int status;
     status = _getDnsResponse(udp_data, udp_data_len, ctx);
+    if (status != ERR_CODE && qconf->topk) topkRecord(qconf->topk, ctx, src_addr, is_ipv4);
 
     if (status != ERR_CODE && sk.query_log_fp) {
         char cip[IP_STR_LEN];
@@ -657,12 +1063,7 @@ int processUDPDnsQuery(struct rte_mbuf *m, char *udp_data, size_t udp_data_len,
     m->pkt_len += ctx->cur;
 
     unsigned max_pkt_len = (unsigned)(ctx->max_resp_size + udp_data_offset);
-    if (m->pkt_len > max_pkt_len) {
-        // set TC flag
-        *((uint8_t*)(udp_data+2)) |= (uint8_t )0x02;
-
-        rte_pktmbuf_trim(m, (uint16_t)(m->pkt_len - max_pkt_len));
-    }
+    if (m->pkt_len > max_pkt_len) truncateUDPResp(m, udp_data, ctx);
     return status;
 }
 
@@ -672,6 +1073,7 @@ int processTCPDnsQuery(tcpConn *conn, char *buf, size_t sz)
     int status;
     char resp[4096];
     size_t respLen = 4096;
+    char src_addr[16];
 
     struct context *ctx = &qconf->ctx;
     ctx->node = qconf->node;
@@ -681,12 +1083,26 @@ int processTCPDnsQuery(tcpConn *conn, char *buf, size_t sz)
     ctx->cur = 0;
     ctx->resp_type = RESP_STACK;
     ctx->max_resp_size = (uint16_t )sk.max_resp_size;
+    ctx->src_addr = src_addr;
+    ctx->src_ipv4 = inet_pton(AF_INET, conn->cip, src_addr) == 1;
+    if (!ctx->src_ipv4) inet_pton(AF_INET6, conn->cip, src_addr);
+    ctx->src_view = VIEW_HOP_UNKNOWN;
+    ctx->acl = NULL;
+    ctx->acl_rule = ACL_RULE_UNKNOWN;
 
     status = _getDnsResponse(buf, sz, ctx);
+    // the query is dropped(invalid or denied by acl), don't respond.
+    if (status == ERR_CODE) return status;
 
     if (status != ERR_CODE && sk.query_log_fp) {
         logQuery(ctx, conn->cip, conn->cport, true);
     }
+    if (status == XFR_CODE) {
+        // the transfer is streamed by zone transfer thread.
+        if (xfrOutSubmit(conn, buf, sz) == OK_CODE) return XFR_CODE;
+        dumpDnsError(ctx, DNS_RCODE_REFUSED);
+        status = OK_CODE;
+    }
 
     snpack(ctx->chunk, DNS_HDR_SIZE, respLen, "m>hh",
            ctx->name, ctx->nameLen+1, ctx->qType, ctx->qClass);
@@ -705,28 +1121,53 @@ static void updateCachedTime() {
     sk.mstime = mstime();
 }
 
+/*
+ * main thread is a QSBR reader too, it stays offline while it is blocked
+ * in the event loop, so it won't delay the grace periods.
+ */
+static void mainThreadBeforeSleep(struct aeEventLoop *el) {
+    UNUSED(el);
+    rcu_thread_offline();
+}
+
+static void mainThreadAfterSleep(struct aeEventLoop *el) {
+    UNUSED(el);
+    rcu_thread_online();
+}
+
 static int mainThreadCron(struct aeEventLoop *el, long long id, void *clientData) {
     UNUSED3(el, id, clientData);
     zone *z;
     zoneReloadContext *ctx;
 
     updateCachedTime();
+    collectStats();
+    topkCron();
+    nxguardCron();
+    cookieCron();
     if (sk.checkAsyncContext() == ERR_CODE) {
         // we don't care the return value.
         sk.initAsyncContext();
     } else {
-        // reload the oldest zones
-        while((z = getOldestZone()) != NULL) {
-            if (z->refresh_ts > sk.unixtime) break;
-            asyncReloadZoneRaw(z->dotOrigin);
+        if (sk.asyncPollCatalog) {
+            // the catalog tells which zones are changed, no need to check every zone.
+            sk.asyncPollCatalog();
+        } else {
+            // reload the oldest zones
+            while((z = getOldestZone()) != NULL) {
+                if (z->refresh_ts > sk.unixtime) break;
+                asyncReloadZoneRaw(z->dotOrigin);
+            }
         }
         // check if need to do all reload
         if (sk.unixtime - sk.last_all_reload_ts > sk.all_reload_interval) {
             LOG_INFO("start reloading all zone asynchronously.");
             sk.asyncReloadAllZone();
         }
-        while ((ctx = __shiftZoneReloadContext()) != NULL) {
-            sk.asyncReloadZone(ctx);
+        // the remaining tasks wait for the next cron.
+        while (sk.nr_inflight_tasks < sk.max_inflight_reloads &&
+               (ctx = __shiftZoneReloadContext()) != NULL) {
+            zoneReloadContextDispatch(ctx);
         }
     }
 
@@ -796,6 +1237,15 @@ dictType dictTypeCaseStringCopyKey = {
         NULL,                         /* val destructor */
 };
 
+dictType dictTypeStringCopyKeyVal = {
+        _dictStringHash,              /* hash function */
+        _dictStringDup,               /* key dup */
+        _dictStringDup,               /* val dup */
+        _dictStringKeyCompare,        /* key compare */
+        _dictStringDestructor,        /* key destructor */
+        _dictStringDestructor,        /* val destructor */
+};
+
 dictType dictTypeStringCopyKey = {
         _dictStringHash,              /* hash function */
         _dictStringDup,               /* key dup */
@@ -875,17 +1325,29 @@ static void initShuke() {
         sk.syncGetAllZone = &mongoGetAllZone;
         sk.asyncReloadAllZone = &mongoAsyncReloadAllZone;
         sk.asyncReloadZone = &mongoAsyncReloadZone;
+        if (sk.mongo_catalog) sk.asyncPollCatalog = &mongoAsyncPollCatalog;
     } else if (strcasecmp(sk.data_store, "file") == 0) {
         sk.initAsyncContext = &initFileStore;
         sk.checkAsyncContext = &checkFileStore;
         sk.syncGetAllZone = &initialGetAllZoneFromFile;
         sk.asyncReloadAllZone = &getAllZoneFromFile;
         sk.asyncReloadZone = &reloadZoneFromFile;
+    } else if (strcasecmp(sk.data_store, "xfr") == 0) {
+        sk.initAsyncContext = &initXfrStore;
+        sk.checkAsyncContext = &checkXfrStore;
+        sk.syncGetAllZone = &xfrGetAllZone;
+        sk.asyncReloadAllZone = &xfrReloadAllZone;
+        sk.asyncReloadZone = &xfrReloadZone;
     } else {
         LOG_EXIT("invalid data store config %s", sk.data_store);
     }
 
     sk.rbroot = RB_ROOT;
+    sk.reclaim_crdp = create_call_rcu_data(0, -1);
+    if (sk.reclaim_crdp == NULL) {
+        LOG_EXIT("can't create call_rcu worker.");
+    }
+    set_thread_call_rcu_data(sk.reclaim_crdp);
     // create zoneDict for all numa nodes
     for (int i = 0; i < sk.nr_numa_id; ++i) {
         int numa_id = sk.numa_ids[i];
@@ -902,19 +1364,58 @@ static void initShuke() {
     LOG_INFO("loading all zone from %s to memory cost %lld milliseconds.", sk.data_store, sk.zone_load_time);
     sk.last_all_reload_ts = sk.unixtime;
 
+    if (loadViews(sk.errstr) == ERR_CODE) {
+        LOG_EXIT("can't load views: %s", sk.errstr);
+    }
+    if (loadAcl(sk.errstr) == ERR_CODE) {
+        LOG_EXIT("can't load acl: %s", sk.errstr);
+    }
+    if (initCookie(sk.errstr) == ERR_CODE) {
+        LOG_EXIT("can't init cookies: %s", sk.errstr);
+    }
+
     if (sk.initAsyncContext() == ERR_CODE) {
         LOG_EXIT("init %s async context error.", sk.data_store);
     }
+    // the journal is recorded by reload worker, so start it first.
+    if (sk.nr_xfr_out_allow > 0 && !sk.only_udp && initXfrOut() == ERR_CODE) {
+        LOG_EXIT("can't start zone transfer thread.");
+    }
+    if (initReloader() == ERR_CODE) {
+        LOG_EXIT("can't start reload worker.");
+    }
+    if (strcasecmp(sk.data_store, "file") == 0 && sk.zone_files_watch) {
+        if (initZoneWatcher() == ERR_CODE) {
+            LOG_EXIT("can't watch zone files.");
+        }
+    }
+    if (sk.nr_notify_sources > 0 && initNotify() == ERR_CODE) {
+        LOG_EXIT("can't init NOTIFY handler.");
+    }
+    if (sk.top_window > 0 && initTopk() == ERR_CODE) {
+        LOG_EXIT("can't init heavy hitter tables.");
+    }
+    if (sk.nxguard_threshold > 0 && initNxguard() == ERR_CODE) {
+        LOG_EXIT("can't init nxguard.");
+    }
     // process task queue
     if (aeCreateTimeEvent(sk.el, TIME_INTERVAL, mainThreadCron, NULL, NULL) == AE_ERR) {
         LOG_EXIT("Can't create time event proc");
     }
+    aeSetBeforeSleepProc(sk.el, mainThreadBeforeSleep);
+    aeSetAfterSleepProc(sk.el, mainThreadAfterSleep);
 
     // run admin server
     LOG_INFO("starting admin server on %s:%d", sk.admin_host, sk.admin_port);
     if (initAdminServer() == ERR_CODE) {
         LOG_EXIT("can't init admin server.");
     }
+    if (sk.metrics_port > 0) {
+        LOG_INFO("starting metrics endpoint on %s:%d", sk.admin_host, sk.metrics_port);
+        if (initMetricsServer() == ERR_CODE) {
+            LOG_EXIT("can't init metrics endpoint.");
+        }
+    }
 }
 
 static int construct_lcore_list() {
@@ -1266,6 +1767,18 @@ int main(int argc, char *argv[]) {
         if (!strcasecmp(argv[2], "zparser")) {
             return zoneParserTest(argc, argv);
         }
+        if (!strcasecmp(argv[2], "ztokenizer")) {
+            return zoneTokenizerBenchmark(argc, argv);
+        }
+        if (!strcasecmp(argv[2], "topk")) {
+            return topkBenchmark(argc, argv);
+        }
+        if (!strcasecmp(argv[2], "nxguard")) {
+            return nxguardTest(argc, argv);
+        }
+        if (!strcasecmp(argv[2], "cookie")) {
+            return cookieTest(argc, argv);
+        }
         return -1;  /* test not found */
     }
 #endif
@@ -28,12 +28,16 @@
 #include "dpdk_module.h"
 #include "zparser.h"
 #include "zone.h"
+#include "view.h"
+#include "acl.h"
 #include "sk_lua.h"
 
 #include "himongo/async.h"
 
 #define CONFIG_BINDADDR_MAX 16
+#define CONFIG_VDEV_MAX 8
 #define TIME_INTERVAL 1000
+#define MONGO_MAX_CONNS 16
 
 #define CONN_READ_N     0     /**< reading in a fixed number of bytes */
 #define CONN_READ_LEN   1     /**< reading length bytes */
@@ -69,6 +73,12 @@ typedef struct numaNode_s {
     int min_lcore_id;
     int max_lcore_id;
     ltree *lt;
+    // the lpm tables of views, NULL if no views file is configured.
+    viewTable *vt;
+    // the rte_acl contexts of access control, NULL if no acl file is configured.
+    aclTable *acl;
+    // the secrets of DNS cookies, NULL if cookies are disabled.
+    cookieSecret *cookie;
 } numaNode_t;
 
 typedef struct _tcpServer {
@@ -131,14 +141,63 @@ typedef struct _zoneReloadContext {
     zone *new_zn;
     bool zone_exist;
 
+    // used by reload worker.
+    // the zone file to parse, NULL if new_zn is already built(e.g. mongo)
+    char *fname;
+    // the function building new_zn(e.g. zone transfer), it may build numa_zones too.
+    int (*build)(struct _zoneReloadContext *ctx);
+    // the stamp of zone file in cache, updated by reload worker if the file is unchanged.
+    zoneFileStamp stamp;
+    // set by reload worker if the file is unchanged, then new_zn is NULL.
+    bool unchanged;
+    // the copies of new_zn, indexed by numa id
+    zone *numa_zones[MAX_NUMA_NODES];
+    int err;
+    long long submit_us;
+    long long start_us;
+    long long end_us;
+
+    // used by reload scheduler.
+    // admin reloads are urgent, they are dispatched before the periodical refreshes.
+    bool urgent;
+    // true between dispatching and finishing, counted by sk.nr_inflight_tasks
+    bool inflight;
+    // the mongo connection serving this context, -1 if none
+    int conn_id;
+    // the caller already knows the zone is changed(e.g. zone catalog), skip checking serial.
+    bool sn_checked;
+    long long create_us;
+    long long dispatch_us;
+
     struct _zoneReloadContext *next;
 }zoneReloadContext;
 
+// an IPv4 or IPv6 address prefix, like 10.0.0.0/8
+typedef struct {
+    int af;
+    int prefix;
+    uint8_t addr[16];
+} addrPrefix;
+
 typedef struct {
     zoneReloadContext *head;
     zoneReloadContext *tail;
 } zoneReloadContextList;
 
+typedef struct {
+    uint64_t nr_dispatched;
+    uint64_t nr_finished;
+    uint64_t nr_urgent;
+    // the reloads finding the zone unchanged
+    uint64_t nr_unchanged;
+    // time between creating and dispatching(microseconds)
+    long long wait_us_total;
+    long long wait_us_max;
+    // time between creating and finishing(microseconds)
+    long long latency_us_total;
+    long long latency_us_max;
+} reloadSchedStats;
+
 struct shuke {
     char errstr[ERR_STR_LEN];
 
@@ -153,6 +212,10 @@ struct shuke {
     bool jumbo_on;
     int max_pkt_len;
     char *queue_config;
+    // virtual devices passed to EAL(--vdev), such as "net_af_packet0,iface=veth1"
+    char *vdevs[CONFIG_VDEV_MAX];
+    int nr_vdevs;
+    bool no_pci;
 
     char *bindaddr[CONFIG_BINDADDR_MAX];
     int bindaddr_count;
@@ -174,19 +237,85 @@ struct shuke {
 
     char *zone_files_root;
     dict *zone_files_dict;
+    // watch the zone files by inotify
+    bool zone_files_watch;
+    // milliseconds to wait for more changes before reloading a changed zone
+    int zone_files_debounce;
+    // register all the files in zone_files_root with zone_files_suffix
+    bool zone_files_scan;
+    char *zone_files_suffix;
+
+    // zone transfer(secondary mode)
+    char *xfr_primary;
+    int xfr_port;
+    dict *xfr_zones;
+    bool xfr_ixfr;
+    // seconds
+    int xfr_timeout;
+
+    // zone transfer server, disabled if xfr_out_allow is empty.
+    addrPrefix *xfr_out_allow;
+    int nr_xfr_out_allow;
+    int xfr_out_max_transfers;
+    // KB per second of every transfer, 0 means no limit
+    int xfr_out_rate_limit;
+    // seconds
+    int xfr_out_timeout;
+    // max bytes of IXFR journal of every zone, 0 disables IXFR(AXFR is sent instead)
+    long xfr_out_journal_size;
 
     char *mongo_host;
     int mongo_port;
     char *mongo_dbname;
+    int mongo_conns;
+    // the collection contains the serial of every zone, NULL if disabled.
+    char *mongo_catalog;
+    int catalog_interval;
 
     long retry_interval;
+    // max number of zone reload tasks dispatched but not finished
+    int max_inflight_reloads;
+    // percent of zone's refresh added randomly to refresh_ts
+    int refresh_jitter;
+    // the addresses allowed to send NOTIFY, NOTIFY is disabled if empty.
+    addrPrefix *notify_sources;
+    int nr_notify_sources;
 
     char *admin_host;
     int admin_port;
+    // port of prometheus metrics endpoint(bind to admin_host), 0 means disabled.
+    int metrics_port;
+    // the counts of heavy hitters are halved every top_window seconds, 0 means disabled.
+    int top_window;
+    // maps address prefixes to GeoDNS views, views are disabled if NULL.
+    char *views_file;
+    // access control rules, checked before the queries are parsed, disabled if NULL.
+    char *acl_file;
+
+    // [cookie] DNS cookies(RFC 7873)
+    bool cookie_enabled;
+    // 32 hex digits shared by the servers of an anycast group, random if empty.
+    char *cookie_secret;
+    // seconds between the rotations of the random secret, 0 means never.
+    int cookie_rotate;
+
+    // [nxguard] random subdomain guard, disabled if the threshold is 0.
+    // NXDOMAIN per second of a zone to start mitigating.
+    int nxguard_threshold;
+    char *nxguard_mode_str;
+    int nxguard_mode;
+    // bits per char, the labels of higher entropy are dropped in drop mode.
+    double nxguard_min_entropy;
+    // NXDOMAIN per second per lcore answered in budget mode.
+    int nxguard_budget;
+    // seconds the rate must stay below threshold/2 to stop mitigating.
+    int nxguard_hold;
 
     int all_reload_interval;
     int max_resp_size;
     bool minimize_resp;
+    // microseconds an lcore sleeps after IDLE_BACKOFF_POLLS empty polls, 0 means busy polling.
+    int idle_backoff_us;
 
     struct lua_conf lconf;
     // end config
@@ -218,6 +347,8 @@ struct shuke {
     // pointer to master numa node's zoneDict instance
     ltree *lt;
     struct rb_root rbroot;
+    // dedicated call_rcu worker of main thread, reclaims the replaced zones in batches.
+    struct call_rcu_data *reclaim_crdp;
 
     volatile bool force_quit;
     FILE *query_log_fp;
@@ -242,12 +373,22 @@ struct shuke {
      */
     int (*asyncReloadAllZone)(void);
     int (*asyncReloadZone)(zoneReloadContext *t);
+    /*
+     * optional, if it is set, mainThreadCron calls it instead of reloading
+     * the zones whose refresh_ts is expired one by one.
+     */
+    int (*asyncPollCatalog)(void);
 
     // pending zone reload task
     zoneReloadContextList tasks;
-    // mongo context
-    // it will be NULL when shuke is disconnected with mongodb
-    mongoAsyncContext *mongo_ctx;
+    int nr_pending_tasks;
+    int nr_inflight_tasks;
+    reloadSchedStats sched_stats;
+    // mongo connection pool
+    // a slot will be NULL when the connection is disconnected with mongodb
+    mongoAsyncContext *mongo_ctxs[MONGO_MAX_CONNS];
+    // number of reload tasks using the connection
+    int mongo_conn_load[MONGO_MAX_CONNS];
     long last_retry_ts;
 
     // admin server
@@ -277,6 +418,19 @@ struct shuke {
     int64_t nr_req;                   // number of processed requests
     int64_t nr_dropped;
     long long last_collect_ms;
+    // rates over the last collect interval
+    uint64_t qps;
+    uint64_t dropped_qps;
+    // the sum of all lcores(including the tcp server)
+    int64_t nr_qtype[NR_QTYPES];
+    int64_t nr_rcode[NR_RCODES];
+    // advanced every top_window seconds, the lcores decay their heavy hitter tables lazily.
+    volatile long top_epoch;
+    // advanced every second while nxguard is enabled, the budgets of lcores are reset lazily.
+    volatile long nxguard_epoch;
+    // the zones hinted by lcores and their NXDOMAIN rates, only accessed by main thread.
+    dict *nxguard_zones;
+    uint64_t nxguard_events;
 
     uint64_t num_tcp_conn;
     uint64_t total_tcp_conn;
@@ -290,6 +444,7 @@ extern struct shuke sk;
 extern dictType dictTypeCaseStringCopyKey;
 extern dictType dictTypeCaseStringCopyKeyVal;
 extern dictType dictTypeStringCopyKey;
+extern dictType dictTypeStringCopyKeyVal;
 
 int snpack(char *buf, int offset, size_t size, char const *fmt, ...);
 /*----------------------------------------------
@@ -300,7 +455,11 @@ void zoneReloadContextReset(zoneReloadContext *t);
 void zoneReloadContextDestroy(zoneReloadContext *t);
 
 int asyncReloadZoneRaw(char *dotOrigin);
+int asyncReloadZoneUrgent(char *dotOrigin);
+int asyncReloadZoneNotified(char *dotOrigin, bool *coalesced);
+int asyncReloadChangedZone(char *dotOrigin);
 int asyncRereloadZone(zoneReloadContext *ctx);
+void finishUnchangedZone(zoneReloadContext *t);
 int triggerReloadAllZone();
 /*----------------------------------------------
  *     admin server
@@ -308,34 +467,223 @@ int triggerReloadAllZone();
 int initAdminServer(void);
 void releaseAdminServer(void);
 
+/*----------------------------------------------
+ *     heavy hitters
+ *---------------------------------------------*/
+enum topkKind {
+    TOPK_NAME = 0,
+    TOPK_CLIENT,
+    TOPK_ZONE,
+    TOPK_NR_KINDS,
+};
+
+int initTopk(void);
+void topkRecord(topkLcore *tl, struct context *ctx, const char *src_addr, bool is_ipv4);
+void topkCron(void);
+int topkKindFromStr(const char *ss);
+sds topkToStr(int kind, int n);
+#if defined(SK_TEST)
+int topkBenchmark(int argc, char *argv[]);
+#endif
+
+/*----------------------------------------------
+ *     random subdomain guard
+ *---------------------------------------------*/
+enum nxguardMode {
+    NXGUARD_OFF = 0,
+    NXGUARD_SLIP,
+    NXGUARD_DROP,
+    NXGUARD_BUDGET,
+};
+
+enum nxguardAction {
+    NXGUARD_ANSWER = 0,
+    NXGUARD_SLIP_RESP,
+    NXGUARD_DROP_QUERY,
+};
+
+// an lcore hints the zone to main thread every NXGUARD_HINT_EVERY NXDOMAINs.
+#define NXGUARD_HINT_EVERY  256
+
+int initNxguard(void);
+void nxguardHintZone(nxguardLcore *gl, zone *z);
+int nxguardCheck(zone *z, zoneLcoreStats *zst, struct context *ctx);
+void nxguardCron(void);
+int nxguardModeFromStr(const char *ss);
+sds nxguardToStr(sds s);
+#if defined(SK_TEST)
+int nxguardTest(int argc, char *argv[]);
+#endif
+
+/*----------------------------------------------
+ *     metrics endpoint
+ *---------------------------------------------*/
+int initMetricsServer(void);
+sds genMetrics(void);
+
+/*----------------------------------------------
+ *     reload worker
+ *---------------------------------------------*/
+typedef struct _reloaderStats {
+    size_t nr_pending;
+    size_t nr_running;
+    uint64_t nr_done;
+    uint64_t nr_failed;
+    // the zone files found unchanged by content
+    uint64_t nr_unchanged;
+    // time spent in worker(microseconds)
+    long long build_us_total;
+    long long build_us_max;
+    long long build_us_last;
+    // time between submitting and publishing(microseconds)
+    long long latency_us_total;
+    long long latency_us_max;
+    char max_zone[MAX_DOMAIN_LEN+2];
+} reloaderStats;
+
+int initReloader(void);
+int reloaderSubmit(zoneReloadContext *ctx);
+void reloaderGetStats(reloaderStats *stats);
+
+/*----------------------------------------------
+ *     zone file watcher
+ *---------------------------------------------*/
+typedef struct _zoneWatcherStats {
+    int nr_dirs;
+    size_t nr_files;
+    size_t nr_pending;
+    uint64_t nr_events;
+    uint64_t nr_reloads;
+    uint64_t nr_new_files;
+    uint64_t nr_overflows;
+} zoneWatcherStats;
+
+int initZoneWatcher(void);
+int registerZoneFile(char *dotOrigin, char *fname);
+void unregisterZoneFile(char *dotOrigin);
+int scanZoneFilesRoot(bool runtime);
+void zoneWatcherGetStats(zoneWatcherStats *stats);
+
+/*----------------------------------------------
+ *     zone transfer client
+ *---------------------------------------------*/
+typedef struct _xfrinStats {
+    uint64_t nr_soa_queries;
+    uint64_t nr_axfr;
+    uint64_t nr_ixfr;
+    // the IXFRs failed and retried by AXFR
+    uint64_t nr_ixfr_fallback;
+    uint64_t nr_up_to_date;
+    uint64_t nr_failed;
+    // the RRs deleted or added by IXFR
+    uint64_t nr_changes;
+    uint64_t nr_bytes;
+} xfrinStats;
+
+int initXfrStore(void);
+int checkXfrStore(void);
+int xfrGetAllZone(void);
+int xfrReloadAllZone(void);
+int xfrReloadZone(zoneReloadContext *t);
+void xfrinGetStats(xfrinStats *stats);
+
+/*----------------------------------------------
+ *     zone transfer server
+ *---------------------------------------------*/
+// returned when the tcp connection is handed over to the zone transfer thread
+#define XFR_CODE    1
+
+typedef struct _xfrOutStats {
+    uint64_t nr_axfr;
+    uint64_t nr_ixfr;
+    // the IXFRs answered with the full zone because the journal doesn't cover the serial
+    uint64_t nr_ixfr_fallback;
+    uint64_t nr_up_to_date;
+    // the clients not allowed
+    uint64_t nr_refused;
+    // refused because of the limit of concurrent transfers
+    uint64_t nr_busy;
+    uint64_t nr_failed;
+    uint64_t nr_bytes;
+    size_t nr_active;
+    size_t journal_entries;
+    size_t journal_bytes;
+} xfrOutStats;
+
+int initXfrOut(void);
+int processXfrQuery(struct context *ctx);
+int xfrOutSubmit(tcpConn *conn, char *query, size_t len);
+void xfrJournalRecord(zone *new_z);
+void xfrJournalDrop(char *origin);
+void xfrOutGetStats(xfrOutStats *stats);
+
+/*----------------------------------------------
+ *     notify
+ *---------------------------------------------*/
+typedef struct _notifyStats {
+    uint64_t nr_received;
+    // the NOTIFY for a zone already waiting for reload
+    uint64_t nr_coalesced;
+    uint64_t nr_refused;
+    // the NOTIFY dropped because the pipe is full
+    uint64_t nr_dropped;
+    size_t nr_pending;
+} notifyStats;
+
+int initNotify(void);
+int processNotify(struct context *ctx);
+int parseAddrPrefix(const char *ss, addrPrefix *p);
+bool addrPrefixMatch(addrPrefix *p, const void *addr, bool is_ipv4);
+void notifyGetStats(notifyStats *stats);
+
 /*----------------------------------------------
  *     tcp server
  *---------------------------------------------*/
 tcpServer *tcpServerCreate();
 int tcpServerCron(struct aeEventLoop *el, long long id, void *clientData);
 void tcpConnAppendDnsResponse(tcpConn *conn, char *resp, size_t respLen);
+int tcpConnDetach(tcpConn *conn, sds *pending);
 
 /*----------------------------------------------
  *     mongo
  *---------------------------------------------*/
 int initMongo(void);
 int checkMongo(void);
+int mongoConnectedCount(void);
 int mongoGetAllZone(void);
 int mongoAsyncReloadZone(zoneReloadContext *t);
 int mongoAsyncReloadAllZone(void);
 
+typedef struct _mongoCatalogStats {
+    uint64_t nr_polls;
+    uint64_t nr_failed;
+    // the result of last poll
+    size_t nr_zones;
+    size_t nr_changed;
+    size_t nr_new;
+    size_t nr_removed;
+    long last_poll_ts;
+    long long poll_us;
+} mongoCatalogStats;
+
+int mongoAsyncPollCatalog(void);
+void mongoGetCatalogStats(mongoCatalogStats *stats);
+
 int processUDPDnsQuery(struct rte_mbuf *m, char *udp_data, size_t udp_data_len,
                        char *src_addr, uint16_t src_port,
-                       bool is_ipv4, lcore_conf_t *qconf);
+                       bool is_ipv4, uint32_t src_view, aclTable *acl, uint32_t acl_rule,
+                       lcore_conf_t *qconf);
 
 int processTCPDnsQuery(tcpConn *conn, char *buf, size_t sz);
 
 void addZoneOtherNuma(zone *z);
 void deleteZoneOtherNuma(char *origin);
-void replaceZoneOtherNuma(zone *z);
 
 int replaceZoneAllNumaNodes(zone *z);
 int addZoneAllNumaNodes(zone *z);
+void prepareZoneAllNumaNodes(zone *z, zone **numa_zones);
+int publishZoneAllNumaNodes(zone *z, zone **numa_zones);
+void reserveZoneTree(char **names, size_t n);
 int deleteZoneAllNumaNodes(char *origin);
 void masterRefreshZone(char *origin);
 
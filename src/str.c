@@ -253,6 +253,142 @@ bool str2ipv6(const char *src, void *dst) {
     return inet_pton(AF_INET6, src, dst) == 1;
 }
 
+static int hexval(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/*!
+ * convert hex string to binary
+ * @param hex: hex string, doesn't need to be null terminated
+ * @param len: the length of hex string, must be even
+ * @param dst: the buffer should have at least len/2 bytes
+ * @return the number of bytes stored in dst, -1 if hex string is invalid.
+ */
+int hex2bin(const char *hex, size_t len, char *dst) {
+    if (len % 2 != 0) return -1;
+    for (size_t i = 0; i < len; i += 2) {
+        int hi = hexval(hex[i]);
+        int lo = hexval(hex[i+1]);
+        if (hi < 0 || lo < 0) return -1;
+        *dst++ = (char)((hi << 4) | lo);
+    }
+    return (int)(len / 2);
+}
+
+static int base64val(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+/*!
+ * convert base64 string(RFC 4648) to binary, the padding is optional.
+ * @param src: base64 string, doesn't need to be null terminated
+ * @param dst: the buffer should have at least len*3/4 bytes
+ * @return the number of bytes stored in dst, -1 if base64 string is invalid.
+ */
+int base64ToBin(const char *src, size_t len, char *dst) {
+    char *start = dst;
+    uint32_t acc = 0;
+    int bits = 0, v;
+
+    while (len > 0 && src[len-1] == '=') len--;
+    for (size_t i = 0; i < len; ++i) {
+        if ((v = base64val(src[i])) < 0) return -1;
+        acc = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            *dst++ = (char)(acc >> bits);
+        }
+    }
+    // the remain bits must be padding
+    if (bits >= 6 || (acc & ((1U << bits) - 1)) != 0) return -1;
+    return (int)(dst - start);
+}
+
+/*!
+ * convert binary to base64 string with padding.
+ * @param dst: the buffer should have at least (len+2)/3*4+1 bytes, it is null terminated.
+ * @return the length of base64 string.
+ */
+int binToBase64(const char *src, size_t len, char *dst) {
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const uint8_t *p = (const uint8_t *)src;
+    char *start = dst;
+
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)p[i] << 16;
+        if (i + 1 < len) v |= (uint32_t)p[i+1] << 8;
+        if (i + 2 < len) v |= p[i+2];
+        *dst++ = table[(v >> 18) & 0x3f];
+        *dst++ = table[(v >> 12) & 0x3f];
+        *dst++ = i + 1 < len? table[(v >> 6) & 0x3f]: '=';
+        *dst++ = i + 2 < len? table[v & 0x3f]: '=';
+    }
+    *dst = 0;
+    return (int)(dst - start);
+}
+
+/*!
+ * convert base32hex string(RFC 4648, used by NSEC3) to binary, the padding is not allowed.
+ * @param src: case insensitive base32hex string, doesn't need to be null terminated
+ * @param dst: the buffer should have at least len*5/8 bytes
+ * @return the number of bytes stored in dst, -1 if the string is invalid.
+ */
+int base32hexToBin(const char *src, size_t len, char *dst) {
+    char *start = dst;
+    uint64_t acc = 0;
+    int bits = 0, v;
+
+    for (size_t i = 0; i < len; ++i) {
+        char c = src[i];
+        if (c >= '0' && c <= '9') v = c - '0';
+        else if (c >= 'a' && c <= 'v') v = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'V') v = c - 'A' + 10;
+        else return -1;
+        acc = (acc << 5) | (uint64_t)v;
+        bits += 5;
+        if (bits >= 8) {
+            bits -= 8;
+            *dst++ = (char)(acc >> bits);
+        }
+    }
+    if (bits >= 5 || (acc & ((1U << bits) - 1)) != 0) return -1;
+    return (int)(dst - start);
+}
+
+/*!
+ * convert binary to lower case base32hex string without padding.
+ * @param dst: the buffer should have at least (len*8+4)/5+1 bytes, it is null terminated.
+ * @return the length of base32hex string.
+ */
+int binToBase32hex(const char *src, size_t len, char *dst) {
+    static const char table[] = "0123456789abcdefghijklmnopqrstuv";
+    const uint8_t *p = (const uint8_t *)src;
+    char *start = dst;
+    uint32_t acc = 0;
+    int bits = 0;
+
+    for (size_t i = 0; i < len; ++i) {
+        acc = (acc << 8) | p[i];
+        bits += 8;
+        while (bits >= 5) {
+            bits -= 5;
+            *dst++ = table[(acc >> bits) & 0x1f];
+        }
+    }
+    if (bits > 0) *dst++ = table[(acc << (5 - bits)) & 0x1f];
+    *dst = 0;
+    return (int)(dst - start);
+}
+
 int dot2lenlabel(char *human, char *label) {
     char *dest = label;
     if (dest == NULL) dest = human;
@@ -29,6 +29,11 @@ int tokenize(char *str, char **ret, int *n, char *seps);
 
 bool str2ipv4(const char *src, void *dst);
 bool str2ipv6(const char *src, void *dst);
+int hex2bin(const char *hex, size_t len, char *dst);
+int base64ToBin(const char *src, size_t len, char *dst);
+int binToBase64(const char *src, size_t len, char *dst);
+int base32hexToBin(const char *src, size_t len, char *dst);
+int binToBase32hex(const char *src, size_t len, char *dst);
 
 int dot2lenlabel(char *human, char *label);
 int len2dotlabel(char *label, char *human);
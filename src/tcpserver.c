@@ -111,6 +111,29 @@ void tcpConnDestroy(tcpConn *conn) {
     --sk.num_tcp_conn;
 }
 
+/*!
+ * remove the connection from tcp server without closing the socket(e.g. zone transfer),
+ * the replies not written yet are appended to pending, the connection is released.
+ *
+ * @return the socket of connection
+ */
+int tcpConnDetach(tcpConn *conn, sds *pending) {
+    int fd = conn->fd;
+
+    while(conn->whead) {
+        struct tcpContext *ctx = conn->whead;
+        conn->whead = ctx->next;
+        *pending = sdscatlen(*pending, ctx->reply + ctx->wcur, ctx->wsize - ctx->wcur);
+        tcpContextDestroy(ctx);
+    }
+    aeDeleteFileEvent(conn->el, fd, AE_READABLE|AE_WRITABLE);
+    list_del(&(conn->node));
+    if (conn->data != conn->buf) zfree(conn->data);
+    zfree(conn);
+    --sk.num_tcp_conn;
+    return fd;
+}
+
 // reset tcp connection's status and prepare to read next dns packet.
 void tcpConnReset(tcpConn *c) {
     if (c->data != c->buf) {
@@ -241,7 +264,10 @@ static void tcpReadHandler(struct aeEventLoop *el, int fd,
                 conn->nRead += n;
                 totalread += n;
                 if (conn->nRead == conn->dnsPacketSize) {
-                    processTCPDnsQuery(conn, conn->data, conn->dnsPacketSize);
+                    if (processTCPDnsQuery(conn, conn->data, conn->dnsPacketSize) == XFR_CODE) {
+                        // the connection is released, it is owned by zone transfer thread now.
+                        goto end;
+                    }
                     if (sk.force_quit) {
                         goto closing;
                     }
@@ -0,0 +1,361 @@
+//
+// heavy hitters(top names, client prefixes and zones)
+//
+// every lcore has fixed size tables, one for each kind of key, updated by
+// processUDPDnsQuery without locks or atomic operations. a table is a hashed
+// Misra-Gries summary with one counter per bucket: the key in the bucket is
+// incremented, a different key decrements it and takes over the bucket when
+// the counter drops to zero, so the keys dominating the traffic stay in the
+// table while the rare ones are evicted.
+//
+// the counts are halved every `top_window` seconds, the lcore does it lazily
+// when it sees the epoch advanced by main thread. admin `top` command merges
+// the tables of all lcores, the buckets being replaced are skipped by checking
+// their version(odd while the key is written).
+//
+
+#include "shuke.h"
+#include "utils.h"
+
+DEF_LOG_MODULE(RTE_LOGTYPE_USER1, "TOPK");
+
+#define TOPK_NAME_BUCKETS   1024
+#define TOPK_CLIENT_BUCKETS 1024
+#define TOPK_ZONE_BUCKETS   256
+
+typedef struct {
+    uint64_t key;       // hash of name or the client prefix, 0 means empty
+    uint32_t count;
+    uint32_t version;   // odd while key(and name) is being replaced
+} topkBucket;
+
+typedef struct {
+    topkBucket *buckets;
+    // the names of buckets(len label), NULL for client prefixes
+    char (*names)[MAX_DOMAIN_LEN+2];
+    uint32_t mask;
+} topkTable;
+
+struct topkLcore_s {
+    topkTable tables[TOPK_NR_KINDS];
+    long epoch;
+};
+
+static const char *kindNames[TOPK_NR_KINDS] = {"names", "clients", "zones"};
+
+/*
+ * case insensitive hash of a len label name, 8 bytes a time.
+ * the bit 0x20 is set for every byte, so the upper case letters are folded,
+ * some other bytes are folded too, it is harmless for a hash.
+ */
+static inline uint64_t topkHashName(const char *name, size_t len) {
+    uint64_t h = len * 0x9E3779B97F4A7C15ULL;
+    uint64_t v;
+
+    while (len >= 8) {
+        memcpy(&v, name, 8);
+        h = (h ^ (v | 0x2020202020202020ULL)) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+        name += 8;
+        len -= 8;
+    }
+    if (len > 0) {
+        v = 0;
+        memcpy(&v, name, len);
+        h = (h ^ (v | 0x2020202020202020ULL)) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+    return h? h: 1;
+}
+
+/*
+ * the client prefix(/24 of ipv4, /48 of ipv6) is the key itself.
+ */
+static inline uint64_t topkClientKey(const char *addr, bool is_ipv4) {
+    const uint8_t *a = (const uint8_t *)addr;
+    if (is_ipv4) {
+        return (1ULL << 63) | ((uint64_t)a[0] << 16) | ((uint64_t)a[1] << 8) | a[2];
+    }
+    return (1ULL << 62) | ((uint64_t)a[0] << 40) | ((uint64_t)a[1] << 32) | ((uint64_t)a[2] << 24) |
+           ((uint64_t)a[3] << 16) | ((uint64_t)a[4] << 8) | a[5];
+}
+
+static inline topkBucket *topkBucketOf(topkTable *t, uint64_t key) {
+    return &t->buckets[(key * 0x9E3779B97F4A7C15ULL >> 32) & t->mask];
+}
+
+static inline void topkTableUpdate(topkTable *t, uint64_t key, const char *name, size_t len) {
+    topkBucket *b = topkBucketOf(t, key);
+
+    if (likely(b->key == key)) {
+        b->count++;
+        return;
+    }
+    if (b->count > 0) {
+        b->count--;
+        return;
+    }
+    b->version++;
+    rte_smp_wmb();
+    b->key = key;
+    if (t->names) {
+        char *dst = t->names[b - t->buckets];
+        memcpy(dst, name, len);
+        dst[len] = 0;
+    }
+    b->count = 1;
+    rte_smp_wmb();
+    b->version++;
+}
+
+static void topkTableDecay(topkTable *t, long shift) {
+    for (uint32_t i = 0; i <= t->mask; ++i) {
+        t->buckets[i].count = shift >= 32? 0: t->buckets[i].count >> shift;
+    }
+}
+
+static int topkTableInit(topkTable *t, uint32_t nr_buckets, bool with_names, int socket_id) {
+    t->mask = nr_buckets - 1;
+    t->buckets = socket_calloc(socket_id, nr_buckets, sizeof(topkBucket));
+    if (t->buckets == NULL) return ERR_CODE;
+    if (with_names) {
+        t->names = socket_calloc(socket_id, nr_buckets, sizeof(*t->names));
+        if (t->names == NULL) return ERR_CODE;
+    }
+    return OK_CODE;
+}
+
+static topkLcore *topkLcoreCreate(int socket_id) {
+    topkLcore *tl = socket_calloc(socket_id, 1, sizeof(*tl));
+    if (tl == NULL ||
+        topkTableInit(&tl->tables[TOPK_NAME], TOPK_NAME_BUCKETS, true, socket_id) == ERR_CODE ||
+        topkTableInit(&tl->tables[TOPK_CLIENT], TOPK_CLIENT_BUCKETS, false, socket_id) == ERR_CODE ||
+        topkTableInit(&tl->tables[TOPK_ZONE], TOPK_ZONE_BUCKETS, true, socket_id) == ERR_CODE) {
+        return NULL;
+    }
+    tl->epoch = sk.top_epoch;
+    return tl;
+}
+
+/*!
+ * record a query, called by lcores after the response is built.
+ *
+ * @param tl: the tables of current lcore
+ * @param ctx: ctx->z is not NULL if the name belongs to a zone, the origin is the
+ *             last ctx->originLen bytes of name(the zone itself may be freed).
+ */
+void topkRecord(topkLcore *tl, struct context *ctx, const char *src_addr, bool is_ipv4) {
+    long epoch = sk.top_epoch;
+
+    if (unlikely(tl->epoch != epoch)) {
+        for (int i = 0; i < TOPK_NR_KINDS; ++i) topkTableDecay(&tl->tables[i], epoch - tl->epoch);
+        tl->epoch = epoch;
+    }
+    topkTableUpdate(&tl->tables[TOPK_NAME], topkHashName(ctx->name, ctx->nameLen),
+                    ctx->name, ctx->nameLen);
+    topkTableUpdate(&tl->tables[TOPK_CLIENT], topkClientKey(src_addr, is_ipv4), NULL, 0);
+    if (ctx->z != NULL) {
+        const char *origin = ctx->name + ctx->nameLen - ctx->originLen;
+        topkTableUpdate(&tl->tables[TOPK_ZONE], topkHashName(origin, ctx->originLen),
+                        origin, ctx->originLen);
+    }
+}
+
+/*!
+ * advance the epoch every `top_window` seconds, called by main thread cron.
+ */
+void topkCron(void) {
+    static long last_ts = 0;
+
+    if (sk.top_window <= 0) return;
+    if (last_ts == 0) last_ts = sk.unixtime;
+    if (sk.unixtime - last_ts >= sk.top_window) {
+        sk.top_epoch++;
+        last_ts = sk.unixtime;
+    }
+}
+
+typedef struct {
+    uint64_t key;
+    uint64_t count;
+    char name[MAX_DOMAIN_LEN+2];
+} topkEntry;
+
+static int cmpEntryKey(const void *a, const void *b) {
+    uint64_t ka = ((const topkEntry *)a)->key, kb = ((const topkEntry *)b)->key;
+    return ka < kb? -1: (ka > kb);
+}
+
+static int cmpEntryCount(const void *a, const void *b) {
+    uint64_t ca = ((const topkEntry *)a)->count, cb = ((const topkEntry *)b)->count;
+    return ca > cb? -1: (ca < cb);
+}
+
+static void clientKeyToStr(uint64_t key, char *buf, size_t size) {
+    if (key & (1ULL << 63)) {
+        snprintf(buf, size, "%u.%u.%u.0/24", (unsigned)(key >> 16) & 0xff,
+                 (unsigned)(key >> 8) & 0xff, (unsigned)key & 0xff);
+    } else {
+        snprintf(buf, size, "%x:%x:%x::/48", (unsigned)(key >> 32) & 0xffff,
+                 (unsigned)(key >> 16) & 0xffff, (unsigned)key & 0xffff);
+    }
+}
+
+/*!
+ * merge the tables of all lcores and return the top n keys of the kind.
+ * the counts are decayed, a key queried at a steady rate r converges to about 2*r*top_window.
+ */
+sds topkToStr(int kind, int n) {
+    topkTable *t;
+    topkEntry *entries;
+    size_t nr_entries = 0, nr_uniq = 0, cap = 0;
+    uint64_t total = 0;
+    long epoch = sk.top_epoch;
+    sds s;
+
+    for (int i = 0; i < sk.nr_lcore_ids; ++i) {
+        topkLcore *tl = sk.lcore_conf[sk.lcore_ids[i]].topk;
+        if (tl) cap += tl->tables[kind].mask + 1;
+    }
+    entries = zcalloc(sizeof(*entries) * (cap? cap: 1));
+
+    for (int i = 0; i < sk.nr_lcore_ids; ++i) {
+        topkLcore *tl = sk.lcore_conf[sk.lcore_ids[i]].topk;
+        if (tl == NULL) continue;
+        // the idle lcores haven't decayed their tables.
+        long shift = epoch - tl->epoch;
+        t = &tl->tables[kind];
+        for (uint32_t j = 0; j <= t->mask; ++j) {
+            topkBucket *b = &t->buckets[j];
+            topkEntry *e = &entries[nr_entries];
+            uint32_t version = b->version;
+            rte_smp_rmb();
+            if (version & 1) continue;
+            e->key = b->key;
+            e->count = shift <= 0? b->count: (shift >= 32? 0: b->count >> shift);
+            if (t->names) len2dotlabel(t->names[j], e->name);
+            rte_smp_rmb();
+            if (b->version != version || e->key == 0 || e->count == 0) continue;
+            nr_entries++;
+        }
+    }
+
+    // merge the same keys of different lcores
+    qsort(entries, nr_entries, sizeof(*entries), cmpEntryKey);
+    for (size_t i = 0; i < nr_entries; ++i) {
+        total += entries[i].count;
+        if (nr_uniq > 0 && entries[nr_uniq-1].key == entries[i].key) {
+            entries[nr_uniq-1].count += entries[i].count;
+        } else {
+            entries[nr_uniq++] = entries[i];
+        }
+    }
+    qsort(entries, nr_uniq, sizeof(*entries), cmpEntryCount);
+
+    s = sdscatprintf(sdsempty(), "# top %s(window %ds)\r\n", kindNames[kind], sk.top_window);
+    for (size_t i = 0; i < nr_uniq && i < (size_t)n; ++i) {
+        char buf[64];
+        char *name = entries[i].name;
+        if (kind == TOPK_CLIENT) {
+            clientKeyToStr(entries[i].key, buf, sizeof(buf));
+            name = buf;
+        }
+        s = sdscatprintf(s, "%zu: %s %lu %.2f%%\r\n", i+1, name, entries[i].count,
+                         total? entries[i].count * 100.0 / total: 0.0);
+    }
+    zfree(entries);
+    return s;
+}
+
+/*!
+ * get the kind by name(names, clients or zones).
+ */
+int topkKindFromStr(const char *ss) {
+    for (int i = 0; i < TOPK_NR_KINDS; ++i) {
+        if (strcasecmp(ss, kindNames[i]) == 0) return i;
+    }
+    return -1;
+}
+
+int initTopk(void) {
+    for (int i = 0; i < sk.nr_lcore_ids; ++i) {
+        unsigned lcore_id = (unsigned)sk.lcore_ids[i];
+        if (lcore_id == rte_get_master_lcore()) continue;
+        sk.lcore_conf[lcore_id].topk = topkLcoreCreate((int)rte_lcore_to_socket_id(lcore_id));
+        if (sk.lcore_conf[lcore_id].topk == NULL) {
+            LOG_ERROR("can't allocate heavy hitter tables for lcore %u.", lcore_id);
+            return ERR_CODE;
+        }
+    }
+    return OK_CODE;
+}
+
+#if defined(SK_TEST)
+#include <stdlib.h>
+#include "testhelp.h"
+
+/*
+ * usage: shuke-server test topk [queries]
+ * a zipf-like stream of names from 100000 clients, the heavy hitters must be found,
+ * and the cost of every query is reported.
+ */
+int topkBenchmark(int argc, char *argv[]) {
+    long nr_queries = argc >= 4 ? atol(argv[3]) : 10000000;
+    int nr_names = 100000;
+    char (*names)[MAX_DOMAIN_LEN+2] = malloc(sizeof(*names) * nr_names);
+    size_t *lens = malloc(sizeof(size_t) * nr_names);
+    uint32_t *stream = malloc(sizeof(uint32_t) * nr_queries);
+    char addr[16] = {0};
+    struct context ctx;
+    char dotName[MAX_DOMAIN_LEN+2];
+
+    for (int i = 0; i < nr_names; ++i) {
+        snprintf(dotName, sizeof(dotName), "www%d.example%d.com.", i, i % 100);
+        dot2lenlabel(dotName, names[i]);
+        lens[i] = strlen(names[i]);
+    }
+    // 30% of queries go to name 0, 15% to name 1, 5% to name 2, the others are uniform.
+    srand(1);
+    for (long i = 0; i < nr_queries; ++i) {
+        int r = rand() % 100;
+        stream[i] = r < 30? 0: r < 45? 1: r < 50? 2: 3 + (uint32_t)rand() % (nr_names - 3);
+    }
+
+    sk.top_window = 10;
+    topkLcore *tl = topkLcoreCreate(SOCKET_ID_HEAP);
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.z = NULL;
+
+    long long start = ustime();
+    for (long i = 0; i < nr_queries; ++i) {
+        ctx.name = names[stream[i]];
+        ctx.nameLen = lens[stream[i]];
+        memcpy(addr, &stream[i], 4);
+        topkRecord(tl, &ctx, addr, true);
+    }
+    long long elapsed = ustime() - start;
+    printf("%ld queries in %.3f s: %.1f ns/query\n", nr_queries, elapsed / 1e6,
+           elapsed * 1000.0 / nr_queries);
+
+    sk.nr_lcore_ids = 1;
+    int lcore_ids[1] = {0};
+    sk.lcore_ids = lcore_ids;
+    sk.lcore_conf[0].topk = tl;
+    sds s = topkToStr(TOPK_NAME, 3);
+    printf("%s", s);
+    test_cond("top 1 is www0", strstr(s, "1: www0.example0.com. ") != NULL);
+    test_cond("top 2 is www1", strstr(s, "2: www1.example1.com. ") != NULL);
+    test_cond("top 3 is www2", strstr(s, "3: www2.example2.com. ") != NULL);
+    sdsfree(s);
+
+    topkBucket *b = topkBucketOf(&tl->tables[TOPK_NAME], topkHashName(names[0], lens[0]));
+    uint32_t count = b->count;
+    sk.top_epoch++;
+    ctx.name = names[0];
+    ctx.nameLen = lens[0];
+    topkRecord(tl, &ctx, addr, true);
+    test_cond("counts are halved by decay", b->count == count / 2 + 1);
+    test_report();
+    return 0;
+}
+#endif
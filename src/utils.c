@@ -251,6 +251,100 @@ size_t lenlabellen(char *domain) {
     return ptr - domain;
 }
 
+/*!
+ * 64 bit MurmurHash2(MurmurHash64A), used to check if a large buffer(e.g. zone file) is changed.
+ * the result depends on the byte order, so don't persist it.
+ */
+uint64_t memhash64(const void *key, size_t len, uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    const unsigned char *data = key;
+    const unsigned char *end = data + (len & ~(size_t)7);
+    uint64_t h = seed ^ (len * m);
+
+    for (; data != end; data += 8) {
+        uint64_t k;
+        memcpy(&k, data, 8);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    switch (len & 7) {
+    case 7: h ^= (uint64_t)data[6] << 48; /* fall through */
+    case 6: h ^= (uint64_t)data[5] << 40; /* fall through */
+    case 5: h ^= (uint64_t)data[4] << 32; /* fall through */
+    case 4: h ^= (uint64_t)data[3] << 24; /* fall through */
+    case 3: h ^= (uint64_t)data[2] << 16; /* fall through */
+    case 2: h ^= (uint64_t)data[1] << 8; /* fall through */
+    case 1: h ^= (uint64_t)data[0];
+        h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void sha1Block(uint32_t h[5], const uint8_t *p) {
+    uint32_t w[80], a, b, c, d, e, f, k, t;
+    int i;
+
+    for (i = 0; i < 16; ++i) {
+        w[i] = (uint32_t)p[4*i] << 24 | (uint32_t)p[4*i+1] << 16 | (uint32_t)p[4*i+2] << 8 | p[4*i+3];
+    }
+    for (; i < 80; ++i) w[i] = ROL32(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+    a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (i = 0; i < 80; ++i) {
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        t = ROL32(a, 5) + f + e + k + w[i];
+        e = d, d = c, c = ROL32(b, 30), b = a, a = t;
+    }
+    h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e;
+}
+
+/*!
+ * SHA-1(FIPS 180-4) of a buffer, only used to hash owner names for NSEC3(RFC 5155).
+ */
+void sha1(const void *data, size_t len, uint8_t digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    const uint8_t *p = data;
+    uint64_t bits = (uint64_t)len * 8;
+    size_t rem = len % 64, last;
+    uint8_t buf[128];
+
+    for (size_t n = len / 64; n > 0; --n, p += 64) sha1Block(h, p);
+    // the padding: 0x80, zeros and the length in bits(big endian) at the end of a block.
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, p, rem);
+    buf[rem] = 0x80;
+    last = rem < 56? 64: 128;
+    for (int i = 0; i < 8; ++i) buf[last-1-i] = (uint8_t)(bits >> (8*i));
+    sha1Block(h, buf);
+    if (last == 128) sha1Block(h, buf + 64);
+    for (int i = 0; i < 5; ++i) {
+        digest[4*i] = (uint8_t)(h[i] >> 24);
+        digest[4*i+1] = (uint8_t)(h[i] >> 16);
+        digest[4*i+2] = (uint8_t)(h[i] >> 8);
+        digest[4*i+3] = (uint8_t)h[i];
+    }
+}
+
 /*!
  * this function will dump all the arguments to buf, the format is specified by fmt.
  * it is similar to the struct package in python.
@@ -6,6 +6,8 @@
 #define SHUKE_UTILS_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 void freev(void **pp);
 
@@ -23,11 +25,18 @@ char *toAbsPath(char *p, char *rootp);
 char *getHomePath(void);
 
 size_t lenlabellen(char *domain);
+uint64_t memhash64(const void *key, size_t len, uint64_t seed);
+void sha1(const void *data, size_t len, uint8_t digest[20]);
 
 static inline bool isEmptyStr(char *ss) {
     return (ss == NULL) || (ss[0] == 0);
 }
 
+// serial number arithmetic(RFC 1982)
+static inline bool serialGt(uint32_t s1, uint32_t s2) {
+    return (int32_t)(s1 - s2) > 0;
+}
+
 int snpack(char *buf, int offset, size_t size, char const *fmt, ...);
 
 #endif //SHUKE_UTILS_H
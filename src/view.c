@@ -0,0 +1,346 @@
+//
+// GeoDNS views
+//
+// the views file maps address prefixes to views, one view per line:
+//
+//     # view   prefixes
+//     cn       1.0.1.0/24 1.0.2.0/23 240e::/20
+//     us       8.8.8.0/24
+//
+// every numa node has its own rte_lpm/rte_lpm6 tables built from the file, the lcores
+// look up the source addresses of a whole RX burst at once, the ECS address(and
+// the source address of ipv6 and tcp queries) is looked up when a name that has
+// views is queried. the file is reloaded by admin `view reload`, the new tables
+// are published by rcu_assign_pointer and the old ones are freed after a grace period.
+//
+
+#include <rte_lpm.h>
+#include <rte_lpm6.h>
+
+#include "shuke.h"
+#include "utils.h"
+
+DEF_LOG_MODULE(RTE_LOGTYPE_USER1, "VIEW");
+
+struct viewTable_s {
+    struct rte_lpm *lpm;
+    struct rte_lpm6 *lpm6;
+    struct rcu_head rcu_head;
+};
+
+typedef struct {
+    uint32_t view;
+    addrPrefix p;
+} viewRule;
+
+/*
+ * the names are registered by the zone parsers(main thread and reload worker)
+ * and the views file, they are never removed, so the returned names stay valid.
+ */
+static struct {
+    pthread_mutex_t lock;
+    dict *ids;                       // name -> id
+    char *names[VIEW_MAX+1];
+    uint32_t nr;
+} registry = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+// only accessed by main thread.
+static struct {
+    unsigned generation;            // makes the names of lpm tables unique
+    long load_ts;
+    int nr_rules4;
+    int nr_rules6;
+    uint32_t nr_prefixes[VIEW_MAX+1];
+} views;
+
+/*!
+ * get the id of a view.
+ *
+ * @param create : register the name if it doesn't exist.
+ * @return ERR_CODE if the name doesn't exist(or too many views).
+ */
+int viewGetId(const char *name, bool create) {
+    int id = ERR_CODE;
+    void *v;
+
+    pthread_mutex_lock(&registry.lock);
+    if (registry.ids == NULL) registry.ids = dictCreate(&dictTypeCaseStringCopyKey, NULL, SOCKET_ID_HEAP);
+    if ((v = dictFetchValue(registry.ids, name)) != NULL) {
+        id = (int)(uintptr_t)v;
+    } else if (create && registry.nr < VIEW_MAX) {
+        id = (int)++registry.nr;
+        registry.names[id] = zstrdup(name);
+        dictAdd(registry.ids, (void *)name, (void *)(uintptr_t)id);
+    }
+    pthread_mutex_unlock(&registry.lock);
+    return id;
+}
+
+const char *viewIdToName(uint32_t id) {
+    const char *name = VIEW_DEFAULT_NAME;
+
+    pthread_mutex_lock(&registry.lock);
+    if (id > 0 && id <= registry.nr) name = registry.names[id];
+    pthread_mutex_unlock(&registry.lock);
+    return name;
+}
+
+static void viewTableDestroy(viewTable *vt) {
+    if (vt == NULL) return;
+    if (vt->lpm) rte_lpm_free(vt->lpm);
+    if (vt->lpm6) rte_lpm6_free(vt->lpm6);
+    zfree(vt);
+}
+
+static void viewTableFreeCallback(struct rcu_head *head) {
+    viewTable *vt = caa_container_of(head, viewTable, rcu_head);
+    viewTableDestroy(vt);
+}
+
+static int viewTableAdd(char *errstr, viewTable *vt, viewRule *r) {
+    uint32_t hop = VIEW_HOP(r->view, r->p.prefix);
+    uint32_t old_hop;
+    uint8_t depth = (uint8_t)r->p.prefix;
+    int present;
+
+    if (r->p.af == AF_INET) {
+        uint32_t ip = load32be((char *)r->p.addr);
+        present = rte_lpm_is_rule_present(vt->lpm, ip, depth, &old_hop);
+        if (present == 0 && rte_lpm_add(vt->lpm, ip, depth, hop) == 0) return OK_CODE;
+    } else {
+        present = rte_lpm6_is_rule_present(vt->lpm6, r->p.addr, depth, &old_hop);
+        if (present == 0 && rte_lpm6_add(vt->lpm6, r->p.addr, depth, hop) == 0) return OK_CODE;
+    }
+    if (present == 1) {
+        snprintf(errstr, ERR_STR_LEN, "the prefix of view %s is in view %s too.",
+                 viewIdToName(r->view), viewIdToName(VIEW_HOP_ID(old_hop)));
+    } else {
+        snprintf(errstr, ERR_STR_LEN, "can't add the prefix of view %s to lpm table.", viewIdToName(r->view));
+    }
+    return ERR_CODE;
+}
+
+/*
+ * build the tables of a numa node, the number of tbl8 groups is estimated from
+ * the prefixes longer than 24 bits.
+ */
+static viewTable *viewTableCreate(char *errstr, int socket_id, viewRule *rules, int n) {
+    char name[RTE_LPM_NAMESIZE];
+    viewTable *vt = zcalloc(sizeof(*vt));
+    uint32_t nr4 = 0, nr6 = 0, tbl8s4 = 0, tbl8s6 = 0;
+
+    for (int i = 0; i < n; ++i) {
+        int depth = rules[i].p.prefix;
+        if (rules[i].p.af == AF_INET) {
+            nr4++;
+            if (depth > 24) tbl8s4++;
+        } else {
+            nr6++;
+            if (depth > 24) tbl8s6 += (uint32_t)(depth - 24 + 7) / 8;
+        }
+    }
+    views.generation++;
+    if (nr4 > 0) {
+        struct rte_lpm_config config = {
+            .max_rules = nr4,
+            .number_tbl8s = tbl8s4 + 16,
+            .flags = 0,
+        };
+        snprintf(name, sizeof(name), "view4_%d_%u", socket_id, views.generation);
+        if ((vt->lpm = rte_lpm_create(name, socket_id, &config)) == NULL) {
+            snprintf(errstr, ERR_STR_LEN, "can't create lpm table on socket %d: %s", socket_id, rte_strerror(rte_errno));
+            goto error;
+        }
+    }
+    if (nr6 > 0) {
+        struct rte_lpm6_config config = {
+            .max_rules = nr6,
+            .number_tbl8s = tbl8s6 + 16,
+            .flags = 0,
+        };
+        snprintf(name, sizeof(name), "view6_%d_%u", socket_id, views.generation);
+        if ((vt->lpm6 = rte_lpm6_create(name, socket_id, &config)) == NULL) {
+            snprintf(errstr, ERR_STR_LEN, "can't create lpm6 table on socket %d: %s", socket_id, rte_strerror(rte_errno));
+            goto error;
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        if (viewTableAdd(errstr, vt, rules + i) == ERR_CODE) goto error;
+    }
+    return vt;
+
+error:
+    viewTableDestroy(vt);
+    return NULL;
+}
+
+static int parseViewsFile(char *errstr, const char *fname, viewRule **rulesp, int *np) {
+    FILE *fp;
+    char *line = NULL;
+    size_t cap = 0;
+    int lineno = 0, n = 0, max = 0, argc, id;
+    sds *argv = NULL;
+    viewRule *rules = NULL;
+
+    if ((fp = fopen(fname, "r")) == NULL) {
+        snprintf(errstr, ERR_STR_LEN, "can't open views file %s: %s", fname, strerror(errno));
+        return ERR_CODE;
+    }
+    while (getline(&line, &cap, fp) != -1) {
+        lineno++;
+        char *comment = strchr(line, '#');
+        if (comment) *comment = 0;
+        argv = sdssplitargs(line, &argc);
+        if (argv == NULL) {
+            snprintf(errstr, ERR_STR_LEN, "line %d of %s: unbalanced quotes.", lineno, fname);
+            goto error;
+        }
+        if (argc == 0) {
+            sdsfreesplitres(argv, argc);
+            continue;
+        }
+        if (argc < 2 || strcasecmp(argv[0], VIEW_DEFAULT_NAME) == 0) {
+            snprintf(errstr, ERR_STR_LEN, "line %d of %s: need a view(not %s) and prefixes.",
+                     lineno, fname, VIEW_DEFAULT_NAME);
+            goto error;
+        }
+        if ((id = viewGetId(argv[0], true)) == ERR_CODE) {
+            snprintf(errstr, ERR_STR_LEN, "line %d of %s: too many views(max %d).", lineno, fname, VIEW_MAX);
+            goto error;
+        }
+        for (int i = 1; i < argc; ++i) {
+            if (n == max) {
+                max = max? max * 2: 256;
+                rules = zrealloc(rules, max * sizeof(*rules));
+            }
+            rules[n].view = (uint32_t)id;
+            // rte_lpm doesn't support the default route.
+            if (parseAddrPrefix(argv[i], &rules[n].p) == ERR_CODE || rules[n].p.prefix == 0) {
+                snprintf(errstr, ERR_STR_LEN, "line %d of %s: invalid prefix %s.", lineno, fname, argv[i]);
+                goto error;
+            }
+            n++;
+        }
+        sdsfreesplitres(argv, argc);
+    }
+    argv = NULL;
+    *rulesp = rules;
+    *np = n;
+    free(line);
+    fclose(fp);
+    return OK_CODE;
+
+error:
+    if (argv) sdsfreesplitres(argv, argc);
+    free(line);
+    fclose(fp);
+    zfree(rules);
+    return ERR_CODE;
+}
+
+/*!
+ * (re)load the views file, the tables of all numa nodes are replaced only if
+ * all of them are built successfully, otherwise the old tables are kept.
+ * must be called in main thread.
+ */
+int loadViews(char *errstr) {
+    viewRule *rules = NULL;
+    viewTable *tables[MAX_NUMA_NODES] = {NULL};
+    int n = 0, i, numa_id;
+
+    if (sk.views_file == NULL) return OK_CODE;
+    if (parseViewsFile(errstr, sk.views_file, &rules, &n) == ERR_CODE) return ERR_CODE;
+
+    for (i = 0; i < sk.nr_numa_id; ++i) {
+        numa_id = sk.numa_ids[i];
+        if ((tables[numa_id] = viewTableCreate(errstr, numa_id, rules, n)) == NULL) goto error;
+    }
+    for (i = 0; i < sk.nr_numa_id; ++i) {
+        numa_id = sk.numa_ids[i];
+        viewTable *old = sk.nodes[numa_id]->vt;
+        rcu_assign_pointer(sk.nodes[numa_id]->vt, tables[numa_id]);
+        if (old) call_rcu(&old->rcu_head, viewTableFreeCallback);
+    }
+
+    memset(views.nr_prefixes, 0, sizeof(views.nr_prefixes));
+    views.nr_rules4 = views.nr_rules6 = 0;
+    for (i = 0; i < n; ++i) {
+        views.nr_prefixes[rules[i].view]++;
+        if (rules[i].p.af == AF_INET) views.nr_rules4++;
+        else views.nr_rules6++;
+    }
+    views.load_ts = sk.unixtime;
+    LOG_INFO("load %d prefixes(ipv4: %d, ipv6: %d) from views file %s.",
+             n, views.nr_rules4, views.nr_rules6, sk.views_file);
+    zfree(rules);
+    return OK_CODE;
+
+error:
+    for (i = 0; i < sk.nr_numa_id; ++i) viewTableDestroy(tables[sk.numa_ids[i]]);
+    zfree(rules);
+    return ERR_CODE;
+}
+
+/*!
+ * find the view of an address.
+ *
+ * @param addr : network byte order, 4 bytes if is_ipv4 is true, otherwise 16 bytes.
+ * @return the next hop(view id and prefix length), 0 if no prefix matches.
+ */
+uint32_t viewLookup(viewTable *vt, bool is_ipv4, const void *addr) {
+    uint32_t hop;
+
+    if (is_ipv4) {
+        if (vt->lpm == NULL || rte_lpm_lookup(vt->lpm, load32be((char *)addr), &hop) != 0) return 0;
+    } else {
+        if (vt->lpm6 == NULL || rte_lpm6_lookup(vt->lpm6, (uint8_t *)addr, &hop) != 0) return 0;
+    }
+    return hop;
+}
+
+/*!
+ * look up the source addresses of an RX burst in one rte_lpm_lookup_bulk call,
+ * VIEW_HOP_UNKNOWN is stored for the packets that aren't ipv4.
+ */
+void viewLookupBurst(viewTable *vt, struct rte_mbuf **pkts, int n, uint32_t *hops) {
+    uint32_t ips[MAX_PKT_BURST];
+    uint64_t not_ipv4 = 0;
+    int i;
+
+    for (i = 0; i < n; ++i) {
+        struct ether_hdr *eth_h = rte_pktmbuf_mtod(pkts[i], struct ether_hdr *);
+        if (eth_h->ether_type == rte_cpu_to_be_16(ETHER_TYPE_IPv4)) {
+            struct ipv4_hdr *ipv4_h = (struct ipv4_hdr *)(eth_h + 1);
+            ips[i] = rte_be_to_cpu_32(ipv4_h->src_addr);
+        } else {
+            ips[i] = 0;
+            not_ipv4 |= 1ULL << i;
+        }
+    }
+    if (vt->lpm == NULL) {
+        for (i = 0; i < n; ++i) hops[i] = (not_ipv4 & (1ULL << i))? VIEW_HOP_UNKNOWN: 0;
+        return;
+    }
+    rte_lpm_lookup_bulk(vt->lpm, ips, hops, (unsigned)n);
+    for (i = 0; i < n; ++i) {
+        if (not_ipv4 & (1ULL << i)) hops[i] = VIEW_HOP_UNKNOWN;
+        else if (hops[i] & RTE_LPM_LOOKUP_SUCCESS) hops[i] &= 0x00ffffff;
+        else hops[i] = 0;
+    }
+}
+
+sds viewsToStr(void) {
+    sds s = sdsempty();
+
+    if (sk.views_file == NULL) return sdscat(s, "views file is not configured.\n");
+    s = sdscatprintf(s, "file: %s\nload_time: %ld\nipv4_prefixes: %d\nipv6_prefixes: %d\n",
+                     sk.views_file, views.load_ts, views.nr_rules4, views.nr_rules6);
+    pthread_mutex_lock(&registry.lock);
+    for (uint32_t id = 1; id <= registry.nr; ++id) {
+        s = sdscatprintf(s, "view %s: %u prefixes\n", registry.names[id], views.nr_prefixes[id]);
+    }
+    pthread_mutex_unlock(&registry.lock);
+    return s;
+}
@@ -0,0 +1,44 @@
+//
+// GeoDNS views, the answer of a name can vary with the client.
+//
+
+#ifndef SHUKE_VIEW_H
+#define SHUKE_VIEW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sds.h"
+
+/*
+ * a view is a named set of RRSets($VIEW directive in zone files or the `view` field
+ * of mongo documents), the client is mapped to a view by the longest prefix match of
+ * its ECS address(or source address) in the views file. the names of views are
+ * registered once and never removed, the id(1..VIEW_MAX) is stored in zones,
+ * 0 is the default view(records outside of any $VIEW section).
+ */
+#define VIEW_MAX            (4095)
+#define VIEW_DEFAULT_NAME   "default"
+
+/*
+ * the next hop of a prefix in the lpm tables, the view id is in the high bits and
+ * the prefix length is in the low 8 bits, so one lookup gives the ECS scope too.
+ * 0 means no prefix matches.
+ */
+#define VIEW_HOP(view, depth)   (((uint32_t)(view) << 8) | (uint32_t)(depth))
+#define VIEW_HOP_ID(hop)        ((uint32_t)(hop) >> 8)
+#define VIEW_HOP_DEPTH(hop)     ((uint8_t)((hop) & 0xff))
+// the source address of the packet is not looked up yet(ipv6, tcp).
+#define VIEW_HOP_UNKNOWN        (0xffffffffU)
+
+struct rte_mbuf;
+typedef struct viewTable_s viewTable;
+
+int viewGetId(const char *name, bool create);
+const char *viewIdToName(uint32_t id);
+
+int loadViews(char *errstr);
+uint32_t viewLookup(viewTable *vt, bool is_ipv4, const void *addr);
+void viewLookupBurst(viewTable *vt, struct rte_mbuf **pkts, int n, uint32_t *hops);
+sds viewsToStr(void);
+
+#endif //SHUKE_VIEW_H
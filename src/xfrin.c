@@ -0,0 +1,747 @@
+//
+// zone transfer client(secondary mode)
+//
+// the zones are transferred from the primary over tcp in reload worker.
+// if the serial of primary is newer, IXFR is tried first and the differences
+// are applied to the copies of the zones in memory, the RRSets not touched by
+// the differences are shared with the old zones, so the cost is proportional
+// to the changes instead of the zone size. AXFR is used for new zones,
+// admin reloads and when the primary can't serve IXFR.
+//
+
+#include <ctype.h>
+#include <arpa/inet.h>
+
+#include "shuke.h"
+#include "utils.h"
+
+DEF_LOG_MODULE(RTE_LOGTYPE_USER1, "XFRIN");
+
+#define XFR_MSG_MAX   65535
+// the same limit as RRParserFeedWire
+#define XFR_RDATA_MAX 4094
+
+// a RR deleted or added by IXFR
+typedef struct {
+    bool add;
+    uint16_t type;
+    uint32_t ttl;
+    size_t ownerLen;      // including the terminating zero
+    size_t rdlength;
+    char *owner;          // absolute name in lowercase len label format
+    char *rdata;          // uncompressed wire rdata
+    char data[];
+} xfrChange;
+
+typedef struct {
+    zoneReloadContext *ctx;
+    int fd;
+    uint16_t xid;
+    uint16_t qtype;
+    char origin[MAX_DOMAIN_LEN+2];
+    size_t originLen;
+
+    // the first SOA, the transfer ends with a SOA of the same serial.
+    uint32_t sn;
+    uint32_t soa_ttl;
+    char soa[XFR_RDATA_MAX];
+    size_t soa_len;
+
+    int nr_rrs;
+    bool done;
+    // IXFR: the serial of primary is not newer
+    bool up_to_date;
+    // IXFR: the response is a list of differences instead of the full zone
+    bool incremental;
+    bool deleting;
+    // the serial of current difference sequence
+    uint32_t cur_sn;
+
+    // the full zone(AXFR or AXFR style IXFR response)
+    zone *z;
+    RRParser *psr;
+    // the differences of IXFR
+    xfrChange **changes;
+    size_t nr_changes;
+    size_t cap_changes;
+
+    size_t nr_bytes;
+    size_t nr_skipped;
+    char errstr[ERR_STR_LEN];
+    char buf[XFR_MSG_MAX];
+} xfrTransfer;
+
+static struct {
+    pthread_mutex_t lock;
+    xfrinStats stats;
+} xfrin = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+#define XFRIN_STAT_INCR(field, n) do {          \
+    pthread_mutex_lock(&xfrin.lock);            \
+    xfrin.stats.field += (n);                   \
+    pthread_mutex_unlock(&xfrin.lock);          \
+} while(0)
+
+static inline uint32_t soaSerial(char *rdata, size_t len) {
+    return load32be(rdata + len - 20);
+}
+
+/*
+ * read a domain name(may be compressed) at offset of the message,
+ * the name is stored in uncompressed len label format.
+ *
+ * @param nameLen : the size of name, including the terminating zero.
+ * @return the bytes the name occupies at offset, ERR_CODE if the name is invalid.
+ */
+static int readName(char *msg, size_t size, size_t offset, char *name, size_t *nameLen, bool lower) {
+    size_t pos = offset, n = 0;
+    int consumed = -1;
+    int jumps = 0;
+    uint8_t len;
+
+    while (true) {
+        if (pos >= size) return ERR_CODE;
+        len = (uint8_t)msg[pos];
+        if ((len & 0xC0) == 0xC0) {
+            if (pos + 1 >= size || ++jumps > MAX_DOMAIN_LEN/2) return ERR_CODE;
+            if (consumed < 0) consumed = (int)(pos + 2 - offset);
+            pos = ((size_t)(len & 0x3F) << 8) | (uint8_t)msg[pos+1];
+            continue;
+        }
+        if ((len & 0xC0) != 0) return ERR_CODE;
+        if (pos + 1 + len > size || n + 1 + len > MAX_DOMAIN_LEN) return ERR_CODE;
+        memcpy(name + n, msg + pos, (size_t)len + 1);
+        if (lower) {
+            for (size_t i = n + 1; i <= n + len; ++i) name[i] = (char)tolower((unsigned char)name[i]);
+        }
+        n += (size_t)len + 1;
+        pos += (size_t)len + 1;
+        if (len == 0) break;
+    }
+    if (consumed < 0) consumed = (int)(pos - offset);
+    *nameLen = n;
+    return consumed;
+}
+
+/*
+ * read the rdata at offset of the message, the names in rdata are decompressed.
+ * the type must be supported.
+ */
+static int readRdata(char *msg, size_t size, size_t offset, uint16_t type, size_t rdlength,
+                     char *rdata, size_t *len)
+{
+    size_t end = offset + rdlength;
+    size_t prefix = 0, suffix = 0, n, nameLen;
+    int nr_names = 0, ret;
+
+    if (end > size) return ERR_CODE;
+    switch (type) {
+    case DNS_TYPE_NS:
+    case DNS_TYPE_CNAME:
+    case DNS_TYPE_PTR:
+        nr_names = 1;
+        break;
+    case DNS_TYPE_MX:
+        prefix = 2;
+        nr_names = 1;
+        break;
+    case DNS_TYPE_SRV:
+        prefix = 6;
+        nr_names = 1;
+        break;
+    case DNS_TYPE_SOA:
+        nr_names = 2;
+        suffix = 20;
+        break;
+    default:
+        if (rdlength > XFR_RDATA_MAX) return ERR_CODE;
+        memcpy(rdata, msg + offset, rdlength);
+        *len = rdlength;
+        return OK_CODE;
+    }
+    if (prefix + suffix > rdlength) return ERR_CODE;
+    memcpy(rdata, msg + offset, prefix);
+    n = prefix;
+    offset += prefix;
+    for (int i = 0; i < nr_names; ++i) {
+        if ((ret = readName(msg, size, offset, rdata + n, &nameLen, false)) == ERR_CODE) return ERR_CODE;
+        n += nameLen;
+        offset += (size_t)ret;
+    }
+    if (offset + suffix != end) return ERR_CODE;
+    memcpy(rdata + n, msg + offset, suffix);
+    *len = n + suffix;
+    return OK_CODE;
+}
+
+static void xfrTransferReset(xfrTransfer *x) {
+    if (x->fd >= 0) close(x->fd);
+    x->fd = -1;
+    if (x->z) zoneDestroy(x->z);
+    x->z = NULL;
+    for (size_t i = 0; i < x->nr_changes; ++i) zfree(x->changes[i]);
+    zfree(x->changes);
+    x->changes = NULL;
+    x->nr_changes = x->cap_changes = 0;
+    x->nr_rrs = 0;
+    x->done = x->up_to_date = x->incremental = x->deleting = false;
+}
+
+static int xfrConnect(xfrTransfer *x) {
+    long long timeout = sk.xfr_timeout * 1000LL;
+    int err = 0;
+    socklen_t errlen = sizeof(err);
+
+    x->fd = anetTcpNonBlockConnect(x->errstr, sk.xfr_primary, sk.xfr_port);
+    if (x->fd == ANET_ERR) {
+        x->fd = -1;
+        return ERR_CODE;
+    }
+    if (aeWait(x->fd, AE_WRITABLE, timeout) <= 0) {
+        snprintf(x->errstr, ERR_STR_LEN, "connect to %s:%d timeout", sk.xfr_primary, sk.xfr_port);
+        return ERR_CODE;
+    }
+    if (getsockopt(x->fd, SOL_SOCKET, SO_ERROR, &err, &errlen) < 0 || err != 0) {
+        snprintf(x->errstr, ERR_STR_LEN, "can't connect to %s:%d: %s", sk.xfr_primary, sk.xfr_port, strerror(err));
+        return ERR_CODE;
+    }
+    if (anetBlock(x->errstr, x->fd) == ANET_ERR ||
+        anetSendTimeout(x->errstr, x->fd, timeout) == ANET_ERR ||
+        anetRecvTimeout(x->errstr, x->fd, timeout) == ANET_ERR) {
+        return ERR_CODE;
+    }
+    return OK_CODE;
+}
+
+/*
+ * send SOA, AXFR or IXFR query, the authority section of IXFR query contains
+ * the SOA with our serial, the other fields of the SOA are ignored by primary.
+ */
+static int xfrSendQuery(xfrTransfer *x, uint16_t qtype) {
+    char buf[2 + DNS_HDR_SIZE + MAX_DOMAIN_LEN+2 + 4 + 12 + 22];
+    size_t n = 2;
+    int nwritten;
+    bool ixfr = (qtype == DNS_TYPE_IXFR);
+
+    x->qtype = qtype;
+    x->xid = (uint16_t)rand();
+    dumpDNSHeader(buf + n, DNS_HDR_SIZE, x->xid, 0, 1, 0, ixfr ? 1 : 0, 0);
+    n += DNS_HDR_SIZE;
+    memcpy(buf + n, x->origin, x->originLen + 1);
+    n += x->originLen + 1;
+    dump16be(qtype, buf + n);
+    dump16be(DNS_CLASS_IN, buf + n + 2);
+    n += 4;
+    if (ixfr) {
+        // name(pointer to question), type, class, ttl, rdlength
+        dump16be(0xC000 | DNS_HDR_SIZE, buf + n);
+        dump16be(DNS_TYPE_SOA, buf + n + 2);
+        dump16be(DNS_CLASS_IN, buf + n + 4);
+        dump32be(0, buf + n + 6);
+        dump16be(22, buf + n + 10);
+        n += 12;
+        // root mname and rname, serial and 4 zero fields.
+        memset(buf + n, 0, 22);
+        dump32be(x->ctx->sn, buf + n + 2);
+        n += 22;
+    }
+    dump16be((uint16_t)(n - 2), buf);
+    if (anetWrite(x->fd, buf, (int)n, &nwritten) != (int)n) {
+        snprintf(x->errstr, ERR_STR_LEN, "can't send query: %s", strerror(errno));
+        return ERR_CODE;
+    }
+    return OK_CODE;
+}
+
+static int xfrAddChange(xfrTransfer *x, char *owner, size_t ownerLen, uint16_t type, uint32_t ttl,
+                        char *rdata, size_t rdlength)
+{
+    xfrChange *c = zmalloc(sizeof(*c) + ownerLen + rdlength);
+
+    c->add = !x->deleting;
+    c->type = type;
+    c->ttl = ttl;
+    c->ownerLen = ownerLen;
+    c->rdlength = rdlength;
+    c->owner = c->data;
+    c->rdata = c->data + ownerLen;
+    memcpy(c->owner, owner, ownerLen);
+    memcpy(c->rdata, rdata, rdlength);
+
+    if (x->nr_changes == x->cap_changes) {
+        x->cap_changes = x->cap_changes ? x->cap_changes * 2 : 64;
+        x->changes = zrealloc(x->changes, x->cap_changes * sizeof(xfrChange *));
+    }
+    x->changes[x->nr_changes++] = c;
+    return OK_CODE;
+}
+
+static int xfrFeedFullZone(xfrTransfer *x, char *owner, size_t ownerLen, uint16_t type, uint32_t ttl,
+                           char *rdata, size_t rdlength)
+{
+    if (x->z == NULL) {
+        x->z = zoneCreate(x->ctx->dotOrigin, sk.master_numa_id);
+        if (x->z == NULL) {
+            snprintf(x->errstr, ERR_STR_LEN, "invalid zone name %s", x->ctx->dotOrigin);
+            return ERR_CODE;
+        }
+        if (RRParserFeedWire(x->psr, x->origin, x->originLen+1, x->soa_ttl, "SOA",
+                             x->soa, x->soa_len, x->z) == ERR_CODE) {
+            snprintf(x->errstr, ERR_STR_LEN, "%s", x->psr->errstr);
+            return ERR_CODE;
+        }
+    }
+    if (type == DNS_TYPE_SOA) {
+        if (soaSerial(rdata, rdlength) != x->sn) {
+            snprintf(x->errstr, ERR_STR_LEN, "unexpected SOA in the middle of transfer");
+            return ERR_CODE;
+        }
+        x->done = true;
+        return OK_CODE;
+    }
+    if (RRParserFeedWire(x->psr, owner, ownerLen, ttl, DNSTypeToStr(type), rdata, rdlength, x->z) == ERR_CODE) {
+        snprintf(x->errstr, ERR_STR_LEN, "%s", x->psr->errstr);
+        return ERR_CODE;
+    }
+    return OK_CODE;
+}
+
+/*
+ * feed a RR of the response.
+ * AXFR: SOA(sn), the records of zone, SOA(sn)
+ * IXFR: SOA(sn), [SOA(old), deleted records, SOA(new), added records]..., SOA(sn)
+ *       or the same as AXFR, or just SOA(sn) if our zone is up to date.
+ */
+static int xfrFeedRR(xfrTransfer *x, char *owner, size_t ownerLen, uint16_t type, uint32_t ttl,
+                     char *rdata, size_t rdlength)
+{
+    uint32_t sn;
+
+    x->nr_rrs++;
+    if (x->nr_rrs == 1) {
+        if (type != DNS_TYPE_SOA || ownerLen != x->originLen+1 || memcmp(owner, x->origin, ownerLen) != 0) {
+            snprintf(x->errstr, ERR_STR_LEN, "the first record of answer is not the SOA of zone");
+            return ERR_CODE;
+        }
+        x->sn = soaSerial(rdata, rdlength);
+        x->soa_ttl = ttl;
+        x->soa_len = rdlength;
+        memcpy(x->soa, rdata, rdlength);
+        if (x->qtype == DNS_TYPE_SOA) {
+            x->done = true;
+        } else if (x->qtype == DNS_TYPE_IXFR && !serialGt(x->sn, x->ctx->sn)) {
+            x->up_to_date = true;
+            x->done = true;
+        }
+        return OK_CODE;
+    }
+    if (x->nr_rrs == 2 && x->qtype == DNS_TYPE_IXFR && type == DNS_TYPE_SOA) {
+        sn = soaSerial(rdata, rdlength);
+        // a zone only containing SOA
+        if (sn == x->sn) return xfrFeedFullZone(x, owner, ownerLen, type, ttl, rdata, rdlength);
+        if (sn != x->ctx->sn) {
+            snprintf(x->errstr, ERR_STR_LEN, "the differences start from serial %u, but ours is %u", sn, x->ctx->sn);
+            return ERR_CODE;
+        }
+        x->incremental = true;
+        x->deleting = true;
+        return OK_CODE;
+    }
+    if (!x->incremental) return xfrFeedFullZone(x, owner, ownerLen, type, ttl, rdata, rdlength);
+
+    if (type == DNS_TYPE_SOA) {
+        sn = soaSerial(rdata, rdlength);
+        if (x->deleting) {
+            x->deleting = false;
+            x->cur_sn = sn;
+        } else if (sn == x->sn && x->cur_sn == x->sn) {
+            x->done = true;
+        } else if (sn == x->cur_sn) {
+            x->deleting = true;
+        } else {
+            snprintf(x->errstr, ERR_STR_LEN, "the differences are not continuous(%u, %u)", x->cur_sn, sn);
+            return ERR_CODE;
+        }
+        return OK_CODE;
+    }
+    return xfrAddChange(x, owner, ownerLen, type, ttl, rdata, rdlength);
+}
+
+static int xfrParseMsg(xfrTransfer *x, size_t size) {
+    char *msg = x->buf;
+    char owner[MAX_DOMAIN_LEN+2];
+    char rdata[XFR_RDATA_MAX];
+    size_t ownerLen, rdlength, len;
+    size_t offset = DNS_HDR_SIZE;
+    dnsHeader_t hdr;
+    uint16_t type, cls;
+    uint32_t ttl;
+    int ret;
+
+    if (dnsHeader_load(msg, size, &hdr) == ERR_CODE) goto invalid;
+    if (hdr.xid != x->xid || !GET_QR(hdr.flag)) goto invalid;
+    if (GET_ERROR(hdr.flag) != DNS_RCODE_OK) {
+        snprintf(x->errstr, ERR_STR_LEN, "primary returns rcode %d", GET_ERROR(hdr.flag));
+        return ERR_CODE;
+    }
+    for (int i = 0; i < hdr.nQd; ++i) {
+        if ((ret = readName(msg, size, offset, owner, &ownerLen, true)) == ERR_CODE) goto invalid;
+        offset += (size_t)ret + 4;
+    }
+    for (int i = 0; i < hdr.nAnRR && !x->done; ++i) {
+        if ((ret = readName(msg, size, offset, owner, &ownerLen, true)) == ERR_CODE) goto invalid;
+        offset += (size_t)ret;
+        if (offset + 10 > size) goto invalid;
+        type = load16be(msg + offset);
+        cls = load16be(msg + offset + 2);
+        ttl = load32be(msg + offset + 4);
+        rdlength = load16be(msg + offset + 8);
+        offset += 10;
+        if (offset + rdlength > size) goto invalid;
+
+        if (cls != DNS_CLASS_IN || dnsTypeToSlot(type) < 0) {
+            // the types not supported.
+            x->nr_skipped++;
+        } else {
+            if (readRdata(msg, size, offset, type, rdlength, rdata, &len) == ERR_CODE) goto invalid;
+            if (xfrFeedRR(x, owner, ownerLen, type, ttl, rdata, len) == ERR_CODE) return ERR_CODE;
+        }
+        offset += rdlength;
+    }
+    return OK_CODE;
+
+invalid:
+    snprintf(x->errstr, ERR_STR_LEN, "invalid response from primary");
+    return ERR_CODE;
+}
+
+/*
+ * send the query and read the response, it may contain several messages.
+ */
+static int xfrRequest(xfrTransfer *x, uint16_t qtype) {
+    char lenbuf[2];
+    int nread;
+    size_t size;
+
+    if (xfrSendQuery(x, qtype) == ERR_CODE) return ERR_CODE;
+    while (!x->done) {
+        if (anetRead(x->fd, lenbuf, 2, &nread) != 2) goto read_error;
+        size = load16be(lenbuf);
+        if (anetRead(x->fd, x->buf, (int)size, &nread) != (int)size) goto read_error;
+        x->nr_bytes += size + 2;
+        if (xfrParseMsg(x, size) == ERR_CODE) return ERR_CODE;
+        // the SOA query is answered in one message
+        if (qtype == DNS_TYPE_SOA && !x->done) {
+            snprintf(x->errstr, ERR_STR_LEN, "no SOA in response");
+            return ERR_CODE;
+        }
+    }
+    return OK_CODE;
+
+read_error:
+    snprintf(x->errstr, ERR_STR_LEN, "can't read response: %s", nread < 0 || errno ? strerror(errno) : "connection closed");
+    return ERR_CODE;
+}
+
+/*
+ * apply the differences to z, z must be a copy made by zoneCopyShared, so only
+ * the changed names are duplicated and compacted again.
+ */
+static int xfrApplyChanges(xfrTransfer *x, zone *z) {
+    char key[MAX_DOMAIN_LEN+2];
+    char rr[XFR_RDATA_MAX+2];
+    dnsDictValue *dv;
+    RRSet *rs, *new_rs;
+    size_t relativeLen, pos;
+    int idx;
+
+    for (size_t i = 0; i < x->nr_changes; ++i) {
+        xfrChange *c = x->changes[i];
+        // the SOA is replaced at last.
+        if (c->type == DNS_TYPE_SOA) continue;
+        if (c->ownerLen <= x->originLen) goto not_in_zone;
+        relativeLen = c->ownerLen - 1 - x->originLen;
+        // the owner must end with origin at a label boundary
+        for (pos = 0; pos < relativeLen; pos += (uint8_t)c->owner[pos] + 1);
+        if (pos != relativeLen || strcasecmp(c->owner + relativeLen, x->origin) != 0) goto not_in_zone;
+        if (relativeLen == 0) {
+            strcpy(key, "@");
+        } else {
+            memcpy(key, c->owner, relativeLen);
+            key[relativeLen] = 0;
+        }
+        dump16be((uint16_t)c->rdlength, rr);
+        memcpy(rr + 2, c->rdata, c->rdlength);
+
+        dv = dictFetchValue(z->d, key);
+        rs = dv ? dnsDictValueGet(dv, c->type) : NULL;
+        idx = rs ? RRSetFindRR(rs, rr, c->rdlength + 2) : -1;
+        if (!c->add) {
+            if (idx < 0) continue;
+            if (rs->num == 1) {
+                zoneDeleteTypeVal(z, key, c->type);
+            } else {
+                new_rs = RRSetDup(rs, z->socket_id);
+                RRSetDelRR(new_rs, idx);
+                zoneReplaceTypeVal(z, key, new_rs);
+            }
+        } else {
+            if (idx >= 0) continue;
+            if (RRParserFeedWire(x->psr, c->owner, c->ownerLen, c->ttl, DNSTypeToStr(c->type),
+                                 c->rdata, c->rdlength, z) == ERR_CODE) {
+                snprintf(x->errstr, ERR_STR_LEN, "%s", x->psr->errstr);
+                return ERR_CODE;
+            }
+        }
+    }
+    zoneDeleteTypeVal(z, "@", DNS_TYPE_SOA);
+    z->soa = NULL;
+    if (RRParserFeedWire(x->psr, x->origin, x->originLen+1, x->soa_ttl, "SOA", x->soa, x->soa_len, z) == ERR_CODE) {
+        snprintf(x->errstr, ERR_STR_LEN, "%s", x->psr->errstr);
+        return ERR_CODE;
+    }
+    zoneCompact(z);
+    return OK_CODE;
+
+not_in_zone:
+    snprintf(x->errstr, ERR_STR_LEN, "owner name doesn't belong to %s", x->ctx->dotOrigin);
+    return ERR_CODE;
+}
+
+static void freeNumaZones(zoneReloadContext *ctx) {
+    for (int i = 0; i < MAX_NUMA_NODES; ++i) {
+        if (ctx->numa_zones[i]) zoneDestroy(ctx->numa_zones[i]);
+        ctx->numa_zones[i] = NULL;
+    }
+    ctx->new_zn = NULL;
+}
+
+/*
+ * copy the zone of every numa node and apply the differences to the copies,
+ * the values of unchanged names are shared with the old zone.
+ */
+static int xfrApplyAllNumaNodes(xfrTransfer *x) {
+    zoneReloadContext *ctx = x->ctx;
+    zone *old_z, *z;
+
+    for (int i = 0; i < sk.nr_numa_id; ++i) {
+        int numa_id = sk.numa_ids[i];
+        ltree *lt = sk.nodes[numa_id]->lt;
+
+        // the old zone is only accessed in read side critical section, it is freed after
+        // a grace period, so it is copied without holding the ltree lock.
+        rcu_thread_online();
+        ltreeRLock(lt);
+        old_z = ltreeGetZoneExactRaw(lt, x->origin);
+        ltreeRUnlock(lt);
+        z = old_z ? zoneCopyShared(old_z) : NULL;
+        rcu_thread_offline();
+
+        if (z == NULL) {
+            snprintf(x->errstr, ERR_STR_LEN, "zone is deleted during transfer");
+            goto error;
+        }
+        ctx->numa_zones[numa_id] = z;
+        if (z->sn != ctx->sn) {
+            snprintf(x->errstr, ERR_STR_LEN, "zone is changed during transfer");
+            goto error;
+        }
+        if (xfrApplyChanges(x, z) == ERR_CODE) goto error;
+    }
+    ctx->new_zn = ctx->numa_zones[sk.master_numa_id];
+    return OK_CODE;
+
+error:
+    freeNumaZones(ctx);
+    return ERR_CODE;
+}
+
+/*
+ * transfer the zone by AXFR or IXFR, the connection is already established.
+ */
+static int xfrTransferZone(xfrTransfer *x, uint16_t qtype) {
+    zoneReloadContext *ctx = x->ctx;
+
+    if (xfrRequest(x, qtype) == ERR_CODE) return ERR_CODE;
+
+    if (x->up_to_date) {
+        ctx->unchanged = true;
+        XFRIN_STAT_INCR(nr_up_to_date, 1);
+    } else if (x->incremental) {
+        if (xfrApplyAllNumaNodes(x) == ERR_CODE) return ERR_CODE;
+        XFRIN_STAT_INCR(nr_ixfr, 1);
+        XFRIN_STAT_INCR(nr_changes, x->nr_changes);
+        LOG_INFO("IXFR of zone %s: serial %u -> %u, %lu changes, %lu bytes.",
+                 ctx->dotOrigin, ctx->sn, x->sn, x->nr_changes, x->nr_bytes);
+    } else {
+        if (x->z == NULL || x->z->soa == NULL) {
+            snprintf(x->errstr, ERR_STR_LEN, "no SOA in transfer");
+            return ERR_CODE;
+        }
+        ctx->new_zn = x->z;
+        x->z = NULL;
+        XFRIN_STAT_INCR(nr_axfr, 1);
+        LOG_INFO("%s of zone %s: serial %u, %lu bytes, %lu records skipped.",
+                 qtype == DNS_TYPE_IXFR ? "IXFR(full)" : "AXFR", ctx->dotOrigin, x->sn, x->nr_bytes, x->nr_skipped);
+    }
+    return OK_CODE;
+}
+
+/*!
+ * build the zone from primary, called by reload worker(or main thread when starting).
+ * the SOA is queried first if the zone exists, then IXFR or AXFR is used if the serial
+ * of primary is newer. admin reloads always use AXFR.
+ *
+ * @return ERR_CODE if the transfer failed.
+ */
+static int xfrBuildZone(zoneReloadContext *ctx) {
+    xfrTransfer *x = zcalloc(sizeof(*x));
+    bool exist = ctx->zone_exist && !ctx->urgent;
+    int ret = ERR_CODE;
+
+    x->ctx = ctx;
+    x->fd = -1;
+    dot2lenlabel(ctx->dotOrigin, x->origin);
+    // the owner names in response are converted to lowercase.
+    strtolower(x->origin);
+    x->originLen = strlen(x->origin);
+    x->psr = RRParserCreate("@", 0, ctx->dotOrigin);
+
+    if (xfrConnect(x) == ERR_CODE) goto end;
+    if (exist) {
+        XFRIN_STAT_INCR(nr_soa_queries, 1);
+        if (xfrRequest(x, DNS_TYPE_SOA) == ERR_CODE) goto end;
+        if (!serialGt(x->sn, ctx->sn)) {
+            ctx->unchanged = true;
+            XFRIN_STAT_INCR(nr_up_to_date, 1);
+            ret = OK_CODE;
+            goto end;
+        }
+        xfrTransferReset(x);
+        if (sk.xfr_ixfr) {
+            if (xfrConnect(x) == OK_CODE && xfrTransferZone(x, DNS_TYPE_IXFR) == OK_CODE) {
+                ret = OK_CODE;
+                goto end;
+            }
+            LOG_WARN("IXFR of zone %s failed(%s), fallback to AXFR.", ctx->dotOrigin, x->errstr);
+            XFRIN_STAT_INCR(nr_ixfr_fallback, 1);
+            xfrTransferReset(x);
+        }
+        if (xfrConnect(x) == ERR_CODE) goto end;
+    }
+    ret = xfrTransferZone(x, DNS_TYPE_AXFR);
+
+end:
+    if (ret == ERR_CODE) {
+        LOG_ERROR("can't transfer zone %s from %s:%d: %s.", ctx->dotOrigin, sk.xfr_primary, sk.xfr_port, x->errstr);
+        XFRIN_STAT_INCR(nr_failed, 1);
+    }
+    XFRIN_STAT_INCR(nr_bytes, x->nr_bytes);
+    xfrTransferReset(x);
+    RRParserDestroy(x->psr);
+    zfree(x);
+    return ret;
+}
+
+/*----------------------------------------------
+ *     zone transfer data store
+ *---------------------------------------------*/
+/*!
+ * the transfers connect to the primary on demand, so there is no connection to set up,
+ * only the config is checked.
+ */
+int initXfrStore(void) {
+    if (checkXfrStore() == ERR_CODE) {
+        LOG_ERROR("invalid [zone_source.xfr]: %s.", sk.errstr);
+        return ERR_CODE;
+    }
+    return OK_CODE;
+}
+
+/*!
+ * the store is usable if the primary address and the zones to transfer are configured.
+ */
+int checkXfrStore(void) {
+    if (isEmptyStr(sk.xfr_primary)) {
+        snprintf(sk.errstr, ERR_STR_LEN, "primary is not configured");
+        return ERR_CODE;
+    }
+    if (sk.xfr_port <= 0 || sk.xfr_port > 65535) {
+        snprintf(sk.errstr, ERR_STR_LEN, "invalid port %d of primary", sk.xfr_port);
+        return ERR_CODE;
+    }
+    if (sk.xfr_zones == NULL || dictSize(sk.xfr_zones) == 0) {
+        snprintf(sk.errstr, ERR_STR_LEN, "zones is empty");
+        return ERR_CODE;
+    }
+    return OK_CODE;
+}
+
+/*!
+ * transfer all zones when starting, the zones failed are retried by reload worker.
+ */
+int xfrGetAllZone(void) {
+    dictIterator *it;
+    dictEntry *de;
+    size_t n = 0;
+    char **names = zmalloc((dictSize(sk.xfr_zones) + 1) * sizeof(char *));
+
+    it = dictGetIterator(sk.xfr_zones);
+    while((de = dictNext(it)) != NULL) names[n++] = dictGetKey(de);
+    dictReleaseIterator(it);
+    reserveZoneTree(names, n);
+    zfree(names);
+
+    it = dictGetIterator(sk.xfr_zones);
+    while((de = dictNext(it)) != NULL) {
+        char *dotOrigin = dictGetKey(de);
+        zoneReloadContext *ctx = zoneReloadContextCreate(dotOrigin);
+        if (ctx == NULL) continue;
+        if (xfrBuildZone(ctx) == OK_CODE) {
+            addZoneAllNumaNodes(ctx->new_zn);
+            ctx->new_zn = NULL;
+        } else {
+            asyncReloadZoneRaw(dotOrigin);
+        }
+        zoneReloadContextDestroy(ctx);
+    }
+    dictReleaseIterator(it);
+    sk.last_all_reload_ts = sk.unixtime;
+    return OK_CODE;
+}
+
+int xfrReloadAllZone(void) {
+    dictIterator *it;
+    dictEntry *de;
+
+    it = dictGetIterator(sk.xfr_zones);
+    while((de = dictNext(it)) != NULL) {
+        // the zone in reloading state is skipped.
+        asyncReloadZoneRaw(dictGetKey(de));
+    }
+    dictReleaseIterator(it);
+    sk.last_all_reload_ts = sk.unixtime;
+    return OK_CODE;
+}
+
+int xfrReloadZone(zoneReloadContext *t) {
+    char origin[MAX_DOMAIN_LEN+2];
+
+    // only the configured zones are served.
+    if (dictFind(sk.xfr_zones, t->dotOrigin) == NULL) {
+        dot2lenlabel(t->dotOrigin, origin);
+        deleteZoneAllNumaNodes(origin);
+        zoneReloadContextDestroy(t);
+        return OK_CODE;
+    }
+    t->build = xfrBuildZone;
+    return reloaderSubmit(t);
+}
+
+void xfrinGetStats(xfrinStats *stats) {
+    pthread_mutex_lock(&xfrin.lock);
+    memcpy(stats, &xfrin.stats, sizeof(*stats));
+    pthread_mutex_unlock(&xfrin.lock);
+}
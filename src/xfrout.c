@@ -0,0 +1,781 @@
+//
+// zone transfer server(AXFR/IXFR over tcp)
+//
+// the tcp server hands the connections carrying AXFR/IXFR queries over to a
+// dedicated thread, so big transfers never stall the dns tcp server and admin.
+// the zone is looked up in a read side critical section and copied, the copy
+// shares the interned RRSets with the zone in label tree, so it is cheap and the
+// messages are streamed from the RRSet wire data without holding the read lock.
+//
+// IXFR is served from a journal of recent changes, the changes are computed by
+// reload worker before the new zone is published, the unchanged RRSets are
+// shared(interned) by the old and new zones, so only the changed RRSets are compared.
+//
+
+#include <ctype.h>
+#include <arpa/inet.h>
+
+#include "shuke.h"
+#include "utils.h"
+
+DEF_LOG_MODULE(RTE_LOGTYPE_USER1, "XFROUT");
+
+// the max size of response message, the same as the default max_resp_size
+#define XFR_OUT_MSG_SIZE 16384
+#define XFR_OUT_CRON_INTERVAL 1000
+
+enum {
+    XFR_OUT_SOA_FIRST = 0,
+    XFR_OUT_BODY,
+    XFR_OUT_SOA_LAST,
+    // IXFR: the RRs in stream
+    XFR_OUT_STREAM,
+    XFR_OUT_DONE,
+};
+
+typedef struct _xfrOutConn {
+    int fd;
+    char cip[IP_STR_LEN];
+    int cport;
+    char *query;
+    size_t query_len;
+
+    uint16_t xid;
+    uint16_t qtype;
+    char question[MAX_DOMAIN_LEN+2+4];
+    size_t question_len;
+    char origin[MAX_DOMAIN_LEN+2];
+
+    // the copy of zone
+    zone *z;
+    int stage;
+    dictIterator *it;
+    dictEntry *de;
+    uint32_t rs_idx;
+    uint16_t rr_idx;
+    uint32_t rr_off;
+    // IXFR: the RRs(uncompressed wire format) to send
+    sds stream;
+    size_t stream_pos;
+
+    // the replies of tcp server not written yet, they are written first.
+    sds pending;
+    // current output, points to pending or msg
+    char *wbuf;
+    size_t wlen;
+    size_t wpos;
+    char msg[2+XFR_OUT_MSG_SIZE];
+    size_t msg_len;
+    uint16_t nr_an;
+    size_t nr_msgs;
+    // the rcode of response, the transfer is DONE if it is not NOERROR.
+    int rcode;
+
+    size_t nr_bytes;
+    long long start_ms;
+    long long last_active_ms;
+    // the timer resuming the transfer paused by rate limit
+    long long timer_id;
+    struct list_head node;
+} xfrOutConn;
+
+// the changes from one serial to the next, data is the IXFR sequence:
+// old SOA, deleted RRs, new SOA, added RRs
+typedef struct _xfrJournalEntry {
+    uint32_t from_sn;
+    uint32_t to_sn;
+    sds data;
+    struct _xfrJournalEntry *next;
+} xfrJournalEntry;
+
+typedef struct {
+    xfrJournalEntry *head;
+    xfrJournalEntry *tail;
+    size_t bytes;
+} xfrJournal;
+
+static struct {
+    pthread_t tid;
+    aeEventLoop *el;
+    // main thread writes a byte to fds[1] after queueing connections to submitted
+    int fds[2];
+    struct list_head conns;
+    rte_atomic32_t nr_active;
+
+    // protects submitted, stats and journals
+    pthread_mutex_t lock;
+    // the connections handed over by main thread, not started yet
+    struct list_head submitted;
+    xfrOutStats stats;
+    // origin(len label) => xfrJournal
+    dict *journals;
+} xfrout = {
+    .fds = {-1, -1},
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+#define XFROUT_STAT_INCR(field, n) do {         \
+    pthread_mutex_lock(&xfrout.lock);           \
+    xfrout.stats.field += (n);                  \
+    pthread_mutex_unlock(&xfrout.lock);         \
+} while(0)
+
+/*----------------------------------------------
+ *     journal
+ *---------------------------------------------*/
+static inline bool journalEnabled(void) {
+    return xfrout.journals != NULL && sk.xfr_out_journal_size > 0;
+}
+
+/*
+ * append a RR in wire format(uncompressed), the owner is key(relative name) + origin.
+ *
+ * @param rr : rdlength + rdata
+ */
+static sds wireCatRR(sds s, zone *z, char *key, uint16_t type, uint32_t ttl, char *rr) {
+    char buf[10];
+    if (strcmp(key, "@") != 0) s = sdscatlen(s, key, strlen(key));
+    s = sdscatlen(s, z->origin, z->originLen + 1);
+    dump16be(type, buf);
+    dump16be(DNS_CLASS_IN, buf + 2);
+    dump32be(ttl, buf + 4);
+    s = sdscatlen(s, buf, 8);
+    return sdscatlen(s, rr, 2 + (size_t)load16be(rr));
+}
+
+// the RRs of rs not in other(or other has a different ttl)
+static sds diffRRSet(sds s, zone *z, char *key, RRSet *rs, RRSet *other, size_t *nr_rrs) {
+    uint32_t offset = 0;
+    bool all = other == NULL || other->ttl != rs->ttl;
+
+    for (int i = 0; i < rs->num; ++i) {
+        char *rr = rs->data + offset;
+        size_t len = 2 + (size_t)load16be(rr);
+        if (all || RRSetFindRR(other, rr, len) < 0) {
+            s = wireCatRR(s, z, key, rs->type, rs->ttl, rr);
+            (*nr_rrs)++;
+        }
+        offset += len;
+    }
+    return s;
+}
+
+static inline bool RRSetEqual(RRSet *a, RRSet *b) {
+    if (a == b) return true;
+    if (a == NULL || b == NULL) return false;
+    return a->type == b->type && a->ttl == b->ttl && a->len == b->len && memcmp(a->data, b->data, a->len) == 0;
+}
+
+/*
+ * the RRs in zone a but not in zone b, the SOA is skipped.
+ * the interned RRSets are shared by a and b if they are not changed,
+ * so most RRSets are skipped by comparing the pointers.
+ */
+static sds diffZone(sds s, zone *a, zone *b, size_t *nr_rrs, size_t limit) {
+    dictIterator *it = dictGetIterator(a->d);
+    dictEntry *de;
+
+    while ((de = dictNext(it)) != NULL && sdslen(s) <= limit) {
+        char *key = dictGetKey(de);
+        dnsDictValue *dv = dictGetVal(de);
+        dnsDictValue *other_dv = dictFetchValue(b->d, key);
+        for (uint32_t i = 0; i < dv->nr_rs; ++i) {
+            RRSet *rs = dv->rsArr[i];
+            RRSet *other = other_dv ? dnsDictValueGet(other_dv, rs->type) : NULL;
+            if (rs->type == DNS_TYPE_SOA || RRSetEqual(rs, other)) continue;
+            s = diffRRSet(s, a, key, rs, other, nr_rrs);
+        }
+    }
+    dictReleaseIterator(it);
+    return s;
+}
+
+static void journalFree(xfrJournal *j) {
+    while (j->head) {
+        xfrJournalEntry *e = j->head;
+        j->head = e->next;
+        sdsfree(e->data);
+        zfree(e);
+    }
+    zfree(j);
+}
+
+// must be called with lock held
+static void __journalDrop(char *origin) {
+    xfrJournal *j = dictFetchValue(xfrout.journals, origin);
+    if (j == NULL) return;
+    for (xfrJournalEntry *e = j->head; e; e = e->next) xfrout.stats.journal_entries--;
+    xfrout.stats.journal_bytes -= j->bytes;
+    dictDelete(xfrout.journals, origin);
+    journalFree(j);
+}
+
+/*!
+ * record the changes between the zone in label tree and new_z, called by reload worker
+ * before new_z is published. the journal is dropped if the serial doesn't increase or
+ * the changes are too big.
+ */
+void xfrJournalRecord(zone *new_z) {
+    zone *old_z;
+    xfrJournalEntry *e = NULL;
+    xfrJournal *j;
+    size_t nr_del = 0, nr_add = 0;
+    size_t limit = (size_t)sk.xfr_out_journal_size;
+
+    if (!journalEnabled() || new_z->soa == NULL) return;
+
+    rcu_thread_online();
+    ltreeRLock(sk.lt);
+    old_z = ltreeGetZoneExactRaw(sk.lt, new_z->origin);
+    if (old_z != NULL && old_z->soa != NULL && serialGt(new_z->sn, old_z->sn)) {
+        e = zcalloc(sizeof(*e));
+        e->from_sn = old_z->sn;
+        e->to_sn = new_z->sn;
+        e->data = wireCatRR(sdsempty(), old_z, "@", DNS_TYPE_SOA, old_z->soa->ttl, old_z->soa->data);
+        e->data = diffZone(e->data, old_z, new_z, &nr_del, limit);
+        e->data = wireCatRR(e->data, new_z, "@", DNS_TYPE_SOA, new_z->soa->ttl, new_z->soa->data);
+        e->data = diffZone(e->data, new_z, old_z, &nr_add, limit);
+        if (sdslen(e->data) > limit) {
+            LOG_INFO("the changes of zone %s are too big for journal.", new_z->dotOrigin);
+            sdsfree(e->data);
+            zfree(e);
+            e = NULL;
+        }
+    }
+    ltreeRUnlock(sk.lt);
+    rcu_thread_offline();
+
+    pthread_mutex_lock(&xfrout.lock);
+    j = dictFetchValue(xfrout.journals, new_z->origin);
+    // the changes must be continuous
+    if (j && (e == NULL || j->tail->to_sn != e->from_sn)) {
+        __journalDrop(new_z->origin);
+        j = NULL;
+    }
+    if (e != NULL) {
+        if (j == NULL) {
+            j = zcalloc(sizeof(*j));
+            dictAdd(xfrout.journals, new_z->origin, j);
+        }
+        if (j->tail) j->tail->next = e;
+        else j->head = e;
+        j->tail = e;
+        j->bytes += sdslen(e->data);
+        xfrout.stats.journal_entries++;
+        xfrout.stats.journal_bytes += sdslen(e->data);
+        // remove the oldest changes
+        while (j->bytes > limit) {
+            xfrJournalEntry *old = j->head;
+            j->head = old->next;
+            j->bytes -= sdslen(old->data);
+            xfrout.stats.journal_entries--;
+            xfrout.stats.journal_bytes -= sdslen(old->data);
+            sdsfree(old->data);
+            zfree(old);
+        }
+        LOG_DEBUG("journal of zone %s: %u -> %u, %lu deleted, %lu added.",
+                  new_z->dotOrigin, e->from_sn, e->to_sn, nr_del, nr_add);
+    }
+    pthread_mutex_unlock(&xfrout.lock);
+}
+
+void xfrJournalDrop(char *origin) {
+    if (!journalEnabled()) return;
+    pthread_mutex_lock(&xfrout.lock);
+    __journalDrop(origin);
+    pthread_mutex_unlock(&xfrout.lock);
+}
+
+/*
+ * get the changes from serial `from` to `to` in IXFR format(without the leading and trailing SOA).
+ *
+ * @return NULL if the journal doesn't cover the serials.
+ */
+static sds journalGetChanges(char *origin, uint32_t from, uint32_t to) {
+    xfrJournal *j;
+    xfrJournalEntry *e;
+    sds s = NULL;
+
+    pthread_mutex_lock(&xfrout.lock);
+    j = dictFetchValue(xfrout.journals, origin);
+    for (e = j ? j->head : NULL; e && e->from_sn != from; e = e->next);
+    if (e != NULL) {
+        s = sdsempty();
+        for (; e; e = e->next) {
+            s = sdscatsds(s, e->data);
+            if (e->to_sn == to) break;
+        }
+        // the journal is ahead of(or behind) the zone
+        if (e == NULL) {
+            sdsfree(s);
+            s = NULL;
+        }
+    }
+    pthread_mutex_unlock(&xfrout.lock);
+    return s;
+}
+
+/*----------------------------------------------
+ *     response messages
+ *---------------------------------------------*/
+static void xfrMsgStart(xfrOutConn *c, int rcode) {
+    uint16_t flag = 0;
+
+    SET_QR_R(flag);
+    SET_AA(flag);
+    SET_ERROR(flag, rcode);
+    dumpDNSHeader(c->msg + 2, DNS_HDR_SIZE, c->xid, flag, 1, 0, 0, 0);
+    memcpy(c->msg + 2 + DNS_HDR_SIZE, c->question, c->question_len);
+    c->msg_len = DNS_HDR_SIZE + c->question_len;
+    c->nr_an = 0;
+}
+
+static void xfrMsgFinish(xfrOutConn *c) {
+    dump16be((uint16_t)c->msg_len, c->msg);
+    dump16be(c->nr_an, c->msg + 2 + 6);
+    c->wbuf = c->msg;
+    c->wlen = c->msg_len + 2;
+    c->wpos = 0;
+}
+
+/*
+ * append a RR of the zone, the owner is compressed by a pointer to the question.
+ *
+ * @return false if the message is full.
+ */
+static bool xfrMsgAppendRR(xfrOutConn *c, char *key, uint16_t type, uint32_t ttl, char *rr) {
+    size_t keyLen = strcmp(key, "@") == 0 ? 0 : strlen(key);
+    size_t rrLen = 2 + (size_t)load16be(rr);
+    char *p = c->msg + 2 + c->msg_len;
+
+    if (c->msg_len + keyLen + 2 + 8 + rrLen > XFR_OUT_MSG_SIZE) return false;
+    memcpy(p, key, keyLen);
+    p += keyLen;
+    dump16be(0xC000 | DNS_HDR_SIZE, p);
+    dump16be(type, p + 2);
+    dump16be(DNS_CLASS_IN, p + 4);
+    dump32be(ttl, p + 6);
+    memcpy(p + 10, rr, rrLen);
+    c->msg_len += keyLen + 10 + rrLen;
+    c->nr_an++;
+    return true;
+}
+
+// the size of a RR(uncompressed wire format)
+static inline size_t wireRRLen(char *rr) {
+    size_t n = lenlabellen(rr) + 1;
+    return n + 10 + load16be(rr + n + 8);
+}
+
+// append the next RR of the transfer, return false if the message is full.
+static bool xfrOutNextRR(xfrOutConn *c) {
+    dnsDictValue *dv;
+    RRSet *rs;
+    size_t len;
+
+    switch (c->stage) {
+    case XFR_OUT_SOA_FIRST:
+    case XFR_OUT_SOA_LAST:
+        if (!xfrMsgAppendRR(c, "@", DNS_TYPE_SOA, c->z->soa->ttl, c->z->soa->data)) return false;
+        c->stage = c->stage == XFR_OUT_SOA_FIRST ? XFR_OUT_BODY : XFR_OUT_DONE;
+        return true;
+    case XFR_OUT_BODY:
+        if (c->de == NULL && (c->de = dictNext(c->it)) == NULL) {
+            c->stage = XFR_OUT_SOA_LAST;
+            return true;
+        }
+        dv = dictGetVal(c->de);
+        if (c->rs_idx >= dv->nr_rs) {
+            c->de = NULL;
+            c->rs_idx = 0;
+            return true;
+        }
+        rs = dv->rsArr[c->rs_idx];
+        if (rs->type == DNS_TYPE_SOA || c->rr_idx >= rs->num) {
+            c->rs_idx++;
+            c->rr_idx = 0;
+            c->rr_off = 0;
+            return true;
+        }
+        if (!xfrMsgAppendRR(c, dictGetKey(c->de), rs->type, rs->ttl, rs->data + c->rr_off)) return false;
+        c->rr_off += 2 + load16be(rs->data + c->rr_off);
+        c->rr_idx++;
+        return true;
+    case XFR_OUT_STREAM:
+        if (c->stream_pos >= sdslen(c->stream)) {
+            c->stage = XFR_OUT_DONE;
+            return true;
+        }
+        len = wireRRLen(c->stream + c->stream_pos);
+        if (c->msg_len + len > XFR_OUT_MSG_SIZE) return false;
+        memcpy(c->msg + 2 + c->msg_len, c->stream + c->stream_pos, len);
+        c->msg_len += len;
+        c->nr_an++;
+        c->stream_pos += len;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void xfrOutFillMsg(xfrOutConn *c) {
+    xfrMsgStart(c, c->rcode);
+    while (c->stage != XFR_OUT_DONE && xfrOutNextRR(c));
+    xfrMsgFinish(c);
+}
+
+/*----------------------------------------------
+ *     transfer thread
+ *---------------------------------------------*/
+static void xfrOutConnDestroy(xfrOutConn *c) {
+    if (c->fd >= 0) {
+        if (xfrout.el) aeDeleteFileEvent(xfrout.el, c->fd, AE_READABLE|AE_WRITABLE);
+        close(c->fd);
+    }
+    if (c->timer_id >= 0) aeDeleteTimeEvent(xfrout.el, c->timer_id);
+    if (c->node.next) list_del(&c->node);
+    if (c->it) dictReleaseIterator(c->it);
+    zoneDestroy(c->z);
+    sdsfree(c->stream);
+    sdsfree(c->pending);
+    zfree(c->query);
+    zfree(c);
+    rte_atomic32_dec(&xfrout.nr_active);
+}
+
+static void xfrOutWriteHandler(aeEventLoop *el, int fd, void *privdata, int mask);
+
+static int xfrOutResume(struct aeEventLoop *el, long long id, void *clientData) {
+    UNUSED(id);
+    xfrOutConn *c = clientData;
+
+    c->timer_id = -1;
+    c->last_active_ms = mstime();
+    if (aeCreateFileEvent(el, c->fd, AE_WRITABLE, xfrOutWriteHandler, c) == AE_ERR) {
+        LOG_ERROR("can't create file event for zone transfer.");
+        XFROUT_STAT_INCR(nr_failed, 1);
+        xfrOutConnDestroy(c);
+    }
+    return AE_NOMORE;
+}
+
+/*
+ * pause the transfer if it is faster than rate_limit(KB/s).
+ *
+ * @return true if the transfer is paused.
+ */
+static bool xfrOutThrottle(xfrOutConn *c) {
+    long long rate = sk.xfr_out_rate_limit * 1024LL;
+    long long allowed, delay;
+
+    if (rate <= 0) return false;
+    allowed = rate * (mstime() - c->start_ms) / 1000 + XFR_OUT_MSG_SIZE;
+    if ((long long)c->nr_bytes <= allowed) return false;
+
+    delay = ((long long)c->nr_bytes - allowed) * 1000 / rate + 1;
+    aeDeleteFileEvent(xfrout.el, c->fd, AE_WRITABLE);
+    c->timer_id = aeCreateTimeEvent(xfrout.el, delay, xfrOutResume, c, NULL);
+    if (c->timer_id == AE_ERR) {
+        c->timer_id = -1;
+        return false;
+    }
+    return true;
+}
+
+static void xfrOutWriteHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
+    UNUSED2(el, mask);
+    xfrOutConn *c = privdata;
+    ssize_t n;
+
+    while (true) {
+        if (c->wpos == c->wlen) {
+            if (c->stage == XFR_OUT_DONE && c->nr_msgs > 0) {
+                if (c->rcode == DNS_RCODE_OK) LOG_INFO("%s of zone %s to %s:%d finished, %lu bytes, %lld ms.",
+                         c->qtype == DNS_TYPE_IXFR ? "IXFR" : "AXFR", c->z ? c->z->dotOrigin : "-",
+                         c->cip, c->cport, c->nr_bytes, mstime() - c->start_ms);
+                XFROUT_STAT_INCR(nr_bytes, c->nr_bytes);
+                xfrOutConnDestroy(c);
+                return;
+            }
+            if (xfrOutThrottle(c)) return;
+            xfrOutFillMsg(c);
+            c->nr_msgs++;
+        }
+        n = write(fd, c->wbuf + c->wpos, c->wlen - c->wpos);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            LOG_WARN("zone transfer to %s:%d failed: %s.", c->cip, c->cport, strerror(errno));
+            XFROUT_STAT_INCR(nr_failed, 1);
+            XFROUT_STAT_INCR(nr_bytes, c->nr_bytes);
+            xfrOutConnDestroy(c);
+            return;
+        }
+        c->wpos += (size_t)n;
+        c->nr_bytes += (size_t)n;
+        c->last_active_ms = mstime();
+    }
+}
+
+// skip a domain name(may be compressed), return the bytes it occupies.
+static int skipName(char *buf, size_t size, size_t offset) {
+    size_t pos = offset;
+
+    while (pos < size) {
+        uint8_t len = (uint8_t)buf[pos];
+        if ((len & 0xC0) == 0xC0) return pos + 2 <= size ? (int)(pos + 2 - offset) : ERR_CODE;
+        if ((len & 0xC0) != 0) return ERR_CODE;
+        pos += (size_t)len + 1;
+        if (len == 0) return pos <= size ? (int)(pos - offset) : ERR_CODE;
+    }
+    return ERR_CODE;
+}
+
+/*
+ * parse the query, find the zone and decide how to answer it.
+ * the SOA serial of client is in the authority section of IXFR query(RFC 1995).
+ */
+static int xfrOutPrepare(xfrOutConn *c) {
+    dnsHeader_t hdr;
+    char *name;
+    uint16_t qclass;
+    uint32_t serial = 0;
+    size_t offset;
+    int n;
+    zone *z;
+
+    dnsHeader_load(c->query, c->query_len, &hdr);
+    n = parseDnsQuestion(c->query + DNS_HDR_SIZE, c->query_len - DNS_HDR_SIZE, &name, &c->qtype, &qclass);
+    if (n == ERR_CODE) return ERR_CODE;
+    c->xid = hdr.xid;
+    memcpy(c->question, name, (size_t)n);
+    c->question_len = (size_t)n;
+    memcpy(c->origin, name, (size_t)n - 4);
+    strtolower(c->origin);
+
+    if (c->qtype == DNS_TYPE_IXFR) {
+        offset = DNS_HDR_SIZE + (size_t)n;
+        if (hdr.nNsRR < 1 || (n = skipName(c->query, c->query_len, offset)) == ERR_CODE) goto formerr;
+        offset += (size_t)n;
+        if (offset + 10 > c->query_len || load16be(c->query + offset) != DNS_TYPE_SOA) goto formerr;
+        size_t rdlength = load16be(c->query + offset + 8);
+        offset += 10;
+        if (rdlength < 22 || offset + rdlength > c->query_len) goto formerr;
+        serial = load32be(c->query + offset + rdlength - 20);
+    }
+
+    rcu_thread_online();
+    ltreeRLock(sk.lt);
+    z = ltreeGetZoneExactRaw(sk.lt, c->origin);
+    c->z = z ? zoneCopy(z, sk.master_numa_id) : NULL;
+    ltreeRUnlock(sk.lt);
+    rcu_thread_offline();
+
+    if (c->z == NULL || c->z->soa == NULL) {
+        LOG_INFO("zone transfer of %s from %s:%d refused: not authoritative.", c->origin, c->cip, c->cport);
+        XFROUT_STAT_INCR(nr_failed, 1);
+        c->rcode = DNS_RCODE_NOTAUTH;
+        c->stage = XFR_OUT_DONE;
+        return OK_CODE;
+    }
+    z = c->z;
+    if (c->qtype == DNS_TYPE_IXFR) {
+        if (!serialGt(z->sn, serial)) {
+            c->stream = wireCatRR(sdsempty(), z, "@", DNS_TYPE_SOA, z->soa->ttl, z->soa->data);
+            c->stage = XFR_OUT_STREAM;
+            XFROUT_STAT_INCR(nr_up_to_date, 1);
+            return OK_CODE;
+        }
+        sds changes = journalEnabled() ? journalGetChanges(c->origin, serial, z->sn) : NULL;
+        if (changes != NULL) {
+            c->stream = wireCatRR(sdsempty(), z, "@", DNS_TYPE_SOA, z->soa->ttl, z->soa->data);
+            c->stream = sdscatsds(c->stream, changes);
+            c->stream = wireCatRR(c->stream, z, "@", DNS_TYPE_SOA, z->soa->ttl, z->soa->data);
+            sdsfree(changes);
+            c->stage = XFR_OUT_STREAM;
+            XFROUT_STAT_INCR(nr_ixfr, 1);
+            LOG_INFO("IXFR of zone %s to %s:%d: serial %u -> %u.", z->dotOrigin, c->cip, c->cport, serial, z->sn);
+            return OK_CODE;
+        }
+        // the journal doesn't cover the serial of client, send the full zone.
+        XFROUT_STAT_INCR(nr_ixfr_fallback, 1);
+    } else {
+        XFROUT_STAT_INCR(nr_axfr, 1);
+    }
+    c->it = dictGetIterator(z->d);
+    c->stage = XFR_OUT_SOA_FIRST;
+    LOG_INFO("AXFR of zone %s to %s:%d: serial %u.", z->dotOrigin, c->cip, c->cport, z->sn);
+    return OK_CODE;
+
+formerr:
+    c->rcode = DNS_RCODE_FORMERR;
+    c->stage = XFR_OUT_DONE;
+    return OK_CODE;
+}
+
+static void xfrOutStart(xfrOutConn *c) {
+    c->start_ms = c->last_active_ms = mstime();
+    list_add_tail(&c->node, &xfrout.conns);
+
+    if (xfrOutPrepare(c) == ERR_CODE) {
+        XFROUT_STAT_INCR(nr_failed, 1);
+        xfrOutConnDestroy(c);
+        return;
+    }
+    // the pending replies of tcp server are written before the transfer.
+    c->wbuf = c->pending;
+    c->wlen = sdslen(c->pending);
+    if (aeCreateFileEvent(xfrout.el, c->fd, AE_WRITABLE, xfrOutWriteHandler, c) == AE_ERR) {
+        LOG_ERROR("can't create file event for zone transfer.");
+        XFROUT_STAT_INCR(nr_failed, 1);
+        xfrOutConnDestroy(c);
+    }
+}
+
+static void xfrOutStartSubmitted(void) {
+    struct list_head *pos, *temp;
+    struct list_head submitted;
+
+    INIT_LIST_HEAD(&submitted);
+    pthread_mutex_lock(&xfrout.lock);
+    list_for_each_safe(pos, temp, &xfrout.submitted) {
+        list_del(pos);
+        list_add_tail(pos, &submitted);
+    }
+    pthread_mutex_unlock(&xfrout.lock);
+
+    list_for_each_safe(pos, temp, &submitted) {
+        list_del(pos);
+        xfrOutStart(list_entry(pos, xfrOutConn, node));
+    }
+}
+
+static void xfrOutReadHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
+    UNUSED3(el, privdata, mask);
+    char buf[64];
+
+    while (read(fd, buf, sizeof(buf)) > 0);
+    xfrOutStartSubmitted();
+}
+
+static int xfrOutCron(struct aeEventLoop *el, long long id, void *clientData) {
+    UNUSED3(el, id, clientData);
+    struct list_head *pos, *temp;
+    long long now = mstime();
+
+    // in case the wakeup of main thread is lost.
+    xfrOutStartSubmitted();
+
+    list_for_each_safe(pos, temp, &xfrout.conns) {
+        xfrOutConn *c = list_entry(pos, xfrOutConn, node);
+        // the transfers paused by rate limit are not idle.
+        if (c->timer_id >= 0 || now - c->last_active_ms < sk.xfr_out_timeout * 1000LL) continue;
+        LOG_WARN("zone transfer to %s:%d timeout.", c->cip, c->cport);
+        XFROUT_STAT_INCR(nr_failed, 1);
+        XFROUT_STAT_INCR(nr_bytes, c->nr_bytes);
+        xfrOutConnDestroy(c);
+    }
+    return XFR_OUT_CRON_INTERVAL;
+}
+
+static void *xfrOutThreadMain(void *arg) {
+    UNUSED(arg);
+
+    // the thread only reads the label tree when a transfer starts.
+    rcu_register_thread();
+    rcu_thread_offline();
+    aeMain(xfrout.el);
+    rcu_unregister_thread();
+    return NULL;
+}
+
+/*----------------------------------------------
+ *     main thread
+ *---------------------------------------------*/
+/*!
+ * check AXFR/IXFR query, called by tcp server or lcores(udp).
+ * transfers are only served over tcp by transfer thread.
+ *
+ * @return XFR_CODE if the connection should be handed over to transfer thread,
+ *         otherwise the error response is dumped.
+ */
+int processXfrQuery(struct context *ctx) {
+    if (sk.nr_xfr_out_allow == 0 || ctx->resp_type == RESP_MBUF) {
+        return dumpDnsError(ctx, DNS_RCODE_NOTIMPL);
+    }
+    for (int i = 0; i < sk.nr_xfr_out_allow; ++i) {
+        if (addrPrefixMatch(&sk.xfr_out_allow[i], ctx->src_addr, ctx->src_ipv4)) return XFR_CODE;
+    }
+    XFROUT_STAT_INCR(nr_refused, 1);
+    return dumpDnsError(ctx, DNS_RCODE_REFUSED);
+}
+
+/*!
+ * hand the tcp connection over to transfer thread, must be called in main thread.
+ *
+ * @return ERR_CODE if there are too many transfers, the connection is untouched,
+ *         otherwise the connection is released.
+ */
+int xfrOutSubmit(tcpConn *conn, char *query, size_t len) {
+    xfrOutConn *c;
+
+    if (rte_atomic32_read(&xfrout.nr_active) >= sk.xfr_out_max_transfers) {
+        LOG_WARN("too many zone transfers, refuse %s:%d.", conn->cip, conn->cport);
+        XFROUT_STAT_INCR(nr_busy, 1);
+        return ERR_CODE;
+    }
+    rte_atomic32_inc(&xfrout.nr_active);
+
+    c = zcalloc(sizeof(*c));
+    c->timer_id = -1;
+    c->query = zmemdup(query, len);
+    c->query_len = len;
+    snprintf(c->cip, sizeof(c->cip), "%s", conn->cip);
+    c->cport = conn->cport;
+    c->pending = sdsempty();
+    c->fd = tcpConnDetach(conn, &c->pending);
+
+    // the connection is owned by transfer thread from now on, it is started
+    // or destroyed there.
+    pthread_mutex_lock(&xfrout.lock);
+    list_add_tail(&c->node, &xfrout.submitted);
+    pthread_mutex_unlock(&xfrout.lock);
+
+    // the pipe is non-blocking, if it is full, transfer thread will be woken up anyway.
+    if (write(xfrout.fds[1], "x", 1) < 0 && errno != EAGAIN) {
+        LOG_WARN("can't wakeup transfer thread: %s.", strerror(errno));
+    }
+    return OK_CODE;
+}
+
+void xfrOutGetStats(xfrOutStats *stats) {
+    pthread_mutex_lock(&xfrout.lock);
+    memcpy(stats, &xfrout.stats, sizeof(*stats));
+    pthread_mutex_unlock(&xfrout.lock);
+    stats->nr_active = (size_t)rte_atomic32_read(&xfrout.nr_active);
+}
+
+int initXfrOut(void) {
+    rte_atomic32_init(&xfrout.nr_active);
+    INIT_LIST_HEAD(&xfrout.conns);
+    INIT_LIST_HEAD(&xfrout.submitted);
+    xfrout.journals = dictCreate(&dictTypeCaseStringCopyKey, NULL, SOCKET_ID_HEAP);
+
+    if (pipe(xfrout.fds) < 0) {
+        LOG_ERROR("can't create pipe: %s.", strerror(errno));
+        return ERR_CODE;
+    }
+    anetNonBlock(NULL, xfrout.fds[0]);
+    anetNonBlock(NULL, xfrout.fds[1]);
+
+    xfrout.el = aeCreateEventLoop(1024, true);
+    if (aeCreateFileEvent(xfrout.el, xfrout.fds[0], AE_READABLE, xfrOutReadHandler, NULL) == AE_ERR ||
+        aeCreateTimeEvent(xfrout.el, XFR_OUT_CRON_INTERVAL, xfrOutCron, NULL, NULL) == AE_ERR) {
+        LOG_ERROR("can't create events for zone transfer thread.");
+        return ERR_CODE;
+    }
+    if (pthread_create(&xfrout.tid, NULL, xfrOutThreadMain, NULL) != 0) {
+        LOG_ERROR("can't create zone transfer thread.");
+        return ERR_CODE;
+    }
+    return OK_CODE;
+}
@@ -3,107 +3,131 @@
 //
 
 #include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
 #include <assert.h>
+#include <pthread.h>
+#include <time.h>
 #include <arpa/inet.h>
 
 #include "endianconv.h"
 #include "zmalloc.h"
 #include "sds.h"
 #include "str.h"
+#include "utils.h"
 #include "dict.h"
 #include "protocol.h"
 #include "log.h"
 #include "zone.h"
+#include "view.h"
 
 DEF_LOG_MODULE(RTE_LOGTYPE_USER1, "ZONE");
 
 #define RRSET_MAX_PREALLOC (1024*1024)
 
 extern int checkLenLabel(char *name, size_t max);
+extern char *qtypeToStr(int ty, char *buf, size_t size);
+
+/*
+ * RRSet pool, one pool per NUMA node.
+ * the pool is modified by main thread(intern) and call_rcu worker(release),
+ * so all operations should hold the lock.
+ */
+#define RRSET_POOL_MAX_SOCKETS  (32)
+
+typedef struct _RRSetPool {
+    pthread_mutex_t lock;
+    dict *d;
+    size_t nr_refs;
+    size_t bytes;
+} RRSetPool;
+
+static RRSetPool pools[RRSET_POOL_MAX_SOCKETS];
+
+static inline RRSetPool *getRRSetPool(int socket_id) {
+    if (socket_id < 0 || socket_id >= RRSET_POOL_MAX_SOCKETS) return NULL;
+    return &pools[socket_id];
+}
 
 dnsDictValue *dnsDictValueCreate(int socket_id) {
     dnsDictValue *dv = socket_calloc(socket_id, 1, sizeof(*dv));
+    dv->refcnt = 1;
     return dv;
 }
 
+// the signatures are not copied, the copy must be compacted before serving.
 dnsDictValue *dnsDictValueDup(dnsDictValue *dv, int socket_id) {
-    dnsDictValue *new_dv = socket_memdup(socket_id, dv, sizeof(*dv));
-    for (int i = 0; i < SUPPORT_TYPE_NUM; ++i) {
-        if (dv->v.rsArr[i]) {
-            new_dv->v.rsArr[i] = RRSetDup(dv->v.rsArr[i], socket_id);
-        }
+    size_t sz = sizeof(*dv) + dv->nr_rs * sizeof(RRSet *);
+    dnsDictValue *new_dv = socket_memdup(socket_id, dv, sz);
+    new_dv->sigmap = 0;
+    new_dv->refcnt = 1;
+    for (uint32_t i = 0; i < dv->nr_rs; ++i) {
+        new_dv->rsArr[i] = RRSetShare(dv->rsArr[i], socket_id);
     }
     return new_dv;
 }
 
+static void dnsDictValueDropSigs(dnsDictValue *dv) {
+    int nr_sigs = __builtin_popcount(dv->sigmap);
+    for (int i = 0; i < nr_sigs; ++i) {
+        RRSetDestroy(dv->rsArr[dv->nr_rs + i]);
+    }
+    dv->sigmap = 0;
+}
+
 void dnsDictValueDestroy(dnsDictValue *dv, int socket_id) {
     if (dv == NULL) return;
-    for (int i = 0; i < SUPPORT_TYPE_NUM; ++i) {
-        RRSet *rs = dv->v.rsArr[i];
-        RRSetDestroy(rs);
+    // the value is shared by other copies of the zone, the last one frees it.
+    if (dv->refcnt > 1 && uatomic_sub_return(&dv->refcnt, 1) > 0) return;
+    dnsDictValueDropSigs(dv);
+    for (uint32_t i = 0; i < dv->nr_rs; ++i) {
+        RRSetDestroy(dv->rsArr[i]);
     }
     socket_free(socket_id, dv);
 }
 
-RRSet *dnsDictValueGet(dnsDictValue *dv, int type) {
-    switch (type) {
-        case DNS_TYPE_A:
-            return dv->v.tv.A;
-        case DNS_TYPE_NS:
-            return dv->v.tv.NS;
-        case DNS_TYPE_CNAME:
-            return dv->v.tv.CNAME;
-        case DNS_TYPE_SOA:
-            return dv->v.tv.SOA;
-        case DNS_TYPE_MX:
-            return dv->v.tv.MX;
-        case DNS_TYPE_TXT:
-            return dv->v.tv.TXT;
-        case DNS_TYPE_AAAA:
-            return dv->v.tv.AAAA;
-        case DNS_TYPE_SRV:
-            return dv->v.tv.SRV;
-        // case DNS_TYPE_PTR:
-        //     return dv->v.tv.PTR;
-        default:
-            LOG_FATAL("invalid RR type");
+/*!
+ * set the RRSet of rs->type, the old RRSet(if any) is replaced, but not freed.
+ *
+ * @return the dnsDictValue object may be reallocated, so always use the return value.
+ */
+dnsDictValue *dnsDictValueSet(dnsDictValue *dv, RRSet *rs, int socket_id) {
+    if (rs == NULL) return dv;
+
+    int slot = dnsTypeToSlot(rs->type);
+    if (slot < 0) {
+        LOG_FATAL("invalid RR type %d", rs->type);
+    }
+    uint32_t bit = 1U << slot;
+    uint32_t idx = (uint32_t)__builtin_popcount(dv->bitmap & (bit - 1));
+    dnsDictValueDropSigs(dv);
+    if (dv->bitmap & bit) {
+        dv->rsArr[idx] = rs;
+        return dv;
     }
+    dv = socket_realloc(socket_id, dv, sizeof(*dv) + (dv->nr_rs + 1) * sizeof(RRSet *));
+    memmove(dv->rsArr+idx+1, dv->rsArr+idx, (dv->nr_rs - idx) * sizeof(RRSet *));
+    dv->rsArr[idx] = rs;
+    dv->bitmap |= (uint16_t)bit;
+    dv->nr_rs++;
+    return dv;
 }
 
-void dnsDictValueSet(dnsDictValue *dv, RRSet *rs) {
-    if (rs == NULL) return;
+static dnsViewValue *dnsViewValueDup(dnsViewValue *vv, int socket_id) {
+    size_t sz = sizeof(*vv) + vv->nr * sizeof(dnsViewEntry);
+    dnsViewValue *new_vv = socket_memdup(socket_id, vv, sz);
+    for (uint32_t i = 0; i < vv->nr; ++i) {
+        new_vv->views[i].dv = dnsDictValueDup(vv->views[i].dv, socket_id);
+    }
+    return new_vv;
+}
 
-    switch (rs->type) {
-        case DNS_TYPE_A:
-            dv->v.tv.A = rs;
-            break;
-        case DNS_TYPE_NS:
-            dv->v.tv.NS = rs;
-            break;
-        case DNS_TYPE_CNAME:
-            dv->v.tv.CNAME= rs;
-            break;
-        case DNS_TYPE_SOA:
-            dv->v.tv.SOA = rs;
-            break;
-        case DNS_TYPE_MX:
-            dv->v.tv.MX = rs;
-            break;
-        case DNS_TYPE_TXT:
-            dv->v.tv.TXT = rs;
-            break;
-        case DNS_TYPE_AAAA:
-            dv->v.tv.AAAA = rs;
-            break;
-        case DNS_TYPE_SRV:
-            dv->v.tv.SRV = rs;
-            break;
-        // case DNS_TYPE_PTR:
-        //     dv->v.tv.PTR = rs;
-        //     break;
-        default:
-            LOG_FATAL("invalid RR type");
+static void dnsViewValueDestroy(dnsViewValue *vv, int socket_id) {
+    if (vv == NULL) return;
+    for (uint32_t i = 0; i < vv->nr; ++i) {
+        dnsDictValueDestroy(vv->views[i].dv, socket_id);
     }
+    socket_free(socket_id, vv);
 }
 
 /*----------------------------------------------
@@ -111,37 +135,158 @@ void dnsDictValueSet(dnsDictValue *dv, RRSet *rs) {
  *---------------------------------------------*/
 RRSet *RRSetCreate(uint16_t type, int socket_id) {
     RRSet *rs = socket_calloc(socket_id, 1, sizeof(*rs));
-    rs->socket_id = socket_id;
+    rs->socket_id = (int16_t)socket_id;
     rs->type = type;
+    rs->refcnt = 1;
     return rs;
 }
 
+/*
+ * the returned RRSet is always a private(mutable) copy.
+ */
 RRSet *RRSetDup(RRSet *rs, int socket_id) {
     size_t sz = sizeof(*rs) + rs->len + rs->free;
     RRSet *new = socket_malloc(socket_id, sz);
     rte_memcpy(new, rs, sz);
-    new->socket_id = socket_id;
-    new->offsets = NULL;
+    new->socket_id = (int16_t)socket_id;
+    new->flags &= ~RRSET_F_INTERNED;
+    new->refcnt = 1;
     return new;
 }
 
-void RRSetUpdateOffsets(RRSet *rs) {
-    if (rs == NULL) return;
+/*!
+ * get a read-only reference of rs on the specified NUMA node,
+ * mainly used to copy zone, interned RRSet on the same node is shared.
+ */
+RRSet *RRSetShare(RRSet *rs, int socket_id) {
+    if ((rs->flags & RRSET_F_INTERNED) && rs->socket_id == socket_id) {
+        RRSetPool *pool = getRRSetPool(socket_id);
+        pthread_mutex_lock(&pool->lock);
+        rs->refcnt++;
+        pool->nr_refs++;
+        pthread_mutex_unlock(&pool->lock);
+        return rs;
+    }
+    RRSet *new = RRSetDup(rs, socket_id);
+    if (rs->flags & RRSET_F_INTERNED) new = RRSetIntern(new);
+    return new;
+}
 
-    int i;
-    size_t offset = 0;
-    uint16_t rdlength;
-    char *ptr = rs->data;
+/*!
+ * remove the free space and store the offset array inline,
+ * the RRSet is read-only after compaction.
+ *
+ * @return the RRSet object may be reallocated, so always use the return value.
+ */
+RRSet *RRSetCompact(RRSet *rs) {
+    if (rs == NULL) return NULL;
 
-    assert(rs->offsets == NULL);
-    rs->offsets = socket_malloc(rs->socket_id, rs->num * sizeof(size_t));
+    uint32_t pos = RRSET_OFFSETS_POS(rs->len);
+    uint32_t free = (uint32_t)(pos - rs->len + rs->num * sizeof(uint16_t));
+    uint16_t *offsets;
+    uint16_t rdlength;
+    uint32_t offset = 0;
 
-    for (i = 0; i < rs->num; ++i) {
-        rs->offsets[i] = offset;
-        rdlength = load16be(ptr);
-        ptr += (2 + rdlength);
+    assert(rs->len <= RRSET_MAX_LEN);
+    if (rs->free != free) {
+        rs = socket_realloc(rs->socket_id, rs, sizeof(*rs) + rs->len + free);
+        rs->free = free;
+    }
+    offsets = (uint16_t *)(rs->data + pos);
+    for (int i = 0; i < rs->num; ++i) {
+        offsets[i] = (uint16_t)offset;
+        rdlength = load16be(rs->data + offset);
         offset += (2 + rdlength);
     }
+    rs->hash = dictGenHashFunction(rs->data, (int)rs->len) ^ ((uint32_t)rs->type << 16) ^ rs->ttl;
+    return rs;
+}
+
+/*----------------------------------------------
+ *     RRSet pool(interning)
+ *---------------------------------------------*/
+static unsigned int _RRSetPoolHash(const void *key) {
+    return ((const RRSet *)key)->hash;
+}
+
+static int _RRSetPoolKeyCompare(void *privdata, const void *key1, const void *key2) {
+    DICT_NOTUSED(privdata);
+    const RRSet *rs1 = key1, *rs2 = key2;
+    return rs1->type == rs2->type && rs1->ttl == rs2->ttl &&
+           rs1->num == rs2->num && rs1->len == rs2->len &&
+           memcmp(rs1->data, rs2->data, rs1->len) == 0;
+}
+
+static dictType RRSetPoolDictType = {
+        _RRSetPoolHash,                /* hash function */
+        NULL,                          /* key dup */
+        NULL,                          /* val dup */
+        _RRSetPoolKeyCompare,          /* key compare */
+        NULL,                          /* key destructor */
+        NULL,                          /* val destructor */
+};
+
+/*!
+ * intern a compacted RRSet, if an identical RRSet already exists in the pool
+ * of the same NUMA node, rs is freed and the existing one is returned.
+ *
+ * @param rs: a compacted private RRSet, the caller shouldn't use it after this call.
+ * @return the shared RRSet, the caller owns one reference.
+ */
+RRSet *RRSetIntern(RRSet *rs) {
+    RRSetPool *pool = getRRSetPool(rs->socket_id);
+    if (pool == NULL) return rs;
+    assert(!(rs->flags & RRSET_F_INTERNED));
+
+    RRSet *shared;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->d == NULL) {
+        pool->d = dictCreate(&RRSetPoolDictType, NULL, rs->socket_id);
+    }
+    dictEntry *de = dictFind(pool->d, rs);
+    if (de != NULL) {
+        shared = dictGetKey(de);
+        shared->refcnt++;
+    } else {
+        shared = rs;
+        shared->flags |= RRSET_F_INTERNED;
+        shared->refcnt = 1;
+        dictAdd(pool->d, shared, NULL);
+        pool->bytes += sizeof(*shared) + shared->len + shared->free;
+    }
+    pool->nr_refs++;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (shared != rs) socket_free(rs->socket_id, rs);
+    return shared;
+}
+
+static void RRSetRelease(RRSet *rs) {
+    RRSetPool *pool = getRRSetPool(rs->socket_id);
+    bool need_free = false;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->nr_refs--;
+    if (--rs->refcnt == 0) {
+        dictDelete(pool->d, rs);
+        pool->bytes -= sizeof(*rs) + rs->len + rs->free;
+        need_free = true;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (need_free) socket_free(rs->socket_id, rs);
+}
+
+void RRSetPoolGetStats(int socket_id, size_t *nr_rrsets, size_t *nr_refs, size_t *bytes) {
+    RRSetPool *pool = getRRSetPool(socket_id);
+    *nr_rrsets = *nr_refs = *bytes = 0;
+    if (pool == NULL) return;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->d) *nr_rrsets = dictSize(pool->d);
+    *nr_refs = pool->nr_refs;
+    *bytes = pool->bytes;
+    pthread_mutex_unlock(&pool->lock);
 }
 
 RRSet* RRSetMakeRoomFor(RRSet *rs, size_t addlen) {
@@ -162,13 +307,6 @@ RRSet* RRSetMakeRoomFor(RRSet *rs, size_t addlen) {
     return new_rs;
 }
 
-RRSet *RRSetRemoveFreeSpace(RRSet *rs) {
-    if (rs->free == 0) return rs;
-    RRSet *new = socket_realloc(rs->socket_id, rs, sizeof(*rs)+rs->len);
-    new->free = 0;
-    return new;
-}
-
 RRSet *RRSetCat(RRSet *rs, char *buf, size_t len) {
     RRSet *new = RRSetMakeRoomFor(rs, len);
     rte_memcpy(new->data+new->len, buf, len);
@@ -178,12 +316,94 @@ RRSet *RRSetCat(RRSet *rs, char *buf, size_t len) {
     return new;
 }
 
+/*!
+ * find a RR in RRSet.
+ *
+ * @param rr : the RR in RRSet format(rdlength + rdata)
+ * @return the index of the RR, -1 if not found.
+ */
+int RRSetFindRR(RRSet *rs, char *rr, size_t len) {
+    uint32_t offset = 0;
+    uint16_t rdlength;
+
+    for (int i = 0; i < rs->num; ++i) {
+        rdlength = load16be(rs->data + offset);
+        if ((size_t)rdlength + 2 == len && memcmp(rs->data + offset, rr, len) == 0) return i;
+        offset += (2 + rdlength);
+    }
+    return -1;
+}
+
+/*!
+ * remove the idx-th RR, rs must be a private(not interned) RRSet.
+ * the RRSet needs compaction again after this call.
+ */
+void RRSetDelRR(RRSet *rs, int idx) {
+    uint32_t offset = 0;
+    uint32_t rrlen;
+
+    assert(!(rs->flags & RRSET_F_INTERNED) && idx < rs->num);
+    for (int i = 0; i < idx; ++i) offset += 2 + load16be(rs->data + offset);
+    rrlen = 2U + load16be(rs->data + offset);
+    memmove(rs->data + offset, rs->data + offset + rrlen, rs->len - offset - rrlen);
+    rs->num--;
+    rs->len -= rrlen;
+    rs->free += rrlen;
+}
+
 void RRSetDestroy(RRSet *rs) {
     if (rs == NULL) return;
-    socket_free(rs->socket_id, rs->offsets);
+    if (rs->flags & RRSET_F_INTERNED) {
+        RRSetRelease(rs);
+        return;
+    }
     socket_free(rs->socket_id, rs);
 }
 
+static sds catBase64(sds s, const char *data, size_t len) {
+    char *b64 = zmalloc((len + 2) / 3 * 4 + 1);
+    binToBase64(data, len, b64);
+    s = sdscat(s, b64);
+    zfree(b64);
+    return s;
+}
+
+static sds catSalt(sds s, const char *salt) {
+    uint8_t len = (uint8_t)salt[0];
+    if (len == 0) return sdscat(s, " -");
+    s = sdscat(s, " ");
+    for (int i = 1; i <= len; ++i) s = sdscatprintf(s, "%02X", (uint8_t)salt[i]);
+    return s;
+}
+
+// the type bitmap of NSEC and NSEC3
+static sds catTypeBitmap(sds s, const char *p, size_t len) {
+    char buf[16];
+    size_t i = 0;
+
+    while (i + 2 <= len) {
+        int window = (uint8_t)p[i], n = (uint8_t)p[i+1];
+        for (int j = 0; j < n && i + 2 + j < len; ++j) {
+            uint8_t bits = (uint8_t)p[i+2+j];
+            for (int k = 0; k < 8; ++k) {
+                if (bits & (0x80 >> k)) s = sdscatprintf(s, " %s", qtypeToStr(window * 256 + j * 8 + k, buf, sizeof(buf)));
+            }
+        }
+        i += 2 + n;
+    }
+    return s;
+}
+
+static sds catSigTime(sds s, uint32_t t) {
+    time_t tt = (time_t)t;
+    struct tm tm;
+    char buf[32];
+
+    gmtime_r(&tt, &tm);
+    strftime(buf, sizeof(buf), "%Y%m%d%H%M%S", &tm);
+    return sdscatprintf(s, " %s", buf);
+}
+
 sds RRSetToStr(RRSet *rs) {
     sds s = sdsempty();
     if (rs == NULL) return s;
@@ -312,6 +532,91 @@ sds RRSetToStr(RRSet *rs) {
                 data += (2 + rdlength);
             }
             break;
+        case DNS_TYPE_CAA:
+            for(i = 0; i < rs->num; ++i) {
+                rdlength = load16be(data);
+                uint8_t flags = (uint8_t)data[2];
+                uint8_t tagLen = (uint8_t)data[3];
+                int valueLen = rdlength - 2 - tagLen;
+
+                s = sdscatprintf(s, " %d IN CAA %d %.*s \"%.*s\"\n", rs->ttl, flags,
+                                 tagLen, data+4, valueLen, data+4+tagLen);
+                data += (2 + rdlength);
+            }
+            break;
+        case DNS_TYPE_DS:
+            for(i = 0; i < rs->num; ++i) {
+                rdlength = load16be(data);
+                uint16_t keyTag = load16be(data+2);
+                uint8_t alg = (uint8_t)data[4];
+                uint8_t digestType = (uint8_t)data[5];
+
+                s = sdscatprintf(s, " %d IN DS %d %d %d ", rs->ttl, keyTag, alg, digestType);
+                for (int j = 6; j < rdlength+2; ++j) {
+                    s = sdscatprintf(s, "%02X", (uint8_t)data[j]);
+                }
+                s = sdscat(s, "\n");
+                data += (2 + rdlength);
+            }
+            break;
+        case DNS_TYPE_DNSKEY:
+            for(i = 0; i < rs->num; ++i) {
+                rdlength = load16be(data);
+                s = sdscatprintf(s, " %d IN DNSKEY %d %d %d ", rs->ttl, load16be(data+2),
+                                 (uint8_t)data[4], (uint8_t)data[5]);
+                s = catBase64(s, data+6, rdlength-4U);
+                s = sdscat(s, "\n");
+                data += (2 + rdlength);
+            }
+            break;
+        case DNS_TYPE_RRSIG:
+            for(i = 0; i < rs->num; ++i) {
+                char buf[16];
+                rdlength = load16be(data);
+                len2dotlabel(data+20, human);
+                s = sdscatprintf(s, " %d IN RRSIG %s %d %d %u", rs->ttl,
+                                 qtypeToStr(load16be(data+2), buf, sizeof(buf)),
+                                 (uint8_t)data[4], (uint8_t)data[5], load32be(data+6));
+                s = catSigTime(s, load32be(data+10));
+                s = catSigTime(s, load32be(data+14));
+                s = sdscatprintf(s, " %d %s ", load16be(data+18), human);
+                size_t sigOffset = 20 + strlen(data+20) + 1;
+                s = catBase64(s, data+sigOffset, rdlength+2U-sigOffset);
+                s = sdscat(s, "\n");
+                data += (2 + rdlength);
+            }
+            break;
+        case DNS_TYPE_NSEC:
+            for(i = 0; i < rs->num; ++i) {
+                rdlength = load16be(data);
+                len2dotlabel(data+2, human);
+                s = sdscatprintf(s, " %d IN NSEC %s", rs->ttl, human);
+                size_t nameLen = strlen(data+2) + 1;
+                s = catTypeBitmap(s, data+2+nameLen, rdlength-nameLen);
+                s = sdscat(s, "\n");
+                data += (2 + rdlength);
+            }
+            break;
+        case DNS_TYPE_NSEC3:
+        case DNS_TYPE_NSEC3PARAM:
+            for(i = 0; i < rs->num; ++i) {
+                rdlength = load16be(data);
+                s = sdscatprintf(s, " %d IN %s %d %d %d", rs->ttl, rs->type == DNS_TYPE_NSEC3? "NSEC3": "NSEC3PARAM",
+                                 (uint8_t)data[2], (uint8_t)data[3], load16be(data+4));
+                s = catSalt(s, data+6);
+                if (rs->type == DNS_TYPE_NSEC3) {
+                    size_t offset = 2 + 5 + (uint8_t)data[6];
+                    uint8_t hashLen = (uint8_t)data[offset];
+                    char hash[(255*8+4)/5+1];
+                    binToBase32hex(data+offset+1, hashLen, hash);
+                    s = sdscatprintf(s, " %s", hash);
+                    offset += 1 + hashLen;
+                    s = catTypeBitmap(s, data+offset, rdlength+2U-offset);
+                }
+                s = sdscat(s, "\n");
+                data += (2 + rdlength);
+            }
+            break;
         default:
             LOG_FATAL("invalid RR type");
     }
@@ -350,10 +655,22 @@ zone *zoneCreate(char *ss, int socket_id) {
     return zn;
 }
 
+static void zoneCopyMeta(zone *new_z, zone *z) {
+    new_z->default_ttl = z->default_ttl;
+    new_z->sn = z->sn;
+    new_z->refresh = z->refresh;
+    new_z->retry = z->retry;
+    new_z->expiry = z->expiry;
+    new_z->nx = z->nx;
+    new_z->stamp = z->stamp;
+}
+
 zone *zoneCopy(zone *z, int socket_id) {
     zone *new_z = zoneCreate(z->dotOrigin, socket_id);
     assert(new_z != NULL);
+    zoneCopyMeta(new_z, z);
 
+    dictExpand(new_z->d, dictSize(z->d));
     dictIterator *it = dictGetIterator(z->d);
     dictEntry *de;
     while((de = dictNext(it)) != NULL) {
@@ -363,6 +680,16 @@ zone *zoneCopy(zone *z, int socket_id) {
         dictReplace(new_z->d, name, new_dv);
     }
     dictReleaseIterator(it);
+    if (z->vd) {
+        new_z->vd = dictCreate(&dnsViewDictType, NULL, socket_id);
+        it = dictGetIterator(z->vd);
+        while((de = dictNext(it)) != NULL) {
+            dictReplace(new_z->vd, dictGetKey(de), dnsViewValueDup(dictGetVal(de), socket_id));
+        }
+        dictReleaseIterator(it);
+    }
+    new_z->soa = zoneFetchTypeVal(new_z, "@", DNS_TYPE_SOA);
+    new_z->ns = zoneFetchTypeVal(new_z, "@", DNS_TYPE_NS);
     return new_z;
 }
 
@@ -370,12 +697,746 @@ void zoneDestroy(zone *zn) {
     if (zn == NULL) return;
     LOG_DEBUG("zone %s is destroyed(socket_id %d)", zn->dotOrigin, zn->socket_id);
     dictRelease(zn->d);
+    if (zn->vd) dictRelease(zn->vd);
+    if (zn->ents) dictRelease(zn->ents);
+    if (zn->dirty) dictRelease(zn->dirty);
+    socket_free(zn->socket_id, zn->nf);
+    socket_free(zn->socket_id, zn->neg_soa);
+    socket_free(zn->socket_id, zn->nsec_chain);
+    socket_free(zn->socket_id, zn->nsec3);
+    socket_free(zn->socket_id, zn->lcore_stats);
     socket_free(zn->socket_id, zn->origin);
     socket_free(zn->socket_id, zn->dotOrigin);
-    socket_free(zn->socket_id, zn->rr_offset_array);
     socket_free(zn->socket_id, zn);
 }
 
+/*!
+ * allocate the per-lcore query counters.
+ *
+ * @param start_core_idx: the min lcore id of the numa node this zone belongs to
+ * @param nr_lcores: max lcore id - min lcore id + 1
+ */
+void zoneInitStats(zone *zn, int start_core_idx, int nr_lcores) {
+    assert(zn->lcore_stats == NULL);
+    zn->start_core_idx = start_core_idx;
+    zn->nr_lcore_stats = nr_lcores;
+    zn->lcore_stats = socket_calloc(zn->socket_id, (size_t)nr_lcores, sizeof(zoneLcoreStats));
+}
+
+/*!
+ * sum the counters of all lcores, the counters are read without locks,
+ * the values may be a little stale.
+ */
+void zoneGetQueryStats(zone *zn, uint64_t *nr_queries, uint64_t *nr_nxdomain) {
+    *nr_queries = zn->base_queries;
+    *nr_nxdomain = zn->base_nxdomain;
+    for (int i = 0; i < zn->nr_lcore_stats; ++i) {
+        *nr_queries += zn->lcore_stats[i].nr_queries;
+        *nr_nxdomain += zn->lcore_stats[i].nr_nxdomain;
+    }
+}
+
+/*----------------------------------------------
+ *     name filter and negative responses
+ *---------------------------------------------*/
+#define NAME_FILTER_BITS_PER_NAME 16
+
+// the salts of split block bloom filter, one bit is set in every 64 bits word of the block.
+static const uint32_t nameFilterSalts[8] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+// FNV-1a of the lower case name, the high 32 bits select the block.
+static inline uint64_t nameFilterHash(const char *name, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; ++i) {
+        uint8_t c = (uint8_t)name[i];
+        if (c >= 'A' && c <= 'Z') c |= 0x20;
+        h = (h ^ c) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static inline bool nameFilterProbe(nameFilter *nf, uint64_t h) {
+    uint64_t *block = nf->blocks[(uint32_t)(h >> 32) & nf->mask];
+    uint32_t x = (uint32_t)h;
+    uint64_t miss = 0;
+
+    for (int i = 0; i < 8; ++i) miss |= ~block[i] & (1ULL << ((x * nameFilterSalts[i]) >> 26));
+    return miss == 0;
+}
+
+static inline void nameFilterAdd(nameFilter *nf, const char *name, size_t len) {
+    uint64_t h = nameFilterHash(name, len);
+    uint64_t *block = nf->blocks[(uint32_t)(h >> 32) & nf->mask];
+    uint32_t x = (uint32_t)h;
+
+    for (int i = 0; i < 8; ++i) block[i] |= 1ULL << ((x * nameFilterSalts[i]) >> 26);
+}
+
+static nameFilter *nameFilterCreate(int socket_id, size_t nr_names) {
+    uint32_t nr_blocks = 1;
+    nameFilter *nf;
+
+    while ((size_t)nr_blocks * 512 < nr_names * NAME_FILTER_BITS_PER_NAME) nr_blocks <<= 1;
+    nf = socket_calloc(socket_id, 1, sizeof(*nf) + (size_t)nr_blocks * sizeof(nf->blocks[0]));
+    nf->mask = nr_blocks - 1;
+    return nf;
+}
+
+static size_t nameFilterMemUsage(nameFilter *nf) {
+    return nf? sizeof(*nf) + ((size_t)nf->mask + 1) * sizeof(nf->blocks[0]): 0;
+}
+
+// add the ancestors(between the name and the origin) missing in zone dict to the empty non-terminals.
+static void zoneCollectEnts(zone *zn, dict *d) {
+    dictIterator *it = dictGetIterator(d);
+    dictEntry *de;
+    char *name, *p;
+
+    while((de = dictNext(it)) != NULL) {
+        name = dictGetKey(de);
+        if (strcmp(name, "@") == 0) continue;
+        for (p = name + (uint8_t)*name + 1; *p != 0; p += (uint8_t)*p + 1) {
+            if (dictFind(zn->d, p) != NULL) continue;
+            if (zn->ents == NULL) zn->ents = dictCreate(&nameSetDictType, NULL, zn->socket_id);
+            dictReplace(zn->ents, p, NULL);
+        }
+    }
+    dictReleaseIterator(it);
+}
+
+static void nameFilterAddDict(nameFilter *nf, dict *d) {
+    dictIterator *it = dictGetIterator(d);
+    dictEntry *de;
+    char *name;
+
+    while((de = dictNext(it)) != NULL) {
+        name = dictGetKey(de);
+        if (strcmp(name, "@") != 0) nameFilterAdd(nf, name, strlen(name));
+    }
+    dictReleaseIterator(it);
+}
+
+/*
+ * the filter has the owner names(except the origin) and the empty non-terminals,
+ * the names only having views are not in the filter since they are looked up before.
+ */
+static void zoneBuildNameFilter(zone *zn) {
+    if (zn->ents) dictRelease(zn->ents);
+    zn->ents = NULL;
+    socket_free(zn->socket_id, zn->nf);
+
+    zoneCollectEnts(zn, zn->d);
+    if (zn->vd) zoneCollectEnts(zn, zn->vd);
+    zn->nf = nameFilterCreate(zn->socket_id, dictSize(zn->d) + (zn->ents? dictSize(zn->ents): 0));
+    nameFilterAddDict(zn->nf, zn->d);
+    if (zn->ents) nameFilterAddDict(zn->nf, zn->ents);
+}
+
+/*
+ * the SOA RR of negative responses(RFC 2308), only the owner(a compression pointer
+ * to the origin in question) changes with queries, the rdata is not compressed.
+ */
+static char *dumpNegativeRR(char *p, uint16_t type, uint32_t ttl, char *rr) {
+    uint16_t rdlength = load16be(rr);
+    dump16be(0xC000, p);
+    dump16be(type, p+2);
+    dump16be(DNS_CLASS_IN, p+4);
+    dump32be(ttl, p+6);
+    memcpy(p+10, rr, (size_t)rdlength + 2);
+    return p + 12 + rdlength;
+}
+
+static void zoneBuildNegativeSoa(zone *zn) {
+    RRSet *soa = zn->soa;
+    dnsDictValue *apex;
+    RRSet *sig = NULL;
+    char *p;
+    size_t len;
+    uint32_t ttl;
+
+    socket_free(zn->socket_id, zn->neg_soa);
+    zn->neg_soa = NULL;
+    zn->neg_soa_len = 0;
+    zn->neg_sig_len = 0;
+    if (soa == NULL || soa->num == 0) return;
+
+    if ((apex = dictFetchValue(zn->d, "@")) != NULL) sig = dnsDictValueGetSig(apex, DNS_TYPE_SOA);
+    len = 12 + load16be(soa->data + RRSetGetOffset(soa, 0));
+    if (sig != NULL) len += sig->num * 10U + sig->len;
+    if (len > UINT16_MAX) {
+        LOG_WARN("signatures of SOA in %s are too long, the negative responses are not signed.", zn->dotOrigin);
+        sig = NULL;
+    }
+    ttl = (zn->nx >= 0 && (uint32_t)zn->nx < soa->ttl)? (uint32_t)zn->nx: soa->ttl;
+    p = zn->neg_soa = socket_malloc(zn->socket_id, len);
+    p = dumpNegativeRR(p, DNS_TYPE_SOA, ttl, soa->data + RRSetGetOffset(soa, 0));
+    zn->neg_soa_len = (uint16_t)(p - zn->neg_soa);
+    for (int i = 0; sig != NULL && i < sig->num; ++i) {
+        p = dumpNegativeRR(p, DNS_TYPE_RRSIG, ttl, sig->data + RRSetGetOffset(sig, i));
+    }
+    zn->neg_sig_len = (uint16_t)(p - zn->neg_soa - zn->neg_soa_len);
+}
+
+/*
+ * compare two relative names in canonical order(RFC 4034 6.1), the labels are
+ * compared from the rightmost one as case insensitive strings.
+ */
+static int canonicalNameCmp(const char *a, size_t alen, const char *b, size_t blen) {
+    const char *la[MAX_DOMAIN_LEN/2+1], *lb[MAX_DOMAIN_LEN/2+1];
+    int na = 0, nb = 0;
+
+    for (size_t i = 0; i < alen; i += (uint8_t)a[i] + 1) la[na++] = a + i;
+    for (size_t i = 0; i < blen; i += (uint8_t)b[i] + 1) lb[nb++] = b + i;
+    while (na > 0 && nb > 0) {
+        const uint8_t *x = (const uint8_t *)la[--na], *y = (const uint8_t *)lb[--nb];
+        uint8_t n = x[0] < y[0]? x[0]: y[0];
+        for (uint8_t k = 1; k <= n; ++k) {
+            int c = tolower(x[k]) - tolower(y[k]);
+            if (c != 0) return c;
+        }
+        if (x[0] != y[0]) return x[0] - y[0];
+    }
+    return na - nb;
+}
+
+static int nsecEntryCmp(const void *a, const void *b) {
+    const nsecEntry *x = a, *y = b;
+    return canonicalNameCmp(x->name, x->len, y->name, y->len);
+}
+
+static void zoneBuildNsecChain(zone *zn) {
+    uint32_t bit = 1U << RR_SLOT_NSEC;
+    dictIterator *it;
+    dictEntry *de;
+    uint32_t n = 0;
+
+    socket_free(zn->socket_id, zn->nsec_chain);
+    zn->nsec_chain = NULL;
+    zn->nr_nsec = 0;
+
+    it = dictGetIterator(zn->d);
+    while((de = dictNext(it)) != NULL) {
+        if (((dnsDictValue *)dictGetVal(de))->bitmap & bit) n++;
+    }
+    dictReleaseIterator(it);
+    if (n == 0) return;
+
+    zn->nsec_chain = socket_malloc(zn->socket_id, n * sizeof(nsecEntry));
+    it = dictGetIterator(zn->d);
+    while((de = dictNext(it)) != NULL) {
+        dnsDictValue *dv = dictGetVal(de);
+        char *name = dictGetKey(de);
+        if (!(dv->bitmap & bit)) continue;
+        nsecEntry e = {name, strcmp(name, "@") == 0? 0: strlen(name), dv};
+        zn->nsec_chain[zn->nr_nsec++] = e;
+    }
+    dictReleaseIterator(it);
+    qsort(zn->nsec_chain, zn->nr_nsec, sizeof(nsecEntry), nsecEntryCmp);
+}
+
+/*!
+ * find the NSEC RR covering a name, it is the last name not greater than the name
+ * in canonical order, the first name(origin) covers the names after the last one.
+ *
+ * @param key: the relative name in len label format, keyLen is 0 for origin.
+ * @return NULL if the zone has no NSEC RR.
+ */
+nsecEntry *zoneFindNsecCover(zone *z, char *key, size_t keyLen) {
+    uint32_t lo = 0, hi = z->nr_nsec;
+
+    if (z->nr_nsec == 0) return NULL;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        nsecEntry *e = &z->nsec_chain[mid];
+        if (canonicalNameCmp(e->name, e->len, key, keyLen) <= 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return &z->nsec_chain[lo > 0? lo - 1: z->nr_nsec - 1];
+}
+
+/*!
+ * find the NSEC RR proving that the wildcard of the closest encloser(RFC 4592) doesn't exist.
+ *
+ * @param key: the relative name(not empty) in len label format, it doesn't exist in the zone.
+ */
+nsecEntry *zoneFindWildcardNsecCover(zone *z, char *key, size_t keyLen) {
+    char buf[MAX_DOMAIN_LEN+4] = "\001*";
+    char *end = key + keyLen;
+    char *p = key + (uint8_t)*key + 1;
+
+    for (; p < end; p += (uint8_t)*p + 1) {
+        memcpy(buf+2, p, (size_t)(end - p));
+        buf[2 + (end - p)] = 0;
+        if (dictFind(z->d, buf+2) != NULL || (z->ents && dictFind(z->ents, buf+2) != NULL)) break;
+    }
+    return zoneFindNsecCover(z, buf, 2 + (size_t)(end - p));
+}
+
+/*
+ * the NSEC3PARAM RR(rdlength, algorithm, flags, iterations, salt length and salt)
+ * of apex deciding the NSEC3 chain served, NULL if the zone has no usable one.
+ */
+static char *zoneGetNsec3Param(zone *zn) {
+    dnsDictValue *apex = dictFetchValue(zn->d, "@");
+    RRSet *rs = apex? dnsDictValueGet(apex, DNS_TYPE_NSEC3PARAM): NULL;
+
+    for (int i = 0; rs != NULL && i < rs->num; ++i) {
+        char *rr = rs->data + RRSetGetOffset(rs, i);
+        if ((uint8_t)rr[2] == NSEC3_HASH_SHA1 && rr[3] == 0) return rr;
+    }
+    return NULL;
+}
+
+static bool nsec3ParamEqual(nsec3Chain *c, char *rr) {
+    return c->iterations == load16be(rr+4) && c->salt_len == (uint8_t)rr[6] &&
+           memcmp(c->salt, rr+7, c->salt_len) == 0;
+}
+
+/*
+ * decode the hashed owner name of the NSEC3 RRSet of a name, the name must be a
+ * single label and the RRSet must use the hash parameters of the chain.
+ */
+static bool nsec3OwnerHash(nsec3Chain *c, char *name, dnsDictValue *dv, uint8_t *hash) {
+    RRSet *rs;
+
+    if (dv == NULL || !(dv->bitmap & (1U << RR_SLOT_NSEC3))) return false;
+    if ((uint8_t)name[0] != 32 || name[33] != 0) return false;
+    if (base32hexToBin(name+1, 32, (char *)hash) != NSEC3_HASH_LEN) return false;
+    rs = dnsDictValueGet(dv, DNS_TYPE_NSEC3);
+    // the NSEC3 RR has the same fields as NSEC3PARAM before the next hashed owner name.
+    return rs->num > 0 && (uint8_t)rs->data[RRSetGetOffset(rs, 0)+2] == NSEC3_HASH_SHA1 &&
+           nsec3ParamEqual(c, rs->data + RRSetGetOffset(rs, 0));
+}
+
+static int nsec3EntryCmp(const void *a, const void *b) {
+    return memcmp(((const nsec3Entry *)a)->hash, ((const nsec3Entry *)b)->hash, NSEC3_HASH_LEN);
+}
+
+static void zoneBuildNsec3Chain(zone *zn) {
+    char *param = zoneGetNsec3Param(zn);
+    uint8_t hash[NSEC3_HASH_LEN];
+    nsec3Chain *c;
+    nsec3Entry *e;
+    dictIterator *it;
+    dictEntry *de;
+    uint32_t n = 0;
+    bool match;
+
+    socket_free(zn->socket_id, zn->nsec3);
+    zn->nsec3 = NULL;
+    if (param == NULL) return;
+    if (load16be(param+4) > NSEC3_MAX_ITERATIONS) {
+        LOG_WARN("NSEC3 of %s uses %d iterations, the negative responses don't carry NSEC3.",
+                 zn->dotOrigin, load16be(param+4));
+        return;
+    }
+    it = dictGetIterator(zn->d);
+    while((de = dictNext(it)) != NULL) {
+        if (((dnsDictValue *)dictGetVal(de))->bitmap & (1U << RR_SLOT_NSEC3)) n++;
+    }
+    dictReleaseIterator(it);
+    if (n == 0) return;
+
+    c = socket_malloc(zn->socket_id, sizeof(*c) + n * sizeof(nsec3Entry));
+    c->iterations = load16be(param+4);
+    c->salt_len = (uint8_t)param[6];
+    memcpy(c->salt, param+7, c->salt_len);
+    c->nr = 0;
+    it = dictGetIterator(zn->d);
+    while((de = dictNext(it)) != NULL) {
+        e = &c->entries[c->nr];
+        if (!nsec3OwnerHash(c, dictGetKey(de), dictGetVal(de), e->hash)) continue;
+        e->e.name = dictGetKey(de);
+        e->e.len = 33;
+        e->e.dv = dictGetVal(de);
+        c->nr++;
+    }
+    dictReleaseIterator(it);
+    if (c->nr == 0) {
+        socket_free(zn->socket_id, c);
+        return;
+    }
+    qsort(c->entries, c->nr, sizeof(nsec3Entry), nsec3EntryCmp);
+    zn->nsec3 = c;
+
+    zoneNsec3Hash(zn, "", 0, hash);
+    e = zoneFindNsec3(zn, hash, &match);
+    c->apex = match? (int32_t)(e - c->entries): -1;
+    zoneNsec3Hash(zn, "\001*", 2, hash);
+    c->apex_wildcard = (int32_t)(zoneFindNsec3(zn, hash, &match) - c->entries);
+}
+
+/*!
+ * hash a name with the parameters of the NSEC3 chain(RFC 5155 5), the zone must have the chain.
+ *
+ * @param key: the relative name in len label format, keyLen is 0 for origin.
+ */
+void zoneNsec3Hash(zone *z, char *key, size_t keyLen, uint8_t *hash) {
+    nsec3Chain *c = z->nsec3;
+    uint8_t buf[MAX_DOMAIN_LEN+2+255];
+    size_t len = 0;
+
+    // the owner name in canonical form, the length bytes are not changed by tolower.
+    for (size_t i = 0; i < keyLen; ++i) buf[len++] = (uint8_t)tolower((unsigned char)key[i]);
+    for (size_t i = 0; i <= z->originLen; ++i) buf[len++] = (uint8_t)tolower((unsigned char)z->origin[i]);
+    memcpy(buf+len, c->salt, c->salt_len);
+    sha1(buf, len + c->salt_len, hash);
+    for (int i = 0; i < c->iterations; ++i) {
+        memcpy(buf, hash, NSEC3_HASH_LEN);
+        memcpy(buf+NSEC3_HASH_LEN, c->salt, c->salt_len);
+        sha1(buf, NSEC3_HASH_LEN + c->salt_len, hash);
+    }
+}
+
+/*!
+ * find the NSEC3 RR matching or covering a hashed name, it is the last entry not greater
+ * than the hash, the last entry covers the hashes before the first one.
+ *
+ * @param match: set to true if the hashed owner name of the entry is the hash.
+ */
+nsec3Entry *zoneFindNsec3(zone *z, uint8_t *hash, bool *match) {
+    nsec3Chain *c = z->nsec3;
+    uint32_t lo = 0, hi = c->nr;
+    nsec3Entry *e;
+
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (memcmp(c->entries[mid].hash, hash, NSEC3_HASH_LEN) <= 0) lo = mid + 1;
+        else hi = mid;
+    }
+    e = &c->entries[lo > 0? lo - 1: c->nr - 1];
+    *match = memcmp(e->hash, hash, NSEC3_HASH_LEN) == 0;
+    return e;
+}
+
+/*
+ * split the RRSIG RRSet by the covered type, so the signatures of an answer are
+ * found like the answer itself. the TTL of signatures is the TTL of the covered RRSet.
+ */
+static dnsDictValue *dnsDictValueBuildSigs(dnsDictValue *dv, int socket_id) {
+    RRSet *sigs[SUPPORT_TYPE_NUM] = {NULL};
+    RRSet *rrsig, *rs;
+    uint16_t sigmap = 0;
+    uint32_t nr_sigs = 0;
+    int slot;
+
+    dnsDictValueDropSigs(dv);
+    if ((rrsig = dnsDictValueGet(dv, DNS_TYPE_RRSIG)) == NULL) return dv;
+
+    for (int i = 0; i < rrsig->num; ++i) {
+        char *rr = rrsig->data + RRSetGetOffset(rrsig, i);
+        uint16_t covered = load16be(rr+2);
+        // RRSIG RRs are not signed, and the signatures of absent RRSets are useless.
+        if (covered == DNS_TYPE_RRSIG || (rs = dnsDictValueGet(dv, covered)) == NULL) continue;
+        slot = dnsTypeToSlot(covered);
+        if (sigs[slot] == NULL) {
+            sigs[slot] = RRSetCreate(DNS_TYPE_RRSIG, socket_id);
+            sigs[slot]->ttl = rs->ttl;
+            sigmap |= (uint16_t)(1U << slot);
+            nr_sigs++;
+        }
+        sigs[slot] = RRSetCat(sigs[slot], rr, 2U + load16be(rr));
+    }
+    if (nr_sigs == 0) return dv;
+
+    dv = socket_realloc(socket_id, dv, sizeof(*dv) + (dv->nr_rs + nr_sigs) * sizeof(RRSet *));
+    for (slot = 0, nr_sigs = 0; slot < SUPPORT_TYPE_NUM; ++slot) {
+        if (sigs[slot] == NULL) continue;
+        dv->rsArr[dv->nr_rs + nr_sigs++] = RRSetIntern(RRSetCompact(sigs[slot]));
+    }
+    dv->sigmap = sigmap;
+    return dv;
+}
+
+static dnsDictValue *dnsDictValueCompact(dnsDictValue *dv, int socket_id) {
+    for (uint32_t i = 0; i < dv->nr_rs; ++i) {
+        RRSet *rs = dv->rsArr[i];
+        if (rs->flags & RRSET_F_INTERNED) continue;
+        dv->rsArr[i] = RRSetIntern(RRSetCompact(rs));
+    }
+    return dnsDictValueBuildSigs(dv, socket_id);
+}
+
+static size_t dnsDictValueMemUsage(dnsDictValue *dv, size_t *nr_records) {
+    uint32_t n = dv->nr_rs + (uint32_t)__builtin_popcount(dv->sigmap);
+    size_t sz = sizeof(*dv) + n * sizeof(RRSet *);
+    for (uint32_t i = 0; i < n; ++i) {
+        RRSet *rs = dv->rsArr[i];
+        size_t rs_sz = sizeof(*rs) + rs->len + rs->free;
+        // shared RRSet is accounted proportionally
+        if (rs->flags & RRSET_F_INTERNED) rs_sz /= rs->refcnt;
+        sz += rs_sz;
+        // the split signatures are also in the RRSIG RRSet
+        if (i < dv->nr_rs) *nr_records += rs->num;
+    }
+    return sz;
+}
+
+static size_t zoneNameMemUsage(char *name, dnsDictValue *dv) {
+    size_t nr = 0;
+    return sizeof(dictEntry) + strlen(name) + 1 + dnsDictValueMemUsage(dv, &nr);
+}
+
+// the memory of the name filter, empty non-terminals, negative response and NSEC(3) chain.
+static size_t zoneIndexMemUsage(zone *zn) {
+    size_t sz = nameFilterMemUsage(zn->nf) + zn->neg_soa_len + zn->neg_sig_len;
+    sz += zn->nr_nsec * sizeof(nsecEntry);
+    if (zn->nsec3) sz += sizeof(nsec3Chain) + zn->nsec3->nr * sizeof(nsec3Entry);
+    if (zn->ents) {
+        dictIterator *it = dictGetIterator(zn->ents);
+        dictEntry *de;
+        sz += dictSlots(zn->ents) * sizeof(dictEntry *);
+        while((de = dictNext(it)) != NULL) sz += sizeof(dictEntry) + strlen(dictGetKey(de)) + 1;
+        dictReleaseIterator(it);
+    }
+    return sz;
+}
+
+static inline void zoneSubMemUsage(zone *zn, size_t sz) {
+    zn->mem_usage -= sz < zn->mem_usage? sz: zn->mem_usage;
+}
+
+/*
+ * update the NSEC entry of a modified name in the chain.
+ *
+ * @return false if the name gains or loses its NSEC RRSet, the chain needs to be rebuilt.
+ */
+static bool zoneUpdateNsecEntry(zone *zn, char *name, dnsDictValue *dv) {
+    size_t len = strcmp(name, "@") == 0? 0: strlen(name);
+    nsecEntry *e = zoneFindNsecCover(zn, name, len);
+    bool has_nsec = dv != NULL && (dv->bitmap & (1U << RR_SLOT_NSEC));
+
+    if (e != NULL && canonicalNameCmp(e->name, e->len, name, len) != 0) e = NULL;
+    if ((e != NULL) != has_nsec) return false;
+    if (e != NULL) e->dv = dv;
+    return true;
+}
+
+/*
+ * update the NSEC3 entry of a modified name in the chain.
+ *
+ * @return false if the name gains or loses its NSEC3 RRSet, the chain needs to be rebuilt.
+ */
+static bool zoneUpdateNsec3Entry(zone *zn, char *name, dnsDictValue *dv) {
+    uint8_t hash[NSEC3_HASH_LEN];
+    nsec3Entry *e = NULL;
+    bool has_nsec3, match;
+
+    // no NSEC3PARAM, the NSEC3 RRSets are not served.
+    if (zn->nsec3 == NULL) return true;
+    has_nsec3 = nsec3OwnerHash(zn->nsec3, name, dv, hash);
+    if ((uint8_t)name[0] == 32 && base32hexToBin(name+1, 32, (char *)hash) == NSEC3_HASH_LEN) {
+        e = zoneFindNsec3(zn, hash, &match);
+        if (!match || e->e.name != name) e = NULL;
+    }
+    if ((e != NULL) != has_nsec3) return false;
+    if (e != NULL) e->e.dv = dv;
+    return true;
+}
+
+/*
+ * update the NSEC and NSEC3 chains of a copy made by zoneCopyShared, the entries of the
+ * modified names are pointed to the new values. a chain is rebuilt if a name is added or
+ * removed, a modified name gains or loses its NSEC(3) RRSet, or NSEC3PARAM is changed.
+ */
+static void zoneUpdateNsecChain(zone *zn) {
+    char *param = zoneGetNsec3Param(zn);
+    bool nsec_ok = !zn->names_changed;
+    bool nsec3_ok = !zn->names_changed &&
+                    (zn->nsec3 == NULL? param == NULL: param != NULL && nsec3ParamEqual(zn->nsec3, param));
+    dictIterator *it;
+    dictEntry *de;
+
+    it = dictGetIterator(zn->dirty);
+    while((de = dictNext(it)) != NULL && (nsec_ok || nsec3_ok)) {
+        dictEntry *vde = dictFind(zn->d, dictGetKey(de));
+        char *name = vde? dictGetKey(vde): dictGetKey(de);
+        dnsDictValue *dv = vde? dictGetVal(vde): NULL;
+
+        if (nsec_ok) nsec_ok = zoneUpdateNsecEntry(zn, name, dv);
+        if (nsec3_ok) nsec3_ok = zoneUpdateNsec3Entry(zn, name, dv);
+    }
+    dictReleaseIterator(it);
+    if (!nsec_ok) zoneBuildNsecChain(zn);
+    if (!nsec3_ok) zoneBuildNsec3Chain(zn);
+}
+
+/*!
+ * compact and intern all RRSets of the zone, must be called after the zone is fully loaded.
+ * RRSets may be reallocated, so the soa and ns pointers are refreshed too.
+ * the name filter and the negative response are rebuilt, so the zone must not be
+ * modified after this call.
+ */
+void zoneCompact(zone *zn) {
+    dictIterator *it;
+    dictEntry *de;
+    dnsDictValue *apex;
+
+    if (zn->dirty == NULL) {
+        it = dictGetIterator(zn->d);
+        while((de = dictNext(it)) != NULL) {
+            dictSetVal(zn->d, de, dnsDictValueCompact(dictGetVal(de), zn->socket_id));
+        }
+        dictReleaseIterator(it);
+    } else {
+        // a copy made by zoneCopyShared, the unmodified values are compacted already.
+        it = dictGetIterator(zn->dirty);
+        while((de = dictNext(it)) != NULL) {
+            dictEntry *vde = dictFind(zn->d, dictGetKey(de));
+            if (vde == NULL) continue;
+            dictSetVal(zn->d, vde, dnsDictValueCompact(dictGetVal(vde), zn->socket_id));
+            zn->mem_usage += zoneNameMemUsage(dictGetKey(vde), dictGetVal(vde));
+        }
+        dictReleaseIterator(it);
+    }
+    if (zn->vd) {
+        it = dictGetIterator(zn->vd);
+        while((de = dictNext(it)) != NULL) {
+            dnsViewValue *vv = dictGetVal(de);
+            for (uint32_t i = 0; i < vv->nr; ++i) {
+                vv->views[i].dv = dnsDictValueCompact(vv->views[i].dv, zn->socket_id);
+            }
+        }
+        dictReleaseIterator(it);
+    }
+    apex = dictFetchValue(zn->d, "@");
+    zn->soa = apex? dnsDictValueGet(apex, DNS_TYPE_SOA): NULL;
+    zn->ns = apex? dnsDictValueGet(apex, DNS_TYPE_NS): NULL;
+    zn->ns_sig = apex? dnsDictValueGetSig(apex, DNS_TYPE_NS): NULL;
+    if (zn->dirty == NULL) {
+        zoneBuildNameFilter(zn);
+        zoneBuildNegativeSoa(zn);
+        zoneBuildNsecChain(zn);
+        zoneBuildNsec3Chain(zn);
+        zn->mem_usage = zoneMemUsage(zn, NULL);
+        return;
+    }
+    zoneSubMemUsage(zn, zoneIndexMemUsage(zn));
+    // the filter may have the removed names, they are only false positives.
+    if (zn->names_changed) zoneBuildNameFilter(zn);
+    zoneBuildNegativeSoa(zn);
+    zoneUpdateNsecChain(zn);
+    zn->mem_usage += zoneIndexMemUsage(zn);
+    dictRelease(zn->dirty);
+    zn->dirty = NULL;
+    zn->names_changed = false;
+}
+
+/*!
+ * copy a compacted zone on its NUMA node for incremental updates(e.g. IXFR), the values
+ * of names are shared with z(copy on write), so the copy costs a pointer per name. the
+ * modified names are tracked, zoneCompact only compacts them and keeps the name filter
+ * and the NSEC(3) chains if no name is added or removed.
+ * z must not be freed during the call(e.g. in a RCU read side critical section).
+ */
+zone *zoneCopyShared(zone *z) {
+    zone *new_z = zoneCreate(z->dotOrigin, z->socket_id);
+    dictIterator *it;
+    dictEntry *de;
+
+    // the modification of shared values relies on the RRSets being interned.
+    assert(new_z != NULL && getRRSetPool(z->socket_id) != NULL);
+    zoneCopyMeta(new_z, z);
+    new_z->dirty = dictCreate(&nameSetDictType, NULL, z->socket_id);
+    new_z->mem_usage = z->mem_usage;
+
+    dictExpand(new_z->d, dictSize(z->d));
+    it = dictGetIterator(z->d);
+    while((de = dictNext(it)) != NULL) {
+        char *name = dictGetKey(de);
+        dnsDictValue *dv = dictGetVal(de);
+        if (dv->refcnt < UINT16_MAX) {
+            uatomic_inc(&dv->refcnt);
+        } else {
+            dv = dnsDictValueDup(dv, z->socket_id);
+            dictAdd(new_z->dirty, name, NULL);
+        }
+        dictAdd(new_z->d, name, dv);
+    }
+    dictReleaseIterator(it);
+    // views are rare, they are copied and compacted again.
+    if (z->vd) {
+        new_z->vd = dictCreate(&dnsViewDictType, NULL, z->socket_id);
+        it = dictGetIterator(z->vd);
+        while((de = dictNext(it)) != NULL) {
+            dictAdd(new_z->vd, dictGetKey(de), dnsViewValueDup(dictGetVal(de), z->socket_id));
+        }
+        dictReleaseIterator(it);
+    }
+    new_z->soa = z->soa;
+    new_z->ns = z->ns;
+    new_z->ns_sig = z->ns_sig;
+
+    if (z->nf) new_z->nf = socket_memdup(z->socket_id, z->nf, nameFilterMemUsage(z->nf));
+    if (z->ents) {
+        new_z->ents = dictCreate(&nameSetDictType, NULL, z->socket_id);
+        it = dictGetIterator(z->ents);
+        while((de = dictNext(it)) != NULL) dictAdd(new_z->ents, dictGetKey(de), NULL);
+        dictReleaseIterator(it);
+    }
+    if (z->nr_nsec > 0) {
+        new_z->nsec_chain = socket_memdup(z->socket_id, z->nsec_chain, z->nr_nsec * sizeof(nsecEntry));
+        new_z->nr_nsec = z->nr_nsec;
+        // point the names to the keys of the new dict.
+        for (uint32_t i = 0; i < new_z->nr_nsec; ++i) {
+            nsecEntry *e = &new_z->nsec_chain[i];
+            de = dictFind(new_z->d, e->name);
+            e->name = dictGetKey(de);
+            e->dv = dictGetVal(de);
+        }
+    }
+    if (z->nsec3) {
+        size_t sz = sizeof(nsec3Chain) + z->nsec3->nr * sizeof(nsec3Entry);
+        new_z->nsec3 = socket_memdup(z->socket_id, z->nsec3, sz);
+        for (uint32_t i = 0; i < new_z->nsec3->nr; ++i) {
+            nsecEntry *e = &new_z->nsec3->entries[i].e;
+            de = dictFind(new_z->d, e->name);
+            e->name = dictGetKey(de);
+            e->dv = dictGetVal(de);
+        }
+    }
+    return new_z;
+}
+
+/*!
+ * approximate the memory used by a zone, allocator overhead is not included.
+ * mainly used to account the memory waiting for reclamation.
+ *
+ * @param nr_records: if not NULL, store the number of RRs in this zone
+ */
+size_t zoneMemUsage(zone *zn, size_t *nr_records) {
+    size_t sz = sizeof(*zn) + zn->originLen + 1 + strlen(zn->dotOrigin) + 1;
+    size_t nr = 0;
+
+    sz += dictSlots(zn->d) * sizeof(dictEntry *);
+    dictIterator *it = dictGetIterator(zn->d);
+    dictEntry *de;
+    while((de = dictNext(it)) != NULL) {
+        char *name = dictGetKey(de);
+        sz += sizeof(dictEntry) + strlen(name) + 1;
+        sz += dnsDictValueMemUsage(dictGetVal(de), &nr);
+    }
+    dictReleaseIterator(it);
+    if (zn->vd) {
+        sz += dictSlots(zn->vd) * sizeof(dictEntry *);
+        it = dictGetIterator(zn->vd);
+        while((de = dictNext(it)) != NULL) {
+            char *name = dictGetKey(de);
+            dnsViewValue *vv = dictGetVal(de);
+            sz += sizeof(dictEntry) + strlen(name) + 1;
+            sz += sizeof(*vv) + vv->nr * sizeof(dnsViewEntry);
+            for (uint32_t i = 0; i < vv->nr; ++i) sz += dnsDictValueMemUsage(vv->views[i].dv, &nr);
+        }
+        dictReleaseIterator(it);
+    }
+    sz += zoneIndexMemUsage(zn);
+    if (nr_records) *nr_records = nr;
+    return sz;
+}
+
 /*!
  * fetch dns dict value from zone
  * @param z
@@ -390,11 +1451,30 @@ dnsDictValue *zoneFetchValueAbs(zone *z, void *key, size_t keyLen) {
     // the key ends with origin(absolute domain name).
     assert (keyLen >= originLen && strcasecmp(key+remain, z->origin) == 0);
 
+    // most names of random subdomain attacks stop here.
+    if (remain > 0 && z->nf != NULL && !nameFilterProbe(z->nf, nameFilterHash(key, remain))) return NULL;
     char buf[255] = "@";
     if (remain > 0) rte_memcpy(buf, key, remain);
     return dictFetchValue(z->d, buf);
 }
 
+/*!
+ * check if the name is an empty non-terminal of the zone, such names exist(NODATA)
+ * although they have no RRSet.
+ *
+ * @param key: must be absolute domain name in len label format.
+ */
+bool zoneIsEmptyNonTerminalAbs(zone *z, void *key, size_t keyLen) {
+    size_t remain = keyLen - z->originLen;
+    char buf[MAX_DOMAIN_LEN+2];
+
+    if (z->ents == NULL || remain == 0) return false;
+    if (z->nf != NULL && !nameFilterProbe(z->nf, nameFilterHash(key, remain))) return false;
+    rte_memcpy(buf, key, remain);
+    buf[remain] = 0;
+    return dictFind(z->ents, buf) != NULL;
+}
+
 /*
  * same with zoneFetchValueAbs except key should be a relative domain name in len label format
  */
@@ -402,8 +1482,8 @@ dnsDictValue *zoneFetchValueRelative(zone *z, void *key) {
     return dictFetchValue(z->d, key);
 }
 
-// fetch the RRSet from zone, support relative and absolute name
-RRSet *zoneFetchTypeVal(zone *z, void *key, uint16_t type) {
+// fetch the RRSets of a name from zone, support relative and absolute name
+dnsDictValue *zoneFetchValue(zone *z, void *key) {
     dnsDictValue *dv = NULL;
     size_t keyLen = strlen(key);
     size_t originLen = z->originLen;
@@ -421,6 +1501,12 @@ RRSet *zoneFetchTypeVal(zone *z, void *key, uint16_t type) {
     } else {
         dv = dictFetchValue(z->d, key);
     }
+    return dv;
+}
+
+// fetch the RRSet from zone, support relative and absolute name
+RRSet *zoneFetchTypeVal(zone *z, void *key, uint16_t type) {
+    dnsDictValue *dv = zoneFetchValue(z, key);
     return dv? dnsDictValueGet(dv, type): NULL;
 }
 
@@ -428,25 +1514,179 @@ int zoneReplace(zone *z, void *key, dnsDictValue *val) {
     return dictReplace(z->d, key, val);
 }
 
-// set RRSet
-// TODO validate the implementation
+/*
+ * called before the value of a name is modified, the name is tracked if z is a copy
+ * made by zoneCopyShared, and the value is duplicated if it is still shared.
+ */
+static dnsDictValue *zoneUnshareValue(zone *z, dictEntry *de) {
+    dnsDictValue *dv = dictGetVal(de);
+
+    if (z->dirty == NULL) return dv;
+    if (dictAdd(z->dirty, dictGetKey(de), NULL) == DICT_OK) {
+        zoneSubMemUsage(z, zoneNameMemUsage(dictGetKey(de), dv));
+    }
+    if (dv->refcnt > 1) {
+        dictSetVal(z->d, de, dnsDictValueDup(dv, z->socket_id));
+        dnsDictValueDestroy(dv, z->socket_id);
+        dv = dictGetVal(de);
+    }
+    return dv;
+}
+
+/*!
+ * set the RRSet of its type, the old RRSet of the type is replaced.
+ *
+ * @param key : the relative name in len label format(@ for origin).
+ */
 int zoneReplaceTypeVal(zone *z, char *key, RRSet *rs) {
-    dnsDictValue *dv = dictFetchValue(z->d, key);
-    if (dv == NULL) {
+    dnsDictValue *dv;
+    dictEntry *de = dictFind(z->d, key);
+    if (de == NULL) {
         dv = dnsDictValueCreate(z->socket_id);
-        dnsDictValueSet(dv, rs);
+        dv = dnsDictValueSet(dv, rs, z->socket_id);
         dictReplace(z->d, key, dv);
+        if (z->dirty) dictAdd(z->dirty, key, NULL);
+        z->names_changed = true;
     } else {
+        dv = zoneUnshareValue(z, de);
         RRSet *old_rs = dnsDictValueGet(dv, rs->type);
-        dnsDictValueSet(dv, rs);
-        if (old_rs) RRSetDestroy(old_rs);
+        dv = dnsDictValueSet(dv, rs, z->socket_id);
+        dictSetVal(z->d, de, dv);
+        if (old_rs && old_rs != rs) RRSetDestroy(old_rs);
     }
     return 0;
 }
 
+/*!
+ * delete the RRSet of type, the name is removed if it has no RRSet any more.
+ *
+ * @param key : the relative name in len label format(@ for origin).
+ * @return ERR_CODE if the RRSet doesn't exist.
+ */
+int zoneDeleteTypeVal(zone *z, char *key, uint16_t type) {
+    dictEntry *de = dictFind(z->d, key);
+    dnsDictValue *dv;
+    RRSet *rs;
+    int slot = dnsTypeToSlot(type);
+
+    if (de == NULL || slot < 0) return ERR_CODE;
+    if (dnsDictValueGet(dictGetVal(de), type) == NULL) return ERR_CODE;
+    dv = zoneUnshareValue(z, de);
+    rs = dnsDictValueGet(dv, type);
+    dnsDictValueDropSigs(dv);
+    if (dv->nr_rs == 1) {
+        dictDelete(z->d, key);
+        z->names_changed = true;
+    } else {
+        uint32_t bit = 1U << slot;
+        uint32_t idx = (uint32_t)__builtin_popcount(dv->bitmap & (bit - 1));
+        memmove(dv->rsArr+idx, dv->rsArr+idx+1, (dv->nr_rs - idx - 1) * sizeof(RRSet *));
+        dv->bitmap &= (uint16_t)~bit;
+        dv->nr_rs--;
+        RRSetDestroy(rs);
+    }
+    if (rs == z->soa) z->soa = NULL;
+    if (rs == z->ns) z->ns = NULL;
+    return OK_CODE;
+}
+
+/*!
+ * fetch the RRSets of all views of a name.
+ *
+ * @param key: must be absolute domain name in len label format.
+ * @return NULL if the name has no RRSet in any view, then the answer doesn't depend on client.
+ */
+dnsViewValue *zoneFetchViewsAbs(zone *z, void *key, size_t keyLen) {
+    if (z->vd == NULL) return NULL;
+    size_t remain = keyLen - z->originLen;
+    assert (keyLen >= z->originLen && strcasecmp(key+remain, z->origin) == 0);
+
+    char buf[255] = "@";
+    if (remain > 0) rte_memcpy(buf, key, remain);
+    return dictFetchValue(z->vd, buf);
+}
+
+/*!
+ * same with zoneFetchTypeVal, but fetch the RRSet from view, view 0 is the default view.
+ *
+ * @param key: the relative name in len label format(@ for origin).
+ */
+RRSet *zoneFetchViewTypeVal(zone *z, uint32_t view, void *key, uint16_t type) {
+    if (view == 0) return zoneFetchTypeVal(z, key, type);
+    if (z->vd == NULL) return NULL;
+
+    dnsViewValue *vv = dictFetchValue(z->vd, key);
+    dnsDictValue *dv = vv? dnsViewValueGet(vv, view): NULL;
+    return dv? dnsDictValueGet(dv, type): NULL;
+}
+
+/*!
+ * same with zoneReplaceTypeVal, but set the RRSet of view, view 0 is the default view.
+ */
+int zoneReplaceViewTypeVal(zone *z, uint32_t view, char *key, RRSet *rs) {
+    dnsViewValue *vv;
+    dictEntry *de;
+    uint32_t i;
+
+    if (view == 0) return zoneReplaceTypeVal(z, key, rs);
+    if (z->vd == NULL) z->vd = dictCreate(&dnsViewDictType, NULL, z->socket_id);
+
+    if ((de = dictFind(z->vd, key)) == NULL) {
+        vv = socket_calloc(z->socket_id, 1, sizeof(*vv));
+        dictReplace(z->vd, key, vv);
+        de = dictFind(z->vd, key);
+        z->names_changed = true;
+    }
+    vv = dictGetVal(de);
+    for (i = 0; i < vv->nr; ++i) {
+        if (vv->views[i].view == view) break;
+    }
+    if (i == vv->nr) {
+        vv = socket_realloc(z->socket_id, vv, sizeof(*vv) + (vv->nr + 1) * sizeof(dnsViewEntry));
+        vv->views[i].view = view;
+        vv->views[i].dv = dnsDictValueCreate(z->socket_id);
+        vv->nr++;
+        dictSetVal(z->vd, de, vv);
+    }
+    dnsDictValue *dv = vv->views[i].dv;
+    RRSet *old_rs = dnsDictValueGet(dv, rs->type);
+    vv->views[i].dv = dnsDictValueSet(dv, rs, z->socket_id);
+    if (old_rs && old_rs != rs) RRSetDestroy(old_rs);
+    return 0;
+}
+
+static sds dnsDictValueCatStr(sds s, char *k, dnsDictValue *dv, bool skip_apex) {
+    char human[256];
+    sds dv_s = NULL;
+
+    strncpy(human, k, 255);
+    if (strcmp(human, "@") != 0) {
+        len2dotlabel(human, NULL);
+        human[strlen(human)-1] = 0;
+    }
+    for (uint32_t i = 0; i < dv->nr_rs; ++i) {
+        RRSet *rs = dv->rsArr[i];
+        if (rs) {
+            // SOA and NS records already printed at the top of file.
+            if (skip_apex && rs->type == DNS_TYPE_SOA) continue;
+            if (skip_apex && rs->type == DNS_TYPE_NS && strcmp(k, "@") == 0) continue;
+            sds rs_s = RRSetToStr(rs);
+            if (!dv_s) dv_s = sdsempty();
+            dv_s = sdscatsds(dv_s, rs_s);
+            sdsfree(rs_s);
+        }
+    }
+    if (dv_s) {
+        s = sdscat(s, human);
+        s = sdscatsds(s, dv_s);
+        s = sdscat(s, "\n");
+        sdsfree(dv_s);
+    }
+    return s;
+}
+
 // convert zone to a string, mainly for debug
 sds zoneToStr(zone *z) {
-    char human[256];
     sds s = sdsempty();
     s = sdscatprintf(s, "$ORIGIN %s\n", z->dotOrigin);
     //SOA
@@ -464,34 +1704,21 @@ sds zoneToStr(zone *z) {
     dictIterator *it = dictGetIterator(z->d);
     dictEntry *de;
     while((de = dictNext(it)) != NULL) {
-        sds dv_s = NULL;
-        char *k = dictGetKey(de);
-        strncpy(human, k, 255);
-        if (strcmp(human, "@") != 0) {
-            len2dotlabel(human, NULL);
-            human[strlen(human)-1] = 0;
-        }
-        dnsDictValue *dv = dictGetVal(de);
-        for (int i = 0; i < SUPPORT_TYPE_NUM; ++i) {
-            RRSet *rs = dv->v.rsArr[i];
-            if (rs) {
-                // SOA and NS records already printed at the top of file.
-                if (rs->type == DNS_TYPE_SOA) continue;
-                if (rs->type == DNS_TYPE_NS && strcmp(k, "@") == 0) continue;
-                sds rs_s = RRSetToStr(rs);
-                if (!dv_s) dv_s = sdsempty();
-                dv_s = sdscatsds(dv_s, rs_s);
-                sdsfree(rs_s);
-            }
-        }
-        if (dv_s) {
-            s = sdscat(s, human);
-            s = sdscatsds(s, dv_s);
-            s = sdscat(s, "\n");
-            sdsfree(dv_s);
+        s = dnsDictValueCatStr(s, dictGetKey(de), dictGetVal(de), true);
+    }
+    dictReleaseIterator(it);
+    if (z->vd == NULL) return s;
+    // the records of views, one $VIEW section per name and view.
+    it = dictGetIterator(z->vd);
+    while((de = dictNext(it)) != NULL) {
+        dnsViewValue *vv = dictGetVal(de);
+        for (uint32_t i = 0; i < vv->nr; ++i) {
+            s = sdscatprintf(s, "$VIEW %s\n", viewIdToName(vv->views[i].view));
+            s = dnsDictValueCatStr(s, dictGetKey(de), vv->views[i].dv, false);
         }
     }
     dictReleaseIterator(it);
+    s = sdscat(s, "$VIEW\n");
     return s;
 }
 
@@ -538,3 +1765,27 @@ dictType dnsDictType = {
         _dnsDictValDestructor,         /* val destructor */
 };
 
+static void _dnsViewDictValDestructor(void *privdata, void *val)
+{
+    dict *d = privdata;
+    dnsViewValueDestroy(val, d->socket_id);
+}
+
+// a set of names, the values are always NULL.
+dictType nameSetDictType = {
+        _dictStringCaseHash, /* hash function */
+        _dictStringKeyDup,             /* key dup */
+        NULL,                          /* val dup */
+        _dictStringKeyCaseCompare,         /* key compare */
+        _dictStringKeyDestructor,         /* key destructor */
+        NULL,                          /* val destructor */
+};
+
+dictType dnsViewDictType = {
+        _dictStringCaseHash, /* hash function */
+        _dictStringKeyDup,             /* key dup */
+        NULL,                          /* val dup */
+        _dictStringKeyCaseCompare,         /* key compare */
+        _dictStringKeyDestructor,         /* key destructor */
+        _dnsViewDictValDestructor,         /* val destructor */
+};
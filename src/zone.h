@@ -7,14 +7,16 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <netinet/in.h>
 
-#include <urcu.h>		/* RCU flavor */
+#include <urcu-qsbr.h>	/* RCU flavor */
 #include <urcu/rculfhash.h>	/* RCU Lock-free hash table */
 #include <urcu/compiler.h>	/* For CAA_ARRAY_SIZE */
 
 #include <rte_rwlock.h>
 #include <rte_atomic.h>
+#include <rte_memory.h>
 
 #include "sds.h"
 #include "dict.h"
@@ -36,44 +38,221 @@
 
   rdlength is encoded in big endian.
   NOTICE: SOA and CNAME don't allow multiple records for same name.
+
+  after RRSetCompact, the memory layout of data is
+
+  -----------------------------------------------------
+  | RR | RR | ... | RR |pad| off0 | off1 | ... | offn |
+  -----------------------------------------------------
+  |<------- len ------->|<------------ free --------->|
+
+  the offset array(host endian uint16) is stored inline in the tail of data,
+  it is only valid after compaction, RRSetCat will overwrite it.
+
+  compacted RRSets are interned in a per NUMA node table, identical RRSets
+  (same type, ttl and rdata) of different zones share one object,
+  so an interned RRSet is immutable and released by RRSetDestroy(refcount).
 */
-typedef struct _RRSet{
-    int socket_id;
+#define RRSET_MAX_LEN       (65535)
 
-    uint16_t num;          // the number of RR
+#define RRSET_F_INTERNED    (0x1)
+
+typedef struct _RRSet{
+    int16_t socket_id;
     uint16_t type;         // RRSet type
-    unsigned int free;     //
-    unsigned int len;      // the bytes of data(actually used size)
+    uint16_t num;          // the number of RR
+    uint16_t flags;
     uint32_t ttl;          // every RR in RRSet has same ttl
-
-    size_t *offsets;       // offset array, mainly for round rabin
-    int z_rr_idx;          // round rabin index position in zone
+    uint32_t len;          // the bytes of data(actually used size)
+    uint32_t free;         // unused bytes(or inline offsets after compaction)
+    uint32_t hash;         // hash of type, ttl and data, set by RRSetCompact
+    uint32_t refcnt;       // only used by interned RRSet, protected by the pool lock
 
     char data[];
 } RRSet;
 
-// CNAME record sets cannot coexist with other record sets with the same name
-#define SUPPORT_TYPE_NUM    (8)
-struct _typeValue
-{
-    RRSet *A;
-    RRSet *NS;
-    RRSet *CNAME;
-    RRSet *SOA;
-    RRSet *MX;
-    RRSet *TXT;
-    RRSet *AAAA;
-    RRSet *SRV;
-    // RRSet *PTR;
+#define RRSET_OFFSETS_POS(len) (((len) + 1U) & ~1U)
+
+static inline uint16_t RRSetGetOffset(RRSet *rs, int idx) {
+    return ((uint16_t *)(rs->data + RRSET_OFFSETS_POS(rs->len)))[idx];
+}
+
+/*
+ * every supported type has a slot, dnsDictValue uses a bitmap of slots
+ * to track which RRSets exist.
+ */
+enum {
+    RR_SLOT_A = 0,
+    RR_SLOT_NS,
+    RR_SLOT_CNAME,
+    RR_SLOT_SOA,
+    RR_SLOT_MX,
+    RR_SLOT_TXT,
+    RR_SLOT_AAAA,
+    RR_SLOT_SRV,
+    RR_SLOT_PTR,
+    RR_SLOT_CAA,
+    RR_SLOT_DS,
+    RR_SLOT_DNSKEY,
+    RR_SLOT_RRSIG,
+    RR_SLOT_NSEC,
+    RR_SLOT_NSEC3,
+    RR_SLOT_NSEC3PARAM,
+    // dnsDictValue.bitmap and sigmap are 16 bits
+    SUPPORT_TYPE_NUM,
 };
 
+static inline int dnsTypeToSlot(uint16_t type) {
+    switch (type) {
+        case DNS_TYPE_A:     return RR_SLOT_A;
+        case DNS_TYPE_NS:    return RR_SLOT_NS;
+        case DNS_TYPE_CNAME: return RR_SLOT_CNAME;
+        case DNS_TYPE_SOA:   return RR_SLOT_SOA;
+        case DNS_TYPE_MX:    return RR_SLOT_MX;
+        case DNS_TYPE_TXT:   return RR_SLOT_TXT;
+        case DNS_TYPE_AAAA:  return RR_SLOT_AAAA;
+        case DNS_TYPE_SRV:   return RR_SLOT_SRV;
+        case DNS_TYPE_PTR:   return RR_SLOT_PTR;
+        case DNS_TYPE_CAA:   return RR_SLOT_CAA;
+        case DNS_TYPE_DS:    return RR_SLOT_DS;
+        case DNS_TYPE_DNSKEY: return RR_SLOT_DNSKEY;
+        case DNS_TYPE_RRSIG: return RR_SLOT_RRSIG;
+        case DNS_TYPE_NSEC:  return RR_SLOT_NSEC;
+        case DNS_TYPE_NSEC3: return RR_SLOT_NSEC3;
+        case DNS_TYPE_NSEC3PARAM: return RR_SLOT_NSEC3PARAM;
+        default:             return -1;
+    }
+}
+
+/*
+ * all RRSets of a name, most names only have one type,
+ * so only the existing RRSets are stored, rsArr is sorted by slot.
+ *
+ * the RRSIG RRSet keeps all signatures of the name as they are loaded(zone transfer
+ * and dump use it), zoneCompact splits it by the covered type, the signatures of
+ * slot n are stored after the RRSets if bit n of sigmap is set:
+ *
+ *   | RRSet0 | ... | RRSetN | sig of slot i | ... | sig of slot j |
+ *   |<----- nr_rs -------->|<------- popcount(sigmap) --------->|
+ *
+ * any modification drops the signatures, they are rebuilt by next zoneCompact.
+ *
+ * the copies made by zoneCopyShared share the values of the unmodified names, a shared
+ * value is read only, it is freed when the last zone referencing it is destroyed.
+ *
+ * CNAME record sets cannot coexist with other record sets with the same name
+ */
 typedef struct _dnsDictValue {
-    union {
-        struct _typeValue tv;
-        RRSet *rsArr[SUPPORT_TYPE_NUM];
-    }v;
+    uint16_t bitmap;       // bit n is set if the RRSet of slot n exists
+    uint16_t sigmap;       // bit n is set if the RRSet of slot n is signed
+    uint16_t nr_rs;        // the number of RRSets, equal to popcount(bitmap)
+    uint16_t refcnt;       // the number of zones referencing it, changed atomically
+    RRSet *rsArr[];
 } dnsDictValue;
 
+static inline RRSet *dnsDictValueGet(dnsDictValue *dv, int type) {
+    int slot = dnsTypeToSlot((uint16_t)type);
+    if (slot < 0 || !(dv->bitmap & (1U << slot))) return NULL;
+    return dv->rsArr[__builtin_popcount(dv->bitmap & ((1U << slot) - 1))];
+}
+
+// the RRSIG RRSet covering the RRSet of type, only valid after zoneCompact.
+static inline RRSet *dnsDictValueGetSig(dnsDictValue *dv, int type) {
+    int slot = dnsTypeToSlot((uint16_t)type);
+    if (slot < 0 || !(dv->sigmap & (1U << slot))) return NULL;
+    return dv->rsArr[dv->nr_rs + __builtin_popcount(dv->sigmap & ((1U << slot) - 1))];
+}
+
+/*
+ * the RRSets of a name in GeoDNS views($VIEW directive), a name only has a few
+ * views, so they are stored in an array, the view id is the index in view registry.
+ */
+typedef struct {
+    uint32_t view;
+    dnsDictValue *dv;
+} dnsViewEntry;
+
+typedef struct _dnsViewValue {
+    uint32_t nr;
+    dnsViewEntry views[];
+} dnsViewValue;
+
+static inline dnsDictValue *dnsViewValueGet(dnsViewValue *vv, uint32_t view) {
+    for (uint32_t i = 0; i < vv->nr; ++i) {
+        if (vv->views[i].view == view) return vv->views[i].dv;
+    }
+    return NULL;
+}
+
+// the stat and content hash of a zone file, used to skip reloading unchanged files.
+typedef struct {
+    uint64_t size;
+    uint64_t ino;
+    int64_t mtime_ns;
+    uint64_t hash;
+} zoneFileStamp;
+
+static inline bool zoneFileStatEqual(zoneFileStamp *a, zoneFileStamp *b) {
+    return a->size == b->size && a->ino == b->ino && a->mtime_ns == b->mtime_ns;
+}
+
+/*
+ * query counters of a zone, in order to avoid atomic operations, every lcore of the
+ * numa node the zone belongs to has its own slot, one cache line per slot to avoid
+ * false sharing. the slot of an lcore is lcore_stats[lcore_id - start_core_idx].
+ */
+typedef struct {
+    uint64_t nr_queries;
+    uint64_t nr_nxdomain;
+    // the queries dropped or slipped by nxguard
+    uint64_t nr_guarded;
+    // the NXDOMAINs answered in current second of nxguard budget mode
+    long guard_epoch;
+    uint32_t guard_answered;
+} __rte_cache_aligned zoneLcoreStats;
+
+/*
+ * a blocked bloom filter over the names of a zone(owner names and empty non-terminals),
+ * every name sets 8 bits in one block of 64 bytes, so a probe touches one cache line.
+ * the names not in the filter are answered with NXDOMAIN without looking up the dict.
+ */
+typedef struct {
+    uint32_t mask;          // the number of blocks - 1
+    uint64_t blocks[][8] __rte_cache_aligned;
+} nameFilter;
+
+typedef struct {
+    char *name;            // the key in zone dict(relative name in len label format)
+    size_t len;            // the length of name, 0 for origin
+    dnsDictValue *dv;
+} nsecEntry;
+
+// SHA-1 is the only hash algorithm of NSEC3.
+#define NSEC3_HASH_SHA1         1
+#define NSEC3_HASH_LEN          20
+// the NSEC3 proofs of the zones using more iterations are not served(RFC 9276).
+#define NSEC3_MAX_ITERATIONS    100
+
+typedef struct {
+    uint8_t hash[NSEC3_HASH_LEN];   // the hashed owner name in binary
+    nsecEntry e;
+} nsec3Entry;
+
+/*
+ * the names having NSEC3 RRSet using the hash parameters of apex NSEC3PARAM, sorted by
+ * the hashed owner names. the closest encloser of most NXDOMAIN queries is the apex, so
+ * the NSEC3 RR matching the apex and the one covering its wildcard are found in advance.
+ */
+typedef struct {
+    uint16_t iterations;
+    uint8_t salt_len;
+    uint8_t salt[255];
+    int32_t apex;           // the index of the entry matching apex, -1 if none
+    int32_t apex_wildcard;  // the index of the entry covering the wildcard of apex
+    uint32_t nr;
+    nsec3Entry entries[];
+} nsec3Chain;
+
 typedef struct _zone {
     int socket_id;
     char *origin;          // in <len label> format
@@ -84,12 +263,35 @@ typedef struct _zone {
     // if the key is origin, then use @
     // the value is dnsDictValue instance
     dict *d;
+    // the names that have RRSets in views, same key with d, the value is
+    // dnsViewValue instance. NULL if the zone has no view.
+    dict *vd;
 
     // just two pointer to the RRSet object stored in dict,
     // never free these two pointer.
     RRSet *soa;
     RRSet *ns;
 
+    // built by zoneCompact, NULL before the zone is compacted.
+    nameFilter *nf;
+    // the empty non-terminals(names having no RRSet but descendants), NULL if none.
+    dict *ents;
+    // the SOA RR of the authority section of negative responses, the owner is a
+    // compression pointer set per query, the TTL is min(SOA TTL, SOA MINIMUM).
+    // the RRSIG RRs of SOA follow the SOA RR if the zone is signed, they are
+    // appended to the responses of DNSSEC OK queries.
+    char *neg_soa;
+    uint16_t neg_soa_len;
+    uint16_t neg_sig_len;
+    // the RRSIG of apex NS, NULL if the zone is not signed.
+    RRSet *ns_sig;
+    // the names having NSEC RRSet in canonical order(RFC 4034), used to find
+    // the NSEC RR covering a name in negative responses, NULL if no NSEC.
+    nsecEntry *nsec_chain;
+    uint32_t nr_nsec;
+    // the NSEC3 chain, NULL if the zone has no NSEC3 or NSEC3PARAM.
+    nsec3Chain *nsec3;
+
     // some information of SOA record.
     uint32_t sn;
     int32_t refresh;
@@ -97,28 +299,34 @@ typedef struct _zone {
     int32_t expiry;
     int32_t nx;
 
-    /*
-     * round rabin information for RRSet
-     * in order to avoid atomic operation, we prepare a per-core rr_idx for every rrset object.
-     */
-    int start_core_idx;  // start core of the numa node this zone belongs to
-    /*
-     * the memory layout is
-     * -----------------------------------------------
-     * |  |  |  |  |  |  |      |      |      |      |
-     * -----------------------------------------------
-     * the first half is an offset array, every offset should point to the rr_idx array,
-     * every core in the numa node this zone belongs to should have an element in this array,
-     * in order to decrease the array size, we store the start core idx,
-     * so when you fetch the rr_idx array, you should use lcore_id-start_core_idx as the array index.
-     *
-     * the second half is the real rr_idx array, every rrset has a z_rr_idx field, use this field
-     * to get the rr_idx for this rrset.
-     */
-    uint32_t *rr_offset_array;
-
     // timestamp when this zone needs reload
     long refresh_ts;
+    // timestamp of the last reload and the time(microseconds) spent to build it.
+    long reload_ts;
+    long long reload_us;
+    // the approximate memory used by the zone, computed by zoneCompact(see zoneMemUsage),
+    // so the accounting of the zones waiting for reclamation doesn't walk the zone.
+    size_t mem_usage;
+    // only set in the copies made by zoneCopyShared: the names whose values are
+    // modified(so only they are compacted by zoneCompact), and whether a name is
+    // added or removed(so the name filter and the NSEC chain need to be rebuilt).
+    dict *dirty;
+    bool names_changed;
+    // only used by zones loaded from file.
+    zoneFileStamp stamp;
+
+    // allocated when the zone is prepared for publishing, the copies made
+    // for other purposes(zone transfer etc.) don't count queries.
+    int start_core_idx;
+    int nr_lcore_stats;
+    zoneLcoreStats *lcore_stats;
+    // the counters of the zone replaced by this one, so the counters keep
+    // increasing across reloads.
+    uint64_t base_queries;
+    uint64_t base_nxdomain;
+    // set by main thread while the zone is under random subdomain attack(see nxguard.c).
+    volatile int guard_mode;
+
     struct rb_node rbnode;
     struct cds_lfht_node htnode;
     struct rcu_head rcu_head;
@@ -126,29 +334,56 @@ typedef struct _zone {
 
 RRSet *RRSetCreate(uint16_t type, int socket_id);
 RRSet *RRSetDup(RRSet *rs, int socket_id);
-void RRSetUpdateOffsets(RRSet *rs);
+RRSet *RRSetShare(RRSet *rs, int socket_id);
+RRSet *RRSetCompact(RRSet *rs);
+RRSet *RRSetIntern(RRSet *rs);
+void RRSetPoolGetStats(int socket_id, size_t *nr_rrsets, size_t *nr_refs, size_t *bytes);
 RRSet* RRSetCat(RRSet *rs, char *buf, size_t len);
-RRSet *RRSetRemoveFreeSpace(RRSet *rs);
+int RRSetFindRR(RRSet *rs, char *rr, size_t len);
+void RRSetDelRR(RRSet *rs, int idx);
 sds RRSetToStr(RRSet *rs);
 void RRSetDestroy(RRSet *rs);
 
-RRSet *dnsDictValueGet(dnsDictValue *dv, int type);
-void dnsDictValueSet(dnsDictValue *dv, RRSet *rs);
+dnsDictValue *dnsDictValueSet(dnsDictValue *dv, RRSet *rs, int socket_id);
 dnsDictValue *dnsDictValueCreate(int socket_id);
 dnsDictValue *dnsDictValueDup(dnsDictValue *dv, int socket_id);
 void dnsDictValueDestroy(dnsDictValue *val, int socket_id);
 
+static inline zoneLcoreStats *zoneGetLcoreStats(zone *z, int lcore_id) {
+    int idx = lcore_id - z->start_core_idx;
+    if (z->lcore_stats == NULL || idx < 0 || idx >= z->nr_lcore_stats) return NULL;
+    return &z->lcore_stats[idx];
+}
+
 zone *zoneCreate(char *origin, int socket_id);
 zone *zoneCopy(zone *z, int socket_id);
+zone *zoneCopyShared(zone *z);
 void zoneDestroy(zone *zn);
+void zoneCompact(zone *zn);
+void zoneInitStats(zone *zn, int start_core_idx, int nr_lcores);
+void zoneGetQueryStats(zone *zn, uint64_t *nr_queries, uint64_t *nr_nxdomain);
+size_t zoneMemUsage(zone *zn, size_t *nr_records);
 dnsDictValue *zoneFetchValueAbs(zone *z, void *key, size_t keyLen);
 dnsDictValue *zoneFetchValueRelative(zone *z, void *key);
+bool zoneIsEmptyNonTerminalAbs(zone *z, void *key, size_t keyLen);
+nsecEntry *zoneFindNsecCover(zone *z, char *key, size_t keyLen);
+nsecEntry *zoneFindWildcardNsecCover(zone *z, char *key, size_t keyLen);
+void zoneNsec3Hash(zone *z, char *key, size_t keyLen, uint8_t *hash);
+nsec3Entry *zoneFindNsec3(zone *z, uint8_t *hash, bool *match);
+dnsDictValue *zoneFetchValue(zone *z, void *key);
 RRSet *zoneFetchTypeVal(zone *z, void *key, uint16_t type);
 int zoneReplace(zone *z, void *key, dnsDictValue *val);
 int zoneReplaceTypeVal(zone *z, char *key, RRSet *rs);
+int zoneDeleteTypeVal(zone *z, char *key, uint16_t type);
+dnsViewValue *zoneFetchViewsAbs(zone *z, void *key, size_t keyLen);
+RRSet *zoneFetchViewTypeVal(zone *z, uint32_t view, void *key, uint16_t type);
+int zoneReplaceViewTypeVal(zone *z, uint32_t view, char *key, RRSet *rs);
 sds zoneToStr(zone *z);
 
 extern dictType dnsDictType;
+extern dictType dnsViewDictType;
+extern dictType nameSetDictType;
 extern const struct cds_lfht_mm_type cds_lfht_mm_socket;
+extern unsigned long cds_lfht_mm_socket_bytes;
 
 #endif //SHUKE_ZONE_H
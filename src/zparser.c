@@ -4,26 +4,29 @@
 #include "fmacros.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <sys/stat.h>
+#include <time.h>
 
 #include "str.h"
 #include "endianconv.h"
 #include "dnspacket.h"
 #include "zparser.h"
+#include "view.h"
 #include "log.h"
 #include "utils.h"
 #include "zmalloc.h"
 
 DEF_LOG_MODULE(RTE_LOGTYPE_USER1, "ZPARSER");
 
-#define RECORD_SIZE 8192
-
 static bool isttl(const char *ss);
 static bool isclass(const char *ss);
 static long parsetime(char *ss);
+static int RRParserDoFeed(RRParser *psr, char *name, bool has_owner, zone *z);
 
 
 static inline char *RRParserNextToken(RRParser *psr) {
@@ -75,23 +78,238 @@ int RRParserSetDotOrigin(RRParser *psr, char *dotOrigin) {
     return OK_CODE;
 }
 
-static int RRParserTokenize(RRParser *psr, char *s) {
-    char *tokens[4096];
-    int ntokens = 4096;
-    int maxTokens = (int)(sizeof(psr->tokens)/sizeof(char*));
-    if (tokenize(s, tokens, &ntokens, " \t") < 0) {
-        LOG_ERR("parser error");
-        return -1;
+/*!
+ * set the view of the following records, NULL or "default" means the default view.
+ */
+int RRParserSetView(RRParser *psr, char *view) {
+    int id = 0;
+
+    if (view != NULL && strcasecmp(view, VIEW_DEFAULT_NAME) != 0) {
+        if ((id = viewGetId(view, true)) == ERR_CODE) {
+            snprintf(psr->errstr, ERR_STR_LEN, "too many views(max %d)", VIEW_MAX);
+            psr->err = PARSER_ERR;
+            return ERR_CODE;
+        }
     }
+    psr->view = (uint32_t)id;
+    return OK_CODE;
+}
+
+/*
+ * SOA and NS records of origin decide the authority of the zone, they can't vary with views.
+ */
+static int RRParserCheckView(RRParser *psr, bool is_apex) {
+    if (psr->view == 0) return OK_CODE;
+    if (psr->type == DNS_TYPE_SOA || (psr->type == DNS_TYPE_NS && is_apex)) {
+        snprintf(psr->errstr, ERR_STR_LEN, "%s records of origin are not allowed in view %s.",
+                 DNSTypeToStr(psr->type), viewIdToName(psr->view));
+        return ERR_CODE;
+    }
+    return OK_CODE;
+}
+
+static void RRParserSetTokens(RRParser *psr, char **tokens, int ntokens) {
+    int maxTokens = (int)(sizeof(psr->data)/sizeof(char*));
     if (ntokens > maxTokens) {
         psr->tokens = zmemdup(tokens, sizeof(char *)*ntokens);
     } else {
         rte_memcpy(psr->tokens, tokens, sizeof(char*) *ntokens);
     }
     psr->ntokens = ntokens;
+}
+
+static int RRParserTokenize(RRParser *psr, char *s) {
+    char *tokens[4096];
+    int ntokens = 4096;
+    int ret = tokenize(s, tokens, &ntokens, " \t");
+    if (ret < 0) {
+        snprintf(psr->errstr, ERR_STR_LEN, "%s", ret == -2? "unbalanced double quotes": "too many tokens");
+        LOG_ERR("parser error");
+        return -1;
+    }
+    RRParserSetTokens(psr, tokens, ntokens);
     return 0;
 }
 
+static int uint16Cmp(const void *a, const void *b) {
+    return (int)*(const uint16_t *)a - (int)*(const uint16_t *)b;
+}
+
+/*
+ * the type bitmap of NSEC and NSEC3(RFC 4034 4.1.2), the remaining tokens are types.
+ */
+static char *RRParserParseTypeBitmap(RRParser *psr, char *ptr, char *end) {
+    uint16_t types[512];
+    int n = 0, ret;
+    char *tok;
+
+    while ((tok = RRParserNextToken(psr)) != NULL) {
+        if (n == (int)(sizeof(types)/sizeof(types[0])) || (ret = strToQtype(tok)) == ERR_CODE) {
+            snprintf(psr->errstr, ERR_STR_LEN, "invalid type %s in type bitmap.", tok);
+            return NULL;
+        }
+        types[n++] = (uint16_t)ret;
+    }
+    qsort(types, (size_t)n, sizeof(uint16_t), uint16Cmp);
+    for (int i = 0; i < n; ) {
+        uint8_t window = (uint8_t)(types[i] >> 8);
+        uint8_t bitmap[32] = {0};
+        int len = 0;
+        for (; i < n && (types[i] >> 8) == window; ++i) {
+            uint8_t low = (uint8_t)types[i];
+            bitmap[low / 8] |= (uint8_t)(0x80 >> (low % 8));
+            len = low / 8 + 1;
+        }
+        if (ptr + 2 + len > end) {
+            snprintf(psr->errstr, ERR_STR_LEN, "type bitmap is too long.");
+            return NULL;
+        }
+        *ptr++ = (char)window;
+        *ptr++ = (char)len;
+        memcpy(ptr, bitmap, (size_t)len);
+        ptr += len;
+    }
+    return ptr;
+}
+
+// the base64 data(key or signature) may be split into multiple tokens.
+static char *RRParserParseBase64(RRParser *psr, char *ptr, char *end) {
+    char b64[RECORD_SIZE];
+    size_t len = 0, tokLen;
+    int n;
+    char *tok;
+
+    while ((tok = RRParserNextToken(psr)) != NULL) {
+        tokLen = strlen(tok);
+        if (len + tokLen > sizeof(b64)) goto invalid;
+        memcpy(b64 + len, tok, tokLen);
+        len += tokLen;
+    }
+    if (len == 0 || (len + 3) / 4 * 3 > (size_t)(end - ptr)) goto invalid;
+    if ((n = base64ToBin(b64, len, ptr)) < 0) goto invalid;
+    return ptr + n;
+
+invalid:
+    snprintf(psr->errstr, ERR_STR_LEN, "invalid base64 data for %s record.", DNSTypeToStr(psr->type));
+    return NULL;
+}
+
+static char *RRParserParseName(RRParser *psr, char *ptr) {
+    char *tok = RRParserNextToken(psr);
+    size_t nameLen;
+
+    if (tok == NULL) {
+        snprintf(psr->errstr, ERR_STR_LEN, "need a domain name.");
+        return NULL;
+    }
+    dot2lenlabel(tok, NULL);
+    if (checkLenLabel(tok, 0) == ERR_CODE) {
+        snprintf(psr->errstr, ERR_STR_LEN, "%s is an invalid domain name", tok);
+        return NULL;
+    }
+    nameLen = strlen(tok) + 1;
+    memcpy(ptr, tok, nameLen);
+    return ptr + nameLen;
+}
+
+// the salt of NSEC3 and NSEC3PARAM, "-" means empty salt.
+static char *RRParserParseSalt(RRParser *psr, char *ptr) {
+    char *tok = RRParserNextToken(psr);
+    size_t hexLen = strlen(tok);
+    int n = 0;
+
+    if (strcmp(tok, "-") != 0 && (hexLen > 510 || (n = hex2bin(tok, hexLen, ptr+1)) < 0)) {
+        snprintf(psr->errstr, ERR_STR_LEN, "invalid salt for %s record.", DNSTypeToStr(psr->type));
+        return NULL;
+    }
+    *ptr = (char)n;
+    return ptr + 1 + n;
+}
+
+/*
+ * a character-string(RFC 1035 5.1) in a single token, quoted or not, the escapes(\X and \DDD)
+ * are decoded. the quotes must be balanced, a quote inside the string must be escaped.
+ */
+static char *RRParserParseCharString(RRParser *psr, char *tok, char *ptr, char *end) {
+    size_t len = strlen(tok);
+    int v;
+
+    if (tok[0] == '"') {
+        if (len < 2 || tok[len-1] != '"') goto invalid;
+        tok++;
+        len -= 2;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        if (ptr >= end) {
+            snprintf(psr->errstr, ERR_STR_LEN, "%s record is too long.", DNSTypeToStr(psr->type));
+            return NULL;
+        }
+        if (tok[i] == '"') goto invalid;
+        if (tok[i] != '\\') {
+            *ptr++ = tok[i];
+            continue;
+        }
+        // a trailing backslash escapes the closing quote.
+        if (++i >= len) goto invalid;
+        if (i + 2 < len && isdigit((uint8_t)tok[i]) && isdigit((uint8_t)tok[i+1]) && isdigit((uint8_t)tok[i+2])) {
+            v = (tok[i] - '0') * 100 + (tok[i+1] - '0') * 10 + (tok[i+2] - '0');
+            if (v > 255) goto invalid;
+            *ptr++ = (char)v;
+            i += 2;
+        } else {
+            *ptr++ = tok[i];
+        }
+    }
+    return ptr;
+
+invalid:
+    snprintf(psr->errstr, ERR_STR_LEN, "unbalanced quotes or invalid escape in %s record.", DNSTypeToStr(psr->type));
+    return NULL;
+}
+
+/*
+ * the NSEC3 hash parameters: algorithm, flags and iterations.
+ */
+static char *RRParserParseNsec3Params(RRParser *psr, char *ptr) {
+    for (int i = 0; i < 3; ++i) {
+        char *tok = RRParserNextToken(psr);
+        int v = atoi(tok);
+        if (v < 0 || v > (i < 2? 255: 65535)) {
+            snprintf(psr->errstr, ERR_STR_LEN, "invalid hash parameters for %s record.", DNSTypeToStr(psr->type));
+            return NULL;
+        }
+        if (i < 2) {
+            *ptr++ = (uint8_t)v;
+        } else {
+            dump16be((uint16_t)v, ptr);
+            ptr += 2;
+        }
+    }
+    return RRParserParseSalt(psr, ptr);
+}
+
+/*
+ * the signature expiration and inception, YYYYMMDDHHmmSS in UTC or seconds since epoch.
+ */
+static bool parseSigTime(const char *tok, uint32_t *t) {
+    struct tm tm;
+    char *end;
+
+    if (strlen(tok) == 14 && strspn(tok, "0123456789") == 14) {
+        memset(&tm, 0, sizeof(tm));
+        if (sscanf(tok, "%4d%2d%2d%2d%2d%2d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                   &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6) return false;
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        *t = (uint32_t)timegm(&tm);
+        return true;
+    }
+    unsigned long v = strtoul(tok, &end, 10);
+    if (end == tok || *end != 0 || v > UINT32_MAX) return false;
+    *t = (uint32_t)v;
+    return true;
+}
+
 int RRParserParseTextRdata(RRParser *psr, RRSet **rs, zone *z) {
     int err = OK_CODE;
     uint16_t type = psr->type;
@@ -136,6 +354,7 @@ int RRParserParseTextRdata(RRParser *psr, RRSet **rs, zone *z) {
         break;
     case DNS_TYPE_NS:
     case DNS_TYPE_CNAME:
+    case DNS_TYPE_PTR:
         tok = RRParserNextToken(psr);
         if (tok == NULL) {
             snprintf(psr->errstr, ERR_STR_LEN, "need a domain name.");
@@ -286,7 +505,169 @@ int RRParserParseTextRdata(RRParser *psr, RRSet **rs, zone *z) {
         memcpy(ptr, tok, targetLen);
         ptr += targetLen;
         break;
-    case DNS_TYPE_PTR:
+    case DNS_TYPE_CAA:
+        if (remain != 3) {
+            snprintf(psr->errstr, ERR_STR_LEN, "CAA record needs 3 tokens(quote the value if it has spaces), but got %d.", remain);
+            goto error;
+        }
+        tok = RRParserNextToken(psr);
+        int caaFlags = atoi(tok);
+        if (caaFlags < 0 || caaFlags > 255) {
+            snprintf(psr->errstr, ERR_STR_LEN, "invalid flags for CAA record.");
+            goto error;
+        }
+        tok = RRParserNextToken(psr);
+        size_t tagLen = strlen(tok);
+        if (tagLen == 0 || tagLen > 15) {
+            snprintf(psr->errstr, ERR_STR_LEN, "invalid tag for CAA record.");
+            goto error;
+        }
+        *ptr++ = (uint8_t)caaFlags;
+        *ptr++ = (uint8_t)tagLen;
+        memcpy(ptr, tok, tagLen);
+        ptr += tagLen;
+        // the value is the remainder of rdata, without length prefix.
+        if ((ptr = RRParserParseCharString(psr, RRParserNextToken(psr), ptr, buf + sizeof(buf))) == NULL) goto error;
+        break;
+    case DNS_TYPE_DS:
+        if (remain < 4) {
+            snprintf(psr->errstr, ERR_STR_LEN, "DS record needs at least 4 tokens, but got %d.", remain);
+            goto error;
+        }
+        tok = RRParserNextToken(psr);
+        int keyTag = atoi(tok);
+        if (keyTag < 0 || keyTag > 65535) {
+            snprintf(psr->errstr, ERR_STR_LEN, "invalid key tag for DS record.");
+            goto error;
+        }
+        dump16be((uint16_t)keyTag, ptr);
+        ptr += 2;
+        for (int i = 0; i < 2; ++i) {
+            tok = RRParserNextToken(psr);
+            int v = atoi(tok);
+            if (v < 0 || v > 255) {
+                snprintf(psr->errstr, ERR_STR_LEN, "invalid algorithm or digest type for DS record.");
+                goto error;
+            }
+            *ptr++ = (uint8_t)v;
+        }
+        // the digest may be split into multiple tokens
+        while ((tok = RRParserNextToken(psr)) != NULL) {
+            size_t hexLen = strlen(tok);
+            if (ptr+hexLen/2 - buf >= (int)sizeof(buf)) {
+                snprintf(psr->errstr, ERR_STR_LEN, "DS record is too long");
+                goto error;
+            }
+            int n = hex2bin(tok, hexLen, ptr);
+            if (n < 0) {
+                snprintf(psr->errstr, ERR_STR_LEN, "invalid digest for DS record.");
+                goto error;
+            }
+            ptr += n;
+        }
+        break;
+    case DNS_TYPE_DNSKEY:
+        if (remain < 4) {
+            snprintf(psr->errstr, ERR_STR_LEN, "DNSKEY record needs at least 4 tokens, but got %d.", remain);
+            goto error;
+        }
+        tok = RRParserNextToken(psr);
+        int keyFlags = atoi(tok);
+        if (keyFlags < 0 || keyFlags > 65535) {
+            snprintf(psr->errstr, ERR_STR_LEN, "invalid flags for DNSKEY record.");
+            goto error;
+        }
+        dump16be((uint16_t)keyFlags, ptr);
+        ptr += 2;
+        for (int i = 0; i < 2; ++i) {
+            tok = RRParserNextToken(psr);
+            int v = atoi(tok);
+            if (v < 0 || v > 255) {
+                snprintf(psr->errstr, ERR_STR_LEN, "invalid protocol or algorithm for DNSKEY record.");
+                goto error;
+            }
+            *ptr++ = (uint8_t)v;
+        }
+        if ((ptr = RRParserParseBase64(psr, ptr, buf + sizeof(buf))) == NULL) goto error;
+        break;
+    case DNS_TYPE_RRSIG:
+        if (remain < 9) {
+            snprintf(psr->errstr, ERR_STR_LEN, "RRSIG record needs at least 9 tokens, but got %d.", remain);
+            goto error;
+        }
+        tok = RRParserNextToken(psr);
+        int covered = strToQtype(tok);
+        if (covered == ERR_CODE) {
+            snprintf(psr->errstr, ERR_STR_LEN, "invalid type covered(%s) for RRSIG record.", tok);
+            goto error;
+        }
+        dump16be((uint16_t)covered, ptr);
+        ptr += 2;
+        for (int i = 0; i < 2; ++i) {
+            tok = RRParserNextToken(psr);
+            int v = atoi(tok);
+            if (v < 0 || v > 255) {
+                snprintf(psr->errstr, ERR_STR_LEN, "invalid algorithm or labels for RRSIG record.");
+                goto error;
+            }
+            *ptr++ = (uint8_t)v;
+        }
+        tok = RRParserNextToken(psr);
+        dump32be((uint32_t)parsetime(tok), ptr);
+        ptr += 4;
+        for (int i = 0; i < 2; ++i) {
+            uint32_t t;
+            tok = RRParserNextToken(psr);
+            if (!parseSigTime(tok, &t)) {
+                snprintf(psr->errstr, ERR_STR_LEN, "invalid signature expiration or inception(%s).", tok);
+                goto error;
+            }
+            dump32be(t, ptr);
+            ptr += 4;
+        }
+        tok = RRParserNextToken(psr);
+        int sigKeyTag = atoi(tok);
+        if (sigKeyTag < 0 || sigKeyTag > 65535) {
+            snprintf(psr->errstr, ERR_STR_LEN, "invalid key tag for RRSIG record.");
+            goto error;
+        }
+        dump16be((uint16_t)sigKeyTag, ptr);
+        ptr += 2;
+        // the signer's name is never compressed.
+        if ((ptr = RRParserParseName(psr, ptr)) == NULL) goto error;
+        if ((ptr = RRParserParseBase64(psr, ptr, buf + sizeof(buf))) == NULL) goto error;
+        break;
+    case DNS_TYPE_NSEC:
+        if (remain < 1) {
+            snprintf(psr->errstr, ERR_STR_LEN, "NSEC record needs at least 1 token.");
+            goto error;
+        }
+        if ((ptr = RRParserParseName(psr, ptr)) == NULL) goto error;
+        if ((ptr = RRParserParseTypeBitmap(psr, ptr, buf + sizeof(buf))) == NULL) goto error;
+        break;
+    case DNS_TYPE_NSEC3:
+        if (remain < 5) {
+            snprintf(psr->errstr, ERR_STR_LEN, "NSEC3 record needs at least 5 tokens, but got %d.", remain);
+            goto error;
+        }
+        if ((ptr = RRParserParseNsec3Params(psr, ptr)) == NULL) goto error;
+        tok = RRParserNextToken(psr);
+        size_t hashLen = strlen(tok);
+        int nr_hash = hashLen > 408? -1: base32hexToBin(tok, hashLen, ptr+1);
+        if (nr_hash <= 0) {
+            snprintf(psr->errstr, ERR_STR_LEN, "invalid next hashed owner name for NSEC3 record.");
+            goto error;
+        }
+        *ptr = (char)nr_hash;
+        ptr += 1 + nr_hash;
+        if ((ptr = RRParserParseTypeBitmap(psr, ptr, buf + sizeof(buf))) == NULL) goto error;
+        break;
+    case DNS_TYPE_NSEC3PARAM:
+        if (remain != 4) {
+            snprintf(psr->errstr, ERR_STR_LEN, "NSEC3PARAM record needs 4 tokens, but got %d.", remain);
+            goto error;
+        }
+        if ((ptr = RRParserParseNsec3Params(psr, ptr)) == NULL) goto error;
         break;
     default:
         snprintf(psr->errstr, ERR_STR_LEN, "unsupported dns record type(%d)", type);
@@ -294,6 +675,11 @@ int RRParserParseTextRdata(RRParser *psr, RRSet **rs, zone *z) {
     }
     rdlength = (uint16_t )(ptr-buf - 2);
     dump16be(rdlength, buf);
+    // the inline offsets of RRSet are 16 bits
+    if ((*rs)->len + (ptr-buf) > RRSET_MAX_LEN) {
+        snprintf(psr->errstr, ERR_STR_LEN, "too many records for %s", psr->name);
+        goto error;
+    }
     *rs = RRSetCat(*rs, buf, ptr-buf);
 
     goto ok;
@@ -326,8 +712,9 @@ int RRParserDoParse(RRParser *psr, zone *z, bool check_top_soa) {
             goto error;
         }
     }
+    if (RRParserCheckView(psr, strcmp(domain, "@") == 0) == ERR_CODE) goto error;
 
-    rs = zoneFetchTypeVal(z, domain, type);
+    rs = zoneFetchViewTypeVal(z, psr->view, domain, type);
     if (rs == NULL) rs = RRSetCreate(type, z->socket_id);
     else rs = RRSetDup(rs, z->socket_id);
 
@@ -345,7 +732,7 @@ int RRParserDoParse(RRParser *psr, zone *z, bool check_top_soa) {
     if (type == DNS_TYPE_SOA) {
         z->soa = rs;
     }
-    zoneReplaceTypeVal(z, domain, rs);
+    zoneReplaceViewTypeVal(z, psr->view, domain, rs);
     goto ok;
 
 error:
@@ -370,14 +757,54 @@ ok:
  * @return OK_CODE if everything is ok otherwise return ERR_CODE.
  */
 int RRParserFeed(RRParser *psr, char *ss, char *name, zone *z) {
+    RRParserReset(psr);
+    if (RRParserTokenize(psr, ss) < 0) {
+        psr->err = PARSER_ERR;
+        return ERR_CODE;
+    }
+    return RRParserDoFeed(psr, name, *ss != ' ', z);
+}
+
+/*!
+ * parse a record read by zoneTokenizer, the tokens are copied to psr->rbuf
+ * since the rdata parser needs null terminated strings.
+ *
+ * @param psr : the RRParser object.
+ * @param tokens : the tokens of the record.
+ * @param ntokens
+ * @param has_owner : false if the record uses the owner name of previous record.
+ * @param z : the zone object this RR belongs to.
+ * @return OK_CODE if everything is ok otherwise return ERR_CODE.
+ */
+int RRParserFeedTokens(RRParser *psr, zoneToken *tokens, int ntokens, bool has_owner, zone *z) {
+    char *ptrs[ZT_MAX_TOKENS];
+    char *p = psr->rbuf;
+    char *end = psr->rbuf + sizeof(psr->rbuf);
+
+    RRParserReset(psr);
+    for (int i = 0; i < ntokens; ++i) {
+        if ((size_t)(end - p) <= tokens[i].len) {
+            snprintf(psr->errstr, ERR_STR_LEN, "the record is too long(more than %d)", RECORD_SIZE);
+            psr->err = PARSER_ERR;
+            return ERR_CODE;
+        }
+        memcpy(p, tokens[i].ptr, tokens[i].len);
+        p[tokens[i].len] = 0;
+        ptrs[i] = p;
+        p += tokens[i].len + 1;
+    }
+    RRParserSetTokens(psr, ptrs, ntokens);
+    return RRParserDoFeed(psr, NULL, has_owner, z);
+}
+
+/*
+ * the common part of RRParserFeed and RRParserFeedTokens, psr->tokens must be ready.
+ */
+static int RRParserDoFeed(RRParser *psr, char *name, bool has_owner, zone *z) {
     bool no_type = true;
     bool check_soa_top = true;
     char *tok;
     int err = OK_CODE;
-    RRParserReset(psr);
-    if (RRParserTokenize(psr, ss) < 0) {
-        goto error;
-    }
     if (name != NULL) {
         check_soa_top = false;
         strncpy(psr->name, name, MAX_DOMAIN_LEN);
@@ -386,7 +813,11 @@ int RRParserFeed(RRParser *psr, char *ss, char *name, zone *z) {
             goto error;
         }
     } else {
-        if (*ss != ' ') {
+        if (has_owner) {
+            if (psr->ntokens == 0) {
+                snprintf(psr->errstr, ERR_STR_LEN, "empty record");
+                goto error;
+            }
             strncpy(psr->name, psr->tokens[0], MAX_DOMAIN_LEN);
             if (abs2lenRelative(psr->name, psr->dotOrigin) == ERR_CODE) {
                 // LOG_DEBUG("%s %s", psr->tokens[0], psr->dotOrigin);
@@ -460,6 +891,186 @@ ok:
     return err;
 }
 
+/*
+ * check the uncompressed wire rdata, the names in rdata must be valid,
+ * since they are used to compress the response.
+ */
+static int checkWireRdata(RRParser *psr, zone *z, char *rdata, size_t len) {
+    int n1, n2;
+    size_t offset;
+
+    switch (psr->type) {
+    case DNS_TYPE_A:
+        if (len != 4) goto invalid;
+        break;
+    case DNS_TYPE_AAAA:
+        if (len != 16) goto invalid;
+        break;
+    case DNS_TYPE_NS:
+    case DNS_TYPE_CNAME:
+    case DNS_TYPE_PTR:
+        if (checkLenLabel(rdata, len) != (int)len) goto invalid;
+        break;
+    case DNS_TYPE_MX:
+        if (len <= 2 || checkLenLabel(rdata+2, len-2) != (int)(len-2)) goto invalid;
+        break;
+    case DNS_TYPE_SRV:
+        if (len <= 6 || checkLenLabel(rdata+6, len-6) != (int)(len-6)) goto invalid;
+        break;
+    case DNS_TYPE_TXT:
+        if (len == 0) goto invalid;
+        for (offset = 0; offset < len; offset += (uint8_t)rdata[offset] + 1);
+        if (offset != len) goto invalid;
+        break;
+    case DNS_TYPE_SOA:
+        if ((n1 = checkLenLabel(rdata, len)) == ERR_CODE) goto invalid;
+        if ((n2 = checkLenLabel(rdata+n1, len-n1)) == ERR_CODE) goto invalid;
+        offset = (size_t)(n1 + n2);
+        if (offset + 20 != len) goto invalid;
+        z->sn = load32be(rdata+offset);
+        z->refresh = load32be(rdata+offset+4);
+        z->retry = load32be(rdata+offset+8);
+        z->expiry = load32be(rdata+offset+12);
+        z->nx = load32be(rdata+offset+16);
+        break;
+    case DNS_TYPE_CAA:
+        // flags, tag length(1-15), tag and value
+        if (len < 2 || (uint8_t)rdata[1] == 0 || (uint8_t)rdata[1] > 15 || len < 2U + (uint8_t)rdata[1]) goto invalid;
+        break;
+    case DNS_TYPE_DS:
+        // key tag, algorithm, digest type and digest
+        if (len <= 4) goto invalid;
+        break;
+    case DNS_TYPE_DNSKEY:
+        if (len <= 4) goto invalid;
+        break;
+    case DNS_TYPE_RRSIG:
+        // the signer's name is followed by the signature
+        if (len <= 18 || (n1 = checkLenLabel(rdata+18, len-18)) == ERR_CODE || (size_t)n1 + 18 >= len) goto invalid;
+        break;
+    case DNS_TYPE_NSEC:
+        if (checkLenLabel(rdata, len) == ERR_CODE) goto invalid;
+        break;
+    case DNS_TYPE_NSEC3:
+        // hash parameters, salt and next hashed owner name
+        if (len < 6 || (offset = 5U + (uint8_t)rdata[4]) >= len || offset + 1 + (uint8_t)rdata[offset] > len) goto invalid;
+        break;
+    case DNS_TYPE_NSEC3PARAM:
+        if (len < 5 || 5U + (uint8_t)rdata[4] != len) goto invalid;
+        break;
+    default:
+        snprintf(psr->errstr, ERR_STR_LEN, "unsupported dns record type(%d)", psr->type);
+        return ERR_CODE;
+    }
+    return OK_CODE;
+
+invalid:
+    snprintf(psr->errstr, ERR_STR_LEN, "invalid wire rdata for %s(type %d).", psr->dotOrigin, psr->type);
+    return ERR_CODE;
+}
+
+/*!
+ * add a RR whose rdata is already in wire format(e.g. pre-encoded in mongodb),
+ * this skips tokenizing and parsing the text rdata.
+ *
+ * @param psr : the RRParser object.
+ * @param owner : the absolute owner name in lowercase len label format.
+ * @param ownerLen : the size of owner, including the terminating zero.
+ * @param ttl
+ * @param type : the text type.
+ * @param rdata : the uncompressed wire rdata.
+ * @param rdlength : the size of rdata.
+ * @param z : the zone object this RR belongs to.
+ * @return OK_CODE if everything is ok otherwise return ERR_CODE.
+ */
+int RRParserFeedWire(RRParser *psr, char *owner, size_t ownerLen, uint32_t ttl, char *type,
+                     char *rdata, size_t rdlength, zone *z)
+{
+    RRSet *rs = NULL, *old_rs;
+    char buf[4096];
+    size_t relativeLen, i;
+    int err = OK_CODE;
+    int ret;
+
+    RRParserReset(psr);
+    if (ownerLen <= z->originLen || checkLenLabel(owner, ownerLen) != (int)ownerLen) {
+        snprintf(psr->errstr, ERR_STR_LEN, "invalid owner name in wire format, dotOrigin(%s)", psr->dotOrigin);
+        goto error;
+    }
+    // the owner must end with origin at a label boundary
+    relativeLen = ownerLen - z->originLen - 1;
+    for (i = 0; i < relativeLen; i += (uint8_t)owner[i] + 1);
+    if (i != relativeLen || strncasecmp(owner+relativeLen, z->origin, z->originLen+1) != 0) {
+        snprintf(psr->errstr, ERR_STR_LEN, "owner name doesn't belong to %s", psr->dotOrigin);
+        goto error;
+    }
+    if (relativeLen == 0) {
+        strcpy(psr->name, "@");
+    } else {
+        memcpy(psr->name, owner, relativeLen);
+        psr->name[relativeLen] = 0;
+    }
+    psr->ttl = ttl;
+    if ((ret = strToDNSType(type)) == ERR_CODE) {
+        snprintf(psr->errstr, ERR_STR_LEN, "%s is not a type", type);
+        goto error;
+    }
+    psr->type = (uint16_t)ret;
+
+    if (psr->type == DNS_TYPE_SOA) {
+        if (z->soa != NULL) {
+            snprintf(psr->errstr, ERR_STR_LEN, "syntax Error: Duplicate SOA record.");
+            goto error;
+        }
+        if (relativeLen != 0) {
+            snprintf(psr->errstr, ERR_STR_LEN, "syntax Error: domain name for SOA record is invalid");
+            goto error;
+        }
+    }
+    if (rdlength + 2 > sizeof(buf)) {
+        snprintf(psr->errstr, ERR_STR_LEN, "wire rdata is too long(%zu)", rdlength);
+        goto error;
+    }
+    if (checkWireRdata(psr, z, rdata, rdlength) == ERR_CODE) goto error;
+    if (RRParserCheckView(psr, relativeLen == 0) == ERR_CODE) goto error;
+
+    old_rs = zoneFetchViewTypeVal(z, psr->view, psr->name, psr->type);
+    // the inline offsets of RRSet are 16 bits
+    if (old_rs && old_rs->len + 2 + rdlength > RRSET_MAX_LEN) {
+        snprintf(psr->errstr, ERR_STR_LEN, "too many records for %s", psr->dotOrigin);
+        goto error;
+    }
+    dump16be((uint16_t)rdlength, buf);
+    memcpy(buf+2, rdata, rdlength);
+    /*
+     * the RRs of a RRSet arrive one by one, a private RRSet having room is appended in place,
+     * otherwise it is copied and RRSetCat grows the copy geometrically, so a RRSet of N RRs
+     * is built in O(N). the interned RRSets are shared, they are always copied.
+     */
+    if (old_rs != NULL && !(old_rs->flags & RRSET_F_INTERNED) && old_rs->free >= rdlength + 2) {
+        if (psr->ttl > old_rs->ttl) old_rs->ttl = psr->ttl;
+        RRSetCat(old_rs, buf, rdlength+2);
+        goto ok;
+    }
+    if (old_rs == NULL) rs = RRSetCreate(psr->type, z->socket_id);
+    else rs = RRSetDup(old_rs, z->socket_id);
+
+    if (psr->ttl > rs->ttl) rs->ttl = psr->ttl;
+    rs = RRSetCat(rs, buf, rdlength+2);
+
+    if (psr->type == DNS_TYPE_NS && relativeLen == 0) z->ns = rs;
+    if (psr->type == DNS_TYPE_SOA) z->soa = rs;
+    zoneReplaceViewTypeVal(z, psr->view, psr->name, rs);
+    goto ok;
+
+error:
+    psr->err = PARSER_ERR;
+    err = ERR_CODE;
+    RRSetDestroy(rs);
+ok:
+    return err;
+}
+
 /*!
  * extract sn field from string.
  * @param errstr : used to store error message
@@ -497,12 +1108,6 @@ int parseSOASn(char *errstr, char *soa, unsigned long *sn) {
 }
 
 /* private functions */
-static bool needSkip(char *line) {
-    while (*line == ' ' || *line=='\t' || *line=='\v')
-        line++;
-    return (*line == ';' || *line == '\n' || *line == 0);
-}
-
 static bool isttl(const char *ss) {
     return isdigit(ss[0]) != 0;
 }
@@ -550,115 +1155,6 @@ static long parsetime(char *ss) {
     return ret;
 }
 
-// find position of character in string, it will skip escape and literal string(surrounded by ")
-static char *findChar(char *start, char c) {
-    bool literal = false;
-    for (; *start != 0; ++start) {
-        if (*start == '\\') {
-            if (*++start == 0) break;
-            continue;
-        }
-        if (*start == '"') {
-            if (literal) literal = false;
-            else literal = true;
-            continue;
-        }
-        if (literal) continue;
-        if (*start == c) return start;
-    }
-    if (literal) {  // unbalance double quotes
-        LOG_WARN("unbalanced double quotes");
-    }
-    return NULL;
-}
-
-// replace all invisible character to space.
-// ignore escape and literal string
-static void replaceInvisibleChar(char *start) {
-    bool literal = false;
-    for (; *start != 0; ++start) {
-        if (*start == '\\') {
-            if (*++start == 0) break;
-            continue;
-        }
-        if (*start == '"') {
-            if (literal) literal = false;
-            else literal = true;
-            continue;
-        }
-        if (literal) continue;
-        if (*start == '\v' || *start == '\t' || *start == '\n')
-            *start = ' ';
-    }
-    if (literal) {  // unbalance double quotes
-        LOG_WARN("unbalanced double quotes");
-    }
-}
-
-// find the end position of a line. it will strip the comment and space at the end of line.
-static char *findLineEnd(char *start) {
-    char *cmt = findChar(start, ';');
-    if (cmt == NULL) cmt = start + strlen(start);
-    *cmt = 0;
-    if (*(cmt - 1) == '\n') *--cmt = 0;
-    while (*(cmt - 1) == ' ') *--cmt = 0;
-    return cmt;
-}
-
-static int readFullRecord(char *errstr, char **ssp, char *buf, size_t sz, int *line_idx) {
-    while(1) {
-        if (sgets(buf, (int)sz, ssp) == NULL) {
-            return EOF_CODE;
-        }
-        if (needSkip(buf)) {
-            (*line_idx)++;
-            continue;
-        }
-        size_t remain;
-        char *line_end = findLineEnd(buf);
-
-        char *ptr = line_end;
-        char *open, *close;
-
-        open = findChar(buf, '(');
-        if (open != NULL) {
-            *open = ' ';
-            close = findChar(buf, ')');
-
-            if (close != NULL) {
-                *close = ' ';
-            } else {
-                while (close == NULL) {
-                    *ptr++ = ' ';
-                    remain = sz - (ptr - buf);
-                    if (remain <= 0) {
-                        snprintf(errstr, ERR_STR_LEN, "Syntax error(line %d): the record is too long(more than %d)", *line_idx, RECORD_SIZE);
-                        return ERR_CODE;
-                    }
-                    if (sgets(ptr, remain, ssp) == NULL) {
-                        snprintf(errstr, ERR_STR_LEN, "syntax error(line: %d): no close parenthesis.", *line_idx);
-                        return ERR_CODE;
-                    }
-                    (*line_idx)++;
-                    if (needSkip(ptr)) continue;
-
-                    line_end = findLineEnd(ptr);
-                    close = findChar(ptr, ')');
-
-                    ptr = line_end;
-                }
-                *close = ' ';
-            }
-        }
-        break;
-    }
-    (*line_idx)++;
-    // replace all invisible character to space.
-    replaceInvisibleChar(buf);
-    // LOG_DEBUG("read full record: %s", buf);
-    return OK_CODE;
-}
-
 // convert absolute domain name(<label dot> format) to relative domain name
 // the relative domain will be in <len label> format
 int abs2lenRelative(char domain[], char *dotOrigin) {
@@ -689,78 +1185,99 @@ int abs2lenRelative(char domain[], char *dotOrigin) {
     return OK_CODE;
 }
 
-// parse the directives(starts with $) at the top of zone files.
-static int readDirectives(char *errstr, char **ssp, char *origin, uint32_t *ttl, int *line_idx) {
-    char rbuf[RECORD_SIZE];
-    char *tokens[8];
-    int ntokens = 8;
-    int prev_idx = *line_idx;
-    char *ss = *ssp;
-    int err;
-    for (; ((err= readFullRecord(NULL, ssp, rbuf, RECORD_SIZE, line_idx)) == OK_CODE); ss = *ssp, prev_idx=*line_idx) {
-        // unget this line
-        if (rbuf[0] != '$') {
-            *ssp = ss;
-            *line_idx = prev_idx;
-            return OK_CODE;
-        }
-        tokenize(rbuf, tokens, &ntokens, " \t");
-
-        if (strcasecmp(tokens[0], "$ORIGIN") == 0) {
-            if (ntokens < 2) {
-                snprintf(errstr, ERR_STR_LEN, "Syntax error(line %d): no argument for $ORIGIN", *line_idx);
-                return ERR_CODE;
-            }
-            strncpy(origin, tokens[1], 255);
-            continue;
-        } else if (strcasecmp(tokens[0], "$TTL") == 0) {
-            if (ntokens < 2) {
-                snprintf(errstr, ERR_STR_LEN, "Syntax error(line %d): no argument for $TTL", *line_idx);
-                return ERR_CODE;
-            }
-            *ttl = (uint32_t) parsetime(tokens[1]);
-            continue;
-        } else {
-            snprintf(errstr, ERR_STR_LEN, "Syntax error(line %d): invalid or unsupported directive %s.", *line_idx, tokens[0]);
+// copy a token to a null terminated buffer
+static void tokenToStr(zoneToken *tok, char *buf, size_t sz) {
+    size_t len = tok->len < sz - 1 ? tok->len : sz - 1;
+    memcpy(buf, tok->ptr, len);
+    buf[len] = 0;
+}
+
+/*
+ * parse a directive(starts with $), directives are only allowed at the top of zone files
+ * except $VIEW, which is handled by loadZone.
+ */
+static int parseDirective(char *errstr, zoneTokenizer *zt, char *origin, uint32_t *ttl) {
+    char buf[MAX_DOMAIN_LEN+2];
+    zoneToken *tokens = zt->tokens;
+
+    if (zoneTokenEqual(&tokens[0], "$ORIGIN")) {
+        if (zt->ntokens < 2) {
+            snprintf(errstr, ERR_STR_LEN, "Syntax error(line %d): no argument for $ORIGIN", zt->rec_line);
+            return ERR_CODE;
+        }
+        tokenToStr(&tokens[1], origin, MAX_DOMAIN_LEN+1);
+    } else if (zoneTokenEqual(&tokens[0], "$TTL")) {
+        if (zt->ntokens < 2) {
+            snprintf(errstr, ERR_STR_LEN, "Syntax error(line %d): no argument for $TTL", zt->rec_line);
             return ERR_CODE;
         }
+        tokenToStr(&tokens[1], buf, sizeof(buf));
+        *ttl = (uint32_t) parsetime(buf);
+    } else {
+        tokenToStr(&tokens[0], buf, sizeof(buf));
+        snprintf(errstr, ERR_STR_LEN, "Syntax error(line %d): invalid or unsupported directive %s.", zt->rec_line, buf);
+        return ERR_CODE;
     }
-    if (err != EOF_CODE) err = OK_CODE;
-    return err;
+    return OK_CODE;
 }
 
-int loadZoneFromStr(char *errstr, int socket_id, char *zbuf, zone **zpp) {
+static int loadZone(char *errstr, int socket_id, zoneTokenizer *zt, zone **zpp) {
     char dotOrigin[MAX_DOMAIN_LEN+2] = {0};
-    char rbuf[RECORD_SIZE];
     uint32_t default_ttl = 1800;
     zone *z = NULL;
     int err;
-    int line_idx = 0;
     RRParser *psr = NULL;
-    char *ss = zbuf;
 
-    if(readDirectives(errstr, &ss, dotOrigin, &default_ttl, &line_idx) == ERR_CODE) {
-        goto error;
+    while ((err = zoneTokenizerNext(zt)) == OK_CODE) {
+        bool is_directive = zt->has_owner && zt->tokens[0].ptr[0] == '$';
+        // $VIEW starts a section of records belonging to a view, it can appear anywhere after SOA.
+        if (is_directive && zoneTokenEqual(&zt->tokens[0], "$VIEW")) {
+            char view[MAX_DOMAIN_LEN+2];
+            if (z == NULL) {
+                snprintf(errstr, ERR_STR_LEN, "Syntax error(line %d): $VIEW must be after the SOA record.", zt->rec_line);
+                goto error;
+            }
+            if (zt->ntokens > 1) tokenToStr(&zt->tokens[1], view, sizeof(view));
+            if (RRParserSetView(psr, zt->ntokens > 1? view: NULL) == ERR_CODE) {
+                snprintf(errstr, ERR_STR_LEN, "Line %d %s", zt->rec_line, psr->errstr);
+                goto error;
+            }
+            continue;
+        }
+        if (is_directive) {
+            if (z != NULL) {
+                snprintf(errstr, ERR_STR_LEN, "Syntax error(line %d): directives must be at the top of zone file.", zt->rec_line);
+                goto error;
+            }
+            if (parseDirective(errstr, zt, dotOrigin, &default_ttl) == ERR_CODE) goto error;
+            continue;
+        }
+        if (z == NULL) {
+            LOG_DEBUG("origin: %s, default ttl: %d", dotOrigin, default_ttl);
+            if (strlen(dotOrigin) == 0) {
+                snprintf(errstr, ERR_STR_LEN, "line %d syntax error: no origin", zt->rec_line);
+                goto error;
+            }
+            psr = RRParserCreate("@", default_ttl, dotOrigin);
+            z = zoneCreate(dotOrigin, socket_id);
+            z->default_ttl = default_ttl;
+        }
+        if (RRParserFeedTokens(psr, zt->tokens, zt->ntokens, zt->has_owner, z) == ERR_CODE) {
+            snprintf(errstr, ERR_STR_LEN, "Line %d %s", zt->rec_line, psr->errstr);
+            goto error;
+        }
     }
-    LOG_DEBUG("origin: %s, default ttl: %d", dotOrigin, default_ttl);
-    if (strlen(dotOrigin) == 0) {
-        snprintf(errstr, ERR_STR_LEN, "line %d syntax error: no origin", line_idx);
+    if (err == ERR_CODE) {
+        snprintf(errstr, ERR_STR_LEN, "%s", zt->errstr);
         goto error;
     }
-    psr = RRParserCreate("@", default_ttl, dotOrigin);
-    z = zoneCreate(dotOrigin, socket_id);
-    z->default_ttl = default_ttl;
-
-    while ((err= readFullRecord(errstr, &ss, rbuf, RECORD_SIZE, &line_idx)) == OK_CODE) {
-        LOG_DEBUG("line: %s", rbuf);
-        if (RRParserFeed(psr, rbuf, NULL, z) == ERR_CODE) {
-            snprintf(errstr, ERR_STR_LEN, "Line %d %s", line_idx, psr->errstr);
-            goto error;
-        }
+    if (z == NULL) {
+        snprintf(errstr, ERR_STR_LEN, "empty zone");
+        goto error;
     }
-    if (err != EOF_CODE) goto error;
 
     *zpp = z;
+    err = OK_CODE;
     goto ok;
 
 error:
@@ -771,18 +1288,111 @@ ok:
     return err;
 }
 
+int loadZoneFromStr(char *errstr, int socket_id, char *zbuf, zone **zpp) {
+    zoneTokenizer *zt = zoneTokenizerCreate(zbuf, strlen(zbuf));
+    int err = loadZone(errstr, socket_id, zt, zpp);
+    zoneTokenizerDestroy(zt);
+    return err;
+}
+
+/*!
+ * fill the stat part of stamp, the hash is not touched.
+ */
+int statZoneFile(const char *fname, zoneFileStamp *stamp) {
+    struct stat st;
+
+    if (stat(fname, &st) < 0) return ERR_CODE;
+    stamp->size = (uint64_t)st.st_size;
+    stamp->ino = (uint64_t)st.st_ino;
+    stamp->mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return OK_CODE;
+}
+
+static inline uint64_t zoneTokenizerHash(zoneTokenizer *zt) {
+    return memhash64(zt->buf, (size_t)(zt->end - zt->buf), 0);
+}
+
+/*
+ * get the serial from the SOA record at the top of zone file,
+ * only the directives and the first record are parsed.
+ */
+static int peekZoneSn(zoneTokenizer *zt, uint32_t *sn) {
+    char buf[32];
+    char *endptr;
+
+    while (zoneTokenizerNext(zt) == OK_CODE) {
+        if (zt->has_owner && zt->tokens[0].ptr[0] == '$') continue;
+
+        for (int i = 0; i + 3 < zt->ntokens; ++i) {
+            if (!zoneTokenEqual(&zt->tokens[i], "SOA")) continue;
+            tokenToStr(&zt->tokens[i+3], buf, sizeof(buf));
+            *sn = (uint32_t)strtoul(buf, &endptr, 10);
+            return (*endptr == 0 && endptr != buf)? OK_CODE: ERR_CODE;
+        }
+        break;
+    }
+    return ERR_CODE;
+}
+
+/*!
+ * check if the zone file is changed since the zone was loaded. the SOA record
+ * at the top is checked first, if the serial is the same, then the content hash
+ * is compared, so the file edited without increasing serial is still reloaded.
+ *
+ * @param fname
+ * @param sn : the serial of the loaded zone.
+ * @param stamp : the stamp of the loaded zone, it is updated to the current
+ *                file if the file is unchanged.
+ * @return true if the file needs to be reloaded.
+ */
+bool zoneFileChanged(const char *fname, uint32_t sn, zoneFileStamp *stamp) {
+    char errstr[ERR_STR_LEN];
+    zoneFileStamp cur;
+    zoneTokenizer *zt;
+    uint32_t new_sn;
+    bool changed = true;
+
+    // stat before reading, so a file replaced meanwhile is checked again next time.
+    if (statZoneFile(fname, &cur) == ERR_CODE) return true;
+    if ((zt = zoneTokenizerOpen(fname, errstr)) == NULL) return true;
+
+    if (peekZoneSn(zt, &new_sn) == OK_CODE && new_sn == sn) {
+        cur.hash = zoneTokenizerHash(zt);
+        if (cur.hash == stamp->hash) {
+            *stamp = cur;
+            changed = false;
+        } else {
+            LOG_WARN("zone file %s is changed, but the serial %u is not increased.", fname, sn);
+        }
+    }
+    zoneTokenizerDestroy(zt);
+    return changed;
+}
+
+/*!
+ * load zone from a zone file, the file is mapped into memory and tokenized
+ * in place, so the whole file is never copied.
+ */
 int loadZoneFromFile(int socket_id, const char *fname, zone **zpp) {
-    char *zbuf;
+    zoneTokenizer *zt;
+    zoneFileStamp stamp = {0};
     int err;
     char errstr[ERR_STR_LEN];
 
-    zbuf = zreadFile(fname);
-    if (zbuf == NULL) {
-        LOG_ERROR("Can't read zone file %s.", fname);
+    statZoneFile(fname, &stamp);
+    zt = zoneTokenizerOpen(fname, errstr);
+    if (zt == NULL) {
+        LOG_ERROR("Can't read zone file %s: %s.", fname, errstr);
         return ERR_CODE;
     }
-    err = loadZoneFromStr(errstr, socket_id, zbuf, zpp);
-    zfree(zbuf);
+    err = loadZone(errstr, socket_id, zt, zpp);
+    if (err == ERR_CODE) {
+        LOG_ERROR("failed to load zone file %s: %s", fname, errstr);
+    } else {
+        stamp.hash = zoneTokenizerHash(zt);
+        (*zpp)->stamp = stamp;
+    }
+    zoneTokenizerDestroy(zt);
     return err;
 }
 
@@ -815,15 +1425,48 @@ int zoneParserTest(int argc, char *argv[]) {
         abs2lenRelative(domain, dot_origin);
         test_cond("abs2lenRelative 3", strcmp(domain, "@") == 0);
     }
-    char *ss = readFile(argv[3]);
-    char buf[1000];
-    int idx = 0;
-    int err;
+    {
+        char err[ERR_STR_LEN];
+        char zbuf[] = "$ORIGIN v.com.\n$TTL 60\n"
+                      "@ SOA ns1.v.com. admin.v.com. 1 3600 600 86400 60\n"
+                      "@ NS ns1.v.com.\n"
+                      "www A 1.1.1.1\n"
+                      "$VIEW cn\n"
+                      "www A 2.2.2.2\n"
+                      "only A 3.3.3.3\n"
+                      "$VIEW\n"
+                      "mail A 4.4.4.4\n";
+        char bad[] = "$ORIGIN v.com.\n@ SOA ns1.v.com. admin.v.com. 1 3600 600 86400 60\n"
+                     "$VIEW cn\n@ NS ns2.v.com.\n";
+        zone *vz = NULL, *copy;
+        uint32_t cn;
+
+        test_cond("view 1", loadZoneFromStr(err, SOCKET_ID_HEAP, zbuf, &vz) == OK_CODE);
+        cn = (uint32_t)viewGetId("cn", false);
+        copy = zoneCopy(vz, SOCKET_ID_HEAP);
+        test_cond("view 2", zoneFetchTypeVal(copy, "\3www", DNS_TYPE_A) != NULL &&
+                            zoneFetchViewTypeVal(copy, cn, "\3www", DNS_TYPE_A) != NULL &&
+                            zoneFetchTypeVal(copy, "\3www", DNS_TYPE_A) !=
+                            zoneFetchViewTypeVal(copy, cn, "\3www", DNS_TYPE_A));
+        test_cond("view 3", zoneFetchTypeVal(copy, "\4only", DNS_TYPE_A) == NULL &&
+                            zoneFetchViewTypeVal(copy, cn, "\4only", DNS_TYPE_A) != NULL);
+        test_cond("view 4", zoneFetchTypeVal(copy, "\4mail", DNS_TYPE_A) != NULL &&
+                            zoneFetchViewTypeVal(copy, cn, "\4mail", DNS_TYPE_A) == NULL);
+        test_cond("view 5", loadZoneFromStr(err, SOCKET_ID_HEAP, bad, &vz) == ERR_CODE);
+        zoneDestroy(copy);
+        zoneDestroy(vz);
+    }
     char errstr[ERR_STR_LEN];
+    zoneTokenizer *zt = zoneTokenizerOpen(argv[3], errstr);
     fprintf(stderr, "\n");
-    while ((err=readFullRecord(errstr, &ss, buf, 1000, &idx)) == OK_CODE) {
-        fprintf(stderr, "l%d:%s \n", idx, buf);
+    while (zt != NULL && zoneTokenizerNext(zt) == OK_CODE) {
+        fprintf(stderr, "l%d:", zt->rec_line);
+        for (int i = 0; i < zt->ntokens; ++i) {
+            fprintf(stderr, " %.*s", (int)zt->tokens[i].len, zt->tokens[i].ptr);
+        }
+        fprintf(stderr, "\n");
     }
+    zoneTokenizerDestroy(zt);
     fprintf(stderr, "\n");
 
     zone *z;
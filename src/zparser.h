@@ -9,10 +9,13 @@
 
 #include "defines.h"
 #include "zone.h"
+#include "ztokenizer.h"
 
 #define PARSER_OK    0
 #define PARSER_ERR  (-1)
 
+#define RECORD_SIZE 8192
+
 typedef struct {
     int err;
     char errstr[ERR_STR_LEN];
@@ -25,22 +28,32 @@ typedef struct {
     uint16_t type;
 
     uint32_t ttl;
+    // the view($VIEW) of the following records, 0 is the default view.
+    uint32_t view;
     // the relative name (len label format)
     char name[MAX_DOMAIN_LEN+2];
     // the dot origin this RR belongs to.
     char dotOrigin[MAX_DOMAIN_LEN+2];
+    // the null terminated copies of tokens fed by RRParserFeedTokens
+    char rbuf[RECORD_SIZE];
 } RRParser;
 
 // parser
 RRParser *RRParserCreate(char *name, uint32_t ttl, char *dotOrigin);
 void RRParserDestroy(RRParser *psr);
 int RRParserSetDotOrigin(RRParser *psr, char *dotOrigin);
+int RRParserSetView(RRParser *psr, char *view);
 int RRParserFeed(RRParser *psr, char *ss, char *name, zone *z);
+int RRParserFeedTokens(RRParser *psr, zoneToken *tokens, int ntokens, bool has_owner, zone *z);
 int RRParserFeedRdata(RRParser *psr, char *rdata, char *name, uint32_t ttl, char *type, zone *z);
+int RRParserFeedWire(RRParser *psr, char *owner, size_t ownerLen, uint32_t ttl, char *type,
+                     char *rdata, size_t rdlength, zone *z);
 
 int parseSOASn(char *errstr, char *soa, unsigned long *sn);
 int abs2lenRelative(char domain[], char *dotOrigin);
 int loadZoneFromStr(char *errstr, int socket_id, char *zbuf, zone **zpp);
 int loadZoneFromFile(int socket_id, const char *fname, zone **zpp);
+int statZoneFile(const char *fname, zoneFileStamp *stamp);
+bool zoneFileChanged(const char *fname, uint32_t sn, zoneFileStamp *stamp);
 
 #endif //SHUKE_ZPARSER_H
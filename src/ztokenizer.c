@@ -0,0 +1,288 @@
+//
+// streaming zone file tokenizer
+//
+#include "fmacros.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "ztokenizer.h"
+#include "zmalloc.h"
+
+/*
+ * the characters need special handling, all the others are part of a token.
+ * blank and control characters(<= 0x20) are delimiters.
+ */
+static const uint8_t specialTable[256] = {
+    [0 ... 0x20] = 1,
+    [';'] = 1, ['('] = 1, [')'] = 1, ['"'] = 1, ['\\'] = 1,
+};
+
+// find the first special character in [p, end)
+static inline const char *scanSpecial(const char *p, const char *end) {
+#ifdef __SSE2__
+    const __m128i blank = _mm_set1_epi8(0x20);
+    const __m128i semicolon = _mm_set1_epi8(';');
+    const __m128i lparen = _mm_set1_epi8('(');
+    const __m128i rparen = _mm_set1_epi8(')');
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    while (end - p >= 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)p);
+        // x <= 0x20(unsigned)
+        __m128i m = _mm_cmpeq_epi8(_mm_min_epu8(x, blank), x);
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(x, semicolon));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(x, lparen));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(x, rparen));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(x, quote));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(x, backslash));
+        int mask = _mm_movemask_epi8(m);
+        if (mask) return p + __builtin_ctz((unsigned)mask);
+        p += 16;
+    }
+#endif
+    while (p < end && !specialTable[(uint8_t)*p]) p++;
+    return p;
+}
+
+static zoneTokenizer *zoneTokenizerNew(const char *buf, size_t len, size_t map_size) {
+    zoneTokenizer *zt = zmalloc(sizeof(*zt));
+    zt->buf = buf;
+    zt->end = buf + len;
+    zt->pos = buf;
+    zt->line_start = buf;
+    zt->map_size = map_size;
+    zt->line = 1;
+    zt->rec_line = 0;
+    zt->ntokens = 0;
+    zt->has_owner = false;
+    zt->errstr[0] = 0;
+    return zt;
+}
+
+/*!
+ * create a tokenizer for a memory buffer, the buffer must be valid until
+ * the tokenizer is destroyed. it needn't be null terminated.
+ */
+zoneTokenizer *zoneTokenizerCreate(const char *buf, size_t len) {
+    return zoneTokenizerNew(buf, len, 0);
+}
+
+/*!
+ * map the zone file into memory and create a tokenizer for it.
+ *
+ * @param fname
+ * @param errstr : used to store error message
+ * @return NULL if the file can't be mapped.
+ */
+zoneTokenizer *zoneTokenizerOpen(const char *fname, char *errstr) {
+    struct stat st;
+    void *buf = NULL;
+    int fd = open(fname, O_RDONLY);
+
+    if (fd < 0) {
+        snprintf(errstr, ERR_STR_LEN, "can't open %s: %s", fname, strerror(errno));
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0) {
+        snprintf(errstr, ERR_STR_LEN, "can't stat %s: %s", fname, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    // mmap doesn't accept zero length, an empty file is just an empty buffer.
+    if (st.st_size > 0) {
+        buf = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (buf == MAP_FAILED) {
+            snprintf(errstr, ERR_STR_LEN, "can't mmap %s: %s", fname, strerror(errno));
+            close(fd);
+            return NULL;
+        }
+        madvise(buf, (size_t)st.st_size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+    return zoneTokenizerNew(buf, (size_t)st.st_size, (size_t)st.st_size);
+}
+
+void zoneTokenizerDestroy(zoneTokenizer *zt) {
+    if (zt == NULL) return;
+    if (zt->map_size > 0) munmap((void *)zt->buf, zt->map_size);
+    zfree(zt);
+}
+
+/*
+ * scan a token starts at p, quoted strings and escaped characters are part of the token.
+ * return the end of token, NULL if the quotes are unbalanced.
+ */
+static const char *scanToken(zoneTokenizer *zt, const char *p) {
+    const char *end = zt->end;
+
+    while ((p = scanSpecial(p, end)) < end) {
+        if (*p == '\\') {
+            p += 2;
+            if (p > end) p = end;
+        } else if (*p == '"') {
+            // a quoted string can't span multiple lines.
+            for (p++; p < end && *p != '"' && *p != '\n'; p++) {
+                if (*p == '\\' && p + 1 < end) p++;
+            }
+            if (p >= end || *p != '"') return NULL;
+            p++;
+        } else {
+            break;
+        }
+    }
+    return p;
+}
+
+/*!
+ * read the next record, the tokens are stored in zt->tokens.
+ * a record ends at a newline outside parentheses.
+ *
+ * @return OK_CODE if a record is read, EOF_CODE if no more records,
+ *         ERR_CODE if there is a syntax error, zt->errstr contains the message.
+ */
+int zoneTokenizerNext(zoneTokenizer *zt) {
+    const char *p = zt->pos;
+    const char *end = zt->end;
+    const char *tok_end;
+    int depth = 0;
+
+    zt->ntokens = 0;
+    while (p < end) {
+        switch (*p) {
+        case '\n':
+            zt->line++;
+            p++;
+            zt->line_start = p;
+            if (depth == 0 && zt->ntokens > 0) goto ok;
+            break;
+        case ';':
+            p = memchr(p, '\n', (size_t)(end - p));
+            if (p == NULL) p = end;
+            break;
+        case '(':
+            depth++;
+            p++;
+            break;
+        case ')':
+            if (depth == 0) {
+                snprintf(zt->errstr, ERR_STR_LEN, "syntax error(line %d): unbalanced parenthesis.", zt->line);
+                goto error;
+            }
+            depth--;
+            p++;
+            break;
+        default:
+            if ((uint8_t)*p <= 0x20) {
+                p++;
+                break;
+            }
+            if (zt->ntokens == 0) {
+                zt->rec_line = zt->line;
+                zt->has_owner = (p == zt->line_start);
+            }
+            if (zt->ntokens >= ZT_MAX_TOKENS) {
+                snprintf(zt->errstr, ERR_STR_LEN, "syntax error(line %d): too many tokens.", zt->rec_line);
+                goto error;
+            }
+            if ((tok_end = scanToken(zt, p)) == NULL) {
+                snprintf(zt->errstr, ERR_STR_LEN, "syntax error(line %d): unbalanced double quotes.", zt->line);
+                goto error;
+            }
+            zt->tokens[zt->ntokens].ptr = p;
+            zt->tokens[zt->ntokens].len = (size_t)(tok_end - p);
+            zt->ntokens++;
+            p = tok_end;
+            break;
+        }
+    }
+    if (depth > 0) {
+        snprintf(zt->errstr, ERR_STR_LEN, "syntax error(line %d): no close parenthesis.", zt->rec_line);
+        goto error;
+    }
+    if (zt->ntokens == 0) {
+        zt->pos = p;
+        return EOF_CODE;
+    }
+ok:
+    zt->pos = p;
+    return OK_CODE;
+error:
+    zt->pos = end;
+    return ERR_CODE;
+}
+
+#if defined(SK_TEST)
+#include <stdlib.h>
+#include "testhelp.h"
+#include "utils.h"
+
+/*
+ * usage: shuke-server test ztokenizer <zone file> [scale]
+ * the zone file is repeated `scale` times, then the tokenizer scans it.
+ */
+int zoneTokenizerBenchmark(int argc, char *argv[]) {
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s test ztokenizer <zone file> [scale]\n", argv[0]);
+        exit(1);
+    }
+    long scale = argc >= 5 ? atol(argv[4]) : 100000;
+    char errstr[ERR_STR_LEN];
+    zoneTokenizer *zt;
+
+    {
+        char ss[] = "@ SOA ns1 admin ( 1 ; serial\n 2 3 4 5 )\n\tA \"a b\\\" ;c\" x;y\n\n";
+        zt = zoneTokenizerCreate(ss, strlen(ss));
+        test_cond("tokenizer record 1", zoneTokenizerNext(zt) == OK_CODE && zt->ntokens == 9 && zt->has_owner);
+        test_cond("tokenizer record 2", zoneTokenizerNext(zt) == OK_CODE && zt->ntokens == 3 && !zt->has_owner &&
+                                        zt->tokens[1].len == 10 && zt->tokens[2].len == 1 && zt->rec_line == 3);
+        test_cond("tokenizer eof", zoneTokenizerNext(zt) == EOF_CODE);
+        zoneTokenizerDestroy(zt);
+    }
+
+    char *content = readFile(argv[3]);
+    if (content == NULL) {
+        fprintf(stderr, "can't read %s\n", argv[3]);
+        exit(1);
+    }
+    size_t len = strlen(content);
+    char fname[] = "/tmp/shuke-ztokenizer-XXXXXX";
+    int fd = mkstemp(fname);
+    FILE *fp = fdopen(fd, "w");
+    for (long i = 0; i < scale; ++i) fwrite(content, 1, len, fp);
+    fclose(fp);
+    free(content);
+
+    long long start = ustime();
+    size_t nrecords = 0, ntokens = 0;
+    int err;
+    zt = zoneTokenizerOpen(fname, errstr);
+    if (zt == NULL) {
+        fprintf(stderr, "%s\n", errstr);
+        exit(1);
+    }
+    while ((err = zoneTokenizerNext(zt)) == OK_CODE) {
+        nrecords++;
+        ntokens += zt->ntokens;
+    }
+    long long elapsed = ustime() - start;
+    double mb = (double)len * scale / (1024 * 1024);
+    test_cond("tokenizer scaled file", err == EOF_CODE);
+    printf("%.1f MB, %lu records, %lu tokens in %.3f s: %.1f MB/s\n",
+           mb, nrecords, ntokens, elapsed / 1e6, mb / (elapsed / 1e6));
+    zoneTokenizerDestroy(zt);
+    unlink(fname);
+    test_report();
+    return 0;
+}
+#endif
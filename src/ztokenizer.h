@@ -0,0 +1,62 @@
+//
+// streaming zone file tokenizer
+//
+// the zone file is mapped into memory and scanned in one forward pass,
+// parentheses, comments, quoting and escapes are handled while splitting
+// the tokens. tokens are views into the buffer, nothing is copied.
+//
+
+#ifndef SHUKE_ZTOKENIZER_H
+#define SHUKE_ZTOKENIZER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+
+#include "defines.h"
+
+#define ZT_MAX_TOKENS 4096
+
+typedef struct {
+    const char *ptr;
+    size_t len;
+} zoneToken;
+
+typedef struct {
+    const char *buf;
+    const char *end;
+    const char *pos;
+    // the start of current line, used to check if a record has owner name.
+    const char *line_start;
+    // the size of mapping, 0 if buf is not mapped by tokenizer.
+    size_t map_size;
+
+    int line;           // current line number(start from 1)
+    int rec_line;       // the line number where the last record starts
+
+    // the tokens of last record
+    zoneToken tokens[ZT_MAX_TOKENS];
+    int ntokens;
+    // false if the record starts with blank, then it uses the owner of previous record.
+    bool has_owner;
+
+    char errstr[ERR_STR_LEN];
+} zoneTokenizer;
+
+zoneTokenizer *zoneTokenizerCreate(const char *buf, size_t len);
+zoneTokenizer *zoneTokenizerOpen(const char *fname, char *errstr);
+void zoneTokenizerDestroy(zoneTokenizer *zt);
+int zoneTokenizerNext(zoneTokenizer *zt);
+
+static inline bool zoneTokenEqual(zoneToken *tok, const char *ss) {
+    size_t len = strlen(ss);
+    return tok->len == len && strncasecmp(tok->ptr, ss, len) == 0;
+}
+
+#if defined(SK_TEST)
+int zoneTokenizerBenchmark(int argc, char *argv[]);
+#endif
+
+#endif //SHUKE_ZTOKENIZER_H
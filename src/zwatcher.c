@@ -0,0 +1,332 @@
+//
+// zone file watcher
+//
+// the directories containing zone files are watched by inotify, the zones whose
+// files are changed are reloaded after a short debounce window, so a burst of
+// writes to the same file only triggers one reload.
+// in scan mode, every file in zone_files_root with the configured suffix is a zone,
+// the zone name is the file name without suffix.
+//
+
+#include <dirent.h>
+#include <limits.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "shuke.h"
+#include "utils.h"
+
+DEF_LOG_MODULE(RTE_LOGTYPE_USER1, "ZWATCHER");
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE)
+
+typedef struct {
+    int wd;
+    char *path;
+} watchedDir;
+
+static struct {
+    int fd;
+    // the real path of zone_files_root
+    char root[PATH_MAX];
+    watchedDir *dirs;
+    int nr_dirs;
+    // MAP: absolute path of zone file => dot origin
+    dict *files;
+    // MAP: dot origin => time(ms) of the last event, the zones waiting for debounce.
+    dict *pending;
+    long long timer_id;
+
+    zoneWatcherStats stats;
+} watcher = {
+    .fd = -1,
+    .timer_id = -1,
+};
+
+/*
+ * get the zone name from the file name, return ERR_CODE if the file is not a zone file.
+ */
+static int zoneNameFromFile(const char *name, char *dotOrigin) {
+    size_t len = strlen(name);
+    size_t suffixLen = strlen(sk.zone_files_suffix);
+
+    // hidden files and temporary files of editors.
+    if (name[0] == '.' || name[len-1] == '~') return ERR_CODE;
+    if (len <= suffixLen || strcmp(name + len - suffixLen, sk.zone_files_suffix) != 0) return ERR_CODE;
+    len -= suffixLen;
+    if (len + 2 > MAX_DOMAIN_LEN) return ERR_CODE;
+
+    memcpy(dotOrigin, name, len);
+    if (dotOrigin[len-1] != '.') dotOrigin[len++] = '.';
+    dotOrigin[len] = 0;
+    return isAbsDotDomain(dotOrigin)? OK_CODE: ERR_CODE;
+}
+
+/*
+ * the paths in inotify events are relative to the watched directories,
+ * so the files and directories are all identified by real path.
+ */
+static void toRealPath(const char *fname, char *buf) {
+    if (realpath(fname, buf) == NULL) snprintf(buf, PATH_MAX, "%s", fname);
+}
+
+static watchedDir *getWatchedDir(int wd) {
+    for (int i = 0; i < watcher.nr_dirs; ++i) {
+        if (watcher.dirs[i].wd == wd) return &watcher.dirs[i];
+    }
+    return NULL;
+}
+
+static int watchDir(const char *path) {
+    int wd;
+
+    for (int i = 0; i < watcher.nr_dirs; ++i) {
+        if (strcmp(watcher.dirs[i].path, path) == 0) return OK_CODE;
+    }
+    if ((wd = inotify_add_watch(watcher.fd, path, WATCH_MASK)) < 0) {
+        LOG_ERROR("can't watch directory %s: %s.", path, strerror(errno));
+        return ERR_CODE;
+    }
+    watcher.dirs = zrealloc(watcher.dirs, (watcher.nr_dirs + 1) * sizeof(watchedDir));
+    watcher.dirs[watcher.nr_dirs].wd = wd;
+    watcher.dirs[watcher.nr_dirs].path = zstrdup(path);
+    watcher.nr_dirs++;
+    return OK_CODE;
+}
+
+/*!
+ * add a zone file to zone_files_dict, the file must be an absolute path.
+ *
+ * @return ERR_CODE if the zone already has a file.
+ */
+int registerZoneFile(char *dotOrigin, char *fname) {
+    char path[PATH_MAX];
+
+    if (dictAdd(sk.zone_files_dict, dotOrigin, fname) != DICT_OK) return ERR_CODE;
+    if (watcher.files) {
+        toRealPath(fname, path);
+        dictReplace(watcher.files, path, dotOrigin);
+    }
+    return OK_CODE;
+}
+
+void unregisterZoneFile(char *dotOrigin) {
+    char path[PATH_MAX];
+    dictIterator *it;
+    dictEntry *de;
+
+    if (dictFind(sk.zone_files_dict, dotOrigin) == NULL) return;
+    if (watcher.files) {
+        // the file may be removed already, so search the zone instead of resolving the path.
+        it = dictGetIterator(watcher.files);
+        while ((de = dictNext(it)) != NULL) {
+            if (strcasecmp(dictGetVal(de), dotOrigin) != 0) continue;
+            snprintf(path, sizeof(path), "%s", (char *)dictGetKey(de));
+            dictDelete(watcher.files, path);
+            break;
+        }
+        dictReleaseIterator(it);
+    }
+    dictDelete(sk.zone_files_dict, dotOrigin);
+}
+
+/*!
+ * register the zone files in zone_files_root. the zones configured explicitly are kept.
+ *
+ * @param runtime : if true, the zones whose files disappear are removed too,
+ *                  the zones added or removed are reloaded asynchronously.
+ * @return the number of zones registered, ERR_CODE if the directory can't be read.
+ */
+int scanZoneFilesRoot(bool runtime) {
+    char dotOrigin[MAX_DOMAIN_LEN+2];
+    char fname[PATH_MAX];
+    DIR *dir;
+    struct dirent *ent;
+    struct stat st;
+    int n = 0;
+
+    if ((dir = opendir(sk.zone_files_root)) == NULL) {
+        snprintf(sk.errstr, ERR_STR_LEN, "can't open %s: %s", sk.zone_files_root, strerror(errno));
+        return ERR_CODE;
+    }
+    while ((ent = readdir(dir)) != NULL) {
+        if (zoneNameFromFile(ent->d_name, dotOrigin) == ERR_CODE) continue;
+        snprintf(fname, sizeof(fname), "%s/%s", sk.zone_files_root, ent->d_name);
+        if (stat(fname, &st) < 0 || !S_ISREG(st.st_mode)) continue;
+        if (dictFind(sk.zone_files_dict, dotOrigin) != NULL) continue;
+
+        registerZoneFile(dotOrigin, fname);
+        if (runtime) asyncReloadChangedZone(dotOrigin);
+        n++;
+    }
+    closedir(dir);
+
+    if (runtime) {
+        dictIterator *it = dictGetIterator(sk.zone_files_dict);
+        dictEntry *de;
+        while ((de = dictNext(it)) != NULL) {
+            if (access(dictGetVal(de), F_OK) == 0) continue;
+            snprintf(dotOrigin, sizeof(dotOrigin), "%s", (char *)dictGetKey(de));
+            LOG_INFO("zone file %s is removed, remove zone %s.", (char *)dictGetVal(de), dotOrigin);
+            // the iterator already holds the next entry, so deleting current entry is safe.
+            unregisterZoneFile(dotOrigin);
+            asyncReloadChangedZone(dotOrigin);
+        }
+        dictReleaseIterator(it);
+    }
+    return n;
+}
+
+/*
+ * reload the zones whose debounce window is over, the zones in reloading
+ * state are kept and checked again in next round.
+ */
+static int zoneWatcherCron(struct aeEventLoop *el, long long id, void *clientData) {
+    UNUSED3(el, id, clientData);
+    dictIterator *it;
+    dictEntry *de;
+    long long now = mstime();
+    long long next = -1;
+
+    it = dictGetIterator(watcher.pending);
+    while ((de = dictNext(it)) != NULL) {
+        long long due = dictGetSignedIntegerVal(de) + sk.zone_files_debounce;
+        if (due <= now && asyncReloadChangedZone(dictGetKey(de)) == OK_CODE) {
+            watcher.stats.nr_reloads++;
+            dictDelete(watcher.pending, dictGetKey(de));
+            continue;
+        }
+        if (due <= now) due = now + sk.zone_files_debounce;
+        if (next < 0 || due < next) next = due;
+    }
+    dictReleaseIterator(it);
+
+    if (next < 0) {
+        watcher.timer_id = -1;
+        return AE_NOMORE;
+    }
+    return (int)(next - now);
+}
+
+static void addPendingZone(char *dotOrigin) {
+    dictEntry *de = dictFind(watcher.pending, dotOrigin);
+    if (de == NULL) {
+        dictAdd(watcher.pending, dotOrigin, NULL);
+        de = dictFind(watcher.pending, dotOrigin);
+    }
+    dictSetSignedIntegerVal(de, mstime());
+
+    if (watcher.timer_id < 0) {
+        watcher.timer_id = aeCreateTimeEvent(sk.el, sk.zone_files_debounce, zoneWatcherCron, NULL, NULL);
+        if (watcher.timer_id == AE_ERR) {
+            LOG_ERROR("can't create time event for zone watcher.");
+            watcher.timer_id = -1;
+        }
+    }
+}
+
+static void handleEvent(struct inotify_event *ev) {
+    char dotOrigin[MAX_DOMAIN_LEN+2];
+    char fname[PATH_MAX];
+    char *origin;
+    watchedDir *dir;
+
+    if (ev->mask & IN_Q_OVERFLOW) {
+        LOG_WARN("inotify queue overflow, reload all zones.");
+        watcher.stats.nr_overflows++;
+        triggerReloadAllZone();
+        return;
+    }
+    if (ev->len == 0 || (dir = getWatchedDir(ev->wd)) == NULL) return;
+    watcher.stats.nr_events++;
+
+    snprintf(fname, sizeof(fname), "%s/%s", dir->path, ev->name);
+    origin = dictFetchValue(watcher.files, fname);
+    if (origin != NULL) {
+        snprintf(dotOrigin, sizeof(dotOrigin), "%s", origin);
+        if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            // a configured zone is kept until its file comes back.
+            if (!sk.zone_files_scan) return;
+            // in scan mode the zone is removed, unless the file is registered
+            // again before the debounce window is over(editors replace the file by renaming).
+            unregisterZoneFile(dotOrigin);
+        }
+        addPendingZone(dotOrigin);
+        return;
+    }
+    // a new zone file in scan mode.
+    if (sk.zone_files_scan && (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) &&
+        strcmp(dir->path, watcher.root) == 0 &&
+        zoneNameFromFile(ev->name, dotOrigin) == OK_CODE) {
+        if (registerZoneFile(dotOrigin, fname) == OK_CODE) {
+            LOG_INFO("new zone file %s for zone %s.", fname, dotOrigin);
+            watcher.stats.nr_new_files++;
+            addPendingZone(dotOrigin);
+        }
+    }
+}
+
+static void zoneWatcherReadHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
+    UNUSED3(el, privdata, mask);
+    char buf[65536] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t n;
+
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n; ) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            handleEvent(ev);
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+    if (n < 0 && errno != EAGAIN) {
+        LOG_WARN("can't read inotify events: %s.", strerror(errno));
+    }
+}
+
+void zoneWatcherGetStats(zoneWatcherStats *stats) {
+    memcpy(stats, &watcher.stats, sizeof(*stats));
+    stats->nr_dirs = watcher.nr_dirs;
+    stats->nr_files = watcher.files? dictSize(watcher.files): 0;
+    stats->nr_pending = watcher.pending? dictSize(watcher.pending): 0;
+}
+
+/*!
+ * watch zone_files_root and the directories of all zone files, must be called
+ * after the event loop is created.
+ */
+int initZoneWatcher(void) {
+    dictIterator *it;
+    dictEntry *de;
+    char path[PATH_MAX];
+
+    if ((watcher.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+        LOG_ERROR("can't create inotify instance: %s.", strerror(errno));
+        return ERR_CODE;
+    }
+    watcher.files = dictCreate(&dictTypeStringCopyKeyVal, NULL, SOCKET_ID_HEAP);
+    watcher.pending = dictCreate(&dictTypeCaseStringCopyKey, NULL, SOCKET_ID_HEAP);
+
+    toRealPath(sk.zone_files_root, watcher.root);
+    if (watchDir(watcher.root) == ERR_CODE) return ERR_CODE;
+    it = dictGetIterator(sk.zone_files_dict);
+    while ((de = dictNext(it)) != NULL) {
+        toRealPath(dictGetVal(de), path);
+        dictAdd(watcher.files, path, dictGetKey(de));
+
+        char *slash = strrchr(path, '/');
+        if (slash == NULL || slash == path) continue;
+        *slash = 0;
+        if (watchDir(path) == ERR_CODE) {
+            dictReleaseIterator(it);
+            return ERR_CODE;
+        }
+    }
+    dictReleaseIterator(it);
+
+    if (aeCreateFileEvent(sk.el, watcher.fd, AE_READABLE, zoneWatcherReadHandler, NULL) == AE_ERR) {
+        LOG_ERROR("can't create file event for zone watcher.");
+        return ERR_CODE;
+    }
+    LOG_INFO("watching %d directories for %lu zone files.", watcher.nr_dirs, dictSize(watcher.files));
+    return OK_CODE;
+}
@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+end-to-end performance regression suite.
+
+shuke runs in the vagrant vm with a `net_af_packet` vdev on one end of a veth pair,
+the other end is in the network namespace `skperf`, where tools/loadgen(udp) and
+tcpload.py(tcp, through KNI) replay the workloads, so no NIC is needed. every workload
+runs once per lcore count, the throughput, the throughput of every lcore(from the
+metrics endpoint) and the latency percentiles are written to a json file, which
+tools/benchmark_plot.py can plot. the results are compared with a stored baseline,
+the exit code is 1 if any number regresses past the threshold.
+
+    python3 tests/perf/perf.py --lcores 1,2 -o results.json
+    python3 tests/perf/perf.py --lcores 1,2 --update-baseline
+"""
+from __future__ import print_function, division, absolute_import
+
+import argparse
+import json
+import os
+import re
+import sys
+import time
+from collections import OrderedDict
+from os.path import dirname, abspath
+
+sys.path.insert(0, dirname(dirname(abspath(__file__))))
+from support import constants, server
+
+from fabric.api import task, sudo, settings
+
+PERF_DIR = dirname(abspath(__file__))
+GUEST_PERF_DIR = os.path.join(constants.GUEST_REPO_ROOT, "tests/perf")
+GUEST_LOADGEN = os.path.join(constants.GUEST_REPO_ROOT, "tools/loadgen/loadgen")
+DEFAULT_BASELINE = os.path.join(PERF_DIR, "baseline.json")
+
+NETNS = "skperf"
+CLIENT_IF = "skperf0"
+SERVER_IF = "skperf1"
+CLIENT_IP = "10.77.0.1"
+SERVER_IP = "10.77.0.10"
+DNS_PORT = 19899
+
+WORKLOADS = OrderedDict([
+    # a few hot names, the first one takes most of the queries.
+    ("hot_a", {"file": "hot_a.txt", "args": "-m zipf=100 -z 1.2"}),
+    # MX with the addresses of the exchanges in additional section.
+    ("mx", {"file": "mx.txt", "args": "-m uniform=100 -e 1232"}),
+    # random labels under the zone.
+    ("nxdomain", {"file": "hot_a.txt", "args": "-m nxdomain=100"}),
+    ("ecs", {"file": "hot_a.txt", "args": "-m zipf=100 -z 1.2 -c 10.1.2.0/24"}),
+    ("tcp", {"file": "hot_a.txt", "tcp": True}),
+])
+
+
+@task
+def setup_net():
+    with settings(warn_only=True):
+        sudo("ip netns del %s" % NETNS)
+        sudo("ip link del %s" % SERVER_IF)
+    sudo("ip netns add %s" % NETNS)
+    sudo("ip link add %s type veth peer name %s" % (CLIENT_IF, SERVER_IF))
+    sudo("ip link set %s netns %s" % (CLIENT_IF, NETNS))
+    sudo("ip -n %s addr add %s/24 dev %s" % (NETNS, CLIENT_IP, CLIENT_IF))
+    sudo("ip -n %s link set %s up" % (NETNS, CLIENT_IF))
+    sudo("ip -n %s link set lo up" % NETNS)
+    sudo("ip link set %s up" % SERVER_IF)
+    # the responses are read by AF_PACKET, don't let the kernel answer them with icmp.
+    sudo("ip netns exec %s iptables -A INPUT -p udp --sport %d -j DROP" % (NETNS, DNS_PORT))
+    sudo("make -C %s" % dirname(GUEST_LOADGEN))
+
+
+@task
+def teardown_net():
+    with settings(warn_only=True):
+        sudo("ip netns del %s" % NETNS)
+        sudo("ip link del %s" % SERVER_IF)
+
+
+@task
+def run_in_netns(cmd, result):
+    result.append(sudo("ip netns exec %s %s" % (NETNS, cmd)))
+
+
+@task
+def server_mac(result):
+    result.append(sudo("cat /sys/class/net/%s/address" % SERVER_IF).strip())
+
+
+def parse_summary(output):
+    res = {}
+    m = re.search(r"received: (\d+)\((\d+) rps, ([\d.]+)%\)", output)
+    if m is None:
+        raise Exception("can't parse the output of load generator:\n%s" % output)
+    res["qps"] = int(m.group(2))
+    res["response_rate"] = float(m.group(3))
+    m = re.search(r"p50: (\d+), p90: (\d+), p99: (\d+), p99.9: (\d+), max: (\d+)", output)
+    if m:
+        for k, v in zip(["p50_us", "p90_us", "p99_us", "p999_us", "max_us"], m.groups()):
+            res[k] = int(v)
+    res["rcodes"] = {k: int(v) for k, v in re.findall(r"^([A-Z0-9]+): (\d+)\(", output, re.M)}
+    return res
+
+
+def lcore_answered(srv):
+    res = {}
+    for lcore, v in re.findall(r'^shuke_lcore_answered_total\{lcore="(\d+)"\} (\d+)', srv.metrics(), re.M):
+        res[lcore] = int(v)
+    return res
+
+
+def run_workload(srv, name, wl, mac, duration):
+    query_file = os.path.join(GUEST_PERF_DIR, "queries", wl["file"])
+    if wl.get("tcp"):
+        cmd = "python3 %s/tcpload.py -d %s -p %d -f %s -t %d" % (
+            GUEST_PERF_DIR, SERVER_IP, DNS_PORT, query_file, duration)
+    else:
+        cmd = "%s -i %s -M %s -s %s -d %s -p %d -f %s -r 0 -t %d %s" % (
+            GUEST_LOADGEN, CLIENT_IF, mac, CLIENT_IP, SERVER_IP, DNS_PORT, query_file,
+            duration, wl["args"])
+    before = lcore_answered(srv)
+    t0 = time.time()
+    output = []
+    srv._execute(run_in_netns, cmd, output)
+    elapsed = time.time() - t0
+    # the counters in metrics are refreshed by lcores without delay.
+    after = lcore_answered(srv)
+    res = parse_summary(output[0])
+    res["lcore_qps"] = {k: int((after[k] - before.get(k, 0)) / elapsed) for k in after}
+    print("%-10s qps: %-10d p50: %-6s p99: %-6s response: %.2f%%" % (
+        name, res["qps"], res.get("p50_us"), res.get("p99_us"), res["response_rate"]))
+    return res
+
+
+def run_suite(nr_lcores_list, workloads, duration):
+    results = []
+    for nr_lcores in nr_lcores_list:
+        overrides = {
+            "dpdk.queue_config": "[1-%d].0" % nr_lcores if nr_lcores > 1 else "[1].0",
+            "dpdk.vdevs": ["net_af_packet0,iface=%s" % SERVER_IF],
+            "dpdk.no_pci": True,
+            "core.bind": [SERVER_IP],
+            "core.port": DNS_PORT,
+            "core.metrics_port": 14142,
+            "core.loglevel": "info",
+            "core.query_log_file": None,
+            "core.log_verbose": False,
+        }
+        srv = server.DNSServer(overrides)
+        srv._execute(setup_net)
+        mac = []
+        srv._execute(server_mac, mac)
+        srv.start()
+        try:
+            print("# %d lcores" % nr_lcores)
+            for name in workloads:
+                res = run_workload(srv, name, WORKLOADS[name], mac[0], duration)
+                res.update({"workload": name, "lcores": nr_lcores})
+                results.append(res)
+        finally:
+            srv.stop()
+            srv._execute(teardown_net)
+    return results
+
+
+def compare(results, baseline, qps_threshold, latency_threshold):
+    """
+    return the list of regressions, the results without baseline are skipped.
+    """
+    base = {(r["workload"], r["lcores"]): r for r in baseline.get("results", [])}
+    regressions = []
+    for r in results:
+        b = base.get((r["workload"], r["lcores"]))
+        if b is None:
+            continue
+        if r["qps"] < b["qps"] * (1 - qps_threshold):
+            regressions.append("%s(%d lcores): qps %d < baseline %d" % (
+                r["workload"], r["lcores"], r["qps"], b["qps"]))
+        if "p99_us" in r and "p99_us" in b and r["p99_us"] > b["p99_us"] * (1 + latency_threshold):
+            regressions.append("%s(%d lcores): p99 %dus > baseline %dus" % (
+                r["workload"], r["lcores"], r["p99_us"], b["p99_us"]))
+    return regressions
+
+
+def parse_cmd_args():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-l", "--lcores", default="1", help="comma separated lcore counts(default: 1)")
+    parser.add_argument("-w", "--workloads", default=",".join(WORKLOADS),
+                        help="comma separated workloads(default: all)")
+    parser.add_argument("-t", "--duration", default=10, type=int, help="seconds per workload")
+    parser.add_argument("-o", "--output", default=None, help="write the results to a json file")
+    parser.add_argument("-b", "--baseline", default=DEFAULT_BASELINE)
+    parser.add_argument("--update-baseline", action="store_true",
+                        help="write the results to the baseline instead of comparing")
+    parser.add_argument("--qps-threshold", default=0.1, type=float,
+                        help="max drop of throughput(default: 0.1)")
+    parser.add_argument("--latency-threshold", default=0.25, type=float,
+                        help="max growth of p99 latency(default: 0.25)")
+    return parser.parse_args()
+
+
+def main():
+    args = parse_cmd_args()
+    workloads = args.workloads.split(",")
+    for name in workloads:
+        if name not in WORKLOADS:
+            print("unknown workload %s, should be one of %s" % (name, ", ".join(WORKLOADS)))
+            return 2
+    results = run_suite([int(v) for v in args.lcores.split(",")], workloads, args.duration)
+    doc = {"time": int(time.time()), "duration": args.duration, "results": results}
+    if args.output:
+        with open(args.output, "w") as fp:
+            json.dump(doc, fp, indent=2, sort_keys=True)
+    if args.update_baseline:
+        with open(args.baseline, "w") as fp:
+            json.dump(doc, fp, indent=2, sort_keys=True)
+        print("baseline is written to %s" % args.baseline)
+        return 0
+    if not os.path.exists(args.baseline):
+        print("no baseline(%s), run with --update-baseline to create it" % args.baseline)
+        return 0
+    with open(args.baseline) as fp:
+        baseline = json.load(fp)
+    regressions = compare(results, baseline, args.qps_threshold, args.latency_threshold)
+    for reg in regressions:
+        print("REGRESSION: %s" % reg)
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
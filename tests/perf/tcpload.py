@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+dns over tcp load, it opens `-c` connections and keeps `-d` queries in flight on
+every connection. the summary has the same format as tools/loadgen, so perf.py
+parses both in the same way. it only uses the standard library, because it runs
+in the vm.
+"""
+from __future__ import print_function, division, absolute_import
+
+import argparse
+import asyncio
+import random
+import struct
+import time
+
+
+RCODES = ["NOERROR", "FORMERR", "SERVFAIL", "NXDOMAIN", "NOTIMP", "REFUSED"]
+QTYPES = {"A": 1, "NS": 2, "CNAME": 5, "SOA": 6, "MX": 15, "TXT": 16, "AAAA": 28, "SRV": 33}
+
+
+def load_queries(fname):
+    queries = []
+    with open(fname) as fp:
+        for line in fp:
+            parts = line.split()
+            if not parts or parts[0][0] in "#;":
+                continue
+            qtype = QTYPES[parts[1].upper()] if len(parts) > 1 else 1
+            qname = b"".join(struct.pack("B", len(label)) + label.encode()
+                             for label in parts[0].rstrip(".").split("."))
+            queries.append(qname + b"\x00" + struct.pack(">HH", qtype, 1))
+    return queries
+
+
+class Stats(object):
+    def __init__(self):
+        self.sent = 0
+        self.received = 0
+        self.rcodes = {}
+        self.latencies = []
+
+
+async def connection(host, port, queries, depth, deadline, stats):
+    reader, writer = await asyncio.open_connection(host, port)
+    inflight = {}
+    xid = random.randint(0, 0xffff)
+
+    def send_one():
+        nonlocal xid
+        xid = (xid + 1) & 0xffff
+        msg = struct.pack(">HHHHHH", xid, 0x0100, 1, 0, 0, 0) + random.choice(queries)
+        writer.write(struct.pack(">H", len(msg)) + msg)
+        inflight[xid] = time.monotonic()
+        stats.sent += 1
+
+    for _ in range(depth):
+        send_one()
+    try:
+        while inflight:
+            hdr = await reader.readexactly(2)
+            resp = await reader.readexactly(struct.unpack(">H", hdr)[0])
+            rid, flags = struct.unpack(">HH", resp[:4])
+            ts = inflight.pop(rid, None)
+            if ts is None:
+                continue
+            stats.received += 1
+            stats.latencies.append(time.monotonic() - ts)
+            rcode = flags & 0xf
+            stats.rcodes[rcode] = stats.rcodes.get(rcode, 0) + 1
+            if time.monotonic() < deadline:
+                send_one()
+    except asyncio.IncompleteReadError:
+        pass
+    writer.close()
+
+
+def percentile(sorted_us, p):
+    if not sorted_us:
+        return 0
+    return sorted_us[min(len(sorted_us) - 1, int(len(sorted_us) * p))]
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-d", "--dst-ip", required=True)
+    parser.add_argument("-p", "--port", type=int, default=53)
+    parser.add_argument("-f", "--query-file", required=True)
+    parser.add_argument("-c", "--conns", type=int, default=16)
+    parser.add_argument("-D", "--depth", type=int, default=8, help="queries in flight per connection")
+    parser.add_argument("-t", "--duration", type=int, default=10)
+    args = parser.parse_args()
+
+    queries = load_queries(args.query_file)
+    stats = Stats()
+    loop = asyncio.get_event_loop()
+    start = time.monotonic()
+    deadline = start + args.duration
+    tasks = [connection(args.dst_ip, args.port, queries, args.depth, deadline, stats)
+             for _ in range(args.conns)]
+    loop.run_until_complete(asyncio.gather(*tasks))
+    elapsed = time.monotonic() - start
+
+    print("\n# summary")
+    print("duration: %.2fs" % elapsed)
+    print("sent: %d(%.0f qps), send errors: 0" % (stats.sent, stats.sent / elapsed))
+    print("received: %d(%.0f rps, %.2f%%), unmatched: 0, lost: %d" % (
+        stats.received, stats.received / elapsed,
+        100.0 * stats.received / stats.sent if stats.sent else 0.0, stats.sent - stats.received))
+    print("\n# rcodes")
+    for rcode, n in sorted(stats.rcodes.items()):
+        name = RCODES[rcode] if rcode < len(RCODES) else "RCODE%d" % rcode
+        print("%s: %d(%.2f%%)" % (name, n, 100.0 * n / stats.received))
+    us = sorted(int(v * 1e6) for v in stats.latencies)
+    if us:
+        print("\n# latency(us)")
+        print("p50: %d, p90: %d, p99: %d, p99.9: %d, max: %d" % (
+            percentile(us, 0.5), percentile(us, 0.9), percentile(us, 0.99),
+            percentile(us, 0.999), us[-1]))
+
+
+if __name__ == "__main__":
+    main()
@@ -15,6 +15,10 @@ REPO_ROOT = dirname(dirname(dirname(abspath(__file__))))
 MONGO_HOST = os.getenv("MONGO_HOST", "127.0.0.1")
 MONGO_PORT = int(os.getenv("MONGO_PORT", 27117))
 
+# the address of the test primary server, as seen from the vm running shuke.
+XFR_PRIMARY_HOST = os.getenv("XFR_PRIMARY_HOST", "172.28.128.1")
+XFR_PRIMARY_PORT = int(os.getenv("XFR_PRIMARY_PORT", 15353))
+
 GUEST_REPO_ROOT = "/shuke"
 ASSETS_DIR = os.path.join(REPO_ROOT, "tests/assets")
 EXAMPLE_ZONE_FILE = os.path.join(ASSETS_DIR, "example.z")
@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+a tiny primary server used to test zone transfer, it keeps every version
+of the zones and serves SOA, AXFR and IXFR(the differences from the version
+of secondary to the latest version) over tcp.
+"""
+from __future__ import print_function, division, absolute_import
+import socket
+import struct
+import threading
+
+try:
+    import socketserver
+except ImportError:
+    import SocketServer as socketserver
+
+import dns.message
+import dns.name
+import dns.rcode
+import dns.rdatatype
+import dns.rrset
+import dns.zone
+
+# the number of records of every response message
+RRS_PER_MSG = 100
+
+
+def recvall(sock, n):
+    buf = b""
+    while len(buf) < n:
+        data = sock.recv(n - len(buf))
+        if not data:
+            return None
+        buf += data
+    return buf
+
+
+def zone_rrs(z):
+    """ all records of zone except SOA """
+    rrs = []
+    for name, ttl, rdata in z.iterate_rdatas():
+        if rdata.rdtype != dns.rdatatype.SOA:
+            rrs.append((name, ttl, rdata))
+    return rrs
+
+
+def rr_key(rr):
+    name, ttl, rdata = rr
+    return name, rdata.rdtype, ttl, rdata.to_text()
+
+
+def soa_rr(z):
+    rds = z.find_rdataset(z.origin, dns.rdatatype.SOA)
+    return z.origin, rds.ttl, rds[0]
+
+
+class _Handler(socketserver.BaseRequestHandler):
+    def handle(self):
+        primary = self.server.primary
+        while True:
+            lenbuf = recvall(self.request, 2)
+            if lenbuf is None:
+                return
+            wire = recvall(self.request, struct.unpack("!H", lenbuf)[0])
+            if wire is None:
+                return
+            q = dns.message.from_wire(wire)
+            with primary.lock:
+                primary.queries.append(dns.rdatatype.to_text(q.question[0].rdtype))
+            for resp in primary.answer(q):
+                data = resp.to_wire()
+                self.request.sendall(struct.pack("!H", len(data)) + data)
+
+
+class _Server(socketserver.ThreadingMixIn, socketserver.TCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+class ZonePrimary(object):
+    def __init__(self, host, port, ixfr=True):
+        self.versions = {}
+        self.ixfr = ixfr
+        # the qtypes received, used to check AXFR or IXFR is used.
+        self.queries = []
+        self.lock = threading.Lock()
+        self.server = _Server((host, port), _Handler)
+        self.server.primary = self
+        self.thread = None
+
+    def start(self):
+        self.thread = threading.Thread(target=self.server.serve_forever)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def stop(self):
+        self.server.shutdown()
+        self.server.server_close()
+
+    def set_zone(self, zone_ss):
+        """ add a new version of zone """
+        z = dns.zone.from_text(zone_ss, relativize=False)
+        with self.lock:
+            self.versions.setdefault(z.origin, []).append(z)
+
+    def _make_msgs(self, q, rrs):
+        msgs = []
+        for i in range(0, max(len(rrs), 1), RRS_PER_MSG):
+            resp = dns.message.make_response(q)
+            for name, ttl, rdata in rrs[i:i+RRS_PER_MSG]:
+                resp.answer.append(dns.rrset.from_rdata(name, ttl, rdata))
+            msgs.append(resp)
+        return msgs
+
+    def answer(self, q):
+        qname = q.question[0].name
+        qtype = q.question[0].rdtype
+        with self.lock:
+            versions = list(self.versions.get(qname, []))
+        if not versions:
+            resp = dns.message.make_response(q)
+            resp.set_rcode(dns.rcode.NOTAUTH)
+            return [resp]
+        latest = versions[-1]
+        soa = soa_rr(latest)
+        if qtype == dns.rdatatype.SOA:
+            return self._make_msgs(q, [soa])
+        if qtype == dns.rdatatype.IXFR:
+            if not self.ixfr:
+                resp = dns.message.make_response(q)
+                resp.set_rcode(dns.rcode.NOTIMP)
+                return [resp]
+            serial = q.authority[0][0].serial
+            old = [z for z in versions if soa_rr(z)[2].serial == serial]
+            if old and old[0] is latest:
+                return self._make_msgs(q, [soa])
+            if old:
+                old_rrs = set(zone_rrs(old[0]))
+                new_rrs = set(zone_rrs(latest))
+                rrs = [soa, soa_rr(old[0])] + sorted(old_rrs - new_rrs, key=rr_key) + \
+                      [soa] + sorted(new_rrs - old_rrs, key=rr_key) + [soa]
+                return self._make_msgs(q, rrs)
+            # unknown serial, send the full zone
+        if qtype in (dns.rdatatype.AXFR, dns.rdatatype.IXFR):
+            return self._make_msgs(q, [soa] + zone_rrs(latest) + [soa])
+        resp = dns.message.make_response(q)
+        resp.set_rcode(dns.rcode.REFUSED)
+        return [resp]
@@ -11,11 +11,14 @@ import struct
 import time
 import tempfile
 import io
+import urllib.request
 
 import toml
 
 import dns.message
+import dns.opcode
 import dns.query
+import dns.rdatatype
 import vagrant
 from fabric.api import env, execute, task, sudo, get, settings
 from fabric.operations import put
@@ -23,6 +26,7 @@ from fabric.contrib import files
 
 from . import constants
 from .zone2mongo import ZoneMongo
+from .primary import ZonePrimary
 
 
 DNS_BIN = '/shuke/build/shuke-server'
@@ -82,6 +86,12 @@ def stop_shuke(pidfile):
             raise Exception("shuke doesn't stop correctly.")
 
 
+@task
+def write_file(path, ss):
+    sudo("mkdir -p %s" % os.path.dirname(path))
+    put(io.BytesIO(ss.encode("utf8")), path, use_sudo=True)
+
+
 @task
 def shuke_is_running(pidfile):
     if files.exists(pidfile, use_sudo=True):
@@ -130,16 +140,19 @@ class AdminClient(object):
 
 
 def update_nested_dict(d, overrides):
+    """
+    the key is a dotted path, a value of None removes the key.
+    """
     def update_one(d, k, v):
         k_list = k.split(".")
         if len(k_list) == 0:
             return
-        elif len(k_list) == 1:
-            d[k_list[0]] = v
+        old_v = d
+        for kk in k_list[:-1]:
+            old_v = old_v[kk]
+        if v is None:
+            old_v.pop(k_list[-1], None)
         else:
-            old_v = d[k_list[0]]
-            for kk in k_list[1:-1]:
-                old_v = old_v[kk]
             old_v[k_list[-1]] = v
     for k, v in overrides.items():
         update_one(d, k, v)
@@ -166,7 +179,16 @@ class DNSServer(object):
         if self.data_store == "mongo":
             self.zm = ZoneMongo(constants.MONGO_HOST,
                                 constants.MONGO_PORT,
-                                mongo_conf["dbname"])
+                                mongo_conf["dbname"],
+                                mongo_conf.get("catalog"))
+        # start a primary server in the host, shuke transfers zones from it.
+        self.primary = None
+        if self.data_store == "xfr":
+            xfr_conf = self.cf["zone_source"].setdefault("xfr", {})
+            xfr_conf["primary"] = constants.XFR_PRIMARY_HOST
+            xfr_conf["port"] = constants.XFR_PRIMARY_PORT
+            self.primary = ZonePrimary("0.0.0.0", constants.XFR_PRIMARY_PORT,
+                                       xfr_conf.get("ixfr", True))
         self.valgrind = valgrind
 
         self.cf_str = toml.dumps(self.cf)
@@ -190,6 +212,8 @@ class DNSServer(object):
         execute(fn, *args, **kwargs)  # run a fabric task on the vagrant host.
 
     def start(self):
+        if self.primary:
+            self.primary.start()
         try:
             self._start_srv()
         except Exception as e:
@@ -210,6 +234,8 @@ class DNSServer(object):
         self.admin_cli.close()
         self.fp.close()
         self._stop_srv()
+        if self.primary:
+            self.primary.stop()
 
     def set_zone(self, ss):
         return self.admin_cmd("zone set \"%s\"" % ss)
@@ -235,12 +261,78 @@ class DNSServer(object):
         else:
             return dns.query.udp(q, dns_host, port=dns_port)
 
+    def udp_flood(self, names, duration):
+        """
+        send the udp queries(type A) of names round robin as fast as possible for
+        duration seconds, the responses are read but not parsed.
+
+        :return: the number of queries sent and the number of responses
+        """
+        dns_host = self.dns_host[0] if len(self.dns_host) > 0 else ""
+        wires = [dns.message.make_query(name, "A").to_wire() for name in names]
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.setblocking(False)
+        nr_sent = nr_resp = 0
+        deadline = time.time() + duration
+        try:
+            while time.time() < deadline:
+                try:
+                    sock.sendto(wires[nr_sent % len(wires)], (dns_host, self.dns_port))
+                    nr_sent += 1
+                except BlockingIOError:
+                    pass
+                try:
+                    while True:
+                        sock.recv(4096)
+                        nr_resp += 1
+                except BlockingIOError:
+                    pass
+        finally:
+            sock.close()
+        return nr_sent, nr_resp
+
+    def send_notify(self, dot_origin, use_tcp=False):
+        dns_host = self.dns_host[0] if len(self.dns_host) > 0 else ""
+        q = dns.message.make_query(dot_origin, dns.rdatatype.SOA)
+        q.set_opcode(dns.opcode.NOTIFY)
+        if use_tcp:
+            return dns.query.tcp(q, dns_host, port=self.dns_port)
+        else:
+            return dns.query.udp(q, dns_host, port=self.dns_port)
+
+    def metrics(self, path="/metrics"):
+        host = self.admin_host if self.admin_host else "127.0.0.1"
+        url = "http://%s:%d%s" % (host, self.cf["core"]["metrics_port"], path)
+        return urllib.request.urlopen(url, timeout=5).read().decode("utf8")
+
+    def zone_transfer(self, dot_origin, rdtype="AXFR", serial=0):
+        dns_host = self.dns_host[0] if len(self.dns_host) > 0 else ""
+        return list(dns.query.xfr(dns_host, dot_origin, rdtype=rdtype, port=self.dns_port,
+                                  serial=serial, relativize=False))
+
+    def write_zone_file(self, fname, zone_ss):
+        """
+        write the zone file in the vm, fname is relative to zone_files_root,
+        the files in the shared folder don't trigger inotify events in the vm.
+        """
+        root = self.cf["zone_source"]["file"]["zone_files_root"]
+        self.write_file(os.path.join(root, fname), zone_ss)
+
+    def write_file(self, path, ss):
+        """
+        write a file(e.g. acl file) in the vm, path is absolute.
+        """
+        self._execute(write_file, path, ss)
+
     def mongo_clear(self):
         self.zm.del_all_zones()
 
     def write_zone_to_mongo(self, zone_ss):
         self.zm.str_to_mongo(zone_ss)
 
+    def write_zone_to_primary(self, zone_ss):
+        self.primary.set_zone(zone_ss)
+
     def mongo_delete_zone(self, dot_origin):
         self.zm.del_zone(dot_origin)
 
@@ -25,10 +25,22 @@ def dns_srv(request):
 
     srv = server.DNSServer(overrides, valgrind)
     if srv.data_store.lower() == "mongo":
+        srv.zm.wire = getattr(request.module, "mongo_wire", False)
         srv.mongo_clear()
         zone_init_str = getattr(request.module, "zone_init_str", None)
         if zone_init_str:
             srv.write_zone_to_mongo(zone_init_str)
+    elif srv.data_store == "xfr":
+        zone_init_str = getattr(request.module, "zone_init_str", None)
+        if zone_init_str:
+            srv.write_zone_to_primary(zone_init_str)
+    elif srv.data_store == "file":
+        zone_files = getattr(request.module, "zone_files", {})
+        for fname, zone_ss in zone_files.items():
+            srv.write_zone_file(fname, zone_ss)
+    # the other files read by the server, path => content.
+    for path, ss in getattr(request.module, "files", {}).items():
+        srv.write_file(path, ss)
     srv.start()
 
     yield srv
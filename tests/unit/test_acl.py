@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+access control lists.
+"""
+from __future__ import print_function, division, absolute_import
+
+import sys
+from os.path import dirname, abspath
+
+import dns.exception
+import dns.message
+import dns.query
+import dns.rcode
+import pytest
+
+sys.path.insert(0, dirname(dirname(abspath(__file__))))
+from support import constants
+
+overrides = {
+    "zone_source.type": "file",
+    "core.acl_file": "/shuke/tests/assets/acl.txt",
+}
+valgrind = False
+
+
+def test_refuse_qtype(dns_srv):
+    msg = dns_srv.dns_query("test-a.example.com.", "ANY", use_tcp=False)
+    assert msg.rcode() == dns.rcode.REFUSED
+    msg = dns_srv.dns_query("test-a.example.com.", "A", use_tcp=False)
+    assert msg.rcode() == dns.rcode.NOERROR
+
+
+def test_refuse_qname(dns_srv):
+    msg = dns_srv.dns_query("a.refused.example.com.", "A", use_tcp=True)
+    assert msg.rcode() == dns.rcode.REFUSED
+    msg = dns_srv.dns_query("a.refused.example.com.", "AAAA", use_tcp=False)
+    assert msg.rcode() == dns.rcode.NXDOMAIN
+
+
+def test_drop_qname(dns_srv):
+    q = dns.message.make_query("x.DROP.example.com.", "A")
+    with pytest.raises(dns.exception.Timeout):
+        dns.query.udp(q, dns_srv.dns_host[0], port=dns_srv.dns_port, timeout=1)
+
+
+def test_acl_admin(dns_srv):
+    dns_srv.dns_query("test-a.example.com.", "ANY", use_tcp=False)
+    lines = dns_srv.admin_cmd("acl list").split("\n")
+    assert "rules: 4" in lines
+    assert any(line.startswith("2: refuse qtype ANY (hits: ") and not line.endswith("(hits: 0)")
+               for line in lines)
+    assert dns_srv.admin_cmd("acl reload") == "OK"
+    assert "2: refuse qtype ANY (hits: 0)" in dns_srv.admin_cmd("acl list")
@@ -0,0 +1,46 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+the packet rules after a query rule don't take effect before it.
+"""
+from __future__ import print_function, division, absolute_import
+
+import dns.exception
+import dns.message
+import dns.query
+import dns.rcode
+import pytest
+
+ACL_FILE = "/tmp/shuke_acl/acl.txt"
+
+overrides = {
+    "zone_source.type": "file",
+    "core.acl_file": ACL_FILE,
+}
+files = {
+    ACL_FILE: """allow qname allowed.example.com.
+drop src 0.0.0.0/0
+""",
+}
+valgrind = False
+
+
+def test_query_rule_first(dns_srv):
+    msg = dns_srv.dns_query("x.allowed.example.com.", "A", use_tcp=False)
+    assert msg.rcode() == dns.rcode.NXDOMAIN
+    msg = dns_srv.dns_query("x.allowed.example.com.", "A", use_tcp=True)
+    assert msg.rcode() == dns.rcode.NXDOMAIN
+
+
+def test_packet_rule_after(dns_srv):
+    q = dns.message.make_query("test-a.example.com.", "A")
+    with pytest.raises(dns.exception.Timeout):
+        dns.query.udp(q, dns_srv.dns_host[0], port=dns_srv.dns_port, timeout=1)
+
+
+def test_hits(dns_srv):
+    dns_srv.dns_query("x.allowed.example.com.", "A", use_tcp=False)
+    lines = dns_srv.admin_cmd("acl list").split("\n")
+    for prefix in ("1: allow qname allowed.example.com. (hits: ", "2: drop src 0.0.0.0/0 (hits: "):
+        assert any(line.startswith(prefix) and not line.endswith("(hits: 0)") for line in lines)
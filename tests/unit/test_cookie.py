@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+DNS cookies(RFC 7873).
+"""
+from __future__ import print_function, division, absolute_import
+
+import sys
+from os.path import dirname, abspath
+
+import dns.edns
+import dns.message
+import dns.query
+import dns.rcode
+
+sys.path.insert(0, dirname(dirname(abspath(__file__))))
+from support import constants
+
+overrides = {
+    "zone_source.type": "file",
+    "cookie.enabled": True,
+}
+valgrind = False
+
+CLIENT_COOKIE = b"\x24\x64\xc4\xab\xcf\x10\xc9\x57"
+OPT_COOKIE = 10
+
+
+def cookie_query(dns_srv, cookie):
+    q = dns.message.make_query("test-a.example.com.", "A")
+    q.use_edns(options=[dns.edns.GenericOption(OPT_COOKIE, cookie)])
+    return dns.query.udp(q, dns_srv.dns_host[0], port=dns_srv.dns_port, timeout=2)
+
+
+def get_cookie(msg):
+    for opt in msg.options:
+        if opt.otype == OPT_COOKIE:
+            return opt.data
+    return None
+
+
+def test_client_cookie(dns_srv):
+    r = cookie_query(dns_srv, CLIENT_COOKIE)
+    assert r.rcode() == dns.rcode.NOERROR and len(r.answer) == 1
+    cookie = get_cookie(r)
+    assert cookie is not None and len(cookie) == 24
+    assert cookie[:8] == CLIENT_COOKIE
+    # version 1 and reserved bytes
+    assert cookie[8:12] == b"\x01\x00\x00\x00"
+
+
+def test_server_cookie(dns_srv):
+    cookie = get_cookie(cookie_query(dns_srv, CLIENT_COOKIE))
+    # a fresh valid server cookie is echoed.
+    assert get_cookie(cookie_query(dns_srv, cookie)) == cookie
+
+    # a bad server cookie is replaced.
+    bad = cookie[:16] + bytes(8)
+    r = cookie_query(dns_srv, bad)
+    assert r.rcode() == dns.rcode.NOERROR
+    new_cookie = get_cookie(r)
+    assert new_cookie[:8] == CLIENT_COOKIE and new_cookie != bad
+
+
+def test_malformed_cookie(dns_srv):
+    r = cookie_query(dns_srv, b"\x01\x02\x03")
+    assert r.rcode() == dns.rcode.FORMERR
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+pre-signed DNSSEC zones.
+"""
+from __future__ import print_function, division, absolute_import
+
+import dns.flags
+import dns.message
+import dns.query
+import dns.rcode
+import dns.rdatatype
+
+overrides = {
+    "zone_source.type": "file",
+    "zone_source.file.files": [{"name": "example.com.", "file": "tests/assets/signed_example.z"}],
+}
+valgrind = False
+
+
+def query(dns_srv, name, ty, dnssec=True, payload=1232, use_tcp=False):
+    q = dns.message.make_query(name, ty, want_dnssec=dnssec, payload=payload)
+    if use_tcp:
+        return dns.query.tcp(q, dns_srv.dns_host[0], port=dns_srv.dns_port, timeout=2)
+    return dns.query.udp(q, dns_srv.dns_host[0], port=dns_srv.dns_port, timeout=2)
+
+
+def rrsets_of(section, ty):
+    return [rrset for rrset in section if rrset.rdtype == ty]
+
+
+def test_signed_answer(dns_srv):
+    r = query(dns_srv, "www.example.com.", "A")
+    assert r.rcode() == dns.rcode.NOERROR
+    sigs = rrsets_of(r.answer, dns.rdatatype.RRSIG)
+    assert len(sigs) == 1 and sigs[0][0].type_covered == dns.rdatatype.A
+    assert r.ednsflags & dns.flags.DO
+
+    r = query(dns_srv, "www.example.com.", "A", dnssec=False)
+    assert len(r.answer) == 1 and not rrsets_of(r.answer, dns.rdatatype.RRSIG)
+
+
+def test_nxdomain_proof(dns_srv):
+    r = query(dns_srv, "nxd.example.com.", "A")
+    assert r.rcode() == dns.rcode.NXDOMAIN
+    assert len(rrsets_of(r.authority, dns.rdatatype.SOA)) == 1
+    covered = {rd.type_covered for rrset in rrsets_of(r.authority, dns.rdatatype.RRSIG) for rd in rrset}
+    assert covered == {dns.rdatatype.SOA, dns.rdatatype.NSEC}
+    owners = {rrset.name.to_text() for rrset in rrsets_of(r.authority, dns.rdatatype.NSEC)}
+    assert owners == {"dns1.example.com.", "example.com."}
+
+
+def test_nodata_proof(dns_srv):
+    r = query(dns_srv, "www.example.com.", "TXT")
+    assert r.rcode() == dns.rcode.NOERROR and len(r.answer) == 0
+    nsec = rrsets_of(r.authority, dns.rdatatype.NSEC)
+    assert len(nsec) == 1 and nsec[0].name.to_text() == "www.example.com."
+
+
+def test_truncated(dns_srv):
+    r = query(dns_srv, "example.com.", "DNSKEY", payload=512)
+    assert r.flags & dns.flags.TC and len(r.answer) == 0
+
+    r = query(dns_srv, "example.com.", "DNSKEY", payload=512, use_tcp=True)
+    assert not r.flags & dns.flags.TC
+    assert len(rrsets_of(r.answer, dns.rdatatype.DNSKEY)[0]) == 2
+    assert len(rrsets_of(r.answer, dns.rdatatype.RRSIG)) == 1
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+pre-signed NSEC3 zones.
+"""
+from __future__ import print_function, division, absolute_import
+
+import sys
+from os.path import dirname, abspath
+
+import dns.dnssec
+import dns.rcode
+import dns.rdatatype
+
+sys.path.insert(0, dirname(abspath(__file__)))
+from test_dnssec import query, rrsets_of
+
+overrides = {
+    "zone_source.type": "file",
+    "zone_source.file.files": [{"name": "example.com.", "file": "tests/assets/signed_nsec3_example.z"}],
+}
+valgrind = False
+
+ORIGIN = "example.com."
+SALT = "aabbccdd"
+ITERATIONS = 1
+
+
+def nsec3_hash(name):
+    return dns.dnssec.nsec3_hash(name, SALT, ITERATIONS, dns.dnssec.NSEC3Hash.SHA1).lower()
+
+
+# hashes of the names in the zone, sorted as the NSEC3 chain.
+CHAIN = sorted(nsec3_hash(n + ORIGIN) for n in ("", "dns1.", "www.", "b.", "a.b."))
+
+
+def covering(name):
+    h = nsec3_hash(name)
+    prev = [x for x in CHAIN if x < h]
+    return prev[-1] if prev else CHAIN[-1]
+
+
+def nsec3_owners(r):
+    return {rrset.name.to_text() for rrset in rrsets_of(r.authority, dns.rdatatype.NSEC3)}
+
+
+def owner(h):
+    return "%s.%s" % (h, ORIGIN)
+
+
+def test_nodata_proof(dns_srv):
+    for name, ty in (("www.example.com.", "TXT"), ("b.example.com.", "A"), ("example.com.", "TXT")):
+        r = query(dns_srv, name, ty)
+        assert r.rcode() == dns.rcode.NOERROR and len(r.answer) == 0
+        assert nsec3_owners(r) == {owner(nsec3_hash(name))}
+        covered = {rd.type_covered for rrset in rrsets_of(r.authority, dns.rdatatype.RRSIG) for rd in rrset}
+        assert covered == {dns.rdatatype.SOA, dns.rdatatype.NSEC3}
+
+
+def test_nxdomain_proof(dns_srv):
+    r = query(dns_srv, "nxd.example.com.", "A")
+    assert r.rcode() == dns.rcode.NXDOMAIN
+    assert len(rrsets_of(r.authority, dns.rdatatype.SOA)) == 1
+    expected = {owner(nsec3_hash(ORIGIN)), owner(covering("nxd." + ORIGIN)), owner(covering("*." + ORIGIN))}
+    assert nsec3_owners(r) == expected
+
+
+def test_nxdomain_below_name(dns_srv):
+    # closest encloser is dns1.example.com., the next closer is x.dns1.example.com.
+    r = query(dns_srv, "y.x.dns1.example.com.", "A")
+    assert r.rcode() == dns.rcode.NXDOMAIN
+    expected = {owner(nsec3_hash("dns1." + ORIGIN)), owner(covering("x.dns1." + ORIGIN)),
+                owner(covering("*.dns1." + ORIGIN))}
+    assert nsec3_owners(r) == expected
+
+    # the empty non-terminal b.example.com. is the closest encloser.
+    r = query(dns_srv, "c.b.example.com.", "A")
+    assert r.rcode() == dns.rcode.NXDOMAIN
+    expected = {owner(nsec3_hash("b." + ORIGIN)), owner(covering("c.b." + ORIGIN)),
+                owner(covering("*.b." + ORIGIN))}
+    assert nsec3_owners(r) == expected
+
+
+def test_no_proof_without_do(dns_srv):
+    r = query(dns_srv, "nxd.example.com.", "A", dnssec=False)
+    assert r.rcode() == dns.rcode.NXDOMAIN
+    assert not nsec3_owners(r) and not rrsets_of(r.authority, dns.rdatatype.RRSIG)
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+prometheus metrics endpoint.
+"""
+from __future__ import print_function, division, absolute_import
+
+import sys
+from os.path import dirname, abspath
+import re
+import time
+import urllib.error
+import pytest
+
+sys.path.insert(0, dirname(dirname(abspath(__file__))))
+from support import constants
+
+overrides = {
+    "zone_source.type": "file",
+    "core.metrics_port": 14142,
+}
+valgrind = False
+
+
+def metric_sum(text, name, **labels):
+    total = 0
+    for line in text.split("\n"):
+        if not line.startswith(name + "{") and not line.startswith(name + " "):
+            continue
+        if all('%s="%s"' % (k, v) in line for k, v in labels.items()):
+            total += float(line.rsplit(" ", 1)[1])
+    return total
+
+
+def test_metrics_format(dns_srv):
+    text = dns_srv.metrics()
+    assert "# TYPE shuke_responses_total counter" in text
+    for line in text.strip().split("\n"):
+        if line.startswith("#"):
+            continue
+        assert re.match(r'^[a-z_]+(\{[^}]*\})? [0-9.e+-]+$', line), line
+    assert metric_sum(text, "shuke_zones") >= 1
+
+
+def test_responses_by_rcode(dns_srv):
+    before = dns_srv.metrics()
+    dns_srv.dns_query("test-a.example.com.", "A")
+    dns_srv.dns_query("nonexist.example.com.", "A")
+    after = dns_srv.metrics()
+    for rcode in ("NOERROR", "NXDOMAIN"):
+        assert metric_sum(after, "shuke_responses_total", rcode=rcode) == \
+            metric_sum(before, "shuke_responses_total", rcode=rcode) + 1
+
+
+def test_queries_by_qtype(dns_srv):
+    before = dns_srv.metrics()
+    dns_srv.dns_query("test-a.example.com.", "AAAA")
+    after = dns_srv.metrics()
+    assert metric_sum(after, "shuke_queries_total", qtype="AAAA") == \
+        metric_sum(before, "shuke_queries_total", qtype="AAAA") + 1
+    # info is refreshed by the main thread every second
+    time.sleep(1.5)
+    assert "qtype_AAAA:" in dns_srv.admin_cmd("info stats")
+
+
+def test_zone_stats(dns_srv):
+    def zone_stats():
+        ss = dns_srv.admin_cmd("zone stats example.com")
+        return dict(line.split(":") for line in ss.strip().split("\r\n"))
+    before = zone_stats()
+    dns_srv.dns_query("test-a.example.com.", "A")
+    dns_srv.dns_query("nonexist.example.com.", "A")
+    after = zone_stats()
+    assert int(after["queries"]) == int(before["queries"]) + 2
+    assert int(after["nxdomain"]) == int(before["nxdomain"]) + 1
+    # the counters survive reloading
+    dns_srv.admin_cmd("zone reload example.com")
+    time.sleep(1)
+    assert int(zone_stats()["queries"]) >= int(after["queries"])
+
+
+def test_scrapes_are_independent(dns_srv):
+    # reading metrics or info doesn't reset any counter
+    dns_srv.info()
+    text1 = dns_srv.metrics()
+    dns_srv.info()
+    text2 = dns_srv.metrics()
+    assert metric_sum(text2, "shuke_reloads_total") == metric_sum(text1, "shuke_reloads_total")
+
+
+def test_not_found(dns_srv):
+    with pytest.raises(urllib.error.HTTPError) as e:
+        dns_srv.metrics("/foo")
+    assert e.value.code == 404
+
+
+def test_top(dns_srv):
+    # only udp queries are tracked
+    for _ in range(5):
+        dns_srv.dns_query("test-a.example.com.", "A", use_tcp=False)
+    assert "test-a.example.com." in dns_srv.admin_cmd("top names 5")
+    assert "example.com." in dns_srv.admin_cmd("top zones")
+    assert "127.0.0.0/24" in dns_srv.admin_cmd("top clients")
+    assert "unknown kind" in dns_srv.admin_cmd("top foo")
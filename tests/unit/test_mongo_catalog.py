@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+zone reloading driven by the zone catalog collection.
+"""
+from __future__ import print_function, division, absolute_import
+
+import sys
+from os.path import dirname, abspath
+import time
+import pytest
+
+sys.path.insert(0, dirname(dirname(abspath(__file__))))
+from support import constants
+
+overrides = {
+    "zone_source.type": "mongo",
+    "zone_source.mongo.catalog": "_catalog",
+    "zone_source.mongo.catalog_interval": 1,
+}
+valgrind = False
+
+zone_init_str  = """
+$origin example.com.
+$ttl 86400
+@	SOA	dns1.example.com.	hostmaster.example.com. (
+		2001062501 ; serial
+		21600      ; refresh after 6 hours
+		3600       ; retry after 1 hour
+		604800     ; expire after 1 week
+		86400 )    ; minimum TTL of 1 day
+www1 4800 IN A 133.2.3.4
+     4800 IN A 134.4.5.6
+"""
+
+def cmp_rrset(ss1, ss2):
+    set1 = set(ss1.split("\n"))
+    set2 = set(ss2.split("\n"))
+    set1 = {ele.strip(" ") for ele in set1}
+    set2 = {ele.strip(" ") for ele in set2}
+    return set1 == set2
+
+def make_zone(serial, ip):
+    return """
+$origin 666.com.
+$ttl 86400
+@	SOA	dns1.666.com.	hostmaster.666.com. (
+		%d ; serial
+		21600      ; refresh after 6 hours
+		3600       ; retry after 1 hour
+		604800     ; expire after 1 week
+		86400 )    ; minimum TTL of 1 day
+www1 4800 IN A %s
+    """ % (serial, ip)
+
+def test_catalog_init(dns_srv):
+    rrset_ss = dns_srv.admin_cmd("zone get_rrset www1.example.com A")
+    assert cmp_rrset(rrset_ss, " 4800 IN A 133.2.3.4\n 4800 IN A 134.4.5.6\n")
+
+def test_catalog_new_zone(dns_srv):
+    # no admin command, the new zone is found by polling catalog.
+    dns_srv.write_zone_to_mongo(make_zone(2001062501, "1.1.1.1"))
+    time.sleep(5)
+    rrset_ss = dns_srv.admin_cmd("zone get_rrset www1.666.com A")
+    assert cmp_rrset(rrset_ss, " 4800 IN A 1.1.1.1\n")
+
+def test_catalog_changed_zone(dns_srv):
+    # serial in catalog is not changed, so the zone is not reloaded.
+    dns_srv.write_zone_to_mongo(make_zone(2001062501, "2.2.2.2"))
+    time.sleep(5)
+    rrset_ss = dns_srv.admin_cmd("zone get_rrset www1.666.com A")
+    assert cmp_rrset(rrset_ss, " 4800 IN A 1.1.1.1\n")
+
+    dns_srv.write_zone_to_mongo(make_zone(2001062502, "3.3.3.3"))
+    time.sleep(5)
+    rrset_ss = dns_srv.admin_cmd("zone get_rrset www1.666.com A")
+    assert cmp_rrset(rrset_ss, " 4800 IN A 3.3.3.3\n")
+
+def test_catalog_removed_zone(dns_srv):
+    dns_srv.mongo_delete_zone("666.com.")
+    time.sleep(5)
+    zone_ss = dns_srv.admin_cmd("zone get 666.com")
+    assert zone_ss == "zone 666.com. not found"
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+load zones whose rdata is pre-encoded in wire format.
+"""
+from __future__ import print_function, division, absolute_import
+
+import sys
+from os.path import dirname, abspath
+import time
+import pytest
+
+sys.path.insert(0, dirname(dirname(abspath(__file__))))
+from support import constants
+
+overrides = {
+    "zone_source.type": "mongo",
+}
+valgrind = False
+mongo_wire = True
+
+zone_init_str  = """
+$origin example.com.
+$ttl 86400
+@	SOA	dns1.example.com.	hostmaster.example.com. (
+		2001062501 ; serial
+		21600      ; refresh after 6 hours
+		3600       ; retry after 1 hour
+		604800     ; expire after 1 week
+		86400 )    ; minimum TTL of 1 day
+@    IN NS dns1.example.com.
+@    IN MX 10 mail.example.com.
+www1 4800 IN A 133.2.3.4
+     4800 IN A 134.4.5.6
+www2 IN AAAA aaaa:bbbb::1
+www3 IN CNAME www1
+txt  IN TXT "hello world" "second"
+"""
+
+def cmp_rrset(ss1, ss2):
+    set1 = set(ss1.split("\n"))
+    set2 = set(ss2.split("\n"))
+    set1 = {ele.strip(" ") for ele in set1}
+    set2 = {ele.strip(" ") for ele in set2}
+    return set1 == set2
+
+def test_wire_init(dns_srv):
+    rrset_ss = dns_srv.admin_cmd("zone get_rrset example.com SOA")
+    assert cmp_rrset(rrset_ss, " 86400 IN SOA dns1.example.com. hostmaster.example.com. 2001062501 21600 3600 604800 86400\n")
+    rrset_ss = dns_srv.admin_cmd("zone get_rrset www1.example.com A")
+    assert cmp_rrset(rrset_ss, " 4800 IN A 133.2.3.4\n 4800 IN A 134.4.5.6\n")
+    rrset_ss = dns_srv.admin_cmd("zone get_rrset example.com MX")
+    assert cmp_rrset(rrset_ss, " 86400 IN MX 10 mail.example.com.\n")
+    rrset_ss = dns_srv.admin_cmd("zone get_rrset www3.example.com CNAME")
+    assert cmp_rrset(rrset_ss, " 86400 IN CNAME www1.example.com.\n")
+
+def test_wire_reload(dns_srv):
+    zone_str = """
+$origin 777.com.
+$ttl 86400
+@	SOA	dns1.777.com.	hostmaster.777.com. (
+		2001062501 ; serial
+		21600      ; refresh after 6 hours
+		3600       ; retry after 1 hour
+		604800     ; expire after 1 week
+		86400 )    ; minimum TTL of 1 day
+www1 4800 IN A 133.2.3.4
+    """
+    dns_srv.write_zone_to_mongo(zone_str)
+    print(dns_srv.admin_cmd("zone reload 777.com."))
+    time.sleep(5)
+    rrset_ss = dns_srv.admin_cmd("zone get_rrset www1.777.com A")
+    assert cmp_rrset(rrset_ss, " 4800 IN A 133.2.3.4\n")
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+zone reloading triggered by DNS NOTIFY.
+"""
+from __future__ import print_function, division, absolute_import
+
+import sys
+from os.path import dirname, abspath
+import time
+import pytest
+import dns.opcode
+import dns.rcode
+
+sys.path.insert(0, dirname(dirname(abspath(__file__))))
+from support import constants
+
+overrides = {
+    "zone_source.type": "mongo",
+    "zone_source.notify_sources": ["172.28.128.0/24"],
+}
+valgrind = False
+
+zone_init_str  = """
+$origin example.com.
+$ttl 86400
+@	SOA	dns1.example.com.	hostmaster.example.com. (
+		2001062501 ; serial
+		21600      ; refresh after 6 hours
+		3600       ; retry after 1 hour
+		604800     ; expire after 1 week
+		86400 )    ; minimum TTL of 1 day
+www1 4800 IN A 133.2.3.4
+"""
+
+def cmp_rrset(ss1, ss2):
+    set1 = set(ss1.split("\n"))
+    set2 = set(ss2.split("\n"))
+    set1 = {ele.strip(" ") for ele in set1}
+    set2 = {ele.strip(" ") for ele in set2}
+    return set1 == set2
+
+def make_zone(serial, ip):
+    return """
+$origin example.com.
+$ttl 86400
+@	SOA	dns1.example.com.	hostmaster.example.com. (
+		%d ; serial
+		21600      ; refresh after 6 hours
+		3600       ; retry after 1 hour
+		604800     ; expire after 1 week
+		86400 )    ; minimum TTL of 1 day
+www1 4800 IN A %s
+    """ % (serial, ip)
+
+@pytest.mark.parametrize("use_tcp", [False, True])
+def test_notify_reload(dns_srv, use_tcp):
+    serial = 2001062502 if not use_tcp else 2001062503
+    ip = "1.1.1.1" if not use_tcp else "2.2.2.2"
+    dns_srv.write_zone_to_mongo(make_zone(serial, ip))
+    resp = dns_srv.send_notify("example.com.", use_tcp=use_tcp)
+    assert resp.opcode() == dns.opcode.NOTIFY
+    assert resp.rcode() == dns.rcode.NOERROR
+    time.sleep(1)
+    rrset_ss = dns_srv.admin_cmd("zone get_rrset www1.example.com A")
+    assert cmp_rrset(rrset_ss, " 4800 IN A %s\n" % ip)
+
+def test_notify_coalesced(dns_srv):
+    dns_srv.write_zone_to_mongo(make_zone(2001062504, "3.3.3.3"))
+    for _ in range(10):
+        resp = dns_srv.send_notify("example.com.")
+        assert resp.rcode() == dns.rcode.NOERROR
+    time.sleep(1)
+    rrset_ss = dns_srv.admin_cmd("zone get_rrset www1.example.com A")
+    assert cmp_rrset(rrset_ss, " 4800 IN A 3.3.3.3\n")
+    assert "notify_coalesced:" in dns_srv.admin_cmd("info reload")
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+random subdomain guard, slip mode.
+"""
+from __future__ import print_function, division, absolute_import
+
+import random
+import string
+import time
+
+import dns.flags
+import dns.rcode
+
+overrides = {
+    "zone_source.type": "file",
+    "nxguard.threshold": 100,
+    "nxguard.mode": "slip",
+}
+valgrind = False
+
+
+def random_names(n):
+    chars = string.ascii_lowercase + string.digits
+    return ["%s.example.com." % "".join(random.choice(chars) for _ in range(16)) for _ in range(n)]
+
+
+def get_info(dns_srv, section):
+    res = {}
+    for line in dns_srv.admin_cmd("info %s" % section).splitlines():
+        if ":" in line and not line.startswith("#"):
+            k, v = line.split(":", 1)
+            res[k.strip()] = v.strip()
+    return res
+
+
+def zone_fields(info, idx=0):
+    return dict(item.split("=", 1) for item in info["zone%d" % idx].split(","))
+
+
+def flood_until_mitigated(dns_srv, timeout=20):
+    """
+    flood the random names of example.com. until the zone is mitigated,
+    the rate is computed by main thread cron every second.
+    """
+    names = random_names(2000)
+    deadline = time.time() + timeout
+    info = get_info(dns_srv, "nxguard")
+    while info["nxguard_mitigated_zones"] == "0" and time.time() < deadline:
+        dns_srv.udp_flood(names, 1)
+        info = get_info(dns_srv, "nxguard")
+    return info
+
+
+def test_not_mitigated(dns_srv):
+    info = get_info(dns_srv, "nxguard")
+    assert info["nxguard_threshold"] == "100" and info["nxguard_mode"] == "slip"
+    assert info["nxguard_events"] == "0" and info["nxguard_mitigated_zones"] == "0"
+    msg = dns_srv.dns_query(random_names(1)[0], "A", use_tcp=False)
+    assert msg.rcode() == dns.rcode.NXDOMAIN and not msg.flags & dns.flags.TC
+
+
+def test_slip(dns_srv):
+    info = flood_until_mitigated(dns_srv)
+    assert info["nxguard_mitigated_zones"] == "1" and int(info["nxguard_events"]) >= 1
+    fields = zone_fields(info)
+    assert fields["origin"] == "example.com." and fields["mode"] == "slip"
+    assert int(fields["nxdomain_rate"]) >= 100 and int(fields["since"]) > 0
+
+    name = random_names(1)[0]
+    msg = dns_srv.dns_query(name, "A", use_tcp=False)
+    assert msg.flags & dns.flags.TC and msg.rcode() == dns.rcode.NOERROR
+    assert len(msg.answer) == 0 and len(msg.authority) == 0
+    # the resolvers retrying over tcp are answered.
+    msg = dns_srv.dns_query(name, "A", use_tcp=True)
+    assert msg.rcode() == dns.rcode.NXDOMAIN
+    # the existing names are always answered.
+    msg = dns_srv.dns_query("test-a.example.com.", "A", use_tcp=False)
+    assert msg.rcode() == dns.rcode.NOERROR and not msg.flags & dns.flags.TC and len(msg.answer) == 1
+
+
+def test_guarded_counter(dns_srv):
+    flood_until_mitigated(dns_srv)
+    dns_srv.udp_flood(random_names(100), 1)
+    # the counters are summed by main thread cron.
+    time.sleep(1.5)
+    fields = zone_fields(get_info(dns_srv, "nxguard"))
+    assert fields["mode"] == "slip" and int(fields["guarded"]) > 0
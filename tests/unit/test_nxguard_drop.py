@@ -0,0 +1,45 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+random subdomain guard, drop mode.
+"""
+from __future__ import print_function, division, absolute_import
+
+import sys
+from os.path import dirname, abspath
+
+import dns.exception
+import dns.message
+import dns.query
+import dns.rcode
+import pytest
+
+sys.path.insert(0, dirname(abspath(__file__)))
+from test_nxguard import random_names, get_info, zone_fields, flood_until_mitigated
+
+overrides = {
+    "zone_source.type": "file",
+    "nxguard.threshold": 100,
+    "nxguard.mode": "drop",
+}
+valgrind = False
+
+
+def test_drop(dns_srv):
+    info = flood_until_mitigated(dns_srv)
+    assert info["nxguard_mitigated_zones"] == "1"
+    assert zone_fields(info)["mode"] == "drop"
+
+    # the random labels are dropped.
+    q = dns.message.make_query(random_names(1)[0], "A")
+    with pytest.raises(dns.exception.Timeout):
+        dns.query.udp(q, dns_srv.dns_host[0], port=dns_srv.dns_port, timeout=1)
+    # the labels don't look random are answered.
+    msg = dns_srv.dns_query("mailserver.example.com.", "A", use_tcp=False)
+    assert msg.rcode() == dns.rcode.NXDOMAIN
+    msg = dns_srv.dns_query("test-a.example.com.", "A", use_tcp=False)
+    assert msg.rcode() == dns.rcode.NOERROR and len(msg.answer) == 1
+    # tcp clients can't spoof addresses.
+    msg = dns_srv.dns_query(random_names(1)[0], "A", use_tcp=True)
+    assert msg.rcode() == dns.rcode.NXDOMAIN
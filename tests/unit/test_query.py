@@ -11,6 +11,8 @@ import socket
 import struct
 
 import pytest
+import dns.rcode
+import dns.rdatatype
 from clientsubnetoption import ClientSubnetOption
 import clientsubnetoption
 
@@ -205,3 +207,28 @@ def test_edns(dns_srv):
             assert option.mask == mask
             # assert option.
     assert nb_ecs == 1
+
+
+def test_query_nxdomain(dns_srv):
+    msg = dns_srv.dns_query("nonexistent.example.com.", "A")
+    assert msg.rcode() == dns.rcode.NXDOMAIN
+    assert len(msg.answer) == 0 and len(msg.authority) == 1
+    soa = msg.authority[0]
+    assert str(soa.name) == "example.com." and soa.rdtype == dns.rdatatype.SOA
+    # min(SOA TTL, SOA MINIMUM)
+    assert soa.ttl == 86400
+
+
+def test_query_nodata(dns_srv):
+    msg = dns_srv.dns_query("test-a.example.com.", "MX")
+    assert msg.rcode() == dns.rcode.NOERROR
+    assert len(msg.answer) == 0 and len(msg.authority) == 1
+    assert msg.authority[0].rdtype == dns.rdatatype.SOA
+
+
+def test_query_empty_non_terminal(dns_srv):
+    for name in ("sub.example.com.", "_tcp.example.com.", "SUB.example.com."):
+        msg = dns_srv.dns_query(name, "A")
+        assert msg.rcode() == dns.rcode.NOERROR
+        assert len(msg.answer) == 0 and len(msg.authority) == 1
+        assert msg.authority[0].rdtype == dns.rdatatype.SOA
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+GeoDNS views selected by EDNS client subnet.
+"""
+from __future__ import print_function, division, absolute_import
+
+import sys
+from os.path import dirname, abspath
+
+import dns.rcode
+from clientsubnetoption import ClientSubnetOption
+
+sys.path.insert(0, dirname(dirname(abspath(__file__))))
+from support import constants
+
+overrides = {
+    "zone_source.type": "file",
+    "zone_source.file.files": [{"name": "example.com.", "file": "tests/assets/view_example.z"}],
+    "core.views_file": "/shuke/tests/assets/views.txt",
+}
+valgrind = False
+
+
+def query(dns_srv, name, cip, bits):
+    msg = dns_srv.dns_query(name, "A", use_tcp=False, edns_options=[ClientSubnetOption(ip=cip, bits=bits)])
+    rdata = {item.to_text() for rrset in msg.answer for item in rrset.items}
+    scopes = [opt.scope for opt in msg.options if isinstance(opt, ClientSubnetOption)]
+    return msg, rdata, scopes[0] if scopes else None
+
+
+def test_view_by_ecs(dns_srv):
+    _, rdata, scope = query(dns_srv, "www.example.com.", "1.2.3.4", 24)
+    assert rdata == {"10.1.0.1", "10.1.0.2"} and scope == 24
+    _, rdata, scope = query(dns_srv, "www.example.com.", "8.8.8.0", 24)
+    assert rdata == {"10.2.0.1"} and scope == 16
+    _, rdata, scope = query(dns_srv, "www.example.com.", "2001:db8::", 56)
+    assert rdata == {"10.1.0.1", "10.1.0.2"} and scope == 32
+
+
+def test_default_view(dns_srv):
+    # no prefix matches, the answer is valid for the whole source prefix.
+    _, rdata, scope = query(dns_srv, "www.example.com.", "9.9.9.0", 24)
+    assert rdata == {"10.0.0.1"} and scope == 24
+    # the name doesn't vary with views.
+    _, rdata, scope = query(dns_srv, "mail.example.com.", "1.2.3.4", 24)
+    assert rdata == {"10.0.0.2"} and scope == 0
+    _, rdata, _ = query(dns_srv, "ftp.example.com.", "1.2.3.4", 24)
+    assert rdata == {"10.0.0.3"}
+
+
+def test_name_only_in_view(dns_srv):
+    _, rdata, _ = query(dns_srv, "cn-only.example.com.", "1.2.3.4", 24)
+    assert rdata == {"10.1.0.3"}
+    msg, _, _ = query(dns_srv, "cn-only.example.com.", "8.8.8.0", 24)
+    assert msg.rcode() == dns.rcode.NXDOMAIN
+
+
+def test_view_admin(dns_srv):
+    assert dns_srv.admin_cmd("view lookup 1.2.3.9") == "cn/24"
+    assert dns_srv.admin_cmd("view lookup 9.9.9.9") == "default"
+    assert "view us: 1 prefixes" in dns_srv.admin_cmd("view list")
+    assert dns_srv.admin_cmd("view reload") == "OK"
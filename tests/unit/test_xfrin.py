@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+secondary mode: the zones are transferred from the primary by AXFR or IXFR.
+"""
+from __future__ import print_function, division, absolute_import
+
+import sys
+from os.path import dirname, abspath
+import time
+import pytest
+import dns.rcode
+
+sys.path.insert(0, dirname(dirname(abspath(__file__))))
+from support import constants
+
+overrides = {
+    "zone_source.type": "xfr",
+    "zone_source.xfr.zones": ["example.com."],
+    "zone_source.notify_sources": ["172.28.128.0/24"],
+}
+valgrind = False
+
+
+def make_zone(serial, ip, extra=""):
+    return """
+$origin example.com.
+$ttl 86400
+@	SOA	dns1.example.com.	hostmaster.example.com. (
+		%d ; serial
+		21600      ; refresh after 6 hours
+		3600       ; retry after 1 hour
+		604800     ; expire after 1 week
+		86400 )    ; minimum TTL of 1 day
+@ IN NS dns1.example.com.
+dns1 IN A 10.0.1.1
+www1 4800 IN A %s
+mail IN MX 10 mx1.example.com.
+%s
+""" % (serial, ip, extra)
+
+zone_init_str = make_zone(2001062501, "133.2.3.4")
+
+
+def cmp_rrset(ss1, ss2):
+    set1 = set(ss1.split("\n"))
+    set2 = set(ss2.split("\n"))
+    set1 = {ele.strip(" ") for ele in set1}
+    set2 = {ele.strip(" ") for ele in set2}
+    return set1 == set2
+
+
+def test_axfr(dns_srv):
+    rrset_ss = dns_srv.admin_cmd("zone get_rrset www1.example.com A")
+    assert cmp_rrset(rrset_ss, " 4800 IN A 133.2.3.4\n")
+    resp = dns_srv.dns_query("mail.example.com.", "MX")
+    assert str(resp.answer[0][0]) == "10 mx1.example.com."
+    assert "AXFR" in dns_srv.primary.queries
+
+
+def test_ixfr(dns_srv):
+    dns_srv.write_zone_to_primary(make_zone(2001062502, "1.1.1.1", "www2 IN A 2.2.2.2"))
+    resp = dns_srv.send_notify("example.com.")
+    assert resp.rcode() == dns.rcode.NOERROR
+    time.sleep(1)
+    assert "IXFR" in dns_srv.primary.queries
+    rrset_ss = dns_srv.admin_cmd("zone get_rrset www1.example.com A")
+    assert cmp_rrset(rrset_ss, " 4800 IN A 1.1.1.1\n")
+    rrset_ss = dns_srv.admin_cmd("zone get_rrset www2.example.com A")
+    assert cmp_rrset(rrset_ss, " 86400 IN A 2.2.2.2\n")
+    # the records not changed are kept
+    resp = dns_srv.dns_query("mail.example.com.", "MX")
+    assert str(resp.answer[0][0]) == "10 mx1.example.com."
+    resp = dns_srv.dns_query("example.com.", "SOA")
+    assert resp.answer[0][0].serial == 2001062502
+    assert "xfrin_ixfr:1" in dns_srv.admin_cmd("info reload").replace(" ", "")
+
+
+def test_ixfr_delete(dns_srv):
+    dns_srv.write_zone_to_primary(make_zone(2001062503, "1.1.1.1"))
+    dns_srv.send_notify("example.com.")
+    time.sleep(1)
+    resp = dns_srv.dns_query("www2.example.com.", "A")
+    assert resp.rcode() == dns.rcode.NXDOMAIN
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+outbound zone transfer: the zones in memory are served by AXFR or IXFR.
+"""
+from __future__ import print_function, division, absolute_import
+
+import sys
+from os.path import dirname, abspath
+import time
+import pytest
+import dns.rcode
+import dns.rdatatype
+
+sys.path.insert(0, dirname(dirname(abspath(__file__))))
+from support import constants
+
+overrides = {
+    "zone_source.type": "mongo",
+    "zone_source.notify_sources": ["172.28.128.0/24"],
+    "xfr_out.allow": ["172.28.128.0/24"],
+}
+valgrind = False
+
+
+def make_zone(serial, ip):
+    return """
+$origin example.com.
+$ttl 86400
+@	SOA	dns1.example.com.	hostmaster.example.com. (
+		%d ; serial
+		21600      ; refresh after 6 hours
+		3600       ; retry after 1 hour
+		604800     ; expire after 1 week
+		86400 )    ; minimum TTL of 1 day
+@ IN NS dns1.example.com.
+dns1 IN A 10.0.1.1
+www1 4800 IN A %s
+""" % (serial, ip)
+
+zone_init_str = make_zone(2001062501, "133.2.3.4")
+
+
+def answers(msgs):
+    return [rrset for m in msgs for rrset in m.answer]
+
+
+def test_axfr(dns_srv):
+    rrsets = answers(dns_srv.zone_transfer("example.com."))
+    assert rrsets[0].rdtype == dns.rdatatype.SOA
+    assert rrsets[-1].rdtype == dns.rdatatype.SOA
+    body = {(str(rrset.name), rrset.rdtype): rrset for rrset in rrsets[1:-1]}
+    assert str(body[("www1.example.com.", dns.rdatatype.A)][0]) == "133.2.3.4"
+    assert ("dns1.example.com.", dns.rdatatype.A) in body
+
+
+def test_ixfr(dns_srv):
+    dns_srv.write_zone_to_mongo(make_zone(2001062502, "1.1.1.1"))
+    dns_srv.send_notify("example.com.")
+    time.sleep(1)
+    rrs = [rr for rrset in answers(dns_srv.zone_transfer("example.com.", "IXFR", 2001062501))
+           for rr in rrset]
+    # new SOA, old SOA, deleted RRs, new SOA, added RRs, new SOA
+    assert [rr.serial for rr in rrs if rr.rdtype == dns.rdatatype.SOA] == \
+        [2001062502, 2001062501, 2001062502, 2001062502]
+    assert [str(rr) for rr in rrs if rr.rdtype == dns.rdatatype.A] == ["133.2.3.4", "1.1.1.1"]
+    assert "xfrout_ixfr:1" in dns_srv.admin_cmd("info stats").replace(" ", "")
+
+    # up to date
+    rrsets = answers(dns_srv.zone_transfer("example.com.", "IXFR", 2001062502))
+    assert len(rrsets) == 1 and rrsets[0][0].serial == 2001062502
+
+
+def test_notauth(dns_srv):
+    with pytest.raises(Exception):
+        dns_srv.zone_transfer("example.org.")
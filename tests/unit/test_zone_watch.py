@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+
+"""
+zone files watched by inotify.
+"""
+from __future__ import print_function, division, absolute_import
+
+import sys
+from os.path import dirname, abspath
+import time
+
+sys.path.insert(0, dirname(dirname(abspath(__file__))))
+from support import constants
+
+overrides = {
+    "zone_source.type": "file",
+    "zone_source.file.zone_files_root": "/tmp/shuke_watch",
+    "zone_source.file.files": [{"name": "example.com.", "file": "example.com.z"}],
+    "zone_source.file.watch": True,
+    "zone_source.file.watch_debounce": 100,
+}
+valgrind = False
+
+
+def make_zone(serial, ip):
+    return """
+$origin example.com.
+$ttl 86400
+@	SOA	dns1.example.com.	hostmaster.example.com. (
+		%d ; serial
+		21600      ; refresh after 6 hours
+		3600       ; retry after 1 hour
+		604800     ; expire after 1 week
+		86400 )    ; minimum TTL of 1 day
+	NS	dns1.example.com.
+dns1	A	10.0.1.1
+www1 4800 IN A %s
+""" % (serial, ip)
+
+zone_files = {"example.com.z": make_zone(2001062501, "1.1.1.1")}
+
+
+def get_info(dns_srv, section):
+    res = {}
+    for line in dns_srv.admin_cmd("info %s" % section).splitlines():
+        if ":" in line and not line.startswith("#"):
+            k, v = line.split(":", 1)
+            res[k.strip()] = v.strip()
+    return res
+
+
+def www1_addrs(dns_srv):
+    msg = dns_srv.dns_query("www1.example.com.", "A", use_tcp=False)
+    return {item.to_text() for rrset in msg.answer for item in rrset.items}
+
+
+def wait_for(cond, timeout=5):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        if cond():
+            return True
+        time.sleep(0.2)
+    return cond()
+
+
+def test_changed_file_reloaded(dns_srv):
+    assert www1_addrs(dns_srv) == {"1.1.1.1"}
+    done = int(get_info(dns_srv, "reload")["reload_done"])
+
+    dns_srv.write_zone_file("example.com.z", make_zone(2001062502, "2.2.2.2"))
+    assert wait_for(lambda: www1_addrs(dns_srv) == {"2.2.2.2"})
+    info = get_info(dns_srv, "reload")
+    assert int(info["reload_done"]) > done
+    assert int(info["watch_reloads"]) >= 1
+
+
+def test_unchanged_file_skipped(dns_srv):
+    zone_ss = make_zone(2001062503, "3.3.3.3")
+    dns_srv.write_zone_file("example.com.z", zone_ss)
+    assert wait_for(lambda: www1_addrs(dns_srv) == {"3.3.3.3"})
+    info = get_info(dns_srv, "reload")
+    done, unchanged = int(info["reload_done"]), int(info["reload_unchanged"])
+
+    # the same content in a new file(new inode and mtime), the serial and hash are checked, it is not parsed.
+    dns_srv.write_zone_file("example.com.z", zone_ss)
+    assert wait_for(lambda: int(get_info(dns_srv, "reload")["reload_unchanged"]) > unchanged)
+    assert int(get_info(dns_srv, "reload")["reload_done"]) == done
+    assert www1_addrs(dns_srv) == {"3.3.3.3"}
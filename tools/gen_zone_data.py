@@ -98,6 +98,7 @@ def parse_cmd_args():
     parser.add_argument('-Ns', '--num-subdomains', default=100, type=int, help="number of sumdomain per zone")
     parser.add_argument('-Mh', '--mongo_host', default="127.0.0.1", help='mongodb host(default: 127.0.0.1)')
     parser.add_argument('-Mp', '--mongo_port', default=27017, type=int, help='mongodb port(default: 27017)')
+    parser.add_argument('-q', '--query-file', default=None, help='also write the names to a query file of tools/loadgen')
     return parser.parse_args()
 
 
@@ -121,9 +122,13 @@ def gen_zone_data(parsed):
     print(len(total_zone_list), len(total_subdomain_list), len(zone_list))
     # print(zone_list)
     zm.del_db()
+    qf = open(parsed.query_file, "w") if parsed.query_file else None
     for idx, zname in enumerate(zone_list):
         subdomains = random.sample(total_subdomain_list, num_domains)
         dot_origin, rr_list = gen_a_zone(zname, subdomains)
+        if qf:
+            for rr in rr_list:
+                qf.write("%s %s\n" % (to_abs_domain(rr["name"], dot_origin), rr["type"]))
         try:
             zm.write_to_mongo(dot_origin, rr_list)
         except BulkWriteError as bwe:
@@ -132,6 +137,8 @@ def gen_zone_data(parsed):
             raise
 
         print("add zone: ", idx, zname)
+    if qf:
+        qf.close()
 
 
 if __name__ == '__main__':
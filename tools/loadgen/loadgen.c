@@ -0,0 +1,754 @@
+//
+// a standalone dns load generator.
+//
+// it sends udp queries through an AF_PACKET socket, so it works on a veth pair,
+// a loopback or a real NIC without MoonGen. the qnames are read from a query file
+// (`name [type]` per line, `tools/gen_zone_data.py -q` writes one), and every query
+// is drawn from a mix of zipf, uniform and nxdomain(random label under the zone of
+// a random name) distributions. the responses are matched to the queries by
+// (source port, xid), the tool reports response rate, rcode mix and a latency histogram.
+//
+// build: make -C tools/loadgen
+//
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#define MAX_DOMAIN_LEN  255
+#define MAX_FRAME_LEN   512
+#define BATCH_SIZE      64
+#define NR_RCODES       16
+// latency histogram: 1us resolution below 32us, then 16 buckets per power of 2.
+#define HIST_LINEAR     32
+#define HIST_SUB_BITS   4
+#define HIST_BUCKETS    (HIST_LINEAR + 40 * (1 << HIST_SUB_BITS))
+
+#define ETH_HDR_LEN     14
+#define IPV4_HDR_LEN    20
+#define UDP_HDR_LEN     8
+#define DNS_HDR_LEN     12
+
+enum {
+    DIST_ZIPF = 0,
+    DIST_UNIFORM,
+    DIST_NXDOMAIN,
+    NR_DISTS,
+};
+
+static const char *distNames[NR_DISTS] = {"zipf", "uniform", "nxdomain"};
+
+typedef struct {
+    uint8_t name[MAX_DOMAIN_LEN+1];   // len label
+    uint16_t nameLen;                 // including the terminating zero
+    // offset of the parent zone in name, the nxdomain queries replace the first label.
+    uint16_t parentOffset;
+    uint16_t qType;
+} query;
+
+static struct {
+    char *ifname;
+    int ifindex;
+    uint8_t srcMac[ETH_ALEN];
+    uint8_t dstMac[ETH_ALEN];
+    struct in_addr srcIp;
+    struct in_addr dstIp;
+    uint16_t dstPort;
+    uint16_t srcPortBase;
+    int nrSrcPorts;
+
+    char *queryFile;
+    query *queries;
+    int nrQueries;
+    double zipfS;
+    double *zipfCdf;
+    int weights[NR_DISTS];
+    int totalWeight;
+
+    int ednsSize;               // 0 means no OPT RR
+    bool dnssecOk;
+    bool ecsSet;
+    uint8_t ecsAddr[4];
+    int ecsPrefix;
+
+    long rate;                  // queries per second, 0 means as fast as possible
+    int duration;               // seconds
+    int timeoutMs;
+    bool histogram;
+
+    // send timestamp(ns) of the outstanding query, indexed by (source port index, xid), 0 means free.
+    uint64_t *inflight;
+
+    volatile bool stop;
+    volatile bool recvStop;
+
+    // written by the sender
+    uint64_t sent;
+    uint64_t sendErrors;
+    uint64_t timeouts;
+    uint64_t sentByDist[NR_DISTS];
+    // written by the receiver
+    uint64_t received;
+    uint64_t unmatched;
+    uint64_t rcodes[NR_RCODES];
+    uint64_t hist[HIST_BUCKETS];
+    uint64_t maxLatencyUs;
+} lg;
+
+static const char *rcodeNames[NR_RCODES] = {
+    "NOERROR", "FORMERR", "SERVFAIL", "NXDOMAIN", "NOTIMP", "REFUSED", "YXDOMAIN", "YXRRSET",
+    "NXRRSET", "NOTAUTH", "NOTZONE", "RCODE11", "RCODE12", "RCODE13", "RCODE14", "RCODE15",
+};
+
+static uint64_t nstime(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t xorshift64(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static void die(const char *fmt, ...) __attribute__((format(printf, 1, 2), noreturn));
+
+static void die(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    exit(1);
+}
+
+/*----------------------------------------------
+ *     query set
+ *---------------------------------------------*/
+static int strToQtype(const char *ss) {
+    static const struct {
+        const char *name;
+        int type;
+    } types[] = {
+        {"A", 1}, {"NS", 2}, {"CNAME", 5}, {"SOA", 6}, {"PTR", 12}, {"MX", 15},
+        {"TXT", 16}, {"AAAA", 28}, {"SRV", 33}, {"ANY", 255},
+    };
+    for (size_t i = 0; i < sizeof(types)/sizeof(types[0]); ++i) {
+        if (strcasecmp(ss, types[i].name) == 0) return types[i].type;
+    }
+    if (strncasecmp(ss, "TYPE", 4) == 0) return atoi(ss+4);
+    return -1;
+}
+
+/*
+ * convert a dot name to len label, return the length(including the terminating zero) or -1.
+ */
+static int dot2lenlabel(const char *dot, uint8_t *buf, uint16_t *parentOffset) {
+    size_t n = strlen(dot);
+    int pos = 0;
+
+    if (n > 0 && dot[n-1] == '.') n--;
+    *parentOffset = 0;
+    for (size_t start = 0; start < n; ) {
+        const char *end = memchr(dot + start, '.', n - start);
+        size_t len = end? (size_t)(end - dot - start): n - start;
+        if (len == 0 || len > 63 || pos + len + 2 > MAX_DOMAIN_LEN) return -1;
+        if (pos == 0) *parentOffset = (uint16_t)(len + 1);
+        buf[pos++] = (uint8_t)len;
+        memcpy(buf + pos, dot + start, len);
+        pos += len;
+        start += len + 1;
+    }
+    buf[pos++] = 0;
+    if (*parentOffset >= pos) *parentOffset = (uint16_t)(pos - 1);
+    return pos;
+}
+
+static void loadQueries(const char *fname) {
+    FILE *fp = fopen(fname, "r");
+    char line[1024];
+    int cap = 1024;
+
+    if (fp == NULL) die("can't open %s: %s", fname, strerror(errno));
+    lg.queries = malloc(sizeof(query) * cap);
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char *name, *type, *saveptr = NULL;
+        query *q;
+        int len, qtype = 1;
+
+        name = strtok_r(line, " \t\r\n", &saveptr);
+        if (name == NULL || name[0] == '#' || name[0] == ';') continue;
+        type = strtok_r(NULL, " \t\r\n", &saveptr);
+        if (type != NULL && (qtype = strToQtype(type)) <= 0) {
+            die("invalid type %s of %s in %s", type, name, fname);
+        }
+        if (lg.nrQueries == cap) {
+            cap *= 2;
+            lg.queries = realloc(lg.queries, sizeof(query) * cap);
+        }
+        q = &lg.queries[lg.nrQueries];
+        if ((len = dot2lenlabel(name, q->name, &q->parentOffset)) < 0) {
+            die("invalid name %s in %s", name, fname);
+        }
+        q->nameLen = (uint16_t)len;
+        q->qType = (uint16_t)qtype;
+        lg.nrQueries++;
+    }
+    fclose(fp);
+    if (lg.nrQueries == 0) die("no query in %s", fname);
+}
+
+/*
+ * the names are ranked by their order in the query file, the cdf is
+ * searched by binary search, so sampling is O(log n).
+ */
+static void initZipf(void) {
+    double sum = 0;
+
+    lg.zipfCdf = malloc(sizeof(double) * lg.nrQueries);
+    for (int i = 0; i < lg.nrQueries; ++i) {
+        sum += 1.0 / pow(i + 1, lg.zipfS);
+        lg.zipfCdf[i] = sum;
+    }
+    for (int i = 0; i < lg.nrQueries; ++i) lg.zipfCdf[i] /= sum;
+}
+
+static inline int sampleZipf(uint64_t *rnd) {
+    double u = (double)(xorshift64(rnd) >> 11) / (double)(1ULL << 53);
+    int lo = 0, hi = lg.nrQueries - 1;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (lg.zipfCdf[mid] < u) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void parseMix(char *ss) {
+    char *tok, *saveptr = NULL;
+
+    memset(lg.weights, 0, sizeof(lg.weights));
+    for (tok = strtok_r(ss, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+        char *eq = strchr(tok, '=');
+        int i;
+        if (eq == NULL) die("invalid mix %s, should be like zipf=80,uniform=10,nxdomain=10", tok);
+        *eq = 0;
+        for (i = 0; i < NR_DISTS; ++i) {
+            if (strcasecmp(tok, distNames[i]) == 0) break;
+        }
+        if (i == NR_DISTS) die("unknown distribution %s", tok);
+        lg.weights[i] = atoi(eq + 1);
+        if (lg.weights[i] < 0) die("weight of %s should not be negative", tok);
+    }
+}
+
+/*----------------------------------------------
+ *     packet construction
+ *---------------------------------------------*/
+static uint16_t ipv4Cksum(const uint8_t *hdr) {
+    uint32_t sum = 0;
+    for (int i = 0; i < IPV4_HDR_LEN; i += 2) sum += (uint32_t)(hdr[i] << 8 | hdr[i+1]);
+    while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+static inline uint8_t *put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+    return p + 2;
+}
+
+/*
+ * build a query frame, return its length.
+ */
+static int buildFrame(uint8_t *frame, const query *q, int dist, uint16_t srcPort,
+                      uint16_t xid, uint64_t *rnd) {
+    uint8_t *ip = frame + ETH_HDR_LEN;
+    uint8_t *udp = ip + IPV4_HDR_LEN;
+    uint8_t *dns = udp + UDP_HDR_LEN;
+    uint8_t *p = dns;
+    int dnsLen, ipLen;
+
+    memcpy(frame, lg.dstMac, ETH_ALEN);
+    memcpy(frame + ETH_ALEN, lg.srcMac, ETH_ALEN);
+    put16(frame + 2 * ETH_ALEN, ETH_P_IP);
+
+    p = put16(p, xid);
+    p = put16(p, 0x0100);                       // RD
+    p = put16(p, 1);                            // QDCOUNT
+    p = put16(p, 0);
+    p = put16(p, 0);
+    p = put16(p, lg.ednsSize > 0? 1: 0);        // ARCOUNT
+    if (dist == DIST_NXDOMAIN) {
+        static const char hex[] = "0123456789abcdef";
+        uint64_t r = xorshift64(rnd);
+        *p++ = 12;
+        for (int i = 0; i < 12; ++i, r >>= 4) *p++ = (uint8_t)hex[r & 0xf];
+        memcpy(p, q->name + q->parentOffset, q->nameLen - q->parentOffset);
+        p += q->nameLen - q->parentOffset;
+    } else {
+        memcpy(p, q->name, q->nameLen);
+        p += q->nameLen;
+    }
+    p = put16(p, q->qType);
+    p = put16(p, 1);                            // IN
+    if (lg.ednsSize > 0) {
+        int addrLen = (lg.ecsPrefix + 7) / 8;
+        *p++ = 0;
+        p = put16(p, 41);
+        p = put16(p, (uint16_t)lg.ednsSize);
+        p = put16(p, 0);                        // extended rcode and version
+        p = put16(p, lg.dnssecOk? 0x8000: 0);
+        if (lg.ecsSet) {
+            p = put16(p, (uint16_t)(8 + addrLen));
+            p = put16(p, 8);                    // EDNS CLIENT SUBNET
+            p = put16(p, (uint16_t)(4 + addrLen));
+            p = put16(p, 1);                    // ipv4
+            *p++ = (uint8_t)lg.ecsPrefix;
+            *p++ = 0;
+            memcpy(p, lg.ecsAddr, addrLen);
+            p += addrLen;
+        } else {
+            p = put16(p, 0);
+        }
+    }
+    dnsLen = (int)(p - dns);
+    ipLen = IPV4_HDR_LEN + UDP_HDR_LEN + dnsLen;
+
+    ip[0] = 0x45;
+    ip[1] = 0;
+    put16(ip + 2, (uint16_t)ipLen);
+    put16(ip + 4, xid);
+    put16(ip + 6, 0x4000);                      // DF
+    ip[8] = 64;
+    ip[9] = IPPROTO_UDP;
+    put16(ip + 10, 0);
+    memcpy(ip + 12, &lg.srcIp, 4);
+    memcpy(ip + 16, &lg.dstIp, 4);
+    put16(ip + 10, ipv4Cksum(ip));
+
+    put16(udp, srcPort);
+    put16(udp + 2, lg.dstPort);
+    put16(udp + 4, (uint16_t)(UDP_HDR_LEN + dnsLen));
+    put16(udp + 6, 0);                          // no checksum
+    return ETH_HDR_LEN + ipLen;
+}
+
+/*----------------------------------------------
+ *     receiver
+ *---------------------------------------------*/
+static inline void histAdd(uint64_t us) {
+    int idx;
+
+    if (us < HIST_LINEAR) {
+        idx = (int)us;
+    } else {
+        int e = 63 - __builtin_clzll(us);
+        idx = HIST_LINEAR + (e - 5) * (1 << HIST_SUB_BITS) +
+              (int)((us >> (e - HIST_SUB_BITS)) & ((1 << HIST_SUB_BITS) - 1));
+        if (idx >= HIST_BUCKETS) idx = HIST_BUCKETS - 1;
+    }
+    lg.hist[idx]++;
+    if (us > lg.maxLatencyUs) lg.maxLatencyUs = us;
+}
+
+// the upper bound(exclusive) of a bucket in microseconds.
+static uint64_t histBucketUpper(int idx) {
+    if (idx < HIST_LINEAR) return (uint64_t)idx + 1;
+    idx -= HIST_LINEAR;
+    int e = idx / (1 << HIST_SUB_BITS) + 5;
+    uint64_t sub = (uint64_t)(idx % (1 << HIST_SUB_BITS));
+    return ((1ULL << HIST_SUB_BITS) + sub + 1) << (e - HIST_SUB_BITS);
+}
+
+static void handleResponse(const uint8_t *frame, size_t len) {
+    const uint8_t *ip, *udp, *dns;
+    size_t ihl;
+    uint16_t dport, xid;
+    int portIdx;
+    uint64_t ts, now;
+
+    if (len < ETH_HDR_LEN + IPV4_HDR_LEN + UDP_HDR_LEN + DNS_HDR_LEN) return;
+    if (frame[12] != 0x08 || frame[13] != 0x00) return;
+    ip = frame + ETH_HDR_LEN;
+    ihl = (size_t)(ip[0] & 0xf) * 4;
+    if (ip[9] != IPPROTO_UDP || memcmp(ip + 16, &lg.srcIp, 4) != 0) return;
+    if (len < ETH_HDR_LEN + ihl + UDP_HDR_LEN + DNS_HDR_LEN) return;
+    udp = ip + ihl;
+    if ((uint16_t)(udp[0] << 8 | udp[1]) != lg.dstPort) return;
+    dport = (uint16_t)(udp[2] << 8 | udp[3]);
+    portIdx = (int)dport - (int)lg.srcPortBase;
+    if (portIdx < 0 || portIdx >= lg.nrSrcPorts) return;
+    dns = udp + UDP_HDR_LEN;
+    if ((dns[2] & 0x80) == 0) return;           // not a response
+
+    xid = (uint16_t)(dns[0] << 8 | dns[1]);
+    ts = __atomic_exchange_n(&lg.inflight[(portIdx << 16) | xid], 0, __ATOMIC_ACQ_REL);
+    if (ts == 0) {
+        lg.unmatched++;
+        return;
+    }
+    now = nstime();
+    lg.received++;
+    lg.rcodes[dns[3] & 0xf]++;
+    histAdd(now > ts? (now - ts) / 1000: 0);
+}
+
+static void *receiverMain(void *arg) {
+    int fd = *(int *)arg;
+    uint8_t bufs[BATCH_SIZE][MAX_FRAME_LEN];
+    struct iovec iovs[BATCH_SIZE];
+    struct sockaddr_ll addrs[BATCH_SIZE];
+    struct mmsghdr msgs[BATCH_SIZE];
+    struct timeval tv = {0, 100000};
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+        iovs[i].iov_base = bufs[i];
+        iovs[i].iov_len = MAX_FRAME_LEN;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+    }
+    while (!lg.recvStop) {
+        int n = recvmmsg(fd, msgs, BATCH_SIZE, MSG_WAITFORONE, NULL);
+        if (n <= 0) continue;
+        for (int i = 0; i < n; ++i) {
+            // the queries sent on the same interface are looped back to us.
+            if (addrs[i].sll_pkttype != PACKET_OUTGOING) {
+                handleResponse(bufs[i], msgs[i].msg_len);
+            }
+            msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        }
+    }
+    return NULL;
+}
+
+/*----------------------------------------------
+ *     sender
+ *---------------------------------------------*/
+static int pickDist(uint64_t *rnd) {
+    int r = (int)(xorshift64(rnd) % (uint64_t)lg.totalWeight);
+    for (int i = 0; i < NR_DISTS; ++i) {
+        if (r < lg.weights[i]) return i;
+        r -= lg.weights[i];
+    }
+    return DIST_UNIFORM;
+}
+
+static void sendLoop(int fd) {
+    static uint8_t frames[BATCH_SIZE][MAX_FRAME_LEN];
+    struct iovec iovs[BATCH_SIZE];
+    struct mmsghdr msgs[BATCH_SIZE];
+    struct sockaddr_ll addr;
+    uint16_t *nextXid = calloc((size_t)lg.nrSrcPorts, sizeof(uint16_t));
+    uint64_t rnd = nstime() | 1;
+    uint64_t start = nstime(), end = start + (uint64_t)lg.duration * 1000000000ULL;
+    uint64_t timeoutNs = (uint64_t)lg.timeoutMs * 1000000ULL;
+    uint64_t lastReport = start, lastSent = 0, lastReceived = 0;
+    int portIdx = 0;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_ifindex = lg.ifindex;
+    addr.sll_halen = ETH_ALEN;
+    memcpy(addr.sll_addr, lg.dstMac, ETH_ALEN);
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+        iovs[i].iov_base = frames[i];
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(addr);
+    }
+
+    while (!lg.stop) {
+        uint64_t now = nstime();
+        uint64_t budget = BATCH_SIZE;
+        int n = 0, sent;
+
+        if (now >= end) break;
+        if (now - lastReport >= 1000000000ULL) {
+            uint64_t received = __atomic_load_n(&lg.received, __ATOMIC_RELAXED);
+            printf("[%3ds] sent %lu qps, received %lu rps\n", (int)((now - start) / 1000000000ULL),
+                   lg.sent - lastSent, received - lastReceived);
+            fflush(stdout);
+            lastSent = lg.sent;
+            lastReceived = received;
+            lastReport = now;
+        }
+        if (lg.rate > 0) {
+            uint64_t due = (uint64_t)((double)(now - start) * (double)lg.rate / 1e9);
+            if (due <= lg.sent) {
+                struct timespec ts = {0, 20000};
+                nanosleep(&ts, NULL);
+                continue;
+            }
+            if (due - lg.sent < budget) budget = due - lg.sent;
+        }
+        for (; n < (int)budget; ++n) {
+            int dist = pickDist(&rnd);
+            int qi = dist == DIST_ZIPF? sampleZipf(&rnd): (int)(xorshift64(&rnd) % (uint64_t)lg.nrQueries);
+            uint16_t xid = nextXid[portIdx]++;
+            uint64_t *slot = &lg.inflight[(portIdx << 16) | xid];
+            uint64_t prev;
+
+            iovs[n].iov_len = (size_t)buildFrame(frames[n], &lg.queries[qi], dist,
+                                                 (uint16_t)(lg.srcPortBase + portIdx), xid, &rnd);
+            // the slot is reused after 65536 queries of the port, a query still in it is lost.
+            prev = __atomic_exchange_n(slot, now, __ATOMIC_ACQ_REL);
+            if (prev != 0 && now - prev >= timeoutNs) lg.timeouts++;
+            lg.sentByDist[dist]++;
+            if (++portIdx == lg.nrSrcPorts) portIdx = 0;
+        }
+        sent = sendmmsg(fd, msgs, (unsigned)n, 0);
+        if (sent < 0) sent = 0;
+        lg.sendErrors += (uint64_t)(n - sent);
+        lg.sent += (uint64_t)n;
+    }
+    free(nextXid);
+}
+
+/*----------------------------------------------
+ *     report
+ *---------------------------------------------*/
+static uint64_t percentile(uint64_t total, double p) {
+    uint64_t target = (uint64_t)ceil((double)total * p), acc = 0;
+
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        acc += lg.hist[i];
+        if (acc >= target && acc > 0) return histBucketUpper(i);
+    }
+    return 0;
+}
+
+static void report(double elapsed) {
+    uint64_t lost = 0;
+
+    for (size_t i = 0; i < ((size_t)lg.nrSrcPorts << 16); ++i) {
+        if (lg.inflight[i] != 0) lost++;
+    }
+    printf("\n# summary\n");
+    printf("duration: %.2fs\n", elapsed);
+    printf("sent: %lu(%.0f qps), send errors: %lu\n", lg.sent, lg.sent / elapsed, lg.sendErrors);
+    for (int i = 0; i < NR_DISTS; ++i) {
+        if (lg.weights[i] > 0) printf("  %s: %lu\n", distNames[i], lg.sentByDist[i]);
+    }
+    printf("received: %lu(%.0f rps, %.2f%%), unmatched: %lu, lost: %lu\n", lg.received,
+           lg.received / elapsed, lg.sent? 100.0 * lg.received / lg.sent: 0.0, lg.unmatched,
+           lost + lg.timeouts);
+
+    printf("\n# rcodes\n");
+    for (int i = 0; i < NR_RCODES; ++i) {
+        if (lg.rcodes[i] == 0) continue;
+        printf("%s: %lu(%.2f%%)\n", rcodeNames[i], lg.rcodes[i], 100.0 * lg.rcodes[i] / lg.received);
+    }
+
+    if (lg.received == 0) return;
+    printf("\n# latency(us)\n");
+    printf("p50: %lu, p90: %lu, p99: %lu, p99.9: %lu, max: %lu\n",
+           percentile(lg.received, 0.5), percentile(lg.received, 0.9),
+           percentile(lg.received, 0.99), percentile(lg.received, 0.999), lg.maxLatencyUs);
+    if (!lg.histogram) return;
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        if (lg.hist[i] == 0) continue;
+        printf("< %6lu: %lu\n", histBucketUpper(i), lg.hist[i]);
+    }
+}
+
+/*----------------------------------------------
+ *     main
+ *---------------------------------------------*/
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s -i <ifname> -s <src ip> -d <dst ip> -f <query file> [options]\n"
+            "  -i, --iface <name>      interface to send the queries(AF_PACKET)\n"
+            "  -s, --src-ip <ip>       source ipv4 address, the responses are received on it\n"
+            "  -d, --dst-ip <ip>       ipv4 address of dns server\n"
+            "  -p, --port <port>       port of dns server(default: 53)\n"
+            "  -M, --dst-mac <mac>     destination mac(default: broadcast)\n"
+            "  -f, --query-file <file> `name [type]` per line, type defaults to A\n"
+            "  -m, --mix <mix>         query mix(default: zipf=100), e.g. zipf=80,uniform=10,nxdomain=10\n"
+            "  -z, --zipf <s>          exponent of zipf distribution(default: 1.0)\n"
+            "  -r, --rate <qps>        target rate(default: 0, as fast as possible)\n"
+            "  -t, --duration <sec>    duration(default: 10)\n"
+            "  -T, --timeout <ms>      wait for the responses after sending(default: 1000)\n"
+            "  -n, --src-ports <n>     number of source ports(flows) starting at 10000(default: 16)\n"
+            "  -e, --edns <size>       add OPT RR with the udp payload size\n"
+            "  -D, --dnssec-ok         set DO bit(implies -e 4096)\n"
+            "  -c, --ecs <prefix>      add EDNS client subnet option, e.g. 1.2.3.0/24(implies -e 4096)\n"
+            "  -H, --histogram         print the whole latency histogram\n",
+            prog);
+    exit(1);
+}
+
+static void parseMac(const char *ss, uint8_t *mac) {
+    unsigned v[ETH_ALEN];
+    if (sscanf(ss, "%x:%x:%x:%x:%x:%x", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) != ETH_ALEN) {
+        die("invalid mac address %s", ss);
+    }
+    for (int i = 0; i < ETH_ALEN; ++i) mac[i] = (uint8_t)v[i];
+}
+
+static void parseEcs(char *ss) {
+    char *slash = strchr(ss, '/');
+    struct in_addr addr;
+    uint32_t mask;
+
+    lg.ecsPrefix = 24;
+    if (slash) {
+        *slash = 0;
+        lg.ecsPrefix = atoi(slash + 1);
+    }
+    if (inet_pton(AF_INET, ss, &addr) != 1 || lg.ecsPrefix < 0 || lg.ecsPrefix > 32) {
+        die("invalid client subnet %s", ss);
+    }
+    mask = lg.ecsPrefix? htonl(~0U << (32 - lg.ecsPrefix)): 0;
+    addr.s_addr &= mask;
+    memcpy(lg.ecsAddr, &addr, 4);
+    lg.ecsSet = true;
+}
+
+static int openPacketSocket(int protocol) {
+    struct sockaddr_ll addr;
+    int fd = socket(AF_PACKET, SOCK_RAW, protocol);
+
+    if (fd < 0) die("can't create AF_PACKET socket: %s(root or CAP_NET_RAW is needed)", strerror(errno));
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = (uint16_t)protocol;
+    addr.sll_ifindex = lg.ifindex;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        die("can't bind to %s: %s", lg.ifname, strerror(errno));
+    }
+    return fd;
+}
+
+static void sigintHandler(int sig) {
+    (void)sig;
+    lg.stop = true;
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option longOpts[] = {
+        {"iface", required_argument, NULL, 'i'},
+        {"src-ip", required_argument, NULL, 's'},
+        {"dst-ip", required_argument, NULL, 'd'},
+        {"port", required_argument, NULL, 'p'},
+        {"dst-mac", required_argument, NULL, 'M'},
+        {"query-file", required_argument, NULL, 'f'},
+        {"mix", required_argument, NULL, 'm'},
+        {"zipf", required_argument, NULL, 'z'},
+        {"rate", required_argument, NULL, 'r'},
+        {"duration", required_argument, NULL, 't'},
+        {"timeout", required_argument, NULL, 'T'},
+        {"src-ports", required_argument, NULL, 'n'},
+        {"edns", required_argument, NULL, 'e'},
+        {"dnssec-ok", no_argument, NULL, 'D'},
+        {"ecs", required_argument, NULL, 'c'},
+        {"histogram", no_argument, NULL, 'H'},
+        {NULL, 0, NULL, 0},
+    };
+    struct ifreq ifr;
+    pthread_t receiver;
+    int opt, txFd, rxFd;
+    uint64_t start;
+    double elapsed;
+    bool srcSet = false, dstSet = false;
+
+    lg.dstPort = 53;
+    lg.srcPortBase = 10000;
+    lg.nrSrcPorts = 16;
+    lg.zipfS = 1.0;
+    lg.weights[DIST_ZIPF] = 100;
+    lg.duration = 10;
+    lg.timeoutMs = 1000;
+    memset(lg.dstMac, 0xff, ETH_ALEN);
+
+    while ((opt = getopt_long(argc, argv, "i:s:d:p:M:f:m:z:r:t:T:n:e:Dc:Hh", longOpts, NULL)) != -1) {
+        switch (opt) {
+            case 'i': lg.ifname = optarg; break;
+            case 's': srcSet = inet_pton(AF_INET, optarg, &lg.srcIp) == 1; break;
+            case 'd': dstSet = inet_pton(AF_INET, optarg, &lg.dstIp) == 1; break;
+            case 'p': lg.dstPort = (uint16_t)atoi(optarg); break;
+            case 'M': parseMac(optarg, lg.dstMac); break;
+            case 'f': lg.queryFile = optarg; break;
+            case 'm': parseMix(optarg); break;
+            case 'z': lg.zipfS = atof(optarg); break;
+            case 'r': lg.rate = atol(optarg); break;
+            case 't': lg.duration = atoi(optarg); break;
+            case 'T': lg.timeoutMs = atoi(optarg); break;
+            case 'n': lg.nrSrcPorts = atoi(optarg); break;
+            case 'e': lg.ednsSize = atoi(optarg); break;
+            case 'D': lg.dnssecOk = true; break;
+            case 'c': parseEcs(optarg); break;
+            case 'H': lg.histogram = true; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (lg.ifname == NULL || !srcSet || !dstSet || lg.queryFile == NULL) usage(argv[0]);
+    if (lg.nrSrcPorts <= 0 || lg.nrSrcPorts > 1024) die("src-ports should in 1-1024");
+    if (lg.rate < 0 || lg.duration <= 0 || lg.timeoutMs < 0) die("rate, duration and timeout should be positive");
+    if ((lg.dnssecOk || lg.ecsSet) && lg.ednsSize == 0) lg.ednsSize = 4096;
+    for (int i = 0; i < NR_DISTS; ++i) lg.totalWeight += lg.weights[i];
+    if (lg.totalWeight <= 0) die("the weights of mix are all zero");
+
+    if ((lg.ifindex = (int)if_nametoindex(lg.ifname)) == 0) die("unknown interface %s", lg.ifname);
+    txFd = openPacketSocket(0);
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, IFNAMSIZ, "%s", lg.ifname);
+    if (ioctl(txFd, SIOCGIFHWADDR, &ifr) < 0) die("can't get mac of %s: %s", lg.ifname, strerror(errno));
+    memcpy(lg.srcMac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+    rxFd = openPacketSocket(htons(ETH_P_IP));
+
+    loadQueries(lg.queryFile);
+    initZipf();
+    lg.inflight = calloc((size_t)lg.nrSrcPorts << 16, sizeof(uint64_t));
+    if (lg.inflight == NULL) die("out of memory");
+
+    printf("%d queries from %s, mix:", lg.nrQueries, lg.queryFile);
+    for (int i = 0; i < NR_DISTS; ++i) {
+        if (lg.weights[i] > 0) printf(" %s=%d", distNames[i], lg.weights[i]);
+    }
+    printf(", rate: %ld qps, duration: %ds\n", lg.rate, lg.duration);
+
+    signal(SIGINT, sigintHandler);
+    if (pthread_create(&receiver, NULL, receiverMain, &rxFd) != 0) die("can't create receiver thread");
+    start = nstime();
+    sendLoop(txFd);
+    elapsed = (double)(nstime() - start) / 1e9;
+    // wait for the responses in flight
+    usleep((useconds_t)lg.timeoutMs * 1000);
+    lg.recvStop = true;
+    pthread_join(receiver, NULL);
+    report(elapsed);
+    close(txFd);
+    close(rxFd);
+    return 0;
+}
@@ -7,7 +7,11 @@
 from __future__ import print_function, division, absolute_import
 import argparse
 import io
+import datetime
+import socket
+import struct
 from collections import defaultdict
+from bson.binary import Binary
 from pymongo import MongoClient
 
 
@@ -177,8 +181,15 @@ def parse_zone_str(ss):
 
         prev_domain = None
         prev_ttl = default_ttl
+        view = None
 
         while record:
+            # $VIEW starts the records of a GeoDNS view, $VIEW without name returns to the default view.
+            if record.startswith("$VIEW"):
+                parts = record.split()
+                view = parts[1] if len(parts) > 1 and parts[1].lower() != "default" else None
+                record = read_record(fp)
+                continue
             remain = record
             if record[0] in ' \t':
                 if prev_domain is None:
@@ -201,6 +212,8 @@ def parse_zone_str(ss):
                 "type": dns_type,
                 "rdata": rdata_txt,
             }
+            if view:
+                v["view"] = view
             rr_list.append(v)
             abs_domain = to_abs_domain(domain, dot_origin)
 
@@ -215,10 +228,95 @@ def parse_zone_file(fname):
         return parse_zone_str(fp.read())
 
 
+def name_to_wire(name):
+    """
+    absolute domain name to len label format.
+    """
+    name = name.rstrip(".")
+    buf = b""
+    if name:
+        for label in name.split("."):
+            label = label.encode("utf8")
+            if not 0 < len(label) <= 63:
+                raise Exception("invalid domain name %s" % name)
+            buf += struct.pack("B", len(label)) + label
+    return buf + b"\x00"
+
+
+def rdata_name_to_wire(name, dot_origin):
+    # the names in rdata may not belong to this zone
+    if not name.endswith("."):
+        name = to_abs_domain(name, dot_origin)
+    return name_to_wire(name)
+
+
+def parse_time(ss):
+    units = {"s": 1, "m": 60, "h": 3600, "d": 86400, "w": 604800}
+    total = 0
+    num = ""
+    for c in ss.lower():
+        if c.isdigit():
+            num += c
+        else:
+            total += int(num) * units[c]
+            num = ""
+    if num:
+        total += int(num)
+    return total
+
+
+def rdata_to_wire(dns_type, rdata, dot_origin):
+    """
+    encode text rdata to uncompressed wire format, the same as the zone parser of shuke.
+    """
+    tokens = tokenize(rdata)
+    if dns_type == "A":
+        return socket.inet_pton(socket.AF_INET, tokens[0])
+    elif dns_type == "AAAA":
+        return socket.inet_pton(socket.AF_INET6, tokens[0])
+    elif dns_type in ("NS", "CNAME", "PTR"):
+        return rdata_name_to_wire(tokens[0], dot_origin)
+    elif dns_type == "MX":
+        return struct.pack("!H", int(tokens[0])) + rdata_name_to_wire(tokens[1], dot_origin)
+    elif dns_type == "SRV":
+        return struct.pack("!HHH", int(tokens[0]), int(tokens[1]), int(tokens[2])) + \
+               rdata_name_to_wire(tokens[3], dot_origin)
+    elif dns_type == "TXT":
+        buf = b""
+        for tok in tokens:
+            tok = tok.strip('"').encode("utf8")
+            if len(tok) > 255:
+                raise Exception("txt string is too long")
+            buf += struct.pack("B", len(tok)) + tok
+        return buf
+    elif dns_type == "SOA":
+        buf = rdata_name_to_wire(tokens[0], dot_origin)
+        buf += rdata_name_to_wire(tokens[1], dot_origin)
+        return buf + struct.pack("!IIIII", int(tokens[2]), *[parse_time(t) for t in tokens[3:7]])
+    raise Exception("unsupported dns type %s" % dns_type)
+
+
+def add_wire_fields(dot_origin, rr_list):
+    """
+    add the pre-encoded owner name and rdata, so shuke needn't parse the text rdata.
+    """
+    for rr in rr_list:
+        rr["owner"] = Binary(name_to_wire(to_abs_domain(rr["name"], dot_origin).lower()))
+        rr["wire"] = Binary(rdata_to_wire(rr["type"], rr["rdata"], dot_origin))
+
+def get_serial(rr_list):
+    for rr in rr_list:
+        if rr["type"].upper() == "SOA":
+            return int(rr["rdata"].split()[2])
+    raise Exception("zone must contain a SOA record")
+
+
 class ZoneMongo(object):
-    def __init__(self, host, port, dbname="zone"):
+    def __init__(self, host, port, dbname="zone", catalog=None, wire=False):
         self.r = MongoClient(host=host, port=port)
         self.dbname = dbname
+        self.catalog = catalog
+        self.wire = wire
 
     def __getattr__(self, name):
         try:
@@ -237,11 +335,26 @@ class ZoneMongo(object):
     def write_to_mongo(self, dot_origin, rr_list):
         db = self.r[self.dbname]
         col = db[dot_origin[:-1]]
+        if self.wire:
+            add_wire_fields(dot_origin, rr_list)
         col.insert_many(rr_list)
+        self.update_catalog(dot_origin, rr_list)
+
+    def update_catalog(self, dot_origin, rr_list):
+        if not self.catalog:
+            return
+        db = self.r[self.dbname]
+        zone = dot_origin.strip(".")
+        db[self.catalog].replace_one(
+            {"zone": zone},
+            {"zone": zone, "serial": get_serial(rr_list), "updated_at": datetime.datetime.utcnow()},
+            upsert=True)
 
     def del_zone(self, dot_origin):
         db = self.r[self.dbname]
         db.remove_collection(dot_origin)
+        if self.catalog:
+            db[self.catalog].delete_many({"zone": dot_origin.strip(".")})
 
     def debug_zone_file(self, fname):
         dot_origin, rr_list = parse_zone_file(fname)
@@ -264,12 +377,14 @@ def parse_cmd_args():
     parser.add_argument('-f', '--file', required=True, help="zone file")
     parser.add_argument('-Mh', '--mongo_host', default="127.0.0.1", help='mongodb host(default: 127.0.0.1)')
     parser.add_argument('-Mp', '--mongo_port', default=27017, type=int, help='mongodb port(default: 27017)')
+    parser.add_argument('-c', '--catalog', default=None, help='zone catalog collection to update(default: disabled)')
+    parser.add_argument('-w', '--wire', action='store_true', help='also store the owner name and rdata in wire format')
     return parser.parse_args()
 
 
 if __name__ == '__main__':
     parsed = parse_cmd_args()
-    zm = ZoneMongo(parsed.mongo_host, parsed.mongo_port)
+    zm = ZoneMongo(parsed.mongo_host, parsed.mongo_port, catalog=parsed.catalog, wire=parsed.wire)
     zm.file_to_mongo(parsed.file)
     print(zm.debug_zone_file(parsed.file))
     # zr.del_zone("example.com.")